@@ -23,6 +23,7 @@ G_BEGIN_DECLS
 #define SDP_MEDIA_RTCP_FB_NACK "nack"
 #define SDP_MEDIA_RTCP_FB_CCM "ccm"
 #define SDP_MEDIA_RTCP_FB_GOOG_REMB "goog-remb"
+#define SDP_MEDIA_RTCP_FB_TRANSPORT_CC "transport-cc"
 #define SDP_MEDIA_RTCP_FB_PLI "pli"
 #define SDP_MEDIA_RTCP_FB_FIR "fir"
 
@@ -30,6 +31,12 @@ G_BEGIN_DECLS
 #define RTP_HDR_EXT_ABS_SEND_TIME_URI "http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time"
 #define RTP_HDR_EXT_ABS_SEND_TIME_SIZE 3
 #define RTP_HDR_EXT_ABS_SEND_TIME_ID 3  /* TODO: do it dynamic when needed */
+#define RTP_HDR_EXT_TRANSPORT_CC_URI "http://www.ietf.org/id/draft-holmer-rmcat-transport-wide-cc-extensions-01"
+#define RTP_HDR_EXT_TRANSPORT_CC_SIZE 2
+#define RTP_HDR_EXT_TRANSPORT_CC_ID 5  /* TODO: do it dynamic when needed */
+#define RTP_HDR_EXT_AUDIO_LEVEL_URI "urn:ietf:params:rtp-hdrext:ssrc-audio-level"
+#define RTP_HDR_EXT_AUDIO_LEVEL_SIZE 1
+#define RTP_HDR_EXT_AUDIO_LEVEL_ID 1  /* TODO: do it dynamic when needed */
 
 /* RTP/RTCP profiles */
 #define SDP_MEDIA_RTP_AVP_PROTO "RTP/AVP"
@@ -0,0 +1,196 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsadaptivelatency.h"
+
+#define GST_CAT_DEFAULT kms_adaptive_latency_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsadaptivelatency"
+
+#define JITTER_FACTOR 4         /* Latency covers 4 times the jitter */
+#define JITTER_MARGIN 10        /* ms */
+#define JITTER_MAX_SAMPLE GST_SECOND    /* Bigger samples are stream jumps */
+#define LATE_RATE_THRESHOLD 0.005
+#define LATE_INCREASE_FACTOR 1.25
+#define MAX_INCREASE_STEP 100   /* ms per update */
+#define MAX_DECREASE_STEP 10    /* ms per update */
+#define MIN_LATENCY_CHANGE 5    /* ms */
+#define DECREASE_HOLD_TIME (10 * GST_SECOND)
+
+struct _KmsAdaptiveLatency
+{
+  GMutex mutex;
+
+  guint latency;
+  guint min_latency;
+  guint max_latency;
+
+  gboolean has_packet;
+  guint32 last_ts;
+  GstClockTime last_arrival;
+  gdouble jitter;               /* ns */
+
+  /* Do not decrease before this time */
+  GstClockTime hold_until;
+};
+
+KmsAdaptiveLatency *
+kms_adaptive_latency_new (guint initial_latency, guint min_latency,
+    guint max_latency)
+{
+  KmsAdaptiveLatency *al = g_slice_new0 (KmsAdaptiveLatency);
+
+  g_mutex_init (&al->mutex);
+  al->min_latency = min_latency;
+  al->max_latency = MAX (min_latency, max_latency);
+  al->latency = CLAMP (initial_latency, al->min_latency, al->max_latency);
+
+  return al;
+}
+
+void
+kms_adaptive_latency_destroy (KmsAdaptiveLatency * al)
+{
+  if (al == NULL) {
+    return;
+  }
+
+  g_mutex_clear (&al->mutex);
+  g_slice_free (KmsAdaptiveLatency, al);
+}
+
+void
+kms_adaptive_latency_packet_received (KmsAdaptiveLatency * al,
+    guint32 rtp_ts, gint clock_rate, GstClockTime arrival_time)
+{
+  gint32 ts_diff;
+  gint64 d;
+
+  if (clock_rate <= 0) {
+    return;
+  }
+
+  g_mutex_lock (&al->mutex);
+
+  if (!al->has_packet) {
+    al->has_packet = TRUE;
+    goto end;
+  }
+
+  /* Difference of the relative transit times (RFC 3550 A.8) */
+  ts_diff = (gint32) (rtp_ts - al->last_ts);
+  d = (gint64) (arrival_time - al->last_arrival);
+  if (ts_diff >= 0) {
+    d -= gst_util_uint64_scale_int (ts_diff, GST_SECOND, clock_rate);
+  } else {
+    d += gst_util_uint64_scale_int (-ts_diff, GST_SECOND, clock_rate);
+  }
+
+  d = ABS (d);
+  if (d > JITTER_MAX_SAMPLE) {
+    GST_DEBUG ("Ignoring jitter sample of %" G_GINT64_FORMAT " ns", d);
+    goto end;
+  }
+
+  al->jitter += (d - al->jitter) / 16.0;
+
+end:
+  al->last_ts = rtp_ts;
+  al->last_arrival = arrival_time;
+
+  g_mutex_unlock (&al->mutex);
+}
+
+gboolean
+kms_adaptive_latency_update (KmsAdaptiveLatency * al, guint64 pushed,
+    guint64 late, GstClockTime now, guint * latency)
+{
+  guint target, current;
+  gboolean changed = FALSE;
+
+  g_mutex_lock (&al->mutex);
+
+  current = al->latency;
+  target = JITTER_FACTOR * al->jitter / GST_MSECOND + JITTER_MARGIN;
+
+  if (pushed + late > 0 && (gdouble) late / (pushed + late) >
+      LATE_RATE_THRESHOLD) {
+    /* Drop-outs: grow over the current value whatever the jitter says */
+    target = MAX (target, current * LATE_INCREASE_FACTOR);
+    al->hold_until = now + DECREASE_HOLD_TIME;
+  }
+
+  target = CLAMP (target, al->min_latency, al->max_latency);
+
+  if (target > current) {
+    al->latency = MIN (target, current + MAX_INCREASE_STEP);
+    al->hold_until = MAX (al->hold_until, now + DECREASE_HOLD_TIME);
+  } else if (target < current && late == 0 && now >= al->hold_until) {
+    /* Go down slowly so that the playout is not disrupted */
+    al->latency = MAX (target, current - MIN (current, MAX_DECREASE_STEP));
+  }
+
+  if (al->latency != current &&
+      (ABS ((gint) al->latency - (gint) current) >= MIN_LATENCY_CHANGE ||
+          al->latency == al->min_latency || al->latency == al->max_latency)) {
+    GST_DEBUG ("Latency %u -> %u ms (jitter %.2f ms, late %" G_GUINT64_FORMAT
+        "/%" G_GUINT64_FORMAT ")", current, al->latency,
+        al->jitter / GST_MSECOND, late, pushed + late);
+    changed = TRUE;
+  } else {
+    al->latency = current;
+  }
+
+  *latency = al->latency;
+
+  g_mutex_unlock (&al->mutex);
+
+  return changed;
+}
+
+guint
+kms_adaptive_latency_get_latency (KmsAdaptiveLatency * al)
+{
+  guint latency;
+
+  g_mutex_lock (&al->mutex);
+  latency = al->latency;
+  g_mutex_unlock (&al->mutex);
+
+  return latency;
+}
+
+GstClockTime
+kms_adaptive_latency_get_jitter (KmsAdaptiveLatency * al)
+{
+  GstClockTime jitter;
+
+  g_mutex_lock (&al->mutex);
+  jitter = al->jitter;
+  g_mutex_unlock (&al->mutex);
+
+  return jitter;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,49 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_ADAPTIVE_LATENCY_H__
+#define __KMS_ADAPTIVE_LATENCY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Computes the jitter buffer latency of one SSRC from its interarrival
+ * jitter (RFC 3550) and the rate of packets arriving too late to be played.
+ * Latencies are in milliseconds.
+ */
+typedef struct _KmsAdaptiveLatency KmsAdaptiveLatency;
+
+KmsAdaptiveLatency * kms_adaptive_latency_new (guint initial_latency,
+    guint min_latency, guint max_latency);
+void kms_adaptive_latency_destroy (KmsAdaptiveLatency * al);
+
+void kms_adaptive_latency_packet_received (KmsAdaptiveLatency * al,
+    guint32 rtp_ts, gint clock_rate, GstClockTime arrival_time);
+
+/* @pushed and @late are the packets played and arrived too late since the
+ * last update. Returns TRUE if the latency has to be changed to @latency */
+gboolean kms_adaptive_latency_update (KmsAdaptiveLatency * al, guint64 pushed,
+    guint64 late, GstClockTime now, guint * latency);
+
+guint kms_adaptive_latency_get_latency (KmsAdaptiveLatency * al);
+/* Interarrival jitter in nanoseconds */
+GstClockTime kms_adaptive_latency_get_jitter (KmsAdaptiveLatency * al);
+
+G_END_DECLS
+#endif /* __KMS_ADAPTIVE_LATENCY_H__ */
@@ -0,0 +1,205 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsaudiolevelmeta.h"
+
+#include <gst/rtp/gstrtpbuffer.h>
+#include "constants.h"
+
+#define KMS_AUDIO_LEVEL_GATE_EVENT_NAME "KmsAudioLevelGate"
+
+/* 10^(-1/10), power ratio of one dB */
+#define DB_POWER_RATIO 0.7943282347242815
+
+static gdouble level_power[KMS_AUDIO_LEVEL_SILENCE + 1];
+
+GType
+kms_audio_level_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("KmsAudioLevelMetaAPI", tags);
+
+    g_once_init_leave (&type, _type);
+  }
+
+  return type;
+}
+
+static gboolean
+kms_audio_level_meta_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  KmsAudioLevelMeta *lmeta = (KmsAudioLevelMeta *) meta;
+
+  lmeta->level = KMS_AUDIO_LEVEL_SILENCE;
+  lmeta->voice = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+kms_audio_level_meta_transform (GstBuffer * transbuf, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  KmsAudioLevelMeta *lmeta = (KmsAudioLevelMeta *) meta;
+
+  /* we always copy no matter what transform */
+  if (!GST_META_TRANSFORM_IS_COPY (type)) {
+    return TRUE;
+  }
+
+  return kms_buffer_add_audio_level_meta (transbuf, lmeta->level,
+      lmeta->voice) != NULL;
+}
+
+const GstMetaInfo *
+kms_audio_level_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter (&meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (KMS_AUDIO_LEVEL_META_API_TYPE,
+        "KmsAudioLevelMeta",
+        sizeof (KmsAudioLevelMeta),
+        kms_audio_level_meta_init,
+        NULL,
+        kms_audio_level_meta_transform);
+
+    g_once_init_leave (&meta_info, mi);
+  }
+
+  return meta_info;
+}
+
+KmsAudioLevelMeta *
+kms_buffer_add_audio_level_meta (GstBuffer * buffer, guint8 level,
+    gboolean voice)
+{
+  KmsAudioLevelMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  meta = kms_buffer_get_audio_level_meta (buffer);
+  if (meta == NULL) {
+    meta = (KmsAudioLevelMeta *) gst_buffer_add_meta (buffer,
+        KMS_AUDIO_LEVEL_META_INFO, NULL);
+  }
+
+  meta->level = MIN (level, KMS_AUDIO_LEVEL_SILENCE);
+  meta->voice = voice;
+
+  return meta;
+}
+
+KmsAudioLevelMeta *
+kms_buffer_add_audio_level_meta_from_rtp (GstBuffer * buffer, guint8 id)
+{
+  GstRTPBuffer rtp = { NULL, };
+  KmsAudioLevelMeta *meta = NULL;
+  gpointer ext;
+  guint size;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    return NULL;
+  }
+
+  if (gst_rtp_buffer_get_extension_onebyte_header (&rtp, id, 0, &ext, &size)
+      && size == RTP_HDR_EXT_AUDIO_LEVEL_SIZE) {
+    guint8 value = GST_READ_UINT8 (ext);
+
+    /* V bit and the level in -dBov */
+    meta = kms_buffer_add_audio_level_meta (buffer, value & 0x7f, value >> 7);
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  return meta;
+}
+
+gdouble
+kms_audio_level_to_power (guint8 level)
+{
+  return level_power[MIN (level, KMS_AUDIO_LEVEL_SILENCE)];
+}
+
+guint8
+kms_audio_level_from_power (gdouble power)
+{
+  guint8 level = 0;
+
+  while (level < KMS_AUDIO_LEVEL_SILENCE
+      && level_power[level + 1] >= power) {
+    level++;
+  }
+
+  return level;
+}
+
+/* Audio level gate event begin */
+
+GstEvent *
+kms_audio_level_gate_event_new (guint8 level)
+{
+  return gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
+      gst_structure_new (KMS_AUDIO_LEVEL_GATE_EVENT_NAME,
+          "level", G_TYPE_UINT, (guint) MIN (level, KMS_AUDIO_LEVEL_SILENCE),
+          NULL));
+}
+
+gboolean
+kms_audio_level_gate_event_parse (GstEvent * event, guint8 * level)
+{
+  const GstStructure *s;
+  guint value;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CUSTOM_UPSTREAM) {
+    return FALSE;
+  }
+
+  s = gst_event_get_structure (event);
+  if (!gst_structure_has_name (s, KMS_AUDIO_LEVEL_GATE_EVENT_NAME)
+      || !gst_structure_get_uint (s, "level", &value)) {
+    return FALSE;
+  }
+
+  if (level != NULL) {
+    *level = value;
+  }
+
+  return TRUE;
+}
+
+/* Audio level gate event end */
+
+static void init_levels (void) __attribute__ ((constructor));
+
+static void
+init_levels (void)
+{
+  guint i;
+
+  level_power[0] = 1.0;
+  for (i = 1; i < KMS_AUDIO_LEVEL_SILENCE; i++) {
+    level_power[i] = level_power[i - 1] * DB_POWER_RATIO;
+  }
+
+  /* 127 means digital silence */
+  level_power[KMS_AUDIO_LEVEL_SILENCE] = 0.0;
+}
@@ -0,0 +1,83 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_AUDIO_LEVEL_META_H__
+#define __KMS_AUDIO_LEVEL_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define KMS_AUDIO_LEVEL_SILENCE 127
+
+typedef struct _KmsAudioLevelMeta KmsAudioLevelMeta;
+
+/**
+ * KmsAudioLevelMeta:
+ * @meta: the parent type
+ * @level: audio level in -dBov, from 0 (loudest) to 127 (silence)
+ * @voice: whether the sender detected voice activity
+ *
+ * Audio level of a packet, as signaled by the client-to-mixer audio level
+ * RTP header extension (RFC 6464). It is kept through depayloading and
+ * decoding, so mixers can know the level without looking at samples.
+ */
+struct _KmsAudioLevelMeta {
+  GstMeta       meta;
+
+  guint8 level;
+  gboolean voice;
+};
+
+GType kms_audio_level_meta_api_get_type (void);
+#define KMS_AUDIO_LEVEL_META_API_TYPE \
+  (kms_audio_level_meta_api_get_type())
+
+#define kms_buffer_get_audio_level_meta(b) \
+  ((KmsAudioLevelMeta*)gst_buffer_get_meta((b), KMS_AUDIO_LEVEL_META_API_TYPE))
+
+/* implementation */
+const GstMetaInfo *kms_audio_level_meta_get_info (void);
+#define KMS_AUDIO_LEVEL_META_INFO (kms_audio_level_meta_get_info ())
+
+KmsAudioLevelMeta * kms_buffer_add_audio_level_meta (GstBuffer *buffer,
+  guint8 level, gboolean voice);
+
+/* Reads the client-to-mixer audio level extension (RFC 6464) of an RTP
+ * buffer with extension @id into its meta. Returns NULL when missing */
+KmsAudioLevelMeta * kms_buffer_add_audio_level_meta_from_rtp (
+  GstBuffer *buffer, guint8 id);
+
+/* Power relative to full scale, from 0 to 1, of a level in -dBov */
+gdouble kms_audio_level_to_power (guint8 level);
+
+/* Quietest level whose power is at least @power */
+guint8 kms_audio_level_from_power (gdouble power);
+
+/* Audio level gate event */
+
+/*
+ * Sent upstream by mixers so that buffers quieter than @level are dropped
+ * before being decoded. KMS_AUDIO_LEVEL_SILENCE lets every buffer through.
+ * Decoders shared by several consumers apply the loosest of their gates.
+ */
+GstEvent * kms_audio_level_gate_event_new (guint8 level);
+gboolean kms_audio_level_gate_event_parse (GstEvent *event, guint8 *level);
+
+G_END_DECLS
+
+#endif /* __KMS_AUDIO_LEVEL_META_H__ */
@@ -85,6 +85,8 @@ enum
 {
   SIGNAL_HANDLE_PORT,
   SIGNAL_UNHANDLE_PORT,
+  SIGNAL_HANDLE_PORTS,
+  SIGNAL_UNHANDLE_PORTS,
   LAST_SIGNAL
 };
 
@@ -96,6 +98,11 @@ struct _KmsBaseHubPrivate
   GRecMutex mutex;
   gint port_count;
   gint pad_added_id;
+
+  /* Port batches in progress, accessed atomically */
+  gint batch;
+  GSList *blocked_pads;
+  gint latency_pending;
 };
 
 typedef struct _KmsBaseHubPortData KmsBaseHubPortData;
@@ -666,14 +673,154 @@ kms_base_hub_generate_port_id (KmsBaseHub * hub)
   return id;
 }
 
+/* Batches begin */
+
+#define KEY_BATCH_PROBE "kms-key-batch-probe"
+G_DEFINE_QUARK (KEY_BATCH_PROBE, key_batch_probe);
+
+static GstPadProbeReturn
+kms_base_hub_batch_block (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+void
+kms_base_hub_batch_block_pad (KmsBaseHub * hub, GstPad * pad)
+{
+  gulong probe_id;
+
+  probe_id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
+      kms_base_hub_batch_block, NULL, NULL);
+  g_object_set_qdata (G_OBJECT (pad), key_batch_probe_quark (),
+      GSIZE_TO_POINTER (probe_id));
+
+  KMS_BASE_HUB_LOCK (hub);
+  hub->priv->blocked_pads =
+      g_slist_prepend (hub->priv->blocked_pads, g_object_ref (pad));
+  KMS_BASE_HUB_UNLOCK (hub);
+}
+
+static void
+kms_base_hub_batch_unblock_pad (GstPad * pad)
+{
+  gulong probe_id;
+
+  probe_id = GPOINTER_TO_SIZE (g_object_steal_qdata (G_OBJECT (pad),
+          key_batch_probe_quark ()));
+  gst_pad_remove_probe (pad, probe_id);
+}
+
+void
+kms_base_hub_begin_batch (KmsBaseHub * hub)
+{
+  KMS_BASE_HUB_LOCK (hub);
+  g_atomic_int_inc (&hub->priv->batch);
+}
+
+void
+kms_base_hub_end_batch (KmsBaseHub * hub)
+{
+  GSList *blocked = NULL;
+  gboolean latency = FALSE;
+
+  if (g_atomic_int_dec_and_test (&hub->priv->batch)) {
+    blocked = hub->priv->blocked_pads;
+    hub->priv->blocked_pads = NULL;
+    latency = g_atomic_int_compare_and_exchange (&hub->priv->latency_pending,
+        TRUE, FALSE);
+  }
+
+  KMS_BASE_HUB_UNLOCK (hub);
+
+  g_slist_foreach (blocked, (GFunc) kms_base_hub_batch_unblock_pad, NULL);
+  g_slist_free_full (blocked, g_object_unref);
+
+  if (latency) {
+    gst_element_post_message (GST_ELEMENT (hub),
+        gst_message_new_latency (GST_OBJECT (hub)));
+  }
+}
+
+static GArray *
+kms_base_hub_handle_ports (KmsBaseHub * hub, GPtrArray * hub_ports)
+{
+  KmsBaseHubClass *klass = KMS_BASE_HUB_CLASS (G_OBJECT_GET_CLASS (hub));
+  GArray *ids;
+  guint i;
+
+  ids = g_array_sized_new (FALSE, FALSE, sizeof (gint), hub_ports->len);
+
+  kms_base_hub_begin_batch (hub);
+
+  for (i = 0; i < hub_ports->len; i++) {
+    gint id = klass->handle_port (hub, g_ptr_array_index (hub_ports, i));
+
+    g_array_append_val (ids, id);
+  }
+
+  kms_base_hub_end_batch (hub);
+
+  return ids;
+}
+
+static void
+kms_base_hub_unhandle_ports (KmsBaseHub * hub, GArray * ids)
+{
+  KmsBaseHubClass *klass = KMS_BASE_HUB_CLASS (G_OBJECT_GET_CLASS (hub));
+  guint i;
+
+  kms_base_hub_begin_batch (hub);
+
+  for (i = 0; i < ids->len; i++) {
+    klass->unhandle_port (hub, g_array_index (ids, gint, i));
+  }
+
+  kms_base_hub_end_batch (hub);
+}
+
+static void
+kms_base_hub_handle_message (GstBin * bin, GstMessage * message)
+{
+  KmsBaseHub *hub = KMS_BASE_HUB (bin);
+
+  /*
+   * Latency is recalculated once, when the batch ends. The hub lock is not
+   * taken here, as messages are posted from streaming threads. If the batch
+   * ended meanwhile, whoever clears the pending flag posts the message.
+   */
+  if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_LATENCY &&
+      g_atomic_int_get (&hub->priv->batch) > 0) {
+    g_atomic_int_set (&hub->priv->latency_pending, TRUE);
+
+    if (g_atomic_int_get (&hub->priv->batch) > 0 ||
+        !g_atomic_int_compare_and_exchange (&hub->priv->latency_pending,
+            TRUE, FALSE)) {
+      gst_message_unref (message);
+      return;
+    }
+  }
+
+  GST_BIN_CLASS (kms_base_hub_parent_class)->handle_message (bin, message);
+}
+
+/* Batches end */
+
 static void
 hub_pad_added (KmsBaseHub * hub, GstPad * pad, gpointer data)
 {
+  KMS_BASE_HUB_LOCK (hub);
+
   if (gst_pad_get_direction (pad) != GST_PAD_SRC) {
+    KMS_BASE_HUB_UNLOCK (hub);
     return;
   }
 
-  KMS_BASE_HUB_LOCK (hub);
+  /* Outputs linked during a batch start flowing when it ends */
+  if (g_atomic_int_get (&hub->priv->batch) > 0 &&
+      (g_str_has_prefix (GST_OBJECT_NAME (pad), VIDEO_SRC_PAD_PREFIX) ||
+          g_str_has_prefix (GST_OBJECT_NAME (pad), AUDIO_SRC_PAD_PREFIX))) {
+    kms_base_hub_batch_block_pad (hub, pad);
+  }
 
   if (g_str_has_prefix (GST_OBJECT_NAME (pad), VIDEO_SRC_PAD_PREFIX)) {
     KmsBaseHubPortData *port;
@@ -820,6 +967,8 @@ kms_base_hub_class_init (KmsBaseHubClass * klass)
 
   klass->handle_port = GST_DEBUG_FUNCPTR (kms_base_hub_handle_port);
   klass->unhandle_port = GST_DEBUG_FUNCPTR (kms_base_hub_unhandle_port);
+  klass->handle_ports = GST_DEBUG_FUNCPTR (kms_base_hub_handle_ports);
+  klass->unhandle_ports = GST_DEBUG_FUNCPTR (kms_base_hub_unhandle_ports);
 
   klass->link_video_src =
       GST_DEBUG_FUNCPTR (kms_base_hub_link_video_src_default);
@@ -842,6 +991,9 @@ kms_base_hub_class_init (KmsBaseHubClass * klass)
   gobject_class->dispose = GST_DEBUG_FUNCPTR (kms_base_hub_dispose);
   gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_base_hub_finalize);
 
+  GST_BIN_CLASS (klass)->handle_message =
+      GST_DEBUG_FUNCPTR (kms_base_hub_handle_message);
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&audio_src_factory));
   gst_element_class_add_pad_template (gstelement_class,
@@ -866,6 +1018,22 @@ kms_base_hub_class_init (KmsBaseHubClass * klass)
       G_STRUCT_OFFSET (KmsBaseHubClass, unhandle_port), NULL, NULL,
       __kms_core_marshal_VOID__INT, G_TYPE_NONE, 1, G_TYPE_INT);
 
+  /* Handle or unhandle several ports at once: the hub lock is taken once,
+   * new pads start flowing together and latency is recalculated once */
+  kms_base_hub_signals[SIGNAL_HANDLE_PORTS] =
+      g_signal_new ("handle-ports",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_ACTION | G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (KmsBaseHubClass, handle_ports), NULL, NULL,
+      __kms_core_marshal_BOXED__BOXED, G_TYPE_ARRAY, 1, G_TYPE_PTR_ARRAY);
+
+  kms_base_hub_signals[SIGNAL_UNHANDLE_PORTS] =
+      g_signal_new ("unhandle-ports",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_ACTION | G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (KmsBaseHubClass, unhandle_ports), NULL, NULL,
+      __kms_core_marshal_VOID__BOXED, G_TYPE_NONE, 1, G_TYPE_ARRAY);
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsBaseHubPrivate));
 }
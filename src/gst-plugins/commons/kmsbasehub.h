@@ -64,6 +64,8 @@ struct _KmsBaseHubClass
   /* Actions */
   gint (*handle_port) (KmsBaseHub * self, GstElement * mixer_port);
   void (*unhandle_port) (KmsBaseHub * self, gint port_id);
+  GArray *(*handle_ports) (KmsBaseHub * self, GPtrArray * mixer_ports);
+  void (*unhandle_ports) (KmsBaseHub * self, GArray * port_ids);
 
   /* Virtual methods */
   gboolean (*link_video_src) (KmsBaseHub * mixer, gint id,
@@ -103,6 +105,16 @@ gboolean kms_base_hub_unlink_audio_src (KmsBaseHub * mixer, gint id);
 gboolean kms_base_hub_unlink_video_sink (KmsBaseHub * mixer, gint id);
 gboolean kms_base_hub_unlink_audio_sink (KmsBaseHub * mixer, gint id);
 
+/*
+ * Batches group port changes: latency is recalculated once and pads blocked
+ * with kms_base_hub_batch_block_pad start flowing when the outermost batch
+ * ends. kms_base_hub_begin_batch takes the hub lock until the batch ends,
+ * so kms_base_hub_end_batch must be called from the same thread.
+ */
+void kms_base_hub_begin_batch (KmsBaseHub * hub);
+void kms_base_hub_end_batch (KmsBaseHub * hub);
+void kms_base_hub_batch_block_pad (KmsBaseHub * hub, GstPad * pad);
+
 GType kms_base_hub_get_type (void);
 
 G_END_DECLS
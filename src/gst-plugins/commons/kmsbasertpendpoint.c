@@ -33,13 +33,16 @@
 #include "sdpagent/kmssdprtpavpfmediahandler.h"
 #include "kmsremb.h"
 #include "kmsrefstruct.h"
+#include "kmsadaptivelatency.h"
 
 #include <gst/rtp/gstrtpdefs.h>
 #include <gst/rtp/gstrtpbuffer.h>
 #include <gst/rtp/gstrtcpbuffer.h>
 #include <gst/video/video-event.h>
 #include "kmsbufferlacentymeta.h"
+#include "kmsaudiolevelmeta.h"
 #include "kmsstats.h"
+#include "kmssynctrace.h"
 
 #include <glib/gstdio.h>
 
@@ -56,6 +59,9 @@ static void
 kms_i_rtp_session_manager_interface_init (KmsIRtpSessionManagerInterface *
     iface);
 
+static void kms_base_rtp_endpoint_update_pt_table (KmsBaseRtpEndpoint * self,
+    SdpMessageContext * neg_sdp_ctx);
+
 G_DEFINE_TYPE_WITH_CODE (KmsBaseRtpEndpoint, kms_base_rtp_endpoint,
     KMS_TYPE_BASE_SDP_ENDPOINT,
     G_IMPLEMENT_INTERFACE (KMS_TYPE_I_RTP_SESSION_MANAGER,
@@ -73,12 +79,17 @@ G_DEFINE_TYPE_WITH_CODE (KmsBaseRtpEndpoint, kms_base_rtp_endpoint,
 #define JB_INITIAL_LATENCY 0
 #define JB_READY_AUDIO_LATENCY 100
 #define JB_READY_VIDEO_LATENCY 500
+#define JB_ADAPTIVE_MIN_LATENCY 20
+#define JB_ADAPTIVE_MAX_LATENCY 1000
+#define JB_ADAPTIVE_UPDATE_INTERVAL GST_SECOND
 
 #define DEFAULT_MIN_PORT 1
 #define DEFAULT_MAX_PORT G_MAXUINT16
 
 #define PICTURE_ID_15_BIT 2
 
+#define RTP_FIXED_HEADER_SIZE 12
+
 #define index_of(str,chr) ({  \
   gint __pos;                 \
   gchar *__c;                 \
@@ -200,6 +211,52 @@ ext_data_new ()
   return edata;
 }
 
+/* PtTable begin */
+
+#define RTP_MAX_PT 128
+
+typedef struct _PtTableEntry
+{
+  GstCaps *caps;
+  gint clock_rate;
+  KmsMediaType media;
+} PtTableEntry;
+
+/* Immutable once built, a new one replaces it on each negotiation */
+typedef struct _PtTable
+{
+  KmsRefStruct ref;
+  PtTableEntry entries[RTP_MAX_PT];
+} PtTable;
+
+static void
+pt_table_destroy (PtTable * table)
+{
+  guint i;
+
+  for (i = 0; i < RTP_MAX_PT; i++) {
+    if (table->entries[i].caps != NULL) {
+      gst_caps_unref (table->entries[i].caps);
+    }
+  }
+
+  g_slice_free (PtTable, table);
+}
+
+static PtTable *
+pt_table_new ()
+{
+  PtTable *table;
+
+  table = g_slice_new0 (PtTable);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (table),
+      (GDestroyNotify) pt_table_destroy);
+
+  return table;
+}
+
+/* PtTable end */
+
 typedef struct _SsrcSyncData
 {
   GstClockTime last_sr_ext_ts;
@@ -239,16 +296,24 @@ struct _KmsBaseRtpEndpointPrivate
   KmsRembLocal *rl;
   KmsRembRemote *rm;
 
+  /* Transport-wide sequence number for outgoing RTP */
+  gint transport_cc_seqnum;
+
   /* Port range */
   guint min_port;
   guint max_port;
 
+  /* Jitter buffer latency, ms */
+  gboolean jb_adaptive;
+  guint jb_min_latency;
+  guint jb_max_latency;
+
   /* RTP statistics */
   KmsBaseRTPStats stats;
 
   /* Timestamps */
   gssize init_stats;
-  FILE *stats_file;
+  KmsSyncTrace *sync_trace;
 
   /* Synchronization */
   SsrcSyncData audio_sync;
@@ -256,6 +321,10 @@ struct _KmsBaseRtpEndpointPrivate
   GstClockTime base_sync_time;
   GstClockTime base_ntp_ns_time;
   GMutex sync_mutex;
+
+  /* Caps per payload type of the negotiated session */
+  PtTable *pt_table;
+  GMutex pt_table_mutex;
 };
 
 /* Signals and args */
@@ -295,6 +364,7 @@ enum
   PROP_MIN_PORT,
   PROP_MAX_PORT,
   PROP_SUPPORT_FEC,
+  PROP_JITTER_BUFFER_PARAMS,
   PROP_LAST
 };
 
@@ -318,24 +388,41 @@ is_proto (const gchar * term, const gchar * opt, const gchar * proto)
 
 typedef struct _HdrExtData
 {
+  KmsBaseRtpEndpoint *self;
   GstPad *pad;
-  /* Useful to make buffers writable when needed. */
+  /* Add the extensions if they are not already present */
   gboolean add_hdr;
-  gboolean set_time;
+  /* Stamp send time and transport-wide sequence numbers */
+  gboolean stamp;
   gint abs_send_time_id;
+  gint transport_cc_id;
+  /* Shared by every stream sent by the endpoint */
+  gint *transport_cc_seqnum;
 } HdrExtData;
 
+/* Values computed once per buffer or buffer list */
+typedef struct _HdrExtBatch
+{
+  HdrExtData *data;
+  GstClockTime now;
+  guint8 abs_send_time[RTP_HDR_EXT_ABS_SEND_TIME_SIZE];
+} HdrExtBatch;
+
 static HdrExtData *
-hdr_ext_data_new (GstPad * pad, gboolean add_hdr, gboolean set_time,
-    gint abs_send_time_id)
+hdr_ext_data_new (KmsBaseRtpEndpoint * self, GstPad * pad, gboolean add_hdr,
+    gboolean stamp, gint abs_send_time_id, gint transport_cc_id,
+    gint * transport_cc_seqnum)
 {
   HdrExtData *data;
 
   data = g_slice_new0 (HdrExtData);
+  data->self = self;
   data->pad = pad;
   data->add_hdr = add_hdr;
-  data->set_time = set_time;
+  data->stamp = stamp;
   data->abs_send_time_id = abs_send_time_id;
+  data->transport_cc_id = transport_cc_id;
+  data->transport_cc_seqnum = transport_cc_seqnum;
 
   return data;
 }
@@ -353,12 +440,12 @@ hdr_ext_data_destroy_pointer (gpointer data)
 }
 
 static void
-kms_base_rtp_endpoint_rtp_hdr_ext_set_time (guint8 * data)
+kms_base_rtp_endpoint_rtp_hdr_ext_set_time (guint8 * data,
+    GstClockTime current_time)
 {
-  GstClockTime current_time, ms;
+  GstClockTime ms;
   guint value;
 
-  current_time = kms_utils_get_time_nsecs ();
   ms = GST_TIME_AS_MSECONDS (current_time);
   value = (((ms << 18) / 1000) & 0x00ffffff);
 
@@ -368,71 +455,88 @@ kms_base_rtp_endpoint_rtp_hdr_ext_set_time (guint8 * data)
 }
 
 static void
-kms_base_rtp_endpoint_add_rtp_hdr_ext (HdrExtData * data, GstBuffer * buffer)
+kms_base_rtp_endpoint_write_rtp_hdr_ext (HdrExtData * data,
+    GstRTPBuffer * rtp, guint8 id, const gchar * name, const guint8 * value,
+    guint value_size)
 {
-  GstRTPBuffer rtp = { NULL, };
-  guint8 id = data->abs_send_time_id;
-  GstMapFlags map_flags;
-  guint8 *time;
+  gpointer ext;
   guint size;
 
-  if (data->add_hdr) {
-    map_flags = GST_MAP_WRITE;
-  } else {
-    map_flags = GST_MAP_READ;
+  if (!gst_rtp_buffer_get_extension_onebyte_header (rtp, id, 0, &ext, &size)) {
+    GST_TRACE_OBJECT (data->pad,
+        "RTP hdrext %s with id '%d' not found", name, id);
+
+    if (!data->add_hdr) {
+      GST_WARNING_OBJECT (data->pad, "Cannot add new one: not configured");
+      return;
+    }
+
+    GST_TRACE_OBJECT (data->pad, " Adding new one.");
+    if (!gst_rtp_buffer_add_extension_onebyte_header (rtp, id, value,
+            value_size)) {
+      GST_WARNING_OBJECT (data->pad, "RTP hdrext %s not added", name);
+    }
+  } else if (data->stamp) {
+    if (size != value_size) {
+      GST_WARNING_OBJECT (data->pad,
+          "RTP hdrext %s size with id '%d' not matching", name, id);
+    } else {
+      GST_TRACE_OBJECT (data->pad,
+          "RTP hdrext %s with id '%d' found. Update it.", name, id);
+      memcpy (ext, value, value_size);
+    }
   }
+}
+
+static void
+kms_base_rtp_endpoint_add_rtp_hdr_ext (HdrExtBatch * batch,
+    GstBuffer * buffer)
+{
+  HdrExtData *data = batch->data;
+  GstRTPBuffer rtp = { NULL, };
 
-  if (!gst_rtp_buffer_map (buffer, map_flags, &rtp)) {
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READWRITE, &rtp)) {
     GST_WARNING_OBJECT (data->pad, "Can not map RTP buffer");
     return;
   }
 
-  if (!gst_rtp_buffer_get_extension_onebyte_header (&rtp,
-          id, 0, (gpointer) & time, &size)) {
-    GST_TRACE_OBJECT (data->pad,
-        "RTP hdrext abs-send-time with id '%d' not found", id);
+  if (data->abs_send_time_id != -1) {
+    kms_base_rtp_endpoint_write_rtp_hdr_ext (data, &rtp,
+        data->abs_send_time_id, "abs-send-time", batch->abs_send_time,
+        RTP_HDR_EXT_ABS_SEND_TIME_SIZE);
+  }
 
-    if (data->add_hdr) {
-      GST_TRACE_OBJECT (data->pad, " Adding new one.");
-    } else {
-      GST_WARNING_OBJECT (data->pad, "Cannot add new one: not writable");
-      goto end;
-    }
+  if (data->transport_cc_id != -1) {
+    guint8 seqnum[RTP_HDR_EXT_TRANSPORT_CC_SIZE] = { 0, };
 
-    time = g_malloc0 (RTP_HDR_EXT_ABS_SEND_TIME_SIZE);
-    if (data->set_time) {
-      kms_base_rtp_endpoint_rtp_hdr_ext_set_time (time);
-    }
+    if (data->stamp) {
+      KmsRembRemote *rm = data->self->priv->rm;
+      guint16 value =
+          (guint16) g_atomic_int_add (data->transport_cc_seqnum, 1);
 
-    if (!gst_rtp_buffer_add_extension_onebyte_header (&rtp,
-            id, time, RTP_HDR_EXT_ABS_SEND_TIME_SIZE)) {
-      GST_WARNING_OBJECT (data->pad, "RTP hdrext abs-send-time not added");
-    }
+      GST_WRITE_UINT16_BE (seqnum, value);
 
-    g_free (time);
-  } else if (data->set_time) {
-    if (size != RTP_HDR_EXT_ABS_SEND_TIME_SIZE) {
-      GST_WARNING_OBJECT (data->pad,
-          "RTP hdrext abs-send-time size with id '%d' not matching", id);
-    } else {
-      GST_TRACE_OBJECT (data->pad,
-          "RTP hdrext abs-send-time with id '%d' found. Update time.", id);
-      kms_base_rtp_endpoint_rtp_hdr_ext_set_time (time);
+      if (rm != NULL) {
+        /* Send history for the transport-cc feedback */
+        kms_remb_remote_twcc_packet_sent (rm, value,
+            gst_buffer_get_size (buffer), batch->now);
+      }
     }
+
+    kms_base_rtp_endpoint_write_rtp_hdr_ext (data, &rtp,
+        data->transport_cc_id, "transport-cc", seqnum,
+        RTP_HDR_EXT_TRANSPORT_CC_SIZE);
   }
 
-end:
   gst_rtp_buffer_unmap (&rtp);
 }
 
 static gboolean
 kms_base_rtp_endpoint_add_rtp_hdr_ext_bufflist (GstBuffer ** buf, guint idx,
-    HdrExtData * data)
+    HdrExtBatch * batch)
 {
-  if (data->add_hdr) {
-    *buf = gst_buffer_make_writable (*buf);
-  }
-  kms_base_rtp_endpoint_add_rtp_hdr_ext (data, *buf);
+  *buf = gst_buffer_make_writable (*buf);
+  kms_base_rtp_endpoint_add_rtp_hdr_ext (batch, *buf);
 
   return TRUE;
 }
@@ -441,25 +545,35 @@ static GstPadProbeReturn
 kms_base_rtp_endpoint_add_rtp_hdr_ext_probe (GstPad * pad,
     GstPadProbeInfo * info, gpointer gp)
 {
-  HdrExtData *data = (HdrExtData *) gp;
+  HdrExtBatch batch;
+
+  batch.data = (HdrExtData *) gp;
+  batch.now = GST_CLOCK_TIME_NONE;
+  memset (batch.abs_send_time, 0, RTP_HDR_EXT_ABS_SEND_TIME_SIZE);
+
+  if (batch.data->stamp) {
+    /* One clock read for the whole buffer list */
+    batch.now = kms_utils_get_time_nsecs ();
+
+    if (batch.data->abs_send_time_id != -1) {
+      kms_base_rtp_endpoint_rtp_hdr_ext_set_time (batch.abs_send_time,
+          batch.now);
+    }
+  }
 
   if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
     GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
 
-    if (data->add_hdr) {
-      buffer = gst_buffer_make_writable (buffer);
-    }
-    kms_base_rtp_endpoint_add_rtp_hdr_ext (data, buffer);
+    buffer = gst_buffer_make_writable (buffer);
+    kms_base_rtp_endpoint_add_rtp_hdr_ext (&batch, buffer);
     GST_PAD_PROBE_INFO_DATA (info) = buffer;
   } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
     GstBufferList *bufflist = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
 
-    if (data->add_hdr) {
-      bufflist = gst_buffer_list_make_writable (bufflist);
-    }
+    bufflist = gst_buffer_list_make_writable (bufflist);
     gst_buffer_list_foreach (bufflist,
         (GstBufferListFunc) kms_base_rtp_endpoint_add_rtp_hdr_ext_bufflist,
-        data);
+        &batch);
 
     GST_PAD_PROBE_INFO_DATA (info) = bufflist;
   }
@@ -469,15 +583,20 @@ kms_base_rtp_endpoint_add_rtp_hdr_ext_probe (GstPad * pad,
 
 static void
 kms_base_rtp_endpoint_config_rtp_hdr_ext (KmsBaseRtpEndpoint * self,
-    SdpMediaConfig * mconf, GstElement * payloader)
+    SdpMediaConfig * mconf, GstElement * payloader, gboolean abs_send_time)
 {
   HdrExtData *data;
-  gint abs_send_time_id;
+  gint abs_send_time_id = -1;
+  gint transport_cc_id;
   GstPad *pad;
 
-  abs_send_time_id = kms_sdp_media_config_get_abs_send_time_id (mconf);
-  if (abs_send_time_id == -1) {
-    GST_DEBUG_OBJECT (self, "abs-send-time-id not configured.");
+  if (abs_send_time) {
+    abs_send_time_id = kms_sdp_media_config_get_abs_send_time_id (mconf);
+  }
+  transport_cc_id = kms_sdp_media_config_get_transport_cc_id (mconf);
+
+  if (abs_send_time_id == -1 && transport_cc_id == -1) {
+    GST_DEBUG_OBJECT (self, "RTP hdrext not configured.");
     return;
   }
 
@@ -487,11 +606,13 @@ kms_base_rtp_endpoint_config_rtp_hdr_ext (KmsBaseRtpEndpoint * self,
     return;
   }
 
-  data = hdr_ext_data_new (pad, TRUE, FALSE, abs_send_time_id);
+  /* Reserve the extensions, they are stamped just before sending */
+  data = hdr_ext_data_new (self, pad, TRUE, FALSE, abs_send_time_id,
+      transport_cc_id, NULL);
 
   GST_DEBUG_OBJECT (self,
-      "Add probe for adding abs-send-time (id: %d, %" GST_PTR_FORMAT
-      ").", abs_send_time_id, pad);
+      "Add probe for adding abs-send-time (id: %d) and transport-cc (id: %d, %"
+      GST_PTR_FORMAT ").", abs_send_time_id, transport_cc_id, pad);
   gst_pad_add_probe (pad,
       GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
       kms_base_rtp_endpoint_add_rtp_hdr_ext_probe, data,
@@ -499,6 +620,192 @@ kms_base_rtp_endpoint_config_rtp_hdr_ext (KmsBaseRtpEndpoint * self,
   g_object_unref (pad);
 }
 
+static void
+kms_base_rtp_endpoint_add_send_rtp_hdr_ext_probe (KmsBaseRtpEndpoint * self,
+    SdpMediaConfig * mconf, GstPad * pad, gboolean abs_send_time)
+{
+  gint abs_send_time_id = -1;
+  gint transport_cc_id;
+  HdrExtData *data;
+
+  if (abs_send_time) {
+    abs_send_time_id = kms_sdp_media_config_get_abs_send_time_id (mconf);
+  }
+  transport_cc_id = kms_sdp_media_config_get_transport_cc_id (mconf);
+
+  if (abs_send_time_id == -1 && transport_cc_id == -1) {
+    return;
+  }
+
+  data = hdr_ext_data_new (self, pad, FALSE, TRUE, abs_send_time_id,
+      transport_cc_id, &self->priv->transport_cc_seqnum);
+
+  GST_DEBUG_OBJECT (self,
+      "Add probe for updating abs-send-time (id: %d) and transport-cc (id: %d, %"
+      GST_PTR_FORMAT ").", abs_send_time_id, transport_cc_id, pad);
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      kms_base_rtp_endpoint_add_rtp_hdr_ext_probe,
+      data, hdr_ext_data_destroy_pointer);
+}
+
+typedef struct _RecvHdrExtBatch
+{
+  HdrExtData *data;
+  KmsRembLocal *rl;
+  GstClockTime now;
+} RecvHdrExtBatch;
+
+static void
+kms_base_rtp_endpoint_record_arrival (RecvHdrExtBatch * batch,
+    GstBuffer * buffer)
+{
+  HdrExtData *data = batch->data;
+  GstRTPBuffer rtp = { NULL, };
+  gpointer ext;
+  guint size;
+
+  if (!gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+    GST_WARNING_OBJECT (data->pad, "Can not map RTP buffer");
+    return;
+  }
+
+  if (data->abs_send_time_id != -1
+      && gst_rtp_buffer_get_extension_onebyte_header (&rtp,
+          data->abs_send_time_id, 0, &ext, &size)
+      && size == RTP_HDR_EXT_ABS_SEND_TIME_SIZE) {
+    kms_remb_local_packet_received (batch->rl, GST_READ_UINT24_BE (ext),
+        batch->now, gst_buffer_get_size (buffer));
+  }
+
+  if (data->transport_cc_id != -1
+      && gst_rtp_buffer_get_extension_onebyte_header (&rtp,
+          data->transport_cc_id, 0, &ext, &size)
+      && size == RTP_HDR_EXT_TRANSPORT_CC_SIZE) {
+    kms_remb_local_twcc_packet_received (batch->rl, GST_READ_UINT16_BE (ext),
+        batch->now);
+  }
+
+  gst_rtp_buffer_unmap (&rtp);
+}
+
+static gboolean
+kms_base_rtp_endpoint_record_arrival_bufflist (GstBuffer ** buf,
+    guint idx, RecvHdrExtBatch * batch)
+{
+  kms_base_rtp_endpoint_record_arrival (batch, *buf);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+kms_base_rtp_endpoint_recv_rtp_hdr_ext_probe (GstPad * pad,
+    GstPadProbeInfo * info, gpointer gp)
+{
+  RecvHdrExtBatch batch;
+
+  batch.data = (HdrExtData *) gp;
+  batch.rl = batch.data->self->priv->rl;
+
+  if (batch.rl == NULL || !kms_remb_local_needs_packets (batch.rl)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* One clock read for the whole buffer list */
+  batch.now = kms_utils_get_time_nsecs ();
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    kms_base_rtp_endpoint_record_arrival (&batch,
+        GST_PAD_PROBE_INFO_BUFFER (info));
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        (GstBufferListFunc) kms_base_rtp_endpoint_record_arrival_bufflist,
+        &batch);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+kms_base_rtp_endpoint_add_recv_rtp_hdr_ext_probe (KmsBaseRtpEndpoint * self,
+    SdpMediaConfig * mconf, GstPad * pad, gboolean abs_send_time)
+{
+  gint abs_send_time_id = -1;
+  gint transport_cc_id;
+  HdrExtData *data;
+
+  if (abs_send_time) {
+    abs_send_time_id = kms_sdp_media_config_get_abs_send_time_id (mconf);
+  }
+  transport_cc_id = kms_sdp_media_config_get_transport_cc_id (mconf);
+
+  if (abs_send_time_id == -1 && transport_cc_id == -1) {
+    return;
+  }
+
+  data = hdr_ext_data_new (self, pad, FALSE, FALSE, abs_send_time_id,
+      transport_cc_id, NULL);
+
+  GST_DEBUG_OBJECT (self,
+      "Add probe for recording arrivals of abs-send-time (id: %d) and"
+      " transport-cc (id: %d, %" GST_PTR_FORMAT ").", abs_send_time_id,
+      transport_cc_id, pad);
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      kms_base_rtp_endpoint_recv_rtp_hdr_ext_probe, data,
+      hdr_ext_data_destroy_pointer);
+}
+
+static gboolean
+kms_base_rtp_endpoint_add_audio_level_meta_bufflist (GstBuffer ** buf,
+    guint idx, gpointer id)
+{
+  *buf = gst_buffer_make_writable (*buf);
+  kms_buffer_add_audio_level_meta_from_rtp (*buf, GPOINTER_TO_INT (id));
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+kms_base_rtp_endpoint_audio_level_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer id)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    buffer = gst_buffer_make_writable (buffer);
+    kms_buffer_add_audio_level_meta_from_rtp (buffer, GPOINTER_TO_INT (id));
+    GST_PAD_PROBE_INFO_DATA (info) = buffer;
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *bufflist = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    bufflist = gst_buffer_list_make_writable (bufflist);
+    gst_buffer_list_foreach (bufflist,
+        kms_base_rtp_endpoint_add_audio_level_meta_bufflist, id);
+    GST_PAD_PROBE_INFO_DATA (info) = bufflist;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+kms_base_rtp_endpoint_add_audio_level_probe (KmsBaseRtpEndpoint * self,
+    SdpMediaConfig * mconf, GstPad * pad)
+{
+  gint id = kms_sdp_media_config_get_audio_level_id (mconf);
+
+  if (id == -1) {
+    return;
+  }
+
+  /* Levels travel as buffer meta, so mixers need not measure them */
+  GST_DEBUG_OBJECT (self, "Add probe for reading audio level (id: %d, %"
+      GST_PTR_FORMAT ").", id, pad);
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      kms_base_rtp_endpoint_audio_level_probe, GINT_TO_POINTER (id), NULL);
+}
+
 /* RTP hdrext end */
 
 /* Media handler management begin */
@@ -576,8 +883,16 @@ kms_base_rtp_create_media_handler (KmsBaseSdpEndpoint * base_sdp,
   g_object_set (G_OBJECT (*handler), "rtcp-mux", self->priv->rtcp_mux, NULL);
 
   if (KMS_IS_SDP_RTP_AVPF_MEDIA_HANDLER (*handler)) {
+    gboolean transport_cc = FALSE;
+
+    if (self->priv->remb_params != NULL) {
+      gst_structure_get_boolean (self->priv->remb_params, "transport-cc",
+          &transport_cc);
+    }
+
     g_object_set (G_OBJECT (*handler), "nack", self->priv->rtcp_nack,
-        "goog-remb", self->priv->rtcp_remb, NULL);
+        "goog-remb", self->priv->rtcp_remb, "transport-cc", transport_cc,
+        NULL);
   }
   h_avp = KMS_SDP_RTP_AVP_MEDIA_HANDLER (*handler);
   kms_sdp_rtp_avp_media_handler_add_extmap (h_avp, RTP_HDR_EXT_ABS_SEND_TIME_ID,
@@ -589,6 +904,26 @@ kms_base_rtp_create_media_handler (KmsBaseSdpEndpoint * base_sdp,
     err = NULL;
   }
 
+  kms_sdp_rtp_avp_media_handler_add_extmap (h_avp, RTP_HDR_EXT_TRANSPORT_CC_ID,
+      RTP_HDR_EXT_TRANSPORT_CC_URI, &err);
+
+  if (err != NULL) {
+    GST_WARNING_OBJECT (base_sdp, "Cannot add extmap '%s'", err->message);
+    g_error_free (err);
+    err = NULL;
+  }
+
+  if (g_strcmp0 (AUDIO_STREAM_NAME, media) == 0) {
+    kms_sdp_rtp_avp_media_handler_add_extmap (h_avp,
+        RTP_HDR_EXT_AUDIO_LEVEL_ID, RTP_HDR_EXT_AUDIO_LEVEL_URI, &err);
+
+    if (err != NULL) {
+      GST_WARNING_OBJECT (base_sdp, "Cannot add extmap '%s'", err->message);
+      g_error_free (err);
+      err = NULL;
+    }
+  }
+
   if (self->priv->support_fec) {
     kms_base_rtp_configure_extensions (self, media, *handler);
   }
@@ -906,20 +1241,28 @@ kms_base_rtp_endpoint_request_rtp_sink (KmsIRtpSessionManager * manager,
   GstSDPMedia *media = kms_sdp_media_config_get_sdp_media (mconf);
   const gchar *media_str = gst_sdp_media_get_media (media);
   GstPad *pad;
+  gboolean is_video;
 
   if (g_strcmp0 (AUDIO_STREAM_NAME, media_str) == 0) {
     pad =
         gst_element_get_request_pad (self->priv->rtpbin,
         AUDIO_RTPBIN_RECV_RTP_SINK);
+    kms_base_rtp_endpoint_add_audio_level_probe (self, mconf, pad);
+    is_video = FALSE;
   } else if (g_strcmp0 (VIDEO_STREAM_NAME, media_str) == 0) {
     pad =
         gst_element_get_request_pad (self->priv->rtpbin,
         VIDEO_RTPBIN_RECV_RTP_SINK);
+    is_video = TRUE;
   } else {
     GST_ERROR_OBJECT (self, "'%s' not valid", media_str);
     return NULL;
   }
 
+  /* REMB controllers only estimate the video session */
+  kms_base_rtp_endpoint_add_recv_rtp_hdr_ext_probe (self, mconf, pad,
+      is_video);
+
   return pad;
 }
 
@@ -936,28 +1279,16 @@ kms_base_rtp_endpoint_request_rtp_src (KmsIRtpSessionManager * manager,
     pad =
         gst_element_get_static_pad (self->priv->rtpbin,
         AUDIO_RTPBIN_SEND_RTP_SRC);
+    kms_base_rtp_endpoint_add_send_rtp_hdr_ext_probe (self, mconf, pad, FALSE);
   } else if (g_strcmp0 (VIDEO_STREAM_NAME, media_str) == 0) {
-    gint abs_send_time_id;
-
     pad =
         gst_element_get_static_pad (self->priv->rtpbin,
         VIDEO_RTPBIN_SEND_RTP_SRC);
 
     kms_utils_drop_until_keyframe (pad, TRUE);
 
-    /* TODO: check if needed for audio */
-    abs_send_time_id = kms_sdp_media_config_get_abs_send_time_id (mconf);
-    if (abs_send_time_id != -1) {
-      HdrExtData *data = hdr_ext_data_new (pad, FALSE, TRUE, abs_send_time_id);
-
-      GST_DEBUG_OBJECT (self,
-          "Add probe for updating abs-send-time (id: %d, %" GST_PTR_FORMAT ").",
-          abs_send_time_id, pad);
-      gst_pad_add_probe (pad,
-          GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
-          kms_base_rtp_endpoint_add_rtp_hdr_ext_probe,
-          data, hdr_ext_data_destroy_pointer);
-    }
+    /* TODO: check if abs-send-time is needed for audio */
+    kms_base_rtp_endpoint_add_send_rtp_hdr_ext_probe (self, mconf, pad, TRUE);
   } else {
     GST_ERROR_OBJECT (self, "'%s' not valid", media_str);
     return NULL;
@@ -1051,12 +1382,14 @@ kms_base_rtp_endpoint_start_transport_send (KmsBaseSdpEndpoint *
   GSList *item = kms_sdp_message_context_get_medias (sess->neg_sdp_ctx);
 
   kms_base_rtp_session_start_transport_send (base_rtp_sess, offerer);
+  kms_base_rtp_endpoint_update_pt_table (self, sess->neg_sdp_ctx);
 
   for (; item != NULL; item = g_slist_next (item)) {
     SdpMediaConfig *neg_mconf = item->data;
     GstSDPMedia *media = kms_sdp_media_config_get_sdp_media (neg_mconf);
 
-    if (sdp_utils_media_has_remb (media)) {
+    if (sdp_utils_media_has_remb (media) ||
+        sdp_utils_media_has_transport_cc (media)) {
       kms_base_rtp_endpoint_create_remb_managers (base_rtp_sess, self);
     }
   }
@@ -1410,11 +1743,12 @@ kms_base_rtp_endpoint_set_media_payloader (KmsBaseRtpEndpoint * self,
   GST_DEBUG_OBJECT (self, "Found payloader %" GST_PTR_FORMAT, payloader);
 
   if (g_strcmp0 (AUDIO_STREAM_NAME, media_str) == 0) {
+    kms_base_rtp_endpoint_config_rtp_hdr_ext (self, mconf, payloader, FALSE);
     type = KMS_ELEMENT_PAD_TYPE_AUDIO;
     rtpbin_pad_name = AUDIO_RTPBIN_SEND_RTP_SINK;
   } else if (g_strcmp0 (VIDEO_STREAM_NAME, media_str) == 0) {
-    /* TODO: check if is needed for audio  */
-    kms_base_rtp_endpoint_config_rtp_hdr_ext (self, mconf, payloader);
+    /* TODO: check if abs-send-time is needed for audio  */
+    kms_base_rtp_endpoint_config_rtp_hdr_ext (self, mconf, payloader, TRUE);
     type = KMS_ELEMENT_PAD_TYPE_VIDEO;
     rtpbin_pad_name = VIDEO_RTPBIN_SEND_RTP_SINK;
   } else {
@@ -1605,58 +1939,154 @@ end:
 }
 
 static GstCaps *
-kms_base_rtp_endpoint_get_caps_for_pt (KmsBaseRtpEndpoint * self, guint pt)
+kms_base_rtp_endpoint_create_caps_for_format (const GstSDPMedia * media,
+    const gchar * payload)
 {
-  KmsBaseSdpEndpoint *base_endpoint = KMS_BASE_SDP_ENDPOINT (self);
-  SdpMessageContext *neg_sdp_ctx =
-      kms_base_sdp_endpoint_get_first_negotiated_sdp_ctx (base_endpoint);
+  const gchar *media_str = gst_sdp_media_get_media (media);
+  const gchar *rtpmap, *fmtp;
+  GstCaps *caps;
+
+  rtpmap = sdp_utils_sdp_media_get_rtpmap (media, payload);
+  caps =
+      kms_base_rtp_endpoint_get_caps_from_rtpmap (media_str, payload, rtpmap);
+
+  if (caps == NULL) {
+    return NULL;
+  }
+
+  /* Configure codec if it is possible */
+  fmtp = sdp_utils_sdp_media_get_fmtp (media, payload);
+
+  if (fmtp != NULL) {
+    complement_caps_with_fmtp_attrs (caps, fmtp);
+  }
+
+  complete_caps_with_fb (caps, media, payload);
+
+  return caps;
+}
+
+static void
+kms_base_rtp_endpoint_update_pt_table (KmsBaseRtpEndpoint * self,
+    SdpMessageContext * neg_sdp_ctx)
+{
+  PtTable *table, *old_table;
   const GSList *item;
 
   if (neg_sdp_ctx == NULL) {
     GST_WARNING_OBJECT (self, "Negotiated session not set");
-    return FALSE;
+    return;
   }
 
+  table = pt_table_new ();
+
   item = kms_sdp_message_context_get_medias (neg_sdp_ctx);
   for (; item != NULL; item = g_slist_next (item)) {
     SdpMediaConfig *mconf = item->data;
     GstSDPMedia *media = kms_sdp_media_config_get_sdp_media (mconf);
     const gchar *media_str = gst_sdp_media_get_media (media);
-    const gchar *rtpmap, *fmtp;
     guint j, f_len;
 
     f_len = gst_sdp_media_formats_len (media);
     for (j = 0; j < f_len; j++) {
-      GstCaps *caps;
       const gchar *payload = gst_sdp_media_get_format (media, j);
+      PtTableEntry *entry;
+      GstStructure *st;
+      gint pt;
 
-      if (atoi (payload) != pt) {
+      pt = atoi (payload);
+      if (pt < 0 || pt >= RTP_MAX_PT) {
+        GST_WARNING_OBJECT (self, "Invalid payload type '%s'", payload);
         continue;
       }
 
-      rtpmap = sdp_utils_sdp_media_get_rtpmap (media, payload);
-      caps =
-          kms_base_rtp_endpoint_get_caps_from_rtpmap (media_str, payload,
-          rtpmap);
+      entry = &table->entries[pt];
+      if (entry->caps != NULL) {
+        /* Keep the first media defining this payload type */
+        continue;
+      }
 
-      if (caps == NULL) {
+      entry->caps = kms_base_rtp_endpoint_create_caps_for_format (media,
+          payload);
+      if (entry->caps == NULL) {
         continue;
       }
 
-      /* Configure codec if it is possible */
-      fmtp = sdp_utils_sdp_media_get_fmtp (media, payload);
+      st = gst_caps_get_structure (entry->caps, 0);
+      gst_structure_get_int (st, "clock-rate", &entry->clock_rate);
 
-      if (fmtp != NULL) {
-        complement_caps_with_fmtp_attrs (caps, fmtp);
+      if (g_strcmp0 (AUDIO_STREAM_NAME, media_str) == 0) {
+        entry->media = KMS_MEDIA_TYPE_AUDIO;
+      } else if (g_strcmp0 (VIDEO_STREAM_NAME, media_str) == 0) {
+        entry->media = KMS_MEDIA_TYPE_VIDEO;
+      } else {
+        entry->media = KMS_MEDIA_TYPE_DATA;
       }
+    }
+  }
 
-      complete_caps_with_fb (caps, media, payload);
+  g_mutex_lock (&self->priv->pt_table_mutex);
+  old_table = self->priv->pt_table;
+  self->priv->pt_table = table;
+  g_mutex_unlock (&self->priv->pt_table_mutex);
 
-      return caps;
-    }
+  if (old_table != NULL) {
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (old_table));
   }
 
-  return NULL;
+  GST_DEBUG_OBJECT (self, "Payload type table updated");
+}
+
+static PtTable *
+kms_base_rtp_endpoint_get_pt_table (KmsBaseRtpEndpoint * self)
+{
+  PtTable *table = NULL;
+
+  g_mutex_lock (&self->priv->pt_table_mutex);
+  if (self->priv->pt_table != NULL) {
+    table = (PtTable *)
+        kms_ref_struct_ref (KMS_REF_STRUCT_CAST (self->priv->pt_table));
+  }
+  g_mutex_unlock (&self->priv->pt_table_mutex);
+
+  return table;
+}
+
+static GstCaps *
+kms_base_rtp_endpoint_get_caps_for_pt (KmsBaseRtpEndpoint * self, guint pt)
+{
+  GstCaps *caps = NULL;
+  PtTable *table;
+
+  table = kms_base_rtp_endpoint_get_pt_table (self);
+
+  if (table == NULL) {
+    GST_WARNING_OBJECT (self, "Negotiated session not set");
+    return NULL;
+  }
+
+  if (pt < RTP_MAX_PT && table->entries[pt].caps != NULL) {
+    caps = gst_caps_ref (table->entries[pt].caps);
+  }
+
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (table));
+
+  return caps;
+}
+
+static gint
+kms_base_rtp_endpoint_get_clock_rate_for_pt (KmsBaseRtpEndpoint * self,
+    guint pt)
+{
+  gint clock_rate = 0;
+
+  g_mutex_lock (&self->priv->pt_table_mutex);
+  if (self->priv->pt_table != NULL && pt < RTP_MAX_PT) {
+    clock_rate = self->priv->pt_table->entries[pt].clock_rate;
+  }
+  g_mutex_unlock (&self->priv->pt_table_mutex);
+
+  return clock_rate;
 }
 
 static GstCaps *
@@ -1799,7 +2229,7 @@ init_timestamp_stats_file (KmsBaseRtpEndpoint * self)
   g_date_time_unref (datetime);
 
   stats_file_name =
-      g_strdup_printf ("%s/%s_%s_%p.csv", stats_files_dir, date_str,
+      g_strdup_printf ("%s/%s_%s_%p.trace", stats_files_dir, date_str,
       GST_OBJECT_NAME (self), self);
   g_free (date_str);
 
@@ -1809,13 +2239,12 @@ init_timestamp_stats_file (KmsBaseRtpEndpoint * self)
     goto init_error;
   }
 
-  self->priv->stats_file = g_fopen (stats_file_name, "w+");
+  /* Records are written by a background thread, use kms-sync-trace-to-csv
+   * to convert the file */
+  self->priv->sync_trace = kms_sync_trace_new (stats_file_name);
 
-  if (self->priv->stats_file == NULL) {
+  if (self->priv->sync_trace == NULL) {
     GST_ERROR_OBJECT (self, "Stats file cannot be created");
-  } else {
-    g_fprintf (self->priv->stats_file,
-        "SSRC,CLOCK_RATE,PTS,DTS,RTP,NTP_SR,RTP_SR\n");
   }
 
 init_error:
@@ -1826,61 +2255,82 @@ static void
 kms_base_rtp_endpoint_update_sync_data (KmsBaseRtpEndpoint * self,
     SsrcSyncData * sync_data, guint8 pt)
 {
-  GstStructure *st;
-  GstCaps *caps;
+  gint clock_rate;
 
-  caps = kms_base_rtp_endpoint_get_caps_for_pt (self, pt);
+  clock_rate = kms_base_rtp_endpoint_get_clock_rate_for_pt (self, pt);
 
-  if (caps == NULL) {
-    GST_WARNING_OBJECT (self, "Can not get valid caps for pt %u", pt);
-    return;
-  }
-
-  st = gst_caps_get_structure (caps, 0);
-  if (gst_structure_get_int (st, "clock-rate", &sync_data->clock_rate)) {
+  if (clock_rate > 0) {
+    sync_data->clock_rate = clock_rate;
     sync_data->pt = pt;
   } else {
-    GST_ERROR_OBJECT (self,
-        "Cannot get clockrate from caps: %" GST_PTR_FORMAT, caps);
+    GST_WARNING_OBJECT (self, "Can not get valid clock rate for pt %u", pt);
   }
-
-  gst_caps_unref (caps);
 }
 
-static GstClockTime
-kms_base_rtp_endpoint_calculate_new_pts (KmsBaseRtpEndpoint * self,
-    SsrcSyncData * sync_data, GstClockTime buffer_pts, GstClockTime buffer_dts)
+/* Part of the PTS derived from the last RTCP SR. It only changes when a new
+ * SR arrives, so it is computed once per buffer list instead of per packet. */
+typedef struct _SrSyncOffset
 {
-  GstClockTime pts, diff_ntpnstime, diff_rtptime, diff_rtpnstime;
-  gboolean wrapped_down, wrapped_up, is_lower;
+  GstClockTime pts;
+  GstClockTime diff_ntpnstime;
+  gboolean wrapped_down;
+  gboolean wrapped_up;
+} SrSyncOffset;
 
-  is_lower = wrapped_down = wrapped_up = FALSE;
+typedef struct _SyncBatchData
+{
+  KmsBaseRtpEndpoint *self;
+  SsrcSyncData *offset_sync_data;       /* sync data used to compute offset */
+  SrSyncOffset offset;
+} SyncBatchData;
 
-  if (sync_data->ext_ts == sync_data->last_ext_ts) {
-    return sync_data->last_pts;
-  }
+static void
+kms_base_rtp_endpoint_calculate_sr_offset (KmsBaseRtpEndpoint * self,
+    SsrcSyncData * sync_data, SrSyncOffset * offset)
+{
+  GstClockTime pts = self->priv->base_sync_time;
 
-  pts = self->priv->base_sync_time;
-  diff_ntpnstime = diff_rtptime = diff_rtpnstime = G_GUINT64_CONSTANT (0);
+  offset->diff_ntpnstime = G_GUINT64_CONSTANT (0);
+  offset->wrapped_down = offset->wrapped_up = FALSE;
 
   if (sync_data->last_sr_ntp_ns_time > self->priv->base_ntp_ns_time) {
-    diff_ntpnstime =
+    offset->diff_ntpnstime =
         sync_data->last_sr_ntp_ns_time - self->priv->base_ntp_ns_time;
-    wrapped_up = diff_ntpnstime > (G_MAXUINT64 - pts);
-    pts += diff_ntpnstime;
+    offset->wrapped_up = offset->diff_ntpnstime > (G_MAXUINT64 - pts);
+    pts += offset->diff_ntpnstime;
   } else if (sync_data->last_sr_ntp_ns_time < self->priv->base_ntp_ns_time) {
-    diff_ntpnstime =
+    offset->diff_ntpnstime =
         self->priv->base_ntp_ns_time - sync_data->last_sr_ntp_ns_time;
-    wrapped_down = pts < diff_ntpnstime;
-    pts -= diff_ntpnstime;
+    offset->wrapped_down = pts < offset->diff_ntpnstime;
+    pts -= offset->diff_ntpnstime;
   }
 
+  offset->pts = pts;
+}
+
+static GstClockTime
+kms_base_rtp_endpoint_calculate_new_pts (KmsBaseRtpEndpoint * self,
+    SsrcSyncData * sync_data, const SrSyncOffset * offset,
+    GstClockTime buffer_pts, GstClockTime buffer_dts)
+{
+  GstClockTime pts, diff_rtptime, diff_rtpnstime;
+  gboolean is_lower;
+
+  is_lower = FALSE;
+
+  if (sync_data->ext_ts == sync_data->last_ext_ts) {
+    return sync_data->last_pts;
+  }
+
+  pts = offset->pts;
+  diff_rtptime = diff_rtpnstime = G_GUINT64_CONSTANT (0);
+
   if (sync_data->ext_ts > sync_data->last_sr_ext_ts) {
     diff_rtptime = sync_data->ext_ts - sync_data->last_sr_ext_ts;
     diff_rtpnstime =
         gst_util_uint64_scale_int (diff_rtptime, GST_SECOND,
         sync_data->clock_rate);
-    is_lower = wrapped_down &&
+    is_lower = offset->wrapped_down &&
         diff_rtpnstime < (G_MAXUINT64 - pts + self->priv->base_sync_time);
     if (!is_lower) {
       pts += diff_rtpnstime;
@@ -1890,7 +2340,7 @@ kms_base_rtp_endpoint_calculate_new_pts (KmsBaseRtpEndpoint * self,
     diff_rtpnstime =
         gst_util_uint64_scale_int (diff_rtptime, GST_SECOND,
         sync_data->clock_rate);
-    is_lower = wrapped_down || (wrapped_up &&
+    is_lower = offset->wrapped_down || (offset->wrapped_up &&
         diff_rtpnstime > G_MAXUINT64 - self->priv->base_sync_time + pts);
     if (!is_lower && pts >= diff_rtpnstime) {
       pts -= diff_rtpnstime;
@@ -1919,7 +2369,7 @@ kms_base_rtp_endpoint_calculate_new_pts (KmsBaseRtpEndpoint * self,
         sync_data->last_sr_ntp_ns_time,
         self->priv->base_ntp_ns_time,
         sync_data->last_sr_ext_ts,
-        diff_ntpnstime, diff_rtptime, diff_rtpnstime);
+        offset->diff_ntpnstime, diff_rtptime, diff_rtpnstime);
     pts = buffer_pts;
   }
 
@@ -1935,72 +2385,128 @@ kms_base_rtp_endpoint_calculate_new_pts (KmsBaseRtpEndpoint * self,
   return pts;
 }
 
-static GstPadProbeReturn
-timestamps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+/* Only the fixed header is needed, so avoid a full gst_rtp_buffer_map */
+static gboolean
+kms_base_rtp_endpoint_read_rtp_header (GstBuffer * buff, guint32 * ssrc,
+    guint8 * pt, guint32 * rtp_time)
 {
-  if (GST_PAD_PROBE_INFO_TYPE (info) | GST_PAD_PROBE_TYPE_BUFFER) {
-    KmsBaseRtpEndpoint *self = user_data;
-    GstBuffer *buff = gst_pad_probe_info_get_buffer (info);
-    GstRTPBuffer rtp = { 0 };
+  guint8 hdr[RTP_FIXED_HEADER_SIZE];
 
-    if (gst_rtp_buffer_map (buff, GST_MAP_READ, &rtp)) {
-      guint32 ssrc = gst_rtp_buffer_get_ssrc (&rtp);
-      guint8 pt = gst_rtp_buffer_get_payload_type (&rtp);
-      guint32 rtp_time = gst_rtp_buffer_get_timestamp (&rtp);
-      SsrcSyncData *sync_data;
-      guint32 clock_rate;
-      guint64 last_sr_ntp_ns_time, last_sr_ext_ts;
-
-      if (g_once_init_enter (&self->priv->init_stats)) {
-        init_timestamp_stats_file (self);
-        g_once_init_leave (&self->priv->init_stats, 1);
-      }
+  if (gst_buffer_extract (buff, 0, hdr, RTP_FIXED_HEADER_SIZE) !=
+      RTP_FIXED_HEADER_SIZE) {
+    return FALSE;
+  }
 
-      if (ssrc == self->priv->sess->remote_video_ssrc) {
-        sync_data = &self->priv->video_sync;
-      } else {
-        sync_data = &self->priv->audio_sync;
-      }
+  if ((hdr[0] >> 6) != 2) {
+    /* Not RTP version 2 */
+    return FALSE;
+  }
 
-      if (pt != sync_data->pt) {
-        kms_base_rtp_endpoint_update_sync_data (self, sync_data, pt);
-      }
+  *pt = hdr[1] & 0x7f;
+  *rtp_time = GST_READ_UINT32_BE (hdr + 4);
+  *ssrc = GST_READ_UINT32_BE (hdr + 8);
 
-      g_mutex_lock (&self->priv->sync_mutex);
+  return TRUE;
+}
 
-      gst_rtp_buffer_ext_timestamp (&sync_data->ext_ts, rtp_time);
+/* Must be called with sync_mutex held */
+static GstBuffer *
+kms_base_rtp_endpoint_sync_buffer (SyncBatchData * batch, GstBuffer * buff)
+{
+  KmsBaseRtpEndpoint *self = batch->self;
+  SsrcSyncData *sync_data;
+  guint32 ssrc, rtp_time;
+  guint8 pt;
 
-      if (self->priv->base_sync_time != 0 && sync_data->last_sr_ext_ts != 0) {
-        // Perform bufffer synchronization
-        buff = gst_buffer_make_writable (buff);
-        GST_BUFFER_PTS (buff) = kms_base_rtp_endpoint_calculate_new_pts (self,
-            sync_data, buff->pts, buff->dts);
-        sync_data->last_ext_ts = sync_data->ext_ts;
-      }
+  if (!kms_base_rtp_endpoint_read_rtp_header (buff, &ssrc, &pt, &rtp_time)) {
+    GST_WARNING_OBJECT (self, "Buffer cannot be mapped");
+    return buff;
+  }
 
-      last_sr_ntp_ns_time = sync_data->last_sr_ntp_ns_time;
-      last_sr_ext_ts = sync_data->last_sr_ext_ts;
-      clock_rate = sync_data->clock_rate;
+  if (ssrc == self->priv->sess->remote_video_ssrc) {
+    sync_data = &self->priv->video_sync;
+  } else {
+    sync_data = &self->priv->audio_sync;
+  }
 
-      g_mutex_unlock (&self->priv->sync_mutex);
+  if (pt != sync_data->pt) {
+    kms_base_rtp_endpoint_update_sync_data (self, sync_data, pt);
+  }
 
-      // Write stats if enabled
-      if (self->priv->stats_file) {
-        g_fprintf (self->priv->stats_file,
-            "%" G_GUINT32_FORMAT ",%" G_GUINT32_FORMAT ",%" G_GUINT64_FORMAT
-            ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT
-            ",%" G_GUINT64_FORMAT "\n", ssrc, clock_rate, GST_BUFFER_PTS (buff),
-            GST_BUFFER_DTS (buff), sync_data->ext_ts, last_sr_ntp_ns_time,
-            last_sr_ext_ts);
-      }
+  gst_rtp_buffer_ext_timestamp (&sync_data->ext_ts, rtp_time);
 
-      gst_rtp_buffer_unmap (&rtp);
-    } else {
-      GST_WARNING_OBJECT (self, "Buffer cannot be mapped");
+  if (self->priv->base_sync_time != 0 && sync_data->last_sr_ext_ts != 0) {
+    if (batch->offset_sync_data != sync_data) {
+      kms_base_rtp_endpoint_calculate_sr_offset (self, sync_data,
+          &batch->offset);
+      batch->offset_sync_data = sync_data;
     }
 
-  } else {
-    GST_WARNING ("Buffer list not supported!!");
+    // Perform bufffer synchronization
+    buff = gst_buffer_make_writable (buff);
+    GST_BUFFER_PTS (buff) = kms_base_rtp_endpoint_calculate_new_pts (self,
+        sync_data, &batch->offset, buff->pts, buff->dts);
+    sync_data->last_ext_ts = sync_data->ext_ts;
+  }
+
+  // Write stats if enabled
+  if (self->priv->sync_trace != NULL) {
+    KmsSyncTraceRecord record;
+
+    record.ssrc = ssrc;
+    record.clock_rate = sync_data->clock_rate;
+    record.pts = GST_BUFFER_PTS (buff);
+    record.dts = GST_BUFFER_DTS (buff);
+    record.ext_ts = sync_data->ext_ts;
+    record.sr_ntp_ns_time = sync_data->last_sr_ntp_ns_time;
+    record.sr_ext_ts = sync_data->last_sr_ext_ts;
+
+    kms_sync_trace_push (self->priv->sync_trace, &record);
+  }
+
+  return buff;
+}
+
+static gboolean
+sync_buffer_list_cb (GstBuffer ** buff, guint idx, SyncBatchData * batch)
+{
+  *buff = kms_base_rtp_endpoint_sync_buffer (batch, *buff);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+timestamps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  KmsBaseRtpEndpoint *self = user_data;
+  SyncBatchData batch = { self, NULL, };
+
+  if (g_once_init_enter (&self->priv->init_stats)) {
+    init_timestamp_stats_file (self);
+    g_once_init_leave (&self->priv->init_stats, 1);
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buff = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    g_mutex_lock (&self->priv->sync_mutex);
+    buff = kms_base_rtp_endpoint_sync_buffer (&batch, buff);
+    g_mutex_unlock (&self->priv->sync_mutex);
+
+    GST_PAD_PROBE_INFO_DATA (info) = buff;
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    /* The whole list is synchronized under a single lock, so every packet
+     * in it sees the same SR data */
+    list = gst_buffer_list_make_writable (list);
+
+    g_mutex_lock (&self->priv->sync_mutex);
+    gst_buffer_list_foreach (list, (GstBufferListFunc) sync_buffer_list_cb,
+        &batch);
+    g_mutex_unlock (&self->priv->sync_mutex);
+
+    GST_PAD_PROBE_INFO_DATA (info) = list;
   }
 
   return GST_PAD_PROBE_OK;
@@ -2085,6 +2591,188 @@ rtcp_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
   return GST_PAD_PROBE_OK;
 }
 
+/* Adaptive jitter buffer latency begin */
+
+#define ADAPTIVE_LATENCY_DATA "kms-adaptive-latency-data"
+G_DEFINE_QUARK (ADAPTIVE_LATENCY_DATA, adaptive_latency_data);
+
+typedef struct _AdaptiveLatencyData
+{
+  KmsRefStruct ref;
+  KmsBaseRtpEndpoint *self;
+  KmsAdaptiveLatency *al;
+
+  /* Only used from the jitter buffer src thread */
+  GstClockTime last_update;
+  guint64 last_pushed;
+  guint64 last_late;
+} AdaptiveLatencyData;
+
+typedef struct _AdaptiveLatencyBatch
+{
+  AdaptiveLatencyData *data;
+  GstClockTime now;
+  gint pt;
+  gint clock_rate;
+} AdaptiveLatencyBatch;
+
+static void
+adaptive_latency_data_destroy (AdaptiveLatencyData * data)
+{
+  kms_adaptive_latency_destroy (data->al);
+  g_slice_free (AdaptiveLatencyData, data);
+}
+
+static AdaptiveLatencyData *
+adaptive_latency_data_new (KmsBaseRtpEndpoint * self, guint initial_latency,
+    guint min_latency, guint max_latency)
+{
+  AdaptiveLatencyData *data;
+
+  data = g_slice_new0 (AdaptiveLatencyData);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (data),
+      (GDestroyNotify) adaptive_latency_data_destroy);
+
+  data->self = self;
+  data->al = kms_adaptive_latency_new (initial_latency, min_latency,
+      max_latency);
+  data->last_update = GST_CLOCK_TIME_NONE;
+
+  return data;
+}
+
+static gboolean
+kms_base_rtp_endpoint_jb_packet_received (GstBuffer ** buf, guint idx,
+    AdaptiveLatencyBatch * batch)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  gint pt;
+
+  if (!gst_rtp_buffer_map (*buf, GST_MAP_READ, &rtp)) {
+    return TRUE;
+  }
+
+  pt = gst_rtp_buffer_get_payload_type (&rtp);
+  if (pt != batch->pt) {
+    batch->pt = pt;
+    batch->clock_rate =
+        kms_base_rtp_endpoint_get_clock_rate_for_pt (batch->data->self, pt);
+  }
+
+  kms_adaptive_latency_packet_received (batch->data->al,
+      gst_rtp_buffer_get_timestamp (&rtp), batch->clock_rate, batch->now);
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+kms_base_rtp_endpoint_jb_sink_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  AdaptiveLatencyBatch batch;
+
+  batch.data = user_data;
+  batch.pt = -1;
+  batch.clock_rate = 0;
+
+  /* One clock read for the whole buffer list */
+  batch.now = kms_utils_get_time_nsecs ();
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    kms_base_rtp_endpoint_jb_packet_received (&buffer, 0, &batch);
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        (GstBufferListFunc) kms_base_rtp_endpoint_jb_packet_received, &batch);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+kms_base_rtp_endpoint_jb_src_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  AdaptiveLatencyData *data = user_data;
+  GstElement *jitterbuffer = GST_PAD_PARENT (pad);
+  GstClockTime now = kms_utils_get_time_nsecs ();
+  GstStructure *stats = NULL;
+  guint64 pushed = 0, late = 0;
+  guint latency;
+
+  if (!GST_CLOCK_TIME_IS_VALID (data->last_update)) {
+    data->last_update = now;
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (now - data->last_update < JB_ADAPTIVE_UPDATE_INTERVAL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  data->last_update = now;
+
+  g_object_get (jitterbuffer, "stats", &stats, NULL);
+  if (stats == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_structure_get_uint64 (stats, "num-pushed", &pushed);
+  gst_structure_get_uint64 (stats, "num-late", &late);
+  gst_structure_free (stats);
+
+  if (kms_adaptive_latency_update (data->al, pushed - data->last_pushed,
+          late - data->last_late, now, &latency)) {
+    GST_DEBUG_OBJECT (jitterbuffer, "Setting adaptive latency to: %u",
+        latency);
+    g_object_set (jitterbuffer, "latency", latency, NULL);
+  }
+
+  data->last_pushed = pushed;
+  data->last_late = late;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+kms_base_rtp_endpoint_add_adaptive_latency (KmsBaseRtpEndpoint * self,
+    GstElement * jitterbuffer, guint initial_latency, guint min_latency,
+    guint max_latency)
+{
+  AdaptiveLatencyData *data;
+  GstPad *pad;
+
+  data = adaptive_latency_data_new (self, initial_latency, min_latency,
+      max_latency);
+
+  GST_DEBUG_OBJECT (jitterbuffer, "Adaptive latency in [%u, %u] ms",
+      min_latency, max_latency);
+
+  pad = gst_element_get_static_pad (jitterbuffer, "sink");
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      kms_base_rtp_endpoint_jb_sink_probe,
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (data)),
+      (GDestroyNotify) kms_ref_struct_unref);
+  g_object_unref (pad);
+
+  pad = gst_element_get_static_pad (jitterbuffer, "src");
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      kms_base_rtp_endpoint_jb_src_probe,
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (data)),
+      (GDestroyNotify) kms_ref_struct_unref);
+  g_object_unref (pad);
+
+  g_object_set_qdata_full (G_OBJECT (jitterbuffer),
+      adaptive_latency_data_quark (), data,
+      (GDestroyNotify) kms_ref_struct_unref);
+}
+
+/* Adaptive jitter buffer latency end */
+
 static void
 pad_added_jb (GstElement * jitterbuffer, GstPad * new_pad, gpointer self)
 {
@@ -2105,17 +2793,32 @@ kms_base_rtp_endpoint_rtpbin_new_jitterbuffer (GstElement * rtpbin,
   KmsRTPSessionStats *rtp_stats;
   KmsSSRCStats *ssrc_stats;
   GstPad *src_pad;
+  gboolean adaptive;
+  guint ready_latency, min_latency, max_latency;
 
   g_object_set (jitterbuffer, "mode", 4 /* synced */ ,
       "latency", JB_INITIAL_LATENCY, NULL);
 
+  ready_latency = session == VIDEO_RTP_SESSION ? JB_READY_VIDEO_LATENCY :
+      JB_READY_AUDIO_LATENCY;
+
+  KMS_ELEMENT_LOCK (self);
+  adaptive = self->priv->jb_adaptive;
+  min_latency = self->priv->jb_min_latency;
+  max_latency = self->priv->jb_max_latency;
+  KMS_ELEMENT_UNLOCK (self);
+
+  if (adaptive) {
+    ready_latency = CLAMP (ready_latency, min_latency, max_latency);
+    kms_base_rtp_endpoint_add_adaptive_latency (self, jitterbuffer,
+        ready_latency, min_latency, max_latency);
+  }
+
   src_pad = gst_element_get_static_pad (jitterbuffer, "src");
   gst_pad_add_probe (src_pad,
       GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
       kms_base_rtp_endpoint_change_latency_probe,
-      GINT_TO_POINTER (session ==
-          VIDEO_RTP_SESSION ? JB_READY_VIDEO_LATENCY : JB_READY_AUDIO_LATENCY),
-      NULL);
+      GINT_TO_POINTER (ready_latency), NULL);
   gst_pad_add_probe (src_pad,
       GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
       timestamps_probe, self, NULL);
@@ -2187,6 +2890,7 @@ ssrc_stats_add_jitter_stats (GstStructure * ssrc_stats,
     GstElement * jitter_buffer)
 {
   GstStructure *jitter_stats;
+  AdaptiveLatencyData *data;
   guint percent, latency;
 
   g_object_get (jitter_buffer, "percent", &percent, "latency", &latency,
@@ -2199,6 +2903,13 @@ ssrc_stats_add_jitter_stats (GstStructure * ssrc_stats,
   gst_structure_set (jitter_stats, "latency", G_TYPE_UINT, latency, "percent",
       G_TYPE_UINT, percent, NULL);
 
+  data = g_object_get_qdata (G_OBJECT (jitter_buffer),
+      adaptive_latency_data_quark ());
+  if (data != NULL) {
+    gst_structure_set (jitter_stats, "interarrival-jitter", G_TYPE_UINT64,
+        kms_adaptive_latency_get_jitter (data->al), NULL);
+  }
+
   /* Append jitter buffer stats to the ssrc stats */
   gst_structure_set (ssrc_stats, "jitter-buffer", GST_TYPE_STRUCTURE,
       jitter_stats, NULL);
@@ -2491,6 +3202,30 @@ kms_base_rtp_endpoint_set_property (GObject * object, guint property_id,
         self->priv->remb_params = g_value_dup_boxed (value);
       }
       break;
+    case PROP_JITTER_BUFFER_PARAMS:{
+      const GstStructure *params = g_value_get_boxed (value);
+      guint min_latency = self->priv->jb_min_latency;
+      guint max_latency = self->priv->jb_max_latency;
+
+      if (params == NULL) {
+        break;
+      }
+
+      gst_structure_get_boolean (params, "adaptive", &self->priv->jb_adaptive);
+      gst_structure_get_uint (params, "min-latency", &min_latency);
+      gst_structure_get_uint (params, "max-latency", &max_latency);
+
+      if (max_latency < min_latency) {
+        max_latency = min_latency;
+        GST_WARNING_OBJECT (object,
+            "Trying to set max-latency < min-latency. Setting %"
+            G_GUINT32_FORMAT, max_latency);
+      }
+
+      self->priv->jb_min_latency = min_latency;
+      self->priv->jb_max_latency = max_latency;
+      break;
+    }
     case PROP_MIN_PORT:{
       guint v = g_value_get_uint (value);
 
@@ -2578,6 +3313,12 @@ kms_base_rtp_endpoint_get_property (GObject * object, guint property_id,
     case PROP_SUPPORT_FEC:
       g_value_set_boolean (value, self->priv->support_fec);
       break;
+    case PROP_JITTER_BUFFER_PARAMS:
+      g_value_take_boxed (value, gst_structure_new ("jitter-buffer-params",
+              "adaptive", G_TYPE_BOOLEAN, self->priv->jb_adaptive,
+              "min-latency", G_TYPE_UINT, self->priv->jb_min_latency,
+              "max-latency", G_TYPE_UINT, self->priv->jb_max_latency, NULL));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -2667,9 +3408,12 @@ kms_base_rtp_endpoint_finalize (GObject * gobject)
   g_hash_table_foreach (sessions,
       kms_base_rtp_endpoint_disable_connections_stats, NULL);
 
-  if (self->priv->stats_file) {
-    fclose (self->priv->stats_file);
+  kms_sync_trace_destroy (self->priv->sync_trace);
+
+  if (self->priv->pt_table != NULL) {
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (self->priv->pt_table));
   }
+  g_mutex_clear (&self->priv->pt_table_mutex);
 
   G_OBJECT_CLASS (kms_base_rtp_endpoint_parent_class)->finalize (gobject);
 }
@@ -3004,6 +3748,12 @@ kms_base_rtp_endpoint_class_init (KmsBaseRtpEndpointClass * klass)
           "Forward error correction supported", FALSE,
           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (object_class, PROP_JITTER_BUFFER_PARAMS,
+      g_param_spec_boxed ("jitter-buffer-params", "jitter buffer params",
+          "Jitter buffer latency: 'adaptive' (boolean) moves it within "
+          "['min-latency', 'max-latency'] (ms) following the network jitter",
+          GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /* set signals */
   obj_signals[GET_CONNECTION_STATE] =
       g_signal_new ("get-connection_state",
@@ -3473,6 +4223,9 @@ kms_base_rtp_endpoint_init (KmsBaseRtpEndpoint * self)
   self->priv->min_port = DEFAULT_MIN_PORT;
   self->priv->max_port = DEFAULT_MAX_PORT;
 
+  self->priv->jb_min_latency = JB_ADAPTIVE_MIN_LATENCY;
+  self->priv->jb_max_latency = JB_ADAPTIVE_MAX_LATENCY;
+
   // As default pt is 0 default clockrate should be 8000
   self->priv->audio_sync.clock_rate = 8000;
   self->priv->video_sync.clock_rate = 8000;
@@ -3484,6 +4237,7 @@ kms_base_rtp_endpoint_init (KmsBaseRtpEndpoint * self)
   self->priv->video_sync.ext_ts = -1;
 
   g_mutex_init (&self->priv->sync_mutex);
+  g_mutex_init (&self->priv->pt_table_mutex);
 }
 
 static void
@@ -0,0 +1,158 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "kmscapsindex.h"
+
+/* Fields identifying an output, the rest are checked on lookup */
+static const gchar *fingerprint_fields[] = {
+  "encoding-name", "media", "width", "height", "framerate", NULL
+};
+
+struct _KmsCapsIndex
+{
+  GHashTable *entries;          /* Fingerprint -> CapsIndexEntry */
+};
+
+typedef struct _CapsIndexEntry
+{
+  GstBin *bin;
+  GstCaps *caps;
+} CapsIndexEntry;
+
+static void
+caps_index_entry_destroy (CapsIndexEntry * entry)
+{
+  gst_caps_unref (entry->caps);
+  g_slice_free (CapsIndexEntry, entry);
+}
+
+KmsCapsIndex *
+kms_caps_index_new (void)
+{
+  KmsCapsIndex *index = g_slice_new0 (KmsCapsIndex);
+
+  index->entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) caps_index_entry_destroy);
+
+  return index;
+}
+
+void
+kms_caps_index_destroy (KmsCapsIndex * index)
+{
+  g_hash_table_unref (index->entries);
+  g_slice_free (KmsCapsIndex, index);
+}
+
+gchar *
+kms_caps_index_fingerprint (const GstCaps * caps)
+{
+  GString *fingerprint;
+  guint i, j;
+
+  if (gst_caps_is_any (caps) || gst_caps_is_empty (caps)) {
+    return NULL;
+  }
+
+  fingerprint = g_string_new (NULL);
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    GstStructure *st = gst_caps_get_structure (caps, i);
+
+    g_string_append (fingerprint, gst_structure_get_name (st));
+
+    for (j = 0; fingerprint_fields[j] != NULL; j++) {
+      const GValue *value;
+      gchar *str;
+
+      value = gst_structure_get_value (st, fingerprint_fields[j]);
+      if (value == NULL) {
+        continue;
+      }
+
+      str = gst_value_serialize (value);
+      g_string_append_printf (fingerprint, ",%s=%s", fingerprint_fields[j],
+          str != NULL ? str : "?");
+      g_free (str);
+    }
+
+    g_string_append_c (fingerprint, ';');
+  }
+
+  return g_string_free (fingerprint, FALSE);
+}
+
+void
+kms_caps_index_add (KmsCapsIndex * index, GstCaps * caps, GstBin * bin)
+{
+  CapsIndexEntry *entry;
+  gchar *fingerprint;
+
+  fingerprint = kms_caps_index_fingerprint (caps);
+  if (fingerprint == NULL) {
+    return;
+  }
+
+  entry = g_slice_new (CapsIndexEntry);
+  entry->bin = bin;
+  entry->caps = gst_caps_ref (caps);
+
+  g_hash_table_insert (index->entries, fingerprint, entry);
+}
+
+static gboolean
+caps_index_entry_is_for_bin (gpointer key, CapsIndexEntry * entry,
+    GstBin * bin)
+{
+  return entry->bin == bin;
+}
+
+void
+kms_caps_index_remove (KmsCapsIndex * index, GstBin * bin)
+{
+  g_hash_table_foreach_remove (index->entries,
+      (GHRFunc) caps_index_entry_is_for_bin, bin);
+}
+
+GstBin *
+kms_caps_index_lookup (KmsCapsIndex * index, const GstCaps * caps,
+    GstCaps ** indexed_caps)
+{
+  CapsIndexEntry *entry;
+  gchar *fingerprint;
+
+  fingerprint = kms_caps_index_fingerprint (caps);
+  if (fingerprint == NULL) {
+    return NULL;
+  }
+
+  entry = g_hash_table_lookup (index->entries, fingerprint);
+  g_free (fingerprint);
+
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  if (indexed_caps != NULL) {
+    *indexed_caps = entry->caps;
+  }
+
+  return entry->bin;
+}
@@ -0,0 +1,47 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef __KMS_CAPS_INDEX_H__
+#define __KMS_CAPS_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Resolves the bin serving some caps without querying every bin. Bins are
+ * indexed by a fingerprint of the fields identifying an output: media type,
+ * encoding-name, media, width, height and framerate. Any other field is left
+ * to the owner to check on the bin found. Bins are not referenced.
+ */
+typedef struct _KmsCapsIndex KmsCapsIndex;
+
+KmsCapsIndex * kms_caps_index_new (void);
+void kms_caps_index_destroy (KmsCapsIndex * index);
+
+/* Returns NULL for ANY or empty caps, which cannot be indexed */
+gchar * kms_caps_index_fingerprint (const GstCaps * caps);
+
+void kms_caps_index_add (KmsCapsIndex * index, GstCaps * caps, GstBin * bin);
+void kms_caps_index_remove (KmsCapsIndex * index, GstBin * bin);
+
+/* Returns the bin indexed under the fingerprint of @caps, if any, and the
+ * caps it was added with in @indexed_caps */
+GstBin * kms_caps_index_lookup (KmsCapsIndex * index, const GstCaps * caps,
+    GstCaps ** indexed_caps);
+
+G_END_DECLS
+#endif /* __KMS_CAPS_INDEX_H__ */
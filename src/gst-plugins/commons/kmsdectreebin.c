@@ -21,6 +21,8 @@
 
 #include "kmsdectreebin.h"
 #include "kmsutils.h"
+#include "kmsfactorycache.h"
+#include "kmsaudiolevelmeta.h"
 
 #define GST_DEFAULT_NAME "dectreebin"
 #define GST_CAT_DEFAULT kms_dec_tree_bin_debug
@@ -29,34 +31,64 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define kms_dec_tree_bin_parent_class parent_class
 G_DEFINE_TYPE (KmsDecTreeBin, kms_dec_tree_bin, KMS_TYPE_TREE_BIN);
 
-static GstElement *
-create_decoder_for_caps (const GstCaps * caps, const GstCaps * raw_caps)
+#define KMS_DEC_TREE_BIN_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (             \
+    (obj),                                  \
+    KMS_TYPE_DEC_TREE_BIN,                  \
+    KmsDecTreeBinPrivate                    \
+  )                                         \
+)
+
+#define DEFAULT_MAX_LATENESS -1
+
+/* The minimum delay of the last two windows is taken as the delay of the
+ * stream when the decoder keeps up */
+#define DELAY_WINDOW (5 * GST_SECOND)
+
+/* Lateness reported by QoS events is forgotten after this time */
+#define QOS_VALIDITY GST_SECOND
+
+/* Gate asked by the consumer linked to an output tee src pad, plus one */
+#define KEY_GATE_LEVEL "kms-key-gate-level"
+G_DEFINE_QUARK (KEY_GATE_LEVEL, key_gate_level);
+
+struct _KmsDecTreeBinPrivate
 {
-  GList *decoder_list, *filtered_list, *aux_list, *l;
-  GstElementFactory *decoder_factory = NULL;
-  GstElement *decoder = NULL;
-  gboolean contains_openh264 = FALSE;
+  GstClockTimeDiff max_lateness;
 
-  decoder_list =
-      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_DECODER,
-      GST_RANK_NONE);
+  GstClockTime window_start;
+  GstClockTimeDiff window_min_delay;
+  GstClockTimeDiff prev_min_delay;
 
-  /* HACK: Augment the openh264 rank */
-  for (l = decoder_list; l != NULL; l = l->next) {
-    decoder_factory = GST_ELEMENT_FACTORY (l->data);
+  GstClockTimeDiff qos_jitter;
+  GstClockTime qos_time;
 
-    if (g_str_has_prefix (GST_OBJECT_NAME (decoder_factory), "openh264")) {
-      decoder_list = g_list_remove (decoder_list, l->data);
-      decoder_list = g_list_prepend (decoder_list, decoder_factory);
-      contains_openh264 = TRUE;
-      break;
-    }
-  }
-  decoder_factory = NULL;
+  /* Waiting for a keyframe after dropping a late frame */
+  gboolean keyframe_wait;
+  guint64 dropped;
 
-  /* Remove stream-format from raw_caps to allow select openh264dec */
-  if (contains_openh264 &&
-      g_str_has_suffix (gst_structure_get_name (gst_caps_get_structure (caps,
+  /* Audio quieter than this level is not decoded, the loosest gate of the
+   * consumers */
+  guint8 gate_level;
+  gboolean gated;
+};
+
+enum
+{
+  PROP_0,
+  PROP_MAX_LATENESS,
+  PROP_DROPPED,
+  N_PROPERTIES
+};
+
+static GstElement *
+create_decoder_for_caps (const GstCaps * caps, const GstCaps * raw_caps)
+{
+  GstElementFactory *factory = NULL;
+  GstElement *decoder = NULL;
+
+  /* Remove stream-format from caps to allow selecting openh264dec */
+  if (g_str_has_suffix (gst_structure_get_name (gst_caps_get_structure (caps,
                   0)), "h264")) {
     GstCaps *caps_copy;
     GstStructure *structure;
@@ -64,36 +96,340 @@ create_decoder_for_caps (const GstCaps * caps, const GstCaps * raw_caps)
     structure = gst_structure_copy (gst_caps_get_structure (caps, 0));
     gst_structure_remove_field (structure, "stream-format");
     caps_copy = gst_caps_new_full (structure, NULL);
-    aux_list =
-        gst_element_factory_list_filter (decoder_list, caps_copy, GST_PAD_SINK,
-        FALSE);
+    factory = kms_factory_cache_get (GST_ELEMENT_FACTORY_TYPE_DECODER,
+        caps_copy, raw_caps);
     gst_caps_unref (caps_copy);
+
+    if (factory != NULL && !kms_factory_cache_is_preferred (factory)) {
+      gst_object_unref (factory);
+      factory = NULL;
+    }
+  }
+
+  if (factory == NULL) {
+    factory = kms_factory_cache_get (GST_ELEMENT_FACTORY_TYPE_DECODER, caps,
+        raw_caps);
+  }
+
+  if (factory != NULL) {
+    decoder = gst_element_factory_create (factory, NULL);
+    gst_object_unref (factory);
+  }
+
+  return decoder;
+}
+
+/* Overload protection begin */
+
+static void
+kms_dec_tree_bin_reset_delay (KmsDecTreeBin * self)
+{
+  self->priv->window_start = GST_CLOCK_TIME_NONE;
+  self->priv->window_min_delay = G_MAXINT64;
+  self->priv->prev_min_delay = G_MAXINT64;
+}
+
+/* Delay of a buffer over the delay of the stream when decoding keeps up. It
+ * grows when decoding, or encoding the decoded frames, is too slow */
+static GstClockTimeDiff
+kms_dec_tree_bin_get_excess_delay (KmsDecTreeBin * self, GstClockTime ts,
+    GstClockTime now)
+{
+  GstClockTimeDiff delay = GST_CLOCK_DIFF (ts, now);
+
+  if (!GST_CLOCK_TIME_IS_VALID (self->priv->window_start)
+      || now - self->priv->window_start > DELAY_WINDOW) {
+    self->priv->prev_min_delay = self->priv->window_min_delay;
+    self->priv->window_min_delay = G_MAXINT64;
+    self->priv->window_start = now;
+  }
+
+  self->priv->window_min_delay = MIN (self->priv->window_min_delay, delay);
+
+  return delay - MIN (self->priv->window_min_delay,
+      self->priv->prev_min_delay);
+}
+
+static GstClockTimeDiff
+kms_dec_tree_bin_get_lateness (KmsDecTreeBin * self, GstBuffer * buffer)
+{
+  GstClockTime ts = GST_BUFFER_DTS_OR_PTS (buffer);
+  GstClockTime now = kms_utils_get_time_nsecs ();
+  GstClockTimeDiff lateness = 0;
+
+  if (GST_CLOCK_TIME_IS_VALID (ts)) {
+    lateness = kms_dec_tree_bin_get_excess_delay (self, ts, now);
+  }
+
+  GST_OBJECT_LOCK (self);
+  if (GST_CLOCK_TIME_IS_VALID (self->priv->qos_time)
+      && now - self->priv->qos_time < QOS_VALIDITY) {
+    lateness = MAX (lateness, self->priv->qos_jitter);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return lateness;
+}
+
+static void
+kms_dec_tree_bin_count_dropped (KmsDecTreeBin * self)
+{
+  GST_OBJECT_LOCK (self);
+  self->priv->dropped++;
+  GST_OBJECT_UNLOCK (self);
+}
+
+/* Frames are dropped before being decoded when they are late: non-reference
+ * frames past half of the budget, every frame until the next keyframe past
+ * the whole budget. All of them are counted in "dropped" */
+static GstPadProbeReturn
+overload_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  KmsDecTreeBin *self = KMS_DEC_TREE_BIN (user_data);
+  GstClockTimeDiff max_lateness, lateness;
+  GstBuffer *buffer;
+
+  if (!(GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER)) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT
+        || GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+      kms_dec_tree_bin_reset_delay (self);
+    }
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (self->priv->keyframe_wait) {
+    if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      /* Dropped by the drop until keyframe probe, that runs after this one */
+      kms_dec_tree_bin_count_dropped (self);
+      return GST_PAD_PROBE_OK;
+    }
+
+    self->priv->keyframe_wait = FALSE;
+  }
+
+  GST_OBJECT_LOCK (self);
+  max_lateness = self->priv->max_lateness;
+  GST_OBJECT_UNLOCK (self);
+
+  if (max_lateness < 0) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  lateness = kms_dec_tree_bin_get_lateness (self, buffer);
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)
+      || lateness <= max_lateness / 2) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (lateness <= max_lateness) {
+    if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DROPPABLE)) {
+      return GST_PAD_PROBE_OK;
+    }
+
+    GST_LOG_OBJECT (self, "%" GST_TIME_FORMAT " late, skipping "
+        "non-reference frame", GST_TIME_ARGS (lateness));
   } else {
-    aux_list =
-        gst_element_factory_list_filter (decoder_list, caps, GST_PAD_SINK,
-        FALSE);
+    GST_DEBUG_OBJECT (self, "%" GST_TIME_FORMAT " late, dropping until "
+        "next keyframe", GST_TIME_ARGS (lateness));
+    kms_utils_drop_until_keyframe (pad, TRUE);
+    self->priv->keyframe_wait = TRUE;
   }
 
-  filtered_list =
-      gst_element_factory_list_filter (aux_list, raw_caps, GST_PAD_SRC, FALSE);
+  kms_dec_tree_bin_count_dropped (self);
+
+  return GST_PAD_PROBE_DROP;
+}
 
-  for (l = filtered_list; l != NULL && decoder_factory == NULL; l = l->next) {
-    decoder_factory = GST_ELEMENT_FACTORY (l->data);
-    if (gst_element_factory_get_num_pad_templates (decoder_factory) != 2)
-      decoder_factory = NULL;
+/* Outputs rendering the decoded frames report their lateness */
+static GstPadProbeReturn
+qos_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  KmsDecTreeBin *self = KMS_DEC_TREE_BIN (user_data);
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  GstClockTimeDiff diff;
+  GstClockTime timestamp;
+  GstQOSType type;
+  gdouble proportion;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_QOS) {
+    return GST_PAD_PROBE_OK;
   }
 
-  if (decoder_factory != NULL) {
-    decoder = gst_element_factory_create (decoder_factory, NULL);
+  gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+  if (type == GST_QOS_TYPE_THROTTLE) {
+    return GST_PAD_PROBE_OK;
   }
 
-  gst_plugin_feature_list_free (filtered_list);
-  gst_plugin_feature_list_free (decoder_list);
-  gst_plugin_feature_list_free (aux_list);
+  GST_OBJECT_LOCK (self);
+  self->priv->qos_jitter = diff;
+  self->priv->qos_time = kms_utils_get_time_nsecs ();
+  GST_OBJECT_UNLOCK (self);
 
-  return decoder;
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+kms_dec_tree_bin_watch_load (KmsDecTreeBin * self, GstElement * dec)
+{
+  GstPad *pad;
+
+  pad = gst_element_get_static_pad (dec, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      overload_probe, self, NULL);
+  g_object_unref (pad);
+
+  pad = gst_element_get_static_pad (dec, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, qos_probe, self,
+      NULL);
+  g_object_unref (pad);
+}
+
+/* Overload protection end */
+
+/* Audio level gate begin */
+
+/* Mixers not mixing this stream ask for the audio they would not use to be
+ * dropped, by its RFC 6464 level. Audio without level is always decoded */
+static GstPadProbeReturn
+audio_level_gate_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsDecTreeBin *self = KMS_DEC_TREE_BIN (user_data);
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  KmsAudioLevelMeta *meta;
+  guint8 gate_level;
+
+  GST_OBJECT_LOCK (self);
+  gate_level = self->priv->gate_level;
+  GST_OBJECT_UNLOCK (self);
+
+  meta = kms_buffer_get_audio_level_meta (buffer);
+
+  if (meta != NULL && meta->level > gate_level) {
+    GST_LOG_OBJECT (self, "Level -%u dBov under the gate, not decoding",
+        meta->level);
+    self->priv->gated = TRUE;
+    return GST_PAD_PROBE_DROP;
+  }
+
+  if (self->priv->gated) {
+    self->priv->gated = FALSE;
+    buffer = gst_buffer_make_writable (buffer);
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+    GST_PAD_PROBE_INFO_DATA (info) = buffer;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+loosest_gate (GstPad * pad, gpointer data)
+{
+  gint *gate = data;
+  gint level;
+
+  level = GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (pad),
+          key_gate_level_quark ()));
+
+  /* Pads without level do not feed a consumer */
+  if (level > 0) {
+    *gate = MAX (*gate, level - 1);
+  }
 }
 
+/* The same decoded audio feeds every consumer, so it is only dropped when
+ * all of them would drop it */
+static void
+kms_dec_tree_bin_update_gate (KmsDecTreeBin * self)
+{
+  GstElement *tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (self));
+  gint gate = -1;
+
+  kms_element_for_each_src_pad (tee, loosest_gate, &gate);
+
+  if (gate < 0) {
+    gate = KMS_AUDIO_LEVEL_SILENCE;
+  }
+
+  GST_DEBUG_OBJECT (self, "Decoding audio up to -%u dBov", gate);
+
+  GST_OBJECT_LOCK (self);
+  self->priv->gate_level = gate;
+  GST_OBJECT_UNLOCK (self);
+}
+
+static GstPadProbeReturn
+audio_level_gate_event_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsDecTreeBin *self = KMS_DEC_TREE_BIN (user_data);
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  guint8 level;
+
+  if (!kms_audio_level_gate_event_parse (event, &level)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  g_object_set_qdata (G_OBJECT (pad), key_gate_level_quark (),
+      GUINT_TO_POINTER (level + 1));
+  kms_dec_tree_bin_update_gate (self);
+
+  return GST_PAD_PROBE_DROP;
+}
+
+/* Consumers decode everything until they ask for a gate */
+static void
+audio_level_gate_pad_added (GstElement * tee, GstPad * pad,
+    KmsDecTreeBin * self)
+{
+  if (GST_PAD_DIRECTION (pad) != GST_PAD_SRC) {
+    return;
+  }
+
+  g_object_set_qdata (G_OBJECT (pad), key_gate_level_quark (),
+      GUINT_TO_POINTER (KMS_AUDIO_LEVEL_SILENCE + 1));
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+      audio_level_gate_event_probe, self, NULL);
+  kms_dec_tree_bin_update_gate (self);
+}
+
+static void
+audio_level_gate_pad_removed (GstElement * tee, GstPad * pad,
+    KmsDecTreeBin * self)
+{
+  if (GST_PAD_DIRECTION (pad) == GST_PAD_SRC) {
+    kms_dec_tree_bin_update_gate (self);
+  }
+}
+
+static void
+kms_dec_tree_bin_add_audio_level_gate (KmsDecTreeBin * self,
+    GstElement * dec)
+{
+  GstElement *tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (self));
+  GstPad *pad;
+
+  pad = gst_element_get_static_pad (dec, "sink");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, audio_level_gate_probe,
+      self, NULL);
+  g_object_unref (pad);
+
+  /* Src pads already in the tree bin feed no consumer */
+  g_signal_connect_object (tee, "pad-added",
+      G_CALLBACK (audio_level_gate_pad_added), self, 0);
+  g_signal_connect_object (tee, "pad-removed",
+      G_CALLBACK (audio_level_gate_pad_removed), self, 0);
+}
+
+/* Audio level gate end */
+
 static gboolean
 kms_dec_tree_bin_configure (KmsDecTreeBin * self, const GstCaps * caps,
     const GstCaps * raw_caps)
@@ -144,6 +480,13 @@ kms_dec_tree_bin_configure (KmsDecTreeBin * self, const GstCaps * caps,
     gst_element_link (dec, output_tee);
   }
 
+  kms_dec_tree_bin_watch_load (self, dec);
+
+  if (g_str_has_prefix (gst_structure_get_name (gst_caps_get_structure (caps,
+                  0)), "audio/")) {
+    kms_dec_tree_bin_add_audio_level_gate (self, dec);
+  }
+
   g_free (name);
 
   return TRUE;
@@ -163,15 +506,62 @@ kms_dec_tree_bin_new (const GstCaps * caps, const GstCaps * raw_caps)
   return KMS_DEC_TREE_BIN (dec);
 }
 
+static void
+kms_dec_tree_bin_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsDecTreeBin *self = KMS_DEC_TREE_BIN (object);
+
+  switch (property_id) {
+    case PROP_MAX_LATENESS:
+      GST_OBJECT_LOCK (self);
+      self->priv->max_lateness = g_value_get_int64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_dec_tree_bin_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsDecTreeBin *self = KMS_DEC_TREE_BIN (object);
+
+  switch (property_id) {
+    case PROP_MAX_LATENESS:
+      GST_OBJECT_LOCK (self);
+      g_value_set_int64 (value, self->priv->max_lateness);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_DROPPED:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->priv->dropped);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
 static void
 kms_dec_tree_bin_init (KmsDecTreeBin * self)
 {
-  /* Nothing to do */
+  self->priv = KMS_DEC_TREE_BIN_GET_PRIVATE (self);
+
+  self->priv->max_lateness = DEFAULT_MAX_LATENESS;
+  self->priv->gate_level = KMS_AUDIO_LEVEL_SILENCE;
+  self->priv->qos_time = GST_CLOCK_TIME_NONE;
+  kms_dec_tree_bin_reset_delay (self);
 }
 
 static void
 kms_dec_tree_bin_class_init (KmsDecTreeBinClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
 
   gst_element_class_set_details_simple (gstelement_class,
@@ -180,6 +570,22 @@ kms_dec_tree_bin_class_init (KmsDecTreeBinClass * klass)
       "Bin to decode and distribute RAW media.",
       "Miguel París Díaz <mparisdiaz@gmail.com>");
 
+  gobject_class->set_property = kms_dec_tree_bin_set_property;
+  gobject_class->get_property = kms_dec_tree_bin_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_MAX_LATENESS,
+      g_param_spec_int64 ("max-lateness", "max lateness",
+          "Lateness (ns) from which frames are dropped before being decoded "
+          "(-1 = never drop)", -1, G_MAXINT64, DEFAULT_MAX_LATENESS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DROPPED,
+      g_param_spec_uint64 ("dropped", "dropped",
+          "Frames dropped before being decoded because they were late", 0,
+          G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
       GST_DEFAULT_NAME);
+
+  g_type_class_add_private (klass, sizeof (KmsDecTreeBinPrivate));
 }
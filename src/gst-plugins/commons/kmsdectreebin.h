@@ -36,10 +36,13 @@ G_BEGIN_DECLS
 
 typedef struct _KmsDecTreeBin KmsDecTreeBin;
 typedef struct _KmsDecTreeBinClass KmsDecTreeBinClass;
+typedef struct _KmsDecTreeBinPrivate KmsDecTreeBinPrivate;
 
 struct _KmsDecTreeBin
 {
   KmsTreeBin parent;
+
+  KmsDecTreeBinPrivate *priv;
 };
 
 struct _KmsDecTreeBinClass
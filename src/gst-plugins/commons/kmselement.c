@@ -34,9 +34,11 @@
 #define MAX_BITRATE "max-bitrate"
 #define MIN_BITRATE "min-bitrate"
 #define CODEC_CONFIG "codec-config"
+#define SHARE_ENCODERS "share-encoders"
 
 #define DEFAULT_MIN_BITRATE 0
 #define DEFAULT_MAX_BITRATE G_MAXINT
+#define DEFAULT_SHARE_ENCODERS FALSE
 #define MEDIA_FLOW_INTERNAL_TIME_SEC 2
 
 GST_DEBUG_CATEGORY_STATIC (kms_element_debug_category);
@@ -153,6 +155,7 @@ struct _KmsElementPrivate
   gint max_bitrate;
 
   GstStructure *codec_config;
+  gboolean share_encoders;
 
   /* Statistics */
   KmsElementStats stats;
@@ -182,6 +185,7 @@ enum
   PROP_MAX_BITRATE,
   PROP_MEDIA_STATS,
   PROP_CODEC_CONFIG,
+  PROP_SHARE_ENCODERS,
   PROP_LAST
 };
 
@@ -722,6 +726,12 @@ kms_element_get_output_element (KmsElement * self, KmsElementPadType pad_type,
       kms_element_set_video_output_properties (self, odata->element);
     }
 
+    if (pad_type == KMS_ELEMENT_PAD_TYPE_AUDIO ||
+        pad_type == KMS_ELEMENT_PAD_TYPE_VIDEO) {
+      KMS_SET_OBJECT_PROPERTY_SAFETLY (odata->element, SHARE_ENCODERS,
+          self->priv->share_encoders);
+    }
+
     gst_bin_add (GST_BIN (self), odata->element);
     gst_element_sync_state_with_parent (odata->element);
     KMS_ELEMENT_UNLOCK (self);
@@ -1150,6 +1160,21 @@ set_codec_config (gchar * id, KmsOutputElementData * odata, KmsElement * self)
   }
 }
 
+static void
+set_share_encoders (gchar * id, KmsOutputElementData * odata,
+    KmsElement * self)
+{
+  if (odata->element == NULL) {
+    return;
+  }
+
+  if (odata->type == KMS_ELEMENT_PAD_TYPE_AUDIO ||
+      odata->type == KMS_ELEMENT_PAD_TYPE_VIDEO) {
+    KMS_SET_OBJECT_PROPERTY_SAFETLY (odata->element, SHARE_ENCODERS,
+        self->priv->share_encoders);
+  }
+}
+
 static void
 kms_element_set_property (GObject * object, guint property_id,
     const GValue * value, GParamSpec * pspec)
@@ -1215,6 +1240,13 @@ kms_element_set_property (GObject * object, guint property_id,
       KMS_ELEMENT_UNLOCK (self);
       break;
     }
+    case PROP_SHARE_ENCODERS:
+      KMS_ELEMENT_LOCK (self);
+      self->priv->share_encoders = g_value_get_boolean (value);
+      g_hash_table_foreach (self->priv->output_elements,
+          (GHFunc) set_share_encoders, self);
+      KMS_ELEMENT_UNLOCK (self);
+      break;
     case PROP_MEDIA_STATS:{
       gboolean enable = g_value_get_boolean (value);
 
@@ -1272,6 +1304,11 @@ kms_element_get_property (GObject * object, guint property_id,
       g_value_set_boxed (value, self->priv->codec_config);
       KMS_ELEMENT_UNLOCK (self);
       break;
+    case PROP_SHARE_ENCODERS:
+      KMS_ELEMENT_LOCK (self);
+      g_value_set_boolean (value, self->priv->share_encoders);
+      KMS_ELEMENT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1797,6 +1834,12 @@ kms_element_class_init (KmsElementClass * klass)
       g_param_spec_boxed ("codec-config", "codec config",
           "Codec configuration", GST_TYPE_STRUCTURE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_SHARE_ENCODERS,
+      g_param_spec_boolean ("share-encoders", "share encoders",
+          "Let the outputs share encoders with the elements of the pipeline "
+          "whose input is the same stream", DEFAULT_SHARE_ENCODERS,
+          G_PARAM_READWRITE));
+
   klass->sink_query = GST_DEBUG_FUNCPTR (kms_element_sink_query_default);
   klass->collect_media_stats =
       GST_DEBUG_FUNCPTR (kms_element_collect_media_stats_impl);
@@ -1868,6 +1911,7 @@ kms_element_init (KmsElement * element)
 
   element->priv->min_bitrate = DEFAULT_MIN_BITRATE;
   element->priv->max_bitrate = DEFAULT_MAX_BITRATE;
+  element->priv->share_encoders = DEFAULT_SHARE_ENCODERS;
 
   element->priv->pendingpads = g_hash_table_new_full (g_str_hash, g_str_equal,
       g_free, (GDestroyNotify) destroy_pendingpads);
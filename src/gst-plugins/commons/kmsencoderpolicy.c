@@ -0,0 +1,201 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsencoderpolicy.h"
+
+#include <stdlib.h>
+
+#define GST_CAT_DEFAULT kms_encoder_policy_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsencoderpolicy"
+
+#define ENCODER_CORES_ENV "KURENTO_ENCODER_CORES"
+
+#define PIXELS_PER_CORE (1280 * 720 * 30)       /* pixels/s */
+#define PIXELS_PER_THREAD (640 * 480 * 30)      /* pixels/s */
+#define MAX_THREADS 8
+#define DEFAULT_FRAMERATE 30
+#define OVERLOADED_FRAMERATE 15
+
+/* Load over budget from which every level starts, in percentage */
+#define HIGH_LOAD 70
+#define SATURATED_LOAD 90
+#define OVERLOADED_LOAD 110
+
+struct _KmsEncoderClient
+{
+  KmsEncoderPolicyFunc func;
+  gpointer user_data;
+  guint64 pixel_rate;
+};
+
+static GMutex policy_mutex;
+static GList *clients;
+static guint64 total_load;
+static guint budget_cores;
+static guint default_cores;
+static KmsEncoderLoadLevel current_level = KMS_ENCODER_LOAD_NORMAL;
+
+guint
+kms_encoder_policy_threads_for (guint64 pixel_rate, guint cores)
+{
+  guint64 threads;
+
+  threads = (pixel_rate + PIXELS_PER_THREAD - 1) / PIXELS_PER_THREAD;
+
+  return CLAMP (threads, 1, MAX (1, MIN (MAX_THREADS, cores)));
+}
+
+KmsEncoderLoadLevel
+kms_encoder_policy_level_for (guint64 load, guint cores)
+{
+  guint64 budget = (guint64) MAX (cores, 1) * PIXELS_PER_CORE;
+
+  if (load * 100 >= budget * OVERLOADED_LOAD) {
+    return KMS_ENCODER_LOAD_OVERLOADED;
+  } else if (load * 100 >= budget * SATURATED_LOAD) {
+    return KMS_ENCODER_LOAD_SATURATED;
+  } else if (load * 100 >= budget * HIGH_LOAD) {
+    return KMS_ENCODER_LOAD_HIGH;
+  } else {
+    return KMS_ENCODER_LOAD_NORMAL;
+  }
+}
+
+/* Should be called with the policy mutex held */
+static void
+kms_encoder_policy_fill_settings (KmsEncoderClient * client,
+    KmsEncoderSettings * settings)
+{
+  settings->threads =
+      kms_encoder_policy_threads_for (client->pixel_rate, budget_cores);
+  settings->level = current_level;
+  settings->max_framerate =
+      current_level == KMS_ENCODER_LOAD_OVERLOADED ? OVERLOADED_FRAMERATE : 0;
+}
+
+/* Should be called with the policy mutex held */
+static void
+kms_encoder_policy_update (void)
+{
+  KmsEncoderLoadLevel level;
+  GList *l;
+
+  level = kms_encoder_policy_level_for (total_load, budget_cores);
+  if (level == current_level) {
+    return;
+  }
+
+  GST_INFO ("Encoding load %" G_GUINT64_FORMAT " pixels/s over %u cores, "
+      "level %d -> %d", total_load, budget_cores, current_level, level);
+  current_level = level;
+
+  for (l = clients; l != NULL; l = l->next) {
+    KmsEncoderClient *client = l->data;
+    KmsEncoderSettings settings;
+
+    kms_encoder_policy_fill_settings (client, &settings);
+    client->func (&settings, client->user_data);
+  }
+}
+
+KmsEncoderClient *
+kms_encoder_policy_register (KmsEncoderPolicyFunc func, gpointer user_data)
+{
+  KmsEncoderClient *client;
+
+  client = g_slice_new0 (KmsEncoderClient);
+  client->func = func;
+  client->user_data = user_data;
+
+  g_mutex_lock (&policy_mutex);
+  clients = g_list_prepend (clients, client);
+  g_mutex_unlock (&policy_mutex);
+
+  return client;
+}
+
+void
+kms_encoder_policy_unregister (KmsEncoderClient * client)
+{
+  g_mutex_lock (&policy_mutex);
+  clients = g_list_remove (clients, client);
+  total_load -= client->pixel_rate;
+  kms_encoder_policy_update ();
+  g_mutex_unlock (&policy_mutex);
+
+  g_slice_free (KmsEncoderClient, client);
+}
+
+void
+kms_encoder_policy_set_format (KmsEncoderClient * client, gint width,
+    gint height, gint fps_n, gint fps_d)
+{
+  guint64 pixel_rate;
+
+  if (fps_n <= 0 || fps_d <= 0) {
+    fps_n = DEFAULT_FRAMERATE;
+    fps_d = 1;
+  }
+
+  pixel_rate = gst_util_uint64_scale_int ((guint64) MAX (width, 0) *
+      MAX (height, 0), fps_n, fps_d);
+
+  g_mutex_lock (&policy_mutex);
+  total_load = total_load - client->pixel_rate + pixel_rate;
+  client->pixel_rate = pixel_rate;
+  kms_encoder_policy_update ();
+  g_mutex_unlock (&policy_mutex);
+}
+
+void
+kms_encoder_policy_get_settings (KmsEncoderClient * client,
+    KmsEncoderSettings * settings)
+{
+  g_mutex_lock (&policy_mutex);
+  kms_encoder_policy_fill_settings (client, settings);
+  g_mutex_unlock (&policy_mutex);
+}
+
+void
+kms_encoder_policy_set_cores (guint cores)
+{
+  g_mutex_lock (&policy_mutex);
+  budget_cores = cores != 0 ? cores : default_cores;
+  kms_encoder_policy_update ();
+  g_mutex_unlock (&policy_mutex);
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  const gchar *env;
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  default_cores = g_get_num_processors ();
+
+  env = g_getenv (ENCODER_CORES_ENV);
+  if (env != NULL && atoi (env) > 0) {
+    default_cores = atoi (env);
+  }
+
+  budget_cores = default_cores;
+}
@@ -0,0 +1,77 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_ENCODER_POLICY_H__
+#define __KMS_ENCODER_POLICY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Process wide CPU budget for video encoders. Every encoder declares the
+ * pixel rate (width x height x framerate) it encodes, and gets the number of
+ * threads to use for its resolution and a load level computed from the sum
+ * of all of them against the budget. When the level changes all encoders
+ * are notified, so that they degrade together instead of falling behind.
+ *
+ * The budget is a number of cores, all the available ones by default, that
+ * can be changed with the KURENTO_ENCODER_CORES environment variable.
+ */
+
+typedef enum
+{
+  KMS_ENCODER_LOAD_NORMAL,
+  KMS_ENCODER_LOAD_HIGH,
+  KMS_ENCODER_LOAD_SATURATED,
+  KMS_ENCODER_LOAD_OVERLOADED
+} KmsEncoderLoadLevel;
+
+typedef struct _KmsEncoderSettings
+{
+  guint threads;
+  KmsEncoderLoadLevel level;
+  gint max_framerate;           /* 0 if not limited */
+} KmsEncoderSettings;
+
+typedef struct _KmsEncoderClient KmsEncoderClient;
+
+/* Called with the policy locked, so it cannot be called once the client is
+ * unregistered. It must not call the policy */
+typedef void (*KmsEncoderPolicyFunc) (const KmsEncoderSettings * settings,
+    gpointer user_data);
+
+KmsEncoderClient * kms_encoder_policy_register (KmsEncoderPolicyFunc func,
+    gpointer user_data);
+void kms_encoder_policy_unregister (KmsEncoderClient * client);
+
+/* Updates the load of @client. A framerate of 0 is taken as 30 fps */
+void kms_encoder_policy_set_format (KmsEncoderClient * client, gint width,
+    gint height, gint fps_n, gint fps_d);
+void kms_encoder_policy_get_settings (KmsEncoderClient * client,
+    KmsEncoderSettings * settings);
+
+/* Budget in cores, 0 restores the default one */
+void kms_encoder_policy_set_cores (guint cores);
+
+/* Policy functions */
+guint kms_encoder_policy_threads_for (guint64 pixel_rate, guint cores);
+KmsEncoderLoadLevel kms_encoder_policy_level_for (guint64 load,
+    guint cores);
+
+G_END_DECLS
+#endif /* __KMS_ENCODER_POLICY_H__ */
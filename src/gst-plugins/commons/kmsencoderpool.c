@@ -0,0 +1,398 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsencoderpool.h"
+#include "kmsloop.h"
+
+#define GST_CAT_DEFAULT kms_encoder_pool_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsencoderpool"
+
+#define WARM_ENCODERS_ENV "KURENTO_WARM_ENCODERS"
+
+#define WARM_TARGET_BITRATE 300000
+#define IDLE_TIMEOUT 30000      /* ms */
+#define MAX_IDLE_BINS 8
+
+#define POOL_CAPS "kms-pool-caps"
+G_DEFINE_QUARK (POOL_CAPS, pool_caps);
+
+#define POOL_CONFIG "kms-pool-config"
+G_DEFINE_QUARK (POOL_CONFIG, pool_config);
+
+typedef struct _PoolEntry
+{
+  KmsEncTreeBin *bin;
+  GstCaps *caps;
+  gchar *config;
+  gboolean warm;
+  guint timeout_id;
+} PoolEntry;
+
+static GMutex pool_mutex;
+static GList *entries;
+static const gchar *warm_profiles;
+static gboolean warmed_up;
+static KmsLoop *loop;
+
+static void
+pool_entry_destroy (PoolEntry * entry)
+{
+  gst_element_set_state (GST_ELEMENT (entry->bin), GST_STATE_NULL);
+  g_object_unref (entry->bin);
+  gst_caps_unref (entry->caps);
+  g_free (entry->config);
+  g_slice_free (PoolEntry, entry);
+}
+
+static gchar *
+config_to_string (GstStructure * codec_configs)
+{
+  return codec_configs != NULL ? gst_structure_to_string (codec_configs) :
+      NULL;
+}
+
+static KmsEncTreeBin *
+kms_encoder_pool_create_bin (const GstCaps * caps, gint target_bitrate,
+    gint min_bitrate, gint max_bitrate, GstStructure * codec_configs)
+{
+  KmsEncTreeBin *bin;
+
+  bin = kms_enc_tree_bin_new (caps, target_bitrate, min_bitrate, max_bitrate,
+      codec_configs);
+  if (bin == NULL) {
+    return NULL;
+  }
+
+  g_object_set_qdata_full (G_OBJECT (bin), pool_caps_quark (),
+      gst_caps_copy (caps), (GDestroyNotify) gst_caps_unref);
+  g_object_set_qdata_full (G_OBJECT (bin), pool_config_quark (),
+      config_to_string (codec_configs), g_free);
+
+  return bin;
+}
+
+/* Should be called with the pool mutex held */
+static KmsLoop *
+kms_encoder_pool_get_loop (void)
+{
+  if (loop == NULL) {
+    loop = kms_loop_new ();
+  }
+
+  return loop;
+}
+
+/* Pool entries */
+
+static gboolean
+warm_bin_cb (gpointer data)
+{
+  GstCaps *caps = data;
+  PoolEntry *entry;
+  KmsEncTreeBin *bin;
+
+  bin = kms_encoder_pool_create_bin (caps, WARM_TARGET_BITRATE, 0, G_MAXINT,
+      NULL);
+  if (bin == NULL) {
+    GST_WARNING ("Cannot create warm encoder for %" GST_PTR_FORMAT, caps);
+    return G_SOURCE_REMOVE;
+  }
+
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_READY);
+
+  entry = g_slice_new0 (PoolEntry);
+  entry->bin = bin;
+  entry->caps = gst_caps_ref (caps);
+  entry->warm = TRUE;
+
+  GST_DEBUG ("Warm encoder ready for %" GST_PTR_FORMAT, caps);
+
+  g_mutex_lock (&pool_mutex);
+  entries = g_list_prepend (entries, entry);
+  g_mutex_unlock (&pool_mutex);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Should be called with the pool mutex held */
+static void
+kms_encoder_pool_schedule_warm_bin (const GstCaps * caps)
+{
+  kms_loop_idle_add_full (kms_encoder_pool_get_loop (), G_PRIORITY_LOW,
+      warm_bin_cb, gst_caps_copy (caps), (GDestroyNotify) gst_caps_unref);
+}
+
+static gboolean
+idle_timeout_cb (gpointer bin)
+{
+  PoolEntry *entry = NULL;
+  GList *l;
+
+  g_mutex_lock (&pool_mutex);
+  for (l = entries; l != NULL; l = l->next) {
+    if (((PoolEntry *) l->data)->bin == bin) {
+      entry = l->data;
+      entries = g_list_delete_link (entries, l);
+      break;
+    }
+  }
+  g_mutex_unlock (&pool_mutex);
+
+  if (entry != NULL) {
+    GST_DEBUG ("Destroying idle encoder %" GST_PTR_FORMAT, entry->bin);
+    pool_entry_destroy (entry);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Unlinks everything outside the bin, that is, its input and the outputs
+ * of its tee but the fakesink */
+static void
+kms_encoder_pool_unlink_bin (KmsEncTreeBin * bin)
+{
+  GstElement *tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
+  GstElement *input = kms_tree_bin_get_input_element (KMS_TREE_BIN (bin));
+  GstPad *sink;
+  GList *pads = NULL, *l;
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  sink = gst_element_get_static_pad (input, "sink");
+  if (gst_pad_is_linked (sink)) {
+    kms_tree_bin_unlink_input_element_from_tee (KMS_TREE_BIN (bin));
+  }
+  g_object_unref (sink);
+
+  it = gst_element_iterate_src_pads (tee);
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    pads = g_list_prepend (pads, g_value_dup_object (&item));
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  for (l = pads; l != NULL; l = l->next) {
+    GstPad *pad = l->data, *peer = gst_pad_get_peer (pad);
+    GstObject *peer_parent;
+
+    if (peer == NULL) {
+      continue;
+    }
+
+    peer_parent = gst_pad_get_parent (peer);
+    if (peer_parent != NULL && GST_OBJECT_PARENT (peer_parent) !=
+        GST_OBJECT (bin)) {
+      gst_pad_unlink (pad, peer);
+
+      /* Pads not released when unlinked */
+      if (GST_OBJECT_PARENT (pad) != NULL) {
+        gst_element_release_request_pad (tee, pad);
+      }
+    }
+
+    g_clear_object (&peer_parent);
+    g_object_unref (peer);
+  }
+  g_list_free_full (pads, g_object_unref);
+}
+
+gboolean
+kms_encoder_pool_is_enabled (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    const gchar *env = g_getenv (WARM_ENCODERS_ENV);
+
+    if (env != NULL && *env != '\0') {
+      warm_profiles = env;
+    }
+
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return warm_profiles != NULL;
+}
+
+void
+kms_encoder_pool_warm_up (void)
+{
+  GstCaps *profiles;
+  guint i;
+
+  if (!kms_encoder_pool_is_enabled ()) {
+    return;
+  }
+
+  g_mutex_lock (&pool_mutex);
+  if (warmed_up) {
+    g_mutex_unlock (&pool_mutex);
+    return;
+  }
+
+  warmed_up = TRUE;
+
+  profiles = gst_caps_from_string (warm_profiles);
+  if (profiles == NULL) {
+    GST_WARNING ("Invalid %s: %s", WARM_ENCODERS_ENV, warm_profiles);
+    g_mutex_unlock (&pool_mutex);
+    return;
+  }
+
+  for (i = 0; i < gst_caps_get_size (profiles); i++) {
+    GstCaps *caps = gst_caps_copy_nth (profiles, i);
+
+    kms_encoder_pool_schedule_warm_bin (caps);
+    gst_caps_unref (caps);
+  }
+  gst_caps_unref (profiles);
+
+  g_mutex_unlock (&pool_mutex);
+}
+
+KmsEncTreeBin *
+kms_encoder_pool_acquire (const GstCaps * caps, gint target_bitrate,
+    gint min_bitrate, gint max_bitrate, GstStructure * codec_configs)
+{
+  PoolEntry *entry = NULL;
+  KmsEncTreeBin *bin;
+  gchar *config;
+  GList *l;
+
+  if (!kms_encoder_pool_is_enabled ()) {
+    return kms_enc_tree_bin_new (caps, target_bitrate, min_bitrate,
+        max_bitrate, codec_configs);
+  }
+
+  config = config_to_string (codec_configs);
+
+  g_mutex_lock (&pool_mutex);
+  for (l = entries; l != NULL; l = l->next) {
+    PoolEntry *e = l->data;
+
+    /* Warm bins have not been configured yet, they take any configuration */
+    if ((e->warm || g_strcmp0 (e->config, config) == 0)
+        && gst_caps_can_intersect (caps, e->caps)) {
+      entry = e;
+      entries = g_list_delete_link (entries, l);
+      break;
+    }
+  }
+
+  if (entry != NULL) {
+    if (entry->timeout_id != 0) {
+      kms_loop_remove (loop, entry->timeout_id);
+    }
+
+    if (entry->warm) {
+      kms_encoder_pool_schedule_warm_bin (entry->caps);
+    }
+  }
+  g_mutex_unlock (&pool_mutex);
+
+  if (entry == NULL) {
+    g_free (config);
+
+    return kms_encoder_pool_create_bin (caps, target_bitrate, min_bitrate,
+        max_bitrate, codec_configs);
+  }
+
+  GST_DEBUG ("Reusing %s encoder %" GST_PTR_FORMAT " for %" GST_PTR_FORMAT,
+      entry->warm ? "warm" : "idle", entry->bin, caps);
+
+  bin = entry->bin;
+  kms_enc_tree_bin_reset (bin, target_bitrate, min_bitrate, max_bitrate);
+
+  if (entry->warm) {
+    kms_enc_tree_bin_set_codec_config (bin, codec_configs);
+    g_object_set_qdata_full (G_OBJECT (bin), pool_config_quark (), config,
+        g_free);
+  } else {
+    g_free (config);
+  }
+
+  gst_caps_unref (entry->caps);
+  g_free (entry->config);
+  g_slice_free (PoolEntry, entry);
+
+  return bin;
+}
+
+guint
+kms_encoder_pool_get_idle_count (void)
+{
+  guint count;
+
+  g_mutex_lock (&pool_mutex);
+  count = g_list_length (entries);
+  g_mutex_unlock (&pool_mutex);
+
+  return count;
+}
+
+gboolean
+kms_encoder_pool_release (KmsEncTreeBin * bin)
+{
+  PoolEntry *entry;
+  GstCaps *caps;
+
+  if (!kms_encoder_pool_is_enabled ()) {
+    return FALSE;
+  }
+
+  caps = g_object_get_qdata (G_OBJECT (bin), pool_caps_quark ());
+  if (caps == NULL || GST_OBJECT_PARENT (bin) != NULL) {
+    return FALSE;
+  }
+
+  kms_encoder_pool_unlink_bin (bin);
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_READY);
+
+  g_mutex_lock (&pool_mutex);
+
+  if (g_list_length (entries) >= MAX_IDLE_BINS) {
+    g_mutex_unlock (&pool_mutex);
+    gst_element_set_state (GST_ELEMENT (bin), GST_STATE_NULL);
+    return FALSE;
+  }
+
+  entry = g_slice_new0 (PoolEntry);
+  entry->bin = g_object_ref (bin);
+  entry->caps = gst_caps_ref (caps);
+  entry->config =
+      g_strdup (g_object_get_qdata (G_OBJECT (bin), pool_config_quark ()));
+  entry->timeout_id = kms_loop_timeout_add_full (kms_encoder_pool_get_loop (),
+      G_PRIORITY_DEFAULT, IDLE_TIMEOUT, idle_timeout_cb, bin, NULL);
+  entries = g_list_prepend (entries, entry);
+
+  g_mutex_unlock (&pool_mutex);
+
+  GST_DEBUG ("Keeping idle encoder %" GST_PTR_FORMAT, bin);
+
+  return TRUE;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,55 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_ENCODER_POOL_H__
+#define __KMS_ENCODER_POOL_H__
+
+#include "kmsenctreebin.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Process wide pool of idle encoder bins. It is only enabled when the
+ * KURENTO_WARM_ENCODERS environment variable lists the profiles to keep
+ * warm, as caps separated by ';' (e.g. "video/x-vp8;video/x-h264").
+ *
+ * One bin per profile is created in advance and created again each time it
+ * is checked out. Released bins wait in the pool for some time before being
+ * destroyed, so that a new output for the same format can take them.
+ */
+
+gboolean kms_encoder_pool_is_enabled (void);
+
+/* Creates the warm bins, if not done yet */
+void kms_encoder_pool_warm_up (void);
+
+/* Returns an idle bin able to produce @caps configured with
+ * @codec_configs, or a new one if there is none. Warm bins are configured
+ * with @codec_configs when they are checked out */
+KmsEncTreeBin * kms_encoder_pool_acquire (const GstCaps * caps,
+    gint target_bitrate, gint min_bitrate, gint max_bitrate,
+    GstStructure * codec_configs);
+
+/* Takes a bin given by kms_encoder_pool_acquire () back. It has to be
+ * already removed from its parent. Returns FALSE if it was not taken */
+gboolean kms_encoder_pool_release (KmsEncTreeBin * bin);
+
+/* Bins waiting in the pool, warm or idle */
+guint kms_encoder_pool_get_idle_count (void);
+
+G_END_DECLS
+#endif /* __KMS_ENCODER_POOL_H__ */
@@ -21,6 +21,8 @@
 
 #include "kmsenctreebin.h"
 #include "kmsutils.h"
+#include "kmsfactorycache.h"
+#include "kmsencoderpolicy.h"
 
 #define GST_DEFAULT_NAME "enctreebin"
 #define GST_CAT_DEFAULT kms_enc_tree_bin_debug
@@ -40,6 +42,15 @@ G_DEFINE_TYPE (KmsEncTreeBin, kms_enc_tree_bin, KMS_TYPE_TREE_BIN);
 #define KMS_ENC_TREE_BIN_LIMIT(obj, value) \
   MAX((obj)->priv->min_bitrate,MIN((obj)->priv->max_bitrate, (value)))
 
+/* Do not reconfigure the encoder for REMB variations under 5% */
+#define REMB_NOTIFY_THRESHOLD 0.05
+
+/* Encoding speed for every load level */
+static const gint64 vp8_deadlines[] = { 200000, 100000, 1, 1 };
+static const gint x264_speed_presets[] = { /* veryfast */ 3,
+  /* superfast */ 2, /* ultrafast */ 1, /* ultrafast */ 1
+};
+
 typedef enum
 {
   VP8,
@@ -63,6 +74,11 @@ struct _KmsEncTreeBinPrivate
 
   gint max_bitrate;
   gint min_bitrate;
+
+  GstElement *rate;
+  KmsEncoderClient *policy;
+  /* Properties set through the codec configuration, never changed */
+  GstStructure *user_config;
 };
 
 static const gchar *
@@ -136,7 +152,7 @@ set_encoder_configuration (GstElement * encoder, GstStructure * codec_config,
 
 static void
 configure_encoder (GstElement * encoder, EncoderType type, gint target_bitrate,
-    GstStructure * codec_configs)
+    const KmsEncoderSettings * settings, GstStructure * codec_configs)
 {
   GST_DEBUG ("Configure encoder: %" GST_PTR_FORMAT, encoder);
   switch (type) {
@@ -144,8 +160,8 @@ configure_encoder (GstElement * encoder, EncoderType type, gint target_bitrate,
     {
       /* *INDENT-OFF* */
       g_object_set (G_OBJECT (encoder),
-                    "deadline", G_GINT64_CONSTANT (200000),
-                    "threads", 1,
+                    "deadline", vp8_deadlines[settings->level],
+                    "threads", settings->threads,
                     "cpu-used", 16,
                     "resize-allowed", TRUE,
                     "target-bitrate", target_bitrate,
@@ -158,8 +174,8 @@ configure_encoder (GstElement * encoder, EncoderType type, gint target_bitrate,
     {
       /* *INDENT-OFF* */
       g_object_set (G_OBJECT (encoder),
-                    "speed-preset", /* veryfast */ 3,
-                    "threads", (guint) 1,
+                    "speed-preset", x264_speed_presets[settings->level],
+                    "threads", settings->threads,
                     "bitrate", target_bitrate / 1000,
                     "key-int-max", 60,
                     "tune", /* zero-latency */ 4,
@@ -214,47 +230,137 @@ kms_enc_tree_bin_set_encoder_type (KmsEncTreeBin * self)
   g_free (name);
 }
 
+/* Encoding policy begin */
+
+static gboolean
+kms_enc_tree_bin_is_user_configured (KmsEncTreeBin * self, const gchar * name)
+{
+  return self->priv->user_config != NULL &&
+      gst_structure_has_field (self->priv->user_config, name);
+}
+
+/* Called with the policy locked when the load level changes */
 static void
-kms_enc_tree_bin_create_encoder_for_caps (KmsEncTreeBin * self,
-    const GstCaps * caps, gint target_bitrate, GstStructure * codec_configs)
+kms_enc_tree_bin_apply_policy (const KmsEncoderSettings * settings,
+    gpointer user_data)
 {
-  GList *encoder_list, *filtered_list, *l;
-  GstElementFactory *encoder_factory = NULL;
+  KmsEncTreeBin *self = user_data;
 
-  encoder_list =
-      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_ENCODER,
-      GST_RANK_NONE);
+  GST_DEBUG_OBJECT (self, "Load level %d, max framerate %d", settings->level,
+      settings->max_framerate);
 
-  /* HACK: Augment the openh264 rank */
-  for (l = encoder_list; l != NULL; l = l->next) {
-    encoder_factory = GST_ELEMENT_FACTORY (l->data);
+  /* Only properties that can change while encoding */
+  if (self->priv->enc_type == VP8
+      && !kms_enc_tree_bin_is_user_configured (self, "deadline")) {
+    g_object_set (self->priv->enc, "deadline",
+        vp8_deadlines[settings->level], NULL);
+  }
 
-    if (g_str_has_prefix (GST_OBJECT_NAME (encoder_factory), "openh264")) {
-      encoder_list = g_list_remove (encoder_list, l->data);
-      encoder_list = g_list_prepend (encoder_list, encoder_factory);
-      break;
-    }
+  if (self->priv->rate != NULL) {
+    g_object_set (self->priv->rate, "max-rate",
+        settings->max_framerate > 0 ? settings->max_framerate : G_MAXINT,
+        NULL);
+  }
+}
+
+/* Declares the format in @caps to the policy. Fields not fixed in @caps are
+ * left as 0, so target caps without a resolution count as an empty load */
+static void
+kms_enc_tree_bin_set_policy_format (KmsEncTreeBin * self,
+    const GstCaps * caps)
+{
+  gint width = 0, height = 0, fps_n = 0, fps_d = 0;
+  GstStructure *st;
+
+  if (gst_caps_get_size (caps) > 0) {
+    st = gst_caps_get_structure (caps, 0);
+    gst_structure_get_int (st, "width", &width);
+    gst_structure_get_int (st, "height", &height);
+    gst_structure_get_fraction (st, "framerate", &fps_n, &fps_d);
   }
 
-  encoder_factory = NULL;
-  filtered_list =
-      gst_element_factory_list_filter (encoder_list, caps, GST_PAD_SRC, FALSE);
+  GST_DEBUG_OBJECT (self, "Encoding %dx%d at %d/%d", width, height, fps_n,
+      fps_d);
+  kms_encoder_policy_set_format (self->priv->policy, width, height, fps_n,
+      fps_d);
+}
+
+static GstPadProbeReturn
+policy_caps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+  KmsEncTreeBin *self = data;
+  KmsEncoderSettings settings;
+  GstCaps *caps;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
 
-  for (l = filtered_list; l != NULL && encoder_factory == NULL; l = l->next) {
-    encoder_factory = GST_ELEMENT_FACTORY (l->data);
-    if (gst_element_factory_get_num_pad_templates (encoder_factory) != 2)
-      encoder_factory = NULL;
+  gst_event_parse_caps (event, &caps);
+  kms_enc_tree_bin_set_policy_format (self, caps);
+  kms_encoder_policy_get_settings (self->priv->policy, &settings);
+
+  /* The encoder is (re)initialized with these caps, so properties only read
+   * on initialization can change here */
+  if ((self->priv->enc_type == VP8 || self->priv->enc_type == X264)
+      && !kms_enc_tree_bin_is_user_configured (self, "threads")) {
+    GST_DEBUG_OBJECT (self, "Using %u threads", settings.threads);
+    g_object_set (self->priv->enc, "threads", settings.threads, NULL);
   }
 
-  if (encoder_factory != NULL) {
-    self->priv->enc = gst_element_factory_create (encoder_factory, NULL);
-    kms_enc_tree_bin_set_encoder_type (self);
-    configure_encoder (self->priv->enc, self->priv->enc_type, target_bitrate,
-        codec_configs);
+  if (self->priv->enc_type == X264
+      && !kms_enc_tree_bin_is_user_configured (self, "speed-preset")) {
+    g_object_set (self->priv->enc, "speed-preset",
+        x264_speed_presets[settings.level], NULL);
   }
 
-  gst_plugin_feature_list_free (filtered_list);
-  gst_plugin_feature_list_free (encoder_list);
+  return GST_PAD_PROBE_OK;
+}
+
+/* Encoding policy end */
+
+static void
+kms_enc_tree_bin_set_user_config (KmsEncTreeBin * self,
+    GstStructure * codec_configs)
+{
+  const gchar *config_name;
+
+  config_name = kms_enc_tree_bin_get_name_from_type (self->priv->enc_type);
+  if (self->priv->user_config == NULL && codec_configs != NULL
+      && config_name != NULL
+      && gst_structure_has_field_typed (codec_configs, config_name,
+          GST_TYPE_STRUCTURE)) {
+    gst_structure_get (codec_configs, config_name, GST_TYPE_STRUCTURE,
+        &self->priv->user_config, NULL);
+  }
+}
+
+static void
+kms_enc_tree_bin_create_encoder_for_caps (KmsEncTreeBin * self,
+    const GstCaps * caps, gint target_bitrate, GstStructure * codec_configs)
+{
+  KmsEncoderSettings settings = { 1, KMS_ENCODER_LOAD_NORMAL, 0 };
+
+  self->priv->enc = kms_factory_cache_create (GST_ELEMENT_FACTORY_TYPE_ENCODER,
+      NULL, caps);
+
+  if (self->priv->enc == NULL) {
+    return;
+  }
+
+  kms_enc_tree_bin_set_encoder_type (self);
+  kms_enc_tree_bin_set_user_config (self, codec_configs);
+
+  if (kms_utils_caps_are_video (caps)) {
+    self->priv->policy =
+        kms_encoder_policy_register (kms_enc_tree_bin_apply_policy, self);
+    kms_enc_tree_bin_set_policy_format (self, caps);
+    kms_encoder_policy_get_settings (self->priv->policy, &settings);
+  }
+
+  configure_encoder (self->priv->enc, self->priv->enc_type, target_bitrate,
+      &settings, codec_configs);
 }
 
 static gint
@@ -281,10 +387,8 @@ kms_enc_tree_bin_get_bitrate (KmsEncTreeBin * self)
 }
 
 static void
-kms_enc_tree_bin_set_target_bitrate (KmsEncTreeBin * self)
+kms_enc_tree_bin_apply_bitrate (KmsEncTreeBin * self, gint target_bitrate)
 {
-  gint target_bitrate = kms_enc_tree_bin_get_bitrate (self);
-
   if (target_bitrate <= 0) {
     return;
   }
@@ -334,6 +438,12 @@ kms_enc_tree_bin_set_target_bitrate (KmsEncTreeBin * self)
   }
 }
 
+static void
+kms_enc_tree_bin_set_target_bitrate (KmsEncTreeBin * self)
+{
+  kms_enc_tree_bin_apply_bitrate (self, kms_enc_tree_bin_get_bitrate (self));
+}
+
 void
 kms_enc_tree_bin_set_bitrate_limits (KmsEncTreeBin * self, gint min_bitrate,
     gint max_bitrate)
@@ -345,6 +455,32 @@ kms_enc_tree_bin_set_bitrate_limits (KmsEncTreeBin * self, gint min_bitrate,
   kms_enc_tree_bin_set_target_bitrate (self);
 }
 
+void
+kms_enc_tree_bin_reset (KmsEncTreeBin * self, gint target_bitrate,
+    gint min_bitrate, gint max_bitrate)
+{
+  self->priv->remb_bitrate = -1;
+  self->priv->tag_bitrate = -1;
+  self->priv->max_bitrate = max_bitrate;
+  self->priv->min_bitrate = min_bitrate;
+
+  self->priv->current_bitrate = KMS_ENC_TREE_BIN_LIMIT (self, target_bitrate);
+  kms_enc_tree_bin_apply_bitrate (self, self->priv->current_bitrate);
+}
+
+void
+kms_enc_tree_bin_set_codec_config (KmsEncTreeBin * self,
+    GstStructure * codec_configs)
+{
+  if (self->priv->enc == NULL || codec_configs == NULL) {
+    return;
+  }
+
+  kms_enc_tree_bin_set_user_config (self, codec_configs);
+  set_encoder_configuration (self->priv->enc, codec_configs,
+      kms_enc_tree_bin_get_name_from_type (self->priv->enc_type));
+}
+
 gint
 kms_enc_tree_bin_get_min_bitrate (KmsEncTreeBin * self)
 {
@@ -471,8 +607,14 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
       kms_utils_remb_event_manager_create (self->priv->enc_sink);
   kms_utils_remb_event_manager_set_callback (self->priv->remb_manager,
       bitrate_callback, self, NULL);
+  kms_utils_remb_event_manager_set_notify_threshold (self->priv->remb_manager,
+      REMB_NOTIFY_THRESHOLD);
   gst_pad_add_probe (self->priv->enc_sink, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
       tag_event_probe, self, NULL);
+  if (self->priv->policy != NULL) {
+    gst_pad_add_probe (self->priv->enc_sink,
+        GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, policy_caps_probe, self, NULL);
+  }
 
   rate = kms_utils_create_rate_for_caps (caps);
   convert = kms_utils_create_convert_for_caps (caps);
@@ -481,6 +623,7 @@ kms_enc_tree_bin_configure (KmsEncTreeBin * self, const GstCaps * caps,
   if (rate) {
     gst_bin_add (GST_BIN (self), rate);
   }
+  self->priv->rate = rate;
   gst_bin_add_many (GST_BIN (self), convert, mediator, self->priv->enc, NULL);
   gst_element_sync_state_with_parent (self->priv->enc);
   gst_element_sync_state_with_parent (mediator);
@@ -577,10 +720,35 @@ kms_enc_tree_bin_dispose (GObject * object)
     self->priv->remb_manager = NULL;
   }
 
+  if (self->priv->policy != NULL) {
+    kms_encoder_policy_unregister (self->priv->policy);
+    self->priv->policy = NULL;
+  }
+
+  if (self->priv->user_config != NULL) {
+    gst_structure_free (self->priv->user_config);
+    self->priv->user_config = NULL;
+  }
+
   /* chain up */
   G_OBJECT_CLASS (kms_enc_tree_bin_parent_class)->dispose (object);
 }
 
+static GstStateChangeReturn
+kms_enc_tree_bin_change_state (GstElement * element, GstStateChange transition)
+{
+  KmsEncTreeBin *self = KMS_ENC_TREE_BIN (element);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY
+      && self->priv->policy != NULL) {
+    /* Not encoding any more */
+    kms_encoder_policy_set_format (self->priv->policy, 0, 0, 0, 0);
+  }
+
+  return GST_ELEMENT_CLASS (kms_enc_tree_bin_parent_class)->change_state
+      (element, transition);
+}
+
 static void
 kms_enc_tree_bin_class_init (KmsEncTreeBinClass * klass)
 {
@@ -597,6 +765,8 @@ kms_enc_tree_bin_class_init (KmsEncTreeBinClass * klass)
       GST_DEFAULT_NAME);
 
   gobject_class->dispose = kms_enc_tree_bin_dispose;
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (kms_enc_tree_bin_change_state);
 
   g_type_class_add_private (klass, sizeof (KmsEncTreeBinPrivate));
 }
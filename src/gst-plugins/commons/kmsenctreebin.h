@@ -54,6 +54,11 @@ GType kms_enc_tree_bin_get_type (void);
 
 KmsEncTreeBin * kms_enc_tree_bin_new (const GstCaps * caps, gint target_bitrate, gint min_bitrate, gint max_bitrate, GstStructure *codec_configs);
 void kms_enc_tree_bin_set_bitrate_limits (KmsEncTreeBin *self, gint min_bitrate, gint max_bitrate);
+/* Forgets the bitrates received through REMB and tags, used when the bin is
+ * going to feed different outputs */
+void kms_enc_tree_bin_reset (KmsEncTreeBin *self, gint target_bitrate, gint min_bitrate, gint max_bitrate);
+/* Configures a bin created without codec configuration, before it starts */
+void kms_enc_tree_bin_set_codec_config (KmsEncTreeBin *self, GstStructure *codec_configs);
 gint kms_enc_tree_bin_get_min_bitrate (KmsEncTreeBin *self);
 gint kms_enc_tree_bin_get_max_bitrate (KmsEncTreeBin *self);
 
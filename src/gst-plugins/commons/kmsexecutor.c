@@ -0,0 +1,252 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsexecutor.h"
+#include "kmsrefstruct.h"
+
+#include <stdlib.h>
+
+#define GST_CAT_DEFAULT kms_executor_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsexecutor"
+
+#define EXECUTOR_THREADS_ENV "KURENTO_EXECUTOR_THREADS"
+
+/* Work run from a queue before letting other queues use the worker */
+#define MAX_BATCH 16
+
+/* Time without any work finishing, while there are queues waiting, after
+ * which the workers are taken as blocked and one more is started */
+#define STALL_TIMEOUT (100 * G_TIME_SPAN_MILLISECOND)
+
+/* Workers started over max_workers to replace blocked ones */
+#define MAX_EXTRA_WORKERS 64
+
+typedef struct _Work
+{
+  KmsExecutorFunc func;
+  gpointer data;
+  GDestroyNotify notify;
+} Work;
+
+struct _KmsExecutorQueue
+{
+  KmsRefStruct ref;
+  GMutex mutex;
+  GQueue work;
+  /* Given to a worker, which holds a reference until the queue is empty */
+  gboolean scheduled;
+};
+
+static GThreadPool *workers;
+static gint max_workers;
+
+static GMutex monitor_mutex;
+static GCond monitor_cond;
+static gint finished_work;
+
+static void
+kms_executor_run_queue (KmsExecutorQueue * queue, gpointer user_data)
+{
+  gboolean pending;
+  guint i;
+
+  for (i = 0; i < MAX_BATCH; i++) {
+    Work *work;
+
+    g_mutex_lock (&queue->mutex);
+    work = g_queue_pop_head (&queue->work);
+    g_mutex_unlock (&queue->mutex);
+
+    if (work == NULL) {
+      break;
+    }
+
+    work->func (work->data);
+
+    if (work->notify != NULL) {
+      work->notify (work->data);
+    }
+
+    g_slice_free (Work, work);
+    g_atomic_int_inc (&finished_work);
+  }
+
+  g_mutex_lock (&queue->mutex);
+  pending = !g_queue_is_empty (&queue->work);
+  queue->scheduled = pending;
+  g_mutex_unlock (&queue->mutex);
+
+  if (pending) {
+    /* Back to the end of the line, keeping the order of this queue */
+    g_thread_pool_push (workers, queue, NULL);
+  } else {
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (queue));
+  }
+}
+
+/*
+ * Work may block, for instance setting an element to NULL waits for its
+ * streaming threads. When all workers are blocked other queues would wait
+ * for them, so a worker is added each STALL_TIMEOUT without progress. They
+ * are given back once no queue is waiting.
+ */
+static gpointer
+kms_executor_monitor (gpointer data)
+{
+  g_mutex_lock (&monitor_mutex);
+
+  for (;;) {
+    gint64 end_time;
+    gint finished;
+
+    while (g_thread_pool_unprocessed (workers) == 0) {
+      if (g_thread_pool_get_max_threads (workers) > max_workers) {
+        GST_DEBUG ("No queues waiting, back to %d workers", max_workers);
+        g_thread_pool_set_max_threads (workers, max_workers, NULL);
+      }
+
+      g_cond_wait (&monitor_cond, &monitor_mutex);
+    }
+
+    finished = g_atomic_int_get (&finished_work);
+    end_time = g_get_monotonic_time () + STALL_TIMEOUT;
+    while (g_cond_wait_until (&monitor_cond, &monitor_mutex, end_time)) {
+      /* New work does not shorten the wait */
+    }
+
+    if (g_thread_pool_unprocessed (workers) > 0
+        && g_atomic_int_get (&finished_work) == finished) {
+      gint threads = g_thread_pool_get_max_threads (workers);
+
+      if (threads < max_workers + MAX_EXTRA_WORKERS) {
+        GST_WARNING ("Workers blocked, starting one more (%d)", threads + 1);
+        g_thread_pool_set_max_threads (workers, threads + 1, NULL);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static GThreadPool *
+kms_executor_get_workers (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    GST_DEBUG ("Starting executor with up to %d workers", max_workers);
+    workers = g_thread_pool_new ((GFunc) kms_executor_run_queue, NULL,
+        max_workers, FALSE, NULL);
+    g_thread_unref (g_thread_new ("kmsexecutor", kms_executor_monitor, NULL));
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return workers;
+}
+
+static void
+kms_executor_queue_destroy (KmsExecutorQueue * queue)
+{
+  g_mutex_clear (&queue->mutex);
+
+  g_slice_free (KmsExecutorQueue, queue);
+}
+
+KmsExecutorQueue *
+kms_executor_queue_new (void)
+{
+  KmsExecutorQueue *queue = g_slice_new0 (KmsExecutorQueue);
+
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (queue),
+      (GDestroyNotify) kms_executor_queue_destroy);
+  g_mutex_init (&queue->mutex);
+  g_queue_init (&queue->work);
+
+  return queue;
+}
+
+void
+kms_executor_queue_free (KmsExecutorQueue * queue)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (queue));
+}
+
+void
+kms_executor_queue_push (KmsExecutorQueue * queue, KmsExecutorFunc func,
+    gpointer data, GDestroyNotify notify)
+{
+  Work *work = g_slice_new (Work);
+  gboolean schedule;
+
+  work->func = func;
+  work->data = data;
+  work->notify = notify;
+
+  g_mutex_lock (&queue->mutex);
+  g_queue_push_tail (&queue->work, work);
+  schedule = !queue->scheduled;
+  queue->scheduled = TRUE;
+  g_mutex_unlock (&queue->mutex);
+
+  if (schedule) {
+    g_thread_pool_push (kms_executor_get_workers (),
+        kms_ref_struct_ref (KMS_REF_STRUCT_CAST (queue)), NULL);
+
+    g_mutex_lock (&monitor_mutex);
+    g_cond_signal (&monitor_cond);
+    g_mutex_unlock (&monitor_mutex);
+  }
+}
+
+gboolean
+kms_executor_queue_try_push (GMutex * lock, KmsExecutorQueue ** queue,
+    KmsExecutorFunc func, gpointer data, GDestroyNotify notify)
+{
+  gboolean pushed = FALSE;
+
+  g_mutex_lock (lock);
+  if (*queue != NULL) {
+    kms_executor_queue_push (*queue, func, data, notify);
+    pushed = TRUE;
+  }
+  g_mutex_unlock (lock);
+
+  if (!pushed && notify != NULL) {
+    notify (data);
+  }
+
+  return pushed;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  const gchar *env;
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  max_workers = MAX (g_get_num_processors (), 2);
+
+  env = g_getenv (EXECUTOR_THREADS_ENV);
+  if (env != NULL && atoi (env) > 0) {
+    max_workers = atoi (env);
+  }
+}
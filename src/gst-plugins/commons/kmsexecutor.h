@@ -0,0 +1,55 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_EXECUTOR_H__
+#define __KMS_EXECUTOR_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Process wide set of worker threads running the work that elements cannot
+ * do from a streaming thread, like removing unlinked branches. Each element
+ * has its own queue: the work pushed to a queue runs in order, one item at
+ * a time, while different queues run in parallel. There is one worker per
+ * processor unless KURENTO_EXECUTOR_THREADS sets another number, and some
+ * more while all of them are blocked.
+ */
+
+typedef struct _KmsExecutorQueue KmsExecutorQueue;
+
+typedef void (*KmsExecutorFunc) (gpointer data);
+
+KmsExecutorQueue * kms_executor_queue_new (void);
+
+/* Pending work is still run after the queue is freed */
+void kms_executor_queue_free (KmsExecutorQueue * queue);
+
+/* Runs @func after the work already pushed to @queue. @notify is called on
+ * @data once @func has returned */
+void kms_executor_queue_push (KmsExecutorQueue * queue, KmsExecutorFunc func,
+    gpointer data, GDestroyNotify notify);
+
+/* Pushes to the queue stored at @queue by its owner, read under @lock. The
+ * owner clears it under @lock when disposed, after that @func is not run and
+ * only @notify is called. Returns whether @func was pushed */
+gboolean kms_executor_queue_try_push (GMutex * lock, KmsExecutorQueue ** queue,
+    KmsExecutorFunc func, gpointer data, GDestroyNotify notify);
+
+G_END_DECLS
+#endif /* __KMS_EXECUTOR_H__ */
@@ -0,0 +1,224 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsfactorycache.h"
+
+#define GST_CAT_DEFAULT kms_factory_cache_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsfactorycache"
+
+#define PREFERRED_FACTORIES_ENV "KURENTO_PREFERRED_FACTORIES"
+
+static const gchar *default_preferred[] = { "openh264", NULL };
+
+static GMutex cache_mutex;
+/* "type|sink caps|src caps" -> GstElementFactory, NULL if none found */
+static GHashTable *cache;
+static guint32 cache_cookie;
+static gchar **preferred;
+
+static void
+factory_unref (gpointer factory)
+{
+  if (factory != NULL) {
+    gst_object_unref (factory);
+  }
+}
+
+/* Should be called with the cache mutex held */
+static void
+kms_factory_cache_check_registry (void)
+{
+  guint32 cookie;
+
+  cookie = gst_registry_get_feature_list_cookie (gst_registry_get ());
+
+  if (cache == NULL) {
+    cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        factory_unref);
+  } else if (cookie != cache_cookie) {
+    GST_DEBUG ("Registry changed, dropping cached factories");
+    g_hash_table_remove_all (cache);
+  }
+
+  cache_cookie = cookie;
+}
+
+/* Should be called with the cache mutex held */
+static gint
+preferred_index (GstElementFactory * factory)
+{
+  const gchar *name = GST_OBJECT_NAME (factory);
+  gint i;
+
+  for (i = 0; preferred != NULL && preferred[i] != NULL; i++) {
+    if (g_str_has_prefix (name, preferred[i])) {
+      return i;
+    }
+  }
+
+  return G_MAXINT;
+}
+
+static gint
+compare_preference (gconstpointer a, gconstpointer b)
+{
+  gint pa = preferred_index (GST_ELEMENT_FACTORY (a));
+  gint pb = preferred_index (GST_ELEMENT_FACTORY (b));
+
+  return pa < pb ? -1 : (pa > pb ? 1 : 0);
+}
+
+static GstElementFactory *
+kms_factory_cache_find (GstElementFactoryListType type,
+    const GstCaps * sink_caps, const GstCaps * src_caps)
+{
+  GList *factories, *filtered, *l;
+  GstElementFactory *factory = NULL;
+
+  /* Sorted by rank, the sort is stable so preferred ones keep it too */
+  factories = gst_element_factory_list_get_elements (type, GST_RANK_NONE);
+  factories = g_list_sort (factories, compare_preference);
+
+  if (sink_caps != NULL) {
+    filtered = gst_element_factory_list_filter (factories, sink_caps,
+        GST_PAD_SINK, FALSE);
+    gst_plugin_feature_list_free (factories);
+    factories = filtered;
+  }
+
+  if (src_caps != NULL) {
+    filtered = gst_element_factory_list_filter (factories, src_caps,
+        GST_PAD_SRC, FALSE);
+    gst_plugin_feature_list_free (factories);
+    factories = filtered;
+  }
+
+  for (l = factories; l != NULL && factory == NULL; l = l->next) {
+    if (gst_element_factory_get_num_pad_templates (l->data) == 2) {
+      factory = gst_object_ref (l->data);
+    }
+  }
+
+  gst_plugin_feature_list_free (factories);
+
+  return factory;
+}
+
+GstElementFactory *
+kms_factory_cache_get (GstElementFactoryListType type,
+    const GstCaps * sink_caps, const GstCaps * src_caps)
+{
+  GstElementFactory *factory;
+  gchar *sink_str, *src_str, *key;
+  gpointer value;
+
+  sink_str = sink_caps != NULL ? gst_caps_to_string (sink_caps) : NULL;
+  src_str = src_caps != NULL ? gst_caps_to_string (src_caps) : NULL;
+  key = g_strdup_printf ("%" G_GUINT64_FORMAT "|%s|%s", type,
+      sink_str != NULL ? sink_str : "", src_str != NULL ? src_str : "");
+  g_free (sink_str);
+  g_free (src_str);
+
+  g_mutex_lock (&cache_mutex);
+
+  kms_factory_cache_check_registry ();
+
+  if (g_hash_table_lookup_extended (cache, key, NULL, &value)) {
+    g_free (key);
+    factory = value != NULL ? gst_object_ref (value) : NULL;
+    g_mutex_unlock (&cache_mutex);
+
+    return factory;
+  }
+
+  factory = kms_factory_cache_find (type, sink_caps, src_caps);
+  GST_DEBUG ("Factory for %s: %s", key,
+      factory != NULL ? GST_OBJECT_NAME (factory) : "none");
+
+  g_hash_table_insert (cache, key,
+      factory != NULL ? gst_object_ref (factory) : NULL);
+
+  g_mutex_unlock (&cache_mutex);
+
+  return factory;
+}
+
+GstElement *
+kms_factory_cache_create (GstElementFactoryListType type,
+    const GstCaps * sink_caps, const GstCaps * src_caps)
+{
+  GstElementFactory *factory;
+  GstElement *element;
+
+  factory = kms_factory_cache_get (type, sink_caps, src_caps);
+  if (factory == NULL) {
+    return NULL;
+  }
+
+  element = gst_element_factory_create (factory, NULL);
+  gst_object_unref (factory);
+
+  return element;
+}
+
+void
+kms_factory_cache_set_preferred (const gchar * const *prefixes)
+{
+  g_mutex_lock (&cache_mutex);
+
+  g_strfreev (preferred);
+  preferred = g_strdupv ((gchar **) (prefixes != NULL ? prefixes :
+          default_preferred));
+
+  /* Choices depend on the preference */
+  if (cache != NULL) {
+    g_hash_table_remove_all (cache);
+  }
+
+  g_mutex_unlock (&cache_mutex);
+}
+
+gboolean
+kms_factory_cache_is_preferred (GstElementFactory * factory)
+{
+  gboolean ret;
+
+  g_mutex_lock (&cache_mutex);
+  ret = preferred_index (factory) != G_MAXINT;
+  g_mutex_unlock (&cache_mutex);
+
+  return ret;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  const gchar *env;
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+
+  env = g_getenv (PREFERRED_FACTORIES_ENV);
+  if (env != NULL) {
+    preferred = g_strsplit (env, ",", -1);
+  } else {
+    preferred = g_strdupv ((gchar **) default_preferred);
+  }
+}
@@ -0,0 +1,52 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_FACTORY_CACHE_H__
+#define __KMS_FACTORY_CACHE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Process wide cache of the element factory chosen for some caps, so that
+ * the registry is only filtered the first time. The cache is dropped
+ * whenever the feature list of the registry changes.
+ *
+ * Factories are sorted by rank, except those whose name starts with one of
+ * the preferred prefixes, which go first in the order of the prefixes.
+ * The default preference can be replaced through the
+ * KURENTO_PREFERRED_FACTORIES environment variable (comma separated).
+ */
+
+/* Returns a new reference to the best factory of @type (see
+ * #GstElementFactoryListType) with one sink and one src pad template, whose
+ * sink accepts @sink_caps and whose src can produce @src_caps. Any of the
+ * caps can be NULL. Returns NULL if there is none */
+GstElementFactory * kms_factory_cache_get (GstElementFactoryListType type,
+    const GstCaps * sink_caps, const GstCaps * src_caps);
+
+/* Same as above, but creating an element of the factory */
+GstElement * kms_factory_cache_create (GstElementFactoryListType type,
+    const GstCaps * sink_caps, const GstCaps * src_caps);
+
+/* Replaces the preferred prefixes, NULL restores the default ones */
+void kms_factory_cache_set_preferred (const gchar * const * prefixes);
+gboolean kms_factory_cache_is_preferred (GstElementFactory * factory);
+
+G_END_DECLS
+#endif /* __KMS_FACTORY_CACHE_H__ */
@@ -0,0 +1,317 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsgopcache.h"
+#include "kmsrefstruct.h"
+#include "kmsutils.h"
+
+#define GST_CAT_DEFAULT kms_gop_cache_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmsgopcache"
+
+#define GOP_CACHE "kms-gop-cache"
+G_DEFINE_QUARK (GOP_CACHE, gop_cache);
+
+typedef struct _KmsGopCache
+{
+  KmsRefStruct ref;
+  GMutex mutex;
+  GQueue buffers;
+  gsize bytes;
+  gsize max_bytes;
+  /* Buffers start with a keyframe */
+  gboolean complete;
+} KmsGopCache;
+
+static void
+kms_gop_cache_clear (KmsGopCache * cache)
+{
+  GstBuffer *buffer;
+
+  while ((buffer = g_queue_pop_head (&cache->buffers)) != NULL) {
+    gst_buffer_unref (buffer);
+  }
+
+  cache->bytes = 0;
+  cache->complete = FALSE;
+}
+
+static void
+kms_gop_cache_destroy (KmsGopCache * cache)
+{
+  kms_gop_cache_clear (cache);
+  g_mutex_clear (&cache->mutex);
+
+  g_slice_free (KmsGopCache, cache);
+}
+
+static KmsGopCache *
+kms_gop_cache_new (gsize max_bytes)
+{
+  KmsGopCache *cache;
+
+  cache = g_slice_new0 (KmsGopCache);
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (cache),
+      (GDestroyNotify) kms_gop_cache_destroy);
+  g_mutex_init (&cache->mutex);
+  g_queue_init (&cache->buffers);
+  cache->max_bytes = max_bytes;
+
+  return cache;
+}
+
+static KmsGopCache *
+kms_gop_cache_get (GstElement * tee)
+{
+  KmsGopCache *cache;
+
+  GST_OBJECT_LOCK (tee);
+  cache = g_object_get_qdata (G_OBJECT (tee), gop_cache_quark ());
+  if (cache != NULL) {
+    kms_ref_struct_ref (KMS_REF_STRUCT_CAST (cache));
+  }
+  GST_OBJECT_UNLOCK (tee);
+
+  return cache;
+}
+
+static gboolean
+kms_gop_cache_store (GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+  KmsGopCache *cache = user_data;
+  gsize size = gst_buffer_get_size (*buffer);
+
+  if (!GST_BUFFER_FLAG_IS_SET (*buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    kms_gop_cache_clear (cache);
+    cache->complete = TRUE;
+  } else if (!cache->complete) {
+    return TRUE;
+  }
+
+  if (cache->bytes + size > cache->max_bytes) {
+    GST_DEBUG ("GOP bigger than %" G_GSIZE_FORMAT " bytes, not cached",
+        cache->max_bytes);
+    kms_gop_cache_clear (cache);
+    return TRUE;
+  }
+
+  g_queue_push_tail (&cache->buffers, gst_buffer_ref (*buffer));
+  cache->bytes += size;
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+gop_cache_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  KmsGopCache *cache = user_data;
+
+  g_mutex_lock (&cache->mutex);
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    kms_gop_cache_store (&buffer, 0, cache);
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    gst_buffer_list_foreach (list, kms_gop_cache_store, cache);
+  } else {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    /* Frames already cached cannot be decoded with the new caps */
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS ||
+        GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+      kms_gop_cache_clear (cache);
+    }
+  }
+
+  g_mutex_unlock (&cache->mutex);
+
+  return GST_PAD_PROBE_OK;
+}
+
+void
+kms_gop_cache_enable (GstElement * tee, gsize max_bytes)
+{
+  KmsGopCache *cache;
+  GstPad *sink;
+
+  cache = kms_gop_cache_get (tee);
+  if (cache != NULL) {
+    g_mutex_lock (&cache->mutex);
+    cache->max_bytes = max_bytes;
+    g_mutex_unlock (&cache->mutex);
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (cache));
+    return;
+  }
+
+  cache = kms_gop_cache_new (max_bytes);
+
+  GST_OBJECT_LOCK (tee);
+  g_object_set_qdata_full (G_OBJECT (tee), gop_cache_quark (),
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (cache)),
+      (GDestroyNotify) kms_ref_struct_unref);
+  GST_OBJECT_UNLOCK (tee);
+
+  GST_DEBUG_OBJECT (tee, "Caching GOPs up to %" G_GSIZE_FORMAT " bytes",
+      max_bytes);
+
+  sink = gst_element_get_static_pad (tee, "sink");
+  gst_pad_add_probe (sink,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+      GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      gop_cache_probe, cache, (GDestroyNotify) kms_ref_struct_unref);
+  g_object_unref (sink);
+}
+
+/* Sets @gop to the cached buffers preceding @buffer. Returns FALSE if
+ * @buffer is not part of the cached GOP */
+static gboolean
+kms_gop_cache_get_gop (KmsGopCache * cache, GstBuffer * buffer, GList ** gop)
+{
+  GList *l;
+
+  *gop = NULL;
+
+  g_mutex_lock (&cache->mutex);
+
+  for (l = cache->buffers.head; l != NULL && l->data != buffer; l = l->next) {
+    *gop = g_list_prepend (*gop, gst_buffer_ref (l->data));
+  }
+
+  g_mutex_unlock (&cache->mutex);
+
+  if (l == NULL) {
+    g_list_free_full (*gop, (GDestroyNotify) gst_buffer_unref);
+    *gop = NULL;
+    return FALSE;
+  }
+
+  *gop = g_list_reverse (*gop);
+
+  return TRUE;
+}
+
+static void
+kms_gop_cache_push_gop (GstPad * pad, GList * gop)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstPad *peer;
+  GList *l;
+
+  peer = gst_pad_get_peer (pad);
+
+  for (l = gop; l != NULL; l = l->next) {
+    GstBuffer *buffer = l->data;
+
+    l->data = NULL;
+
+    if (peer == NULL || ret != GST_FLOW_OK) {
+      gst_buffer_unref (buffer);
+      continue;
+    }
+
+    buffer = gst_buffer_make_writable (buffer);
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+    if (l == gop) {
+      GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+    }
+
+    ret = gst_pad_chain (peer, buffer);
+  }
+
+  if (ret != GST_FLOW_OK) {
+    GST_WARNING_OBJECT (pad, "Cannot push cached GOP: %s",
+        gst_flow_get_name (ret));
+  }
+
+  g_list_free (gop);
+  g_clear_object (&peer);
+}
+
+static GstPadProbeReturn
+prime_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  KmsGopCache *cache = user_data;
+  GstBuffer *buffer;
+  GList *gop;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  } else {
+    buffer = gst_buffer_list_get (GST_PAD_PROBE_INFO_BUFFER_LIST (info), 0);
+  }
+
+  if (buffer == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (kms_gop_cache_get_gop (cache, buffer, &gop)) {
+    GST_DEBUG_OBJECT (pad, "Pushing %u cached buffers", g_list_length (gop));
+    kms_gop_cache_push_gop (pad, gop);
+
+    return GST_PAD_PROBE_REMOVE;
+  }
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    return GST_PAD_PROBE_REMOVE;
+  }
+
+  /* A new GOP started after priming was requested */
+  GST_DEBUG_OBJECT (pad, "Cached GOP lost, waiting for a keyframe");
+  kms_utils_drop_until_keyframe (pad, TRUE);
+  gst_pad_remove_probe (pad, GST_PAD_PROBE_INFO_ID (info));
+
+  return GST_PAD_PROBE_DROP;
+}
+
+gboolean
+kms_gop_cache_prime (GstElement * tee, GstPad * pad)
+{
+  KmsGopCache *cache;
+  gboolean ready;
+
+  cache = kms_gop_cache_get (tee);
+  if (cache == NULL) {
+    return FALSE;
+  }
+
+  g_mutex_lock (&cache->mutex);
+  ready = cache->complete && !g_queue_is_empty (&cache->buffers);
+  g_mutex_unlock (&cache->mutex);
+
+  if (!ready) {
+    kms_ref_struct_unref (KMS_REF_STRUCT_CAST (cache));
+    return FALSE;
+  }
+
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      prime_probe, cache, (GDestroyNotify) kms_ref_struct_unref);
+
+  return TRUE;
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
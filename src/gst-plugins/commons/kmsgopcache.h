@@ -0,0 +1,41 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_GOP_CACHE_H__
+#define __KMS_GOP_CACHE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Keeps the last group of pictures going through a tee: the last keyframe
+ * and the delta units following it. A new output of the tee can start with
+ * it instead of waiting for the next keyframe.
+ */
+
+/* Starts caching the GOPs going through @tee. GOPs bigger than @max_bytes
+ * are not cached. Only the size is updated if the cache is already enabled */
+void kms_gop_cache_enable (GstElement * tee, gsize max_bytes);
+
+/* Makes the cached GOP of @tee go through @pad, an output of @tee, before
+ * its first buffer. Cached buffers are flagged GST_BUFFER_FLAG_DECODE_ONLY.
+ * Returns FALSE if there is no complete GOP cached */
+gboolean kms_gop_cache_prime (GstElement * tee, GstPad * pad);
+
+G_END_DECLS
+#endif /* __KMS_GOP_CACHE_H__ */
@@ -0,0 +1,478 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsmixkernels.h"
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#define KMS_MIX_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined (__ARM_NEON) || defined (__ARM_NEON__)
+#define KMS_MIX_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+/* Stands for a missing input */
+#define ZEROS_LENGTH 1024
+
+typedef struct _KmsMixKernels
+{
+  const gchar *name;
+  void (*accumulate_s16) (gint32 * mix, const gint16 * in, guint n);
+  void (*subtract_s16) (gint16 * out, const gint32 * mix, const gint16 * in,
+      guint n);
+  void (*accumulate_f32) (gfloat * mix, const gfloat * in, guint n);
+  void (*subtract_f32) (gfloat * out, const gfloat * mix, const gfloat * in,
+      guint n);
+} KmsMixKernels;
+
+static const KmsMixKernels *kernels;
+static const gint16 zeros_s16[ZEROS_LENGTH];
+static const gfloat zeros_f32[ZEROS_LENGTH];
+
+/* C begin */
+
+static void
+accumulate_s16_c (gint32 * mix, const gint16 * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    mix[i] += in[i];
+  }
+}
+
+static void
+subtract_s16_c (gint16 * out, const gint32 * mix, const gint16 * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    gint32 v = mix[i] - in[i];
+
+    out[i] = CLAMP (v, G_MININT16, G_MAXINT16);
+  }
+}
+
+static void
+accumulate_f32_c (gfloat * mix, const gfloat * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    mix[i] += in[i];
+  }
+}
+
+static void
+subtract_f32_c (gfloat * out, const gfloat * mix, const gfloat * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    gfloat v = mix[i] - in[i];
+
+    out[i] = CLAMP (v, -1.0f, 1.0f);
+  }
+}
+
+static const KmsMixKernels kernels_c = {
+  "c",
+  accumulate_s16_c,
+  subtract_s16_c,
+  accumulate_f32_c,
+  subtract_f32_c
+};
+
+/* C end */
+
+#ifdef KMS_MIX_KERNELS_X86
+
+/* SSE2 begin */
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+widen_lo_sse2 (__m128i v)
+{
+  return _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16);
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128i
+widen_hi_sse2 (__m128i v)
+{
+  return _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+accumulate_s16_sse2 (gint32 * mix, const gint16 * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (in + i));
+    __m128i *m = (__m128i *) (mix + i);
+
+    _mm_storeu_si128 (m, _mm_add_epi32 (_mm_loadu_si128 (m),
+            widen_lo_sse2 (v)));
+    _mm_storeu_si128 (m + 1, _mm_add_epi32 (_mm_loadu_si128 (m + 1),
+            widen_hi_sse2 (v)));
+  }
+
+  accumulate_s16_c (mix + i, in + i, n - i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+subtract_s16_sse2 (gint16 * out, const gint32 * mix, const gint16 * in,
+    guint n)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (in + i));
+    const __m128i *m = (const __m128i *) (mix + i);
+    __m128i lo = _mm_sub_epi32 (_mm_loadu_si128 (m), widen_lo_sse2 (v));
+    __m128i hi = _mm_sub_epi32 (_mm_loadu_si128 (m + 1), widen_hi_sse2 (v));
+
+    _mm_storeu_si128 ((__m128i *) (out + i), _mm_packs_epi32 (lo, hi));
+  }
+
+  subtract_s16_c (out + i, mix + i, in + i, n - i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+accumulate_f32_sse2 (gfloat * mix, const gfloat * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    _mm_storeu_ps (mix + i, _mm_add_ps (_mm_loadu_ps (mix + i),
+            _mm_loadu_ps (in + i)));
+  }
+
+  accumulate_f32_c (mix + i, in + i, n - i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+subtract_f32_sse2 (gfloat * out, const gfloat * mix, const gfloat * in,
+    guint n)
+{
+  const __m128 min = _mm_set1_ps (-1.0f);
+  const __m128 max = _mm_set1_ps (1.0f);
+  guint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128 v = _mm_sub_ps (_mm_loadu_ps (mix + i), _mm_loadu_ps (in + i));
+
+    _mm_storeu_ps (out + i, _mm_min_ps (_mm_max_ps (v, min), max));
+  }
+
+  subtract_f32_c (out + i, mix + i, in + i, n - i);
+}
+
+static const KmsMixKernels kernels_sse2 = {
+  "sse2",
+  accumulate_s16_sse2,
+  subtract_s16_sse2,
+  accumulate_f32_sse2,
+  subtract_f32_sse2
+};
+
+/* SSE2 end */
+
+/* AVX2 begin */
+
+__attribute__ ((target ("avx2")))
+static void
+accumulate_s16_avx2 (gint32 * mix, const gint16 * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i v =
+        _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) (in + i)));
+    __m256i *m = (__m256i *) (mix + i);
+
+    _mm256_storeu_si256 (m, _mm256_add_epi32 (_mm256_loadu_si256 (m), v));
+  }
+
+  accumulate_s16_c (mix + i, in + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+subtract_s16_avx2 (gint16 * out, const gint32 * mix, const gint16 * in,
+    guint n)
+{
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    const __m256i *m = (const __m256i *) (mix + i);
+    __m256i lo = _mm256_sub_epi32 (_mm256_loadu_si256 (m),
+        _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) (in + i))));
+    __m256i hi = _mm256_sub_epi32 (_mm256_loadu_si256 (m + 1),
+        _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((const __m128i *) (in + i +
+                    8))));
+    /* Packing works on 128 bit lanes, put them back in order */
+    __m256i packed = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (lo, hi),
+        0xd8);
+
+    _mm256_storeu_si256 ((__m256i *) (out + i), packed);
+  }
+
+  subtract_s16_c (out + i, mix + i, in + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+accumulate_f32_avx2 (gfloat * mix, const gfloat * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps (mix + i, _mm256_add_ps (_mm256_loadu_ps (mix + i),
+            _mm256_loadu_ps (in + i)));
+  }
+
+  accumulate_f32_c (mix + i, in + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+subtract_f32_avx2 (gfloat * out, const gfloat * mix, const gfloat * in,
+    guint n)
+{
+  const __m256 min = _mm256_set1_ps (-1.0f);
+  const __m256 max = _mm256_set1_ps (1.0f);
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_sub_ps (_mm256_loadu_ps (mix + i),
+        _mm256_loadu_ps (in + i));
+
+    _mm256_storeu_ps (out + i, _mm256_min_ps (_mm256_max_ps (v, min), max));
+  }
+
+  subtract_f32_c (out + i, mix + i, in + i, n - i);
+}
+
+static const KmsMixKernels kernels_avx2 = {
+  "avx2",
+  accumulate_s16_avx2,
+  subtract_s16_avx2,
+  accumulate_f32_avx2,
+  subtract_f32_avx2
+};
+
+/* AVX2 end */
+
+#endif /* KMS_MIX_KERNELS_X86 */
+
+#ifdef KMS_MIX_KERNELS_NEON
+
+/* NEON begin */
+
+static void
+accumulate_s16_neon (gint32 * mix, const gint16 * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    int16x8_t v = vld1q_s16 (in + i);
+
+    vst1q_s32 (mix + i, vaddq_s32 (vld1q_s32 (mix + i),
+            vmovl_s16 (vget_low_s16 (v))));
+    vst1q_s32 (mix + i + 4, vaddq_s32 (vld1q_s32 (mix + i + 4),
+            vmovl_s16 (vget_high_s16 (v))));
+  }
+
+  accumulate_s16_c (mix + i, in + i, n - i);
+}
+
+static void
+subtract_s16_neon (gint16 * out, const gint32 * mix, const gint16 * in,
+    guint n)
+{
+  guint i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    int16x8_t v = vld1q_s16 (in + i);
+    int32x4_t lo = vsubq_s32 (vld1q_s32 (mix + i),
+        vmovl_s16 (vget_low_s16 (v)));
+    int32x4_t hi = vsubq_s32 (vld1q_s32 (mix + i + 4),
+        vmovl_s16 (vget_high_s16 (v)));
+
+    vst1q_s16 (out + i, vcombine_s16 (vqmovn_s32 (lo), vqmovn_s32 (hi)));
+  }
+
+  subtract_s16_c (out + i, mix + i, in + i, n - i);
+}
+
+static void
+accumulate_f32_neon (gfloat * mix, const gfloat * in, guint n)
+{
+  guint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    vst1q_f32 (mix + i, vaddq_f32 (vld1q_f32 (mix + i), vld1q_f32 (in + i)));
+  }
+
+  accumulate_f32_c (mix + i, in + i, n - i);
+}
+
+static void
+subtract_f32_neon (gfloat * out, const gfloat * mix, const gfloat * in,
+    guint n)
+{
+  const float32x4_t min = vdupq_n_f32 (-1.0f);
+  const float32x4_t max = vdupq_n_f32 (1.0f);
+  guint i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    float32x4_t v = vsubq_f32 (vld1q_f32 (mix + i), vld1q_f32 (in + i));
+
+    vst1q_f32 (out + i, vminq_f32 (vmaxq_f32 (v, min), max));
+  }
+
+  subtract_f32_c (out + i, mix + i, in + i, n - i);
+}
+
+static const KmsMixKernels kernels_neon = {
+  "neon",
+  accumulate_s16_neon,
+  subtract_s16_neon,
+  accumulate_f32_neon,
+  subtract_f32_neon
+};
+
+/* NEON end */
+
+#endif /* KMS_MIX_KERNELS_NEON */
+
+void
+kms_mix_kernels_accumulate_s16 (gint32 * mix, const gint16 * in, guint n)
+{
+  kernels->accumulate_s16 (mix, in, n);
+}
+
+void
+kms_mix_kernels_subtract_s16 (gint16 * out, const gint32 * mix,
+    const gint16 * in, guint n)
+{
+  guint done, len;
+
+  if (in != NULL) {
+    kernels->subtract_s16 (out, mix, in, n);
+    return;
+  }
+
+  for (done = 0; done < n; done += len) {
+    len = MIN (n - done, ZEROS_LENGTH);
+    kernels->subtract_s16 (out + done, mix + done, zeros_s16, len);
+  }
+}
+
+void
+kms_mix_kernels_accumulate_f32 (gfloat * mix, const gfloat * in, guint n)
+{
+  kernels->accumulate_f32 (mix, in, n);
+}
+
+void
+kms_mix_kernels_subtract_f32 (gfloat * out, const gfloat * mix,
+    const gfloat * in, guint n)
+{
+  guint done, len;
+
+  if (in != NULL) {
+    kernels->subtract_f32 (out, mix, in, n);
+    return;
+  }
+
+  for (done = 0; done < n; done += len) {
+    len = MIN (n - done, ZEROS_LENGTH);
+    kernels->subtract_f32 (out + done, mix + done, zeros_f32, len);
+  }
+}
+
+gdouble
+kms_mix_kernels_power_s16 (const gint16 * in, guint n)
+{
+  gint64 sum = 0;
+  guint i;
+
+  if (n == 0) {
+    return 0.0;
+  }
+
+  /* Plain C, the compiler vectorizes it well enough */
+  for (i = 0; i < n; i++) {
+    sum += (gint32) in[i] * in[i];
+  }
+
+  return (gdouble) sum / n / (32768.0 * 32768.0);
+}
+
+gdouble
+kms_mix_kernels_power_f32 (const gfloat * in, guint n)
+{
+  gfloat sum = 0.0;
+  guint i;
+
+  if (n == 0) {
+    return 0.0;
+  }
+
+  for (i = 0; i < n; i++) {
+    sum += in[i] * in[i];
+  }
+
+  return MIN ((gdouble) sum / n, 1.0);
+}
+
+const gchar *
+kms_mix_kernels_get_name (void)
+{
+  return kernels->name;
+}
+
+static void init_kernels (void) __attribute__ ((constructor));
+
+static void
+init_kernels (void)
+{
+  kernels = &kernels_c;
+
+#ifdef KMS_MIX_KERNELS_X86
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2")) {
+    kernels = &kernels_avx2;
+  } else if (__builtin_cpu_supports ("sse2")) {
+    kernels = &kernels_sse2;
+  }
+#endif
+
+#ifdef KMS_MIX_KERNELS_NEON
+  kernels = &kernels_neon;
+#endif
+}
@@ -0,0 +1,56 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_MIX_KERNELS_H__
+#define __KMS_MIX_KERNELS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Sample kernels of the mix-minus engine. The mix of all the inputs is
+ * accumulated once, with headroom (32 bits for S16), and every output is
+ * the mix minus one of the inputs, saturated. The AVX2, SSE2 or NEON
+ * version is chosen at runtime, falling back to plain C.
+ */
+
+/* @mix += @in */
+void kms_mix_kernels_accumulate_s16 (gint32 * mix, const gint16 * in,
+    guint n);
+
+/* @out = saturated (@mix - @in). @in may be NULL */
+void kms_mix_kernels_subtract_s16 (gint16 * out, const gint32 * mix,
+    const gint16 * in, guint n);
+
+/* @mix += @in */
+void kms_mix_kernels_accumulate_f32 (gfloat * mix, const gfloat * in,
+    guint n);
+
+/* @out = @mix - @in clamped to [-1, 1]. @in may be NULL */
+void kms_mix_kernels_subtract_f32 (gfloat * out, const gfloat * mix,
+    const gfloat * in, guint n);
+
+/* Mean power relative to full scale, from 0 to 1 */
+gdouble kms_mix_kernels_power_s16 (const gint16 * in, guint n);
+gdouble kms_mix_kernels_power_f32 (const gfloat * in, guint n);
+
+/* Instruction set of the kernels in use */
+const gchar * kms_mix_kernels_get_name (void);
+
+G_END_DECLS
+#endif /* __KMS_MIX_KERNELS_H__ */
@@ -21,6 +21,7 @@
 
 #include "kmsparsetreebin.h"
 #include <kmsutils.h>
+#include "kmsfactorycache.h"
 
 #define GST_DEFAULT_NAME "parsetreebin"
 #define GST_CAT_DEFAULT kms_parse_tree_bin_debug
@@ -53,31 +54,15 @@ struct _KmsParseTreeBinPrivate
 static GstElement *
 create_parser_for_caps (const GstCaps * caps)
 {
-  GList *parser_list, *filtered_list, *l;
-  GstElementFactory *parser_factory = NULL;
-  GstElement *parser = NULL;
-
-  parser_list =
-      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_PARSER,
-      GST_RANK_NONE);
-  filtered_list =
-      gst_element_factory_list_filter (parser_list, caps, GST_PAD_SINK, FALSE);
-
-  for (l = filtered_list; l != NULL && parser_factory == NULL; l = l->next) {
-    parser_factory = GST_ELEMENT_FACTORY (l->data);
-    if (gst_element_factory_get_num_pad_templates (parser_factory) != 2)
-      parser_factory = NULL;
-  }
+  GstElement *parser;
 
-  if (parser_factory != NULL) {
-    parser = gst_element_factory_create (parser_factory, NULL);
-  } else {
+  parser = kms_factory_cache_create (GST_ELEMENT_FACTORY_TYPE_PARSER, caps,
+      NULL);
+
+  if (parser == NULL) {
     parser = gst_element_factory_make ("capsfilter", NULL);
   }
 
-  gst_plugin_feature_list_free (filtered_list);
-  gst_plugin_feature_list_free (parser_list);
-
   return parser;
 }
 
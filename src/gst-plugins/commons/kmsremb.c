@@ -42,14 +42,21 @@ G_DEFINE_QUARK (KMS_REMB_LOCAL, kms_remb_local);
 
 #define REMB_MAX_FACTOR_INPUT_BR 2
 
+/* Keep the compound RTCP packet under the MTU */
+#define TWCC_FEEDBACK_MAX_PACKETS 128
+#define TWCC_FEEDBACK_MAX_PER_RTCP 3
+
 static void
 kms_remb_base_destroy (KmsRembBase * rb)
 {
-  g_signal_handler_disconnect (rb->rtpsess, rb->signal_id);
-  rb->signal_id = 0;
-  g_object_set_qdata (rb->rtpsess, kms_remb_local_quark (), NULL);
-  g_object_set_qdata (rb->rtpsess, kms_remb_remote_quark (), NULL);
-  g_clear_object (&rb->rtpsess);
+  if (rb->rtpsess != NULL) {
+    g_signal_handler_disconnect (rb->rtpsess, rb->signal_id);
+    rb->signal_id = 0;
+    g_object_set_qdata (rb->rtpsess, kms_remb_local_quark (), NULL);
+    g_object_set_qdata (rb->rtpsess, kms_remb_remote_quark (), NULL);
+    g_clear_object (&rb->rtpsess);
+  }
+
   g_rec_mutex_clear (&rb->mutex);
   g_hash_table_unref (rb->remb_stats);
 }
@@ -57,7 +64,9 @@ kms_remb_base_destroy (KmsRembBase * rb)
 static void
 kms_remb_base_create (KmsRembBase * rb, GObject * rtpsess)
 {
-  rb->rtpsess = g_object_ref (rtpsess);
+  if (rtpsess != NULL) {
+    rb->rtpsess = g_object_ref (rtpsess);
+  }
   g_rec_mutex_init (&rb->mutex);
   rb->remb_stats = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
       (GDestroyNotify) kms_utils_destroy_guint);
@@ -194,8 +203,7 @@ get_sessions_info (KmsRlRemoteSession * rlrs, GetRtpSessionsInfo * data)
 }
 
 static gboolean
-get_video_recv_info (KmsRembLocal * rl,
-    guint64 * bitrate, guint * fraction_lost, guint64 * packets_rcv_interval)
+get_video_recv_info (KmsRembLocal * rl, KmsRembControllerInput * input)
 {
   GetRtpSessionsInfo data;
   GstClockTime current_time;
@@ -221,41 +229,60 @@ get_video_recv_info (KmsRembLocal * rl,
 
   current_time = kms_utils_get_time_nsecs ();
 
+  input->time = current_time;
+
   /* Normalize fraction_lost */
-  *fraction_lost =
+  input->fraction_lost =
       data.fraction_lost_accumulative /
       data.packets_received_expected_interval_accumulative;
 
-  *bitrate = data.bitrate;
+  input->bitrate = data.bitrate;
+  input->bytes = 0;
   if (rl->last_time != 0) {
     GstClockTime elapsed = current_time - rl->last_time;
-    guint64 bytes_handled = data.octets_received - rl->last_octets_received;
 
-    *bitrate = gst_util_uint64_scale (bytes_handled, 8 * GST_SECOND, elapsed);
+    input->bytes = data.octets_received - rl->last_octets_received;
+    input->bitrate =
+        gst_util_uint64_scale (input->bytes, 8 * GST_SECOND, elapsed);
     GST_TRACE_OBJECT (KMS_REMB_BASE (rl)->rtpsess,
         "Elapsed %" G_GUINT64_FORMAT " bytes %" G_GUINT64_FORMAT ", rate %"
-        G_GUINT64_FORMAT, elapsed, bytes_handled, *bitrate);
+        G_GUINT64_FORMAT, elapsed, input->bytes, input->bitrate);
   }
 
   rl->last_time = current_time;
   rl->last_octets_received = data.octets_received;
 
-  *packets_rcv_interval = data.packets_received - rl->last_packets_received;
+  input->packets = data.packets_received - rl->last_packets_received;
   rl->last_packets_received = data.packets_received;
 
   return TRUE;
 }
 
-static gboolean
-kms_remb_local_update (KmsRembLocal * rl)
+/* Congestion controller interface begin */
+
+/* Default controller: loss based, its state and params live in KmsRembLocal */
+
+static gpointer
+kms_remb_default_controller_create (KmsRembLocal * rl)
 {
-  guint64 bitrate, packets_rcv_interval;
-  guint fraction_lost, packets_rcv_interval_top;
+  return rl;
+}
 
-  if (!get_video_recv_info (rl, &bitrate, &fraction_lost,
-          &packets_rcv_interval)) {
-    return FALSE;
-  }
+static void
+kms_remb_default_controller_destroy (gpointer ctrl)
+{
+  /* Nothing to free */
+}
+
+static gboolean
+kms_remb_default_controller_update (gpointer ctrl,
+    const KmsRembControllerInput * input, guint * br)
+{
+  KmsRembLocal *rl = ctrl;
+  guint64 bitrate = input->bitrate;
+  guint64 packets_rcv_interval = input->packets;
+  guint fraction_lost = input->fraction_lost;
+  guint packets_rcv_interval_top;
 
   if (!rl->probed) {
     if (bitrate == 0) {
@@ -325,10 +352,6 @@ kms_remb_local_update (KmsRembLocal * rl)
 
   rl->remb = MIN (rl->remb, rl->max_br * REMB_MAX_FACTOR_INPUT_BR);
 
-  if (rl->max_bw > 0) {
-    rl->remb = MIN (rl->remb, rl->max_bw * 1000);
-  }
-
   GST_TRACE_OBJECT (KMS_REMB_BASE (rl)->rtpsess,
       "REMB: %" G_GUINT32_FORMAT ", TH: %" G_GUINT32_FORMAT
       ", fraction_lost: %d, fraction_lost_record: %" G_GUINT64_FORMAT
@@ -336,6 +359,229 @@ kms_remb_local_update (KmsRembLocal * rl)
       ", avg_br: %" G_GUINT32_FORMAT, rl->remb, rl->threshold, fraction_lost,
       rl->fraction_lost_record, bitrate, rl->max_br, rl->avg_br);
 
+  *br = rl->remb;
+
+  return TRUE;
+}
+
+/* Delay based controller: delay gradient over the abs-send-time extension */
+
+#define ABS_SEND_TIME_FRACTION_BITS 18
+#define ABS_SEND_TIME_WRAP (1 << 24)
+
+typedef struct _KmsRembDelayController
+{
+  KmsTwccEstimator *est;
+  gboolean has_send_time;
+  gint64 ext_send_time;         /* 6.18 fixed point seconds, unwrapped */
+} KmsRembDelayController;
+
+static gpointer
+kms_remb_delay_controller_create (KmsRembLocal * rl)
+{
+  KmsRembDelayController *ctrl = g_slice_new0 (KmsRembDelayController);
+
+  ctrl->est = kms_twcc_estimator_new (rl->remb,
+      rl->min_bw > 0 ? rl->min_bw * 1000 : REMB_MIN,
+      rl->max_bw > 0 ? rl->max_bw * 1000 : G_MAXUINT);
+
+  return ctrl;
+}
+
+static void
+kms_remb_delay_controller_destroy (gpointer data)
+{
+  KmsRembDelayController *ctrl = data;
+
+  kms_twcc_estimator_destroy (ctrl->est);
+  g_slice_free (KmsRembDelayController, ctrl);
+}
+
+static void
+kms_remb_delay_controller_packet_received (gpointer data,
+    guint32 abs_send_time, GstClockTime arrival_time, guint size)
+{
+  KmsRembDelayController *ctrl = data;
+  GstClockTime send_time;
+
+  if (!ctrl->has_send_time) {
+    /* Start at the second cycle so that it never gets negative */
+    ctrl->ext_send_time = abs_send_time + ABS_SEND_TIME_WRAP;
+    ctrl->has_send_time = TRUE;
+  } else {
+    gint32 diff;
+
+    /* Sign extend the 24 bits difference */
+    diff = (abs_send_time - ctrl->ext_send_time) & (ABS_SEND_TIME_WRAP - 1);
+    diff = ((gint32) ((guint32) diff << 8)) >> 8;
+    ctrl->ext_send_time += diff;
+  }
+
+  send_time = gst_util_uint64_scale (ctrl->ext_send_time, GST_SECOND,
+      1 << ABS_SEND_TIME_FRACTION_BITS);
+  kms_twcc_estimator_packet_arrived (ctrl->est, send_time, arrival_time, size);
+}
+
+static gboolean
+kms_remb_delay_controller_update (gpointer data,
+    const KmsRembControllerInput * input, guint * bitrate)
+{
+  KmsRembDelayController *ctrl = data;
+
+  return kms_twcc_estimator_update (ctrl->est, input->fraction_lost / 256.0,
+      input->time, bitrate);
+}
+
+static const KmsRembController default_controller = {
+  .name = KMS_REMB_CONTROLLER_DEFAULT,
+  .create = kms_remb_default_controller_create,
+  .destroy = kms_remb_default_controller_destroy,
+  .packet_received = NULL,
+  .update = kms_remb_default_controller_update,
+};
+
+static const KmsRembController delay_based_controller = {
+  .name = KMS_REMB_CONTROLLER_DELAY_BASED,
+  .create = kms_remb_delay_controller_create,
+  .destroy = kms_remb_delay_controller_destroy,
+  .packet_received = kms_remb_delay_controller_packet_received,
+  .update = kms_remb_delay_controller_update,
+};
+
+static GMutex controllers_mutex;
+static GSList *controllers = NULL;
+
+static const KmsRembController *
+kms_remb_controller_lookup_unlocked (const gchar * name)
+{
+  GSList *l;
+
+  if (g_strcmp0 (name, default_controller.name) == 0) {
+    return &default_controller;
+  }
+
+  if (g_strcmp0 (name, delay_based_controller.name) == 0) {
+    return &delay_based_controller;
+  }
+
+  for (l = controllers; l != NULL; l = g_slist_next (l)) {
+    const KmsRembController *controller = l->data;
+
+    if (g_strcmp0 (name, controller->name) == 0) {
+      return controller;
+    }
+  }
+
+  return NULL;
+}
+
+gboolean
+kms_remb_controller_register (const KmsRembController * controller)
+{
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (controller != NULL && controller->name != NULL, FALSE);
+  g_return_val_if_fail (controller->create != NULL &&
+      controller->destroy != NULL && controller->update != NULL, FALSE);
+
+  g_mutex_lock (&controllers_mutex);
+
+  if (kms_remb_controller_lookup_unlocked (controller->name) != NULL) {
+    GST_WARNING ("Congestion controller '%s' already registered",
+        controller->name);
+    goto end;
+  }
+
+  controllers = g_slist_prepend (controllers, (gpointer) controller);
+  ret = TRUE;
+
+end:
+  g_mutex_unlock (&controllers_mutex);
+
+  return ret;
+}
+
+const KmsRembController *
+kms_remb_controller_lookup (const gchar * name)
+{
+  const KmsRembController *controller;
+
+  g_mutex_lock (&controllers_mutex);
+  controller = kms_remb_controller_lookup_unlocked (name);
+  g_mutex_unlock (&controllers_mutex);
+
+  return controller;
+}
+
+/* Congestion controller interface end */
+
+static void
+kms_remb_local_set_controller (KmsRembLocal * rl,
+    const KmsRembController * controller)
+{
+  KMS_REMB_BASE_LOCK (rl);
+
+  if (rl->controller == controller) {
+    KMS_REMB_BASE_UNLOCK (rl);
+    return;
+  }
+
+  if (rl->controller != NULL) {
+    rl->controller->destroy (rl->controller_data);
+  }
+
+  GST_DEBUG_OBJECT (KMS_REMB_BASE (rl)->rtpsess,
+      "Using congestion controller '%s'", controller->name);
+
+  rl->controller = controller;
+  rl->controller_data = controller->create (rl);
+  g_atomic_int_set (&rl->controller_needs_packets,
+      controller->packet_received != NULL);
+
+  KMS_REMB_BASE_UNLOCK (rl);
+}
+
+gboolean
+kms_remb_local_process (KmsRembLocal * rl,
+    const KmsRembControllerInput * input, guint * bitrate)
+{
+  guint br;
+  gboolean ret;
+
+  KMS_REMB_BASE_LOCK (rl);
+  ret = rl->controller->update (rl->controller_data, input, &br);
+  KMS_REMB_BASE_UNLOCK (rl);
+
+  if (!ret) {
+    return FALSE;
+  }
+
+  rl->remb = br;
+
+  if (rl->max_bw > 0) {
+    rl->remb = MIN (rl->remb, rl->max_bw * 1000);
+  }
+
+  br = rl->remb;
+  if (rl->event_manager != NULL) {
+    guint remb_local_max;
+
+    remb_local_max = kms_utils_remb_event_manager_get_min (rl->event_manager);
+    if (remb_local_max > 0) {
+      GST_TRACE_OBJECT (KMS_REMB_BASE (rl)->rtpsess,
+          "REMB local max: %" G_GUINT32_FORMAT, remb_local_max);
+      br = MIN (remb_local_max, rl->remb);
+    }
+  }
+
+  if (rl->min_bw > 0) {
+    br = MAX (br, rl->min_bw * 1000);
+  } else {
+    br = MAX (br, REMB_MIN);
+  }
+
+  *bitrate = br;
+
   return TRUE;
 }
 
@@ -359,12 +605,61 @@ add_ssrcs (KmsRlRemoteSession * rlrs, AddSsrcsData * data)
   kms_remb_base_update_stats (rb, rlrs->ssrc, data->remb_packet->bitrate);
 }
 
+static void
+kms_remb_local_add_twcc_feedback (KmsRembLocal * rl, GObject * sess,
+    GstBuffer * buffer)
+{
+  KmsRTCPTWCCPacket twcc_packet;
+  GstRTCPBuffer rtcp = { NULL, };
+  GstRTCPPacket packet;
+  guint sender_ssrc, media_ssrc = 0;
+  guint i;
+
+  if (rl->remote_sessions != NULL) {
+    KmsRlRemoteSession *rlrs = rl->remote_sessions->data;
+
+    media_ssrc = rlrs->ssrc;
+  }
+
+  g_object_get (sess, "internal-ssrc", &sender_ssrc, NULL);
+
+  if (!gst_rtcp_buffer_map (buffer, GST_MAP_READWRITE, &rtcp)) {
+    GST_WARNING_OBJECT (sess, "Cannot map buffer to RTCP");
+    return;
+  }
+
+  for (i = 0; i < TWCC_FEEDBACK_MAX_PER_RTCP; i++) {
+    if (!kms_twcc_recorder_build_feedback (rl->twcc_recorder, &twcc_packet,
+            TWCC_FEEDBACK_MAX_PACKETS)) {
+      break;
+    }
+
+    if (!gst_rtcp_buffer_add_packet (&rtcp, GST_RTCP_TYPE_RTPFB, &packet)) {
+      GST_WARNING_OBJECT (sess, "Cannot add RTCP packet");
+      break;
+    }
+
+    GST_TRACE_OBJECT (sess, "Sending TWCC (base seq: %" G_GUINT16_FORMAT
+        ", packets: %" G_GUINT16_FORMAT ")", twcc_packet.base_seq,
+        twcc_packet.packet_count);
+
+    if (!kms_rtcp_rtpfb_twcc_marshall_packet (&packet, &twcc_packet,
+            sender_ssrc, media_ssrc)) {
+      gst_rtcp_packet_remove (&packet);
+      break;
+    }
+  }
+
+  gst_rtcp_buffer_unmap (&rtcp);
+}
+
 static void
 on_sending_rtcp (GObject * sess, GstBuffer * buffer, gboolean is_early,
     gboolean * do_not_supress)
 {
   KmsRembLocal *rl;
   GstClockTime current_time, elapsed;
+  KmsRembControllerInput input;
   KmsRTCPPSFBAFBREMBPacket remb_packet;
   GstRTCPBuffer rtcp = { NULL, };
   GstRTCPPacket packet;
@@ -378,6 +673,11 @@ on_sending_rtcp (GObject * sess, GstBuffer * buffer, gboolean is_early,
     return;
   }
 
+  if (rl->transport_cc) {
+    /* Sent on every RTCP, not limited by REMB_MAX_INTERVAL */
+    kms_remb_local_add_twcc_feedback (rl, sess, buffer);
+  }
+
   current_time = kms_utils_get_time_nsecs ();
   elapsed = current_time - rl->last_sent_time;
   if (rl->last_sent_time != 0 && (elapsed < REMB_MAX_INTERVAL * GST_MSECOND)) {
@@ -395,26 +695,12 @@ on_sending_rtcp (GObject * sess, GstBuffer * buffer, gboolean is_early,
     goto end;
   }
 
-  if (!kms_remb_local_update (rl)) {
+  if (!get_video_recv_info (rl, &input)) {
     goto end;
   }
 
-  remb_packet.bitrate = rl->remb;
-  if (rl->event_manager != NULL) {
-    guint remb_local_max;
-
-    remb_local_max = kms_utils_remb_event_manager_get_min (rl->event_manager);
-    if (remb_local_max > 0) {
-      GST_TRACE_OBJECT (sess, "REMB local max: %" G_GUINT32_FORMAT,
-          remb_local_max);
-      remb_packet.bitrate = MIN (remb_local_max, rl->remb);
-    }
-  }
-
-  if (rl->min_bw > 0) {
-    remb_packet.bitrate = MAX (remb_packet.bitrate, rl->min_bw * 1000);
-  } else {
-    remb_packet.bitrate = MAX (remb_packet.bitrate, REMB_MIN);
+  if (!kms_remb_local_process (rl, &input, &remb_packet.bitrate)) {
+    goto end;
   }
 
   remb_packet.n_ssrcs = 0;
@@ -445,6 +731,12 @@ kms_remb_local_destroy (KmsRembLocal * rl)
     kms_utils_remb_event_manager_destroy (rl->event_manager);
   }
 
+  kms_twcc_recorder_destroy (rl->twcc_recorder);
+
+  if (rl->controller != NULL) {
+    rl->controller->destroy (rl->controller_data);
+  }
+
   g_slist_free_full (rl->remote_sessions,
       (GDestroyNotify) kms_rl_remote_session_create_destroy);
   kms_remb_base_destroy (KMS_REMB_BASE (rl));
@@ -457,9 +749,11 @@ kms_remb_local_create (GObject * rtpsess, guint min_bw, guint max_bw)
 {
   KmsRembLocal *rl = g_slice_new0 (KmsRembLocal);
 
-  g_object_set_qdata (rtpsess, kms_remb_local_quark (), rl);
-  rl->base.signal_id = g_signal_connect (rtpsess, "on-sending-rtcp",
-      G_CALLBACK (on_sending_rtcp), NULL);
+  if (rtpsess != NULL) {
+    g_object_set_qdata (rtpsess, kms_remb_local_quark (), rl);
+    rl->base.signal_id = g_signal_connect (rtpsess, "on-sending-rtcp",
+        G_CALLBACK (on_sending_rtcp), NULL);
+  }
 
   kms_remb_base_create (KMS_REMB_BASE (rl), rtpsess);
 
@@ -479,6 +773,10 @@ kms_remb_local_create (GObject * rtpsess, guint min_bw, guint max_bw)
   rl->threshold_factor = DEFAULT_REMB_THRESHOLD_FACTOR;
   rl->up_losses = DEFAULT_REMB_UP_LOSSES;
 
+  rl->twcc_recorder = kms_twcc_recorder_new ();
+
+  kms_remb_local_set_controller (rl, &default_controller);
+
   return rl;
 }
 
@@ -491,11 +789,45 @@ kms_remb_local_add_remote_session (KmsRembLocal * rl, GObject * rtpsess,
   rl->remote_sessions = g_slist_append (rl->remote_sessions, rlrs);
 }
 
+void
+kms_remb_local_twcc_packet_received (KmsRembLocal * rl, guint16 seq,
+    GstClockTime arrival_time)
+{
+  if (!rl->transport_cc) {
+    return;
+  }
+
+  kms_twcc_recorder_add (rl->twcc_recorder, seq, arrival_time);
+}
+
+gboolean
+kms_remb_local_needs_packets (KmsRembLocal * rl)
+{
+  return rl->transport_cc ||
+      g_atomic_int_get (&rl->controller_needs_packets);
+}
+
+void
+kms_remb_local_packet_received (KmsRembLocal * rl, guint32 abs_send_time,
+    GstClockTime arrival_time, guint size)
+{
+  KMS_REMB_BASE_LOCK (rl);
+
+  if (rl->controller->packet_received != NULL) {
+    rl->controller->packet_received (rl->controller_data, abs_send_time,
+        arrival_time, size);
+  }
+
+  KMS_REMB_BASE_UNLOCK (rl);
+}
+
 void
 kms_remb_local_set_params (KmsRembLocal * rl, GstStructure * params)
 {
   gfloat auxf;
   gint auxi;
+  gboolean auxb;
+  gchar *auxs;
   gboolean is_set;
 
   is_set =
@@ -547,6 +879,26 @@ kms_remb_local_set_params (KmsRembLocal * rl, GstStructure * params)
   if (is_set) {
     rl->up_losses = auxi;
   }
+
+  is_set =
+      gst_structure_get (params, "transport-cc", G_TYPE_BOOLEAN, &auxb, NULL);
+  if (is_set) {
+    rl->transport_cc = auxb;
+  }
+
+  is_set =
+      gst_structure_get (params, "controller", G_TYPE_STRING, &auxs, NULL);
+  if (is_set) {
+    const KmsRembController *controller = kms_remb_controller_lookup (auxs);
+
+    if (controller != NULL) {
+      kms_remb_local_set_controller (rl, controller);
+    } else {
+      GST_WARNING ("Unknown congestion controller '%s'", auxs);
+    }
+
+    g_free (auxs);
+  }
 }
 
 void
@@ -559,7 +911,9 @@ kms_remb_local_get_params (KmsRembLocal * rl, GstStructure ** params)
       "lineal-factor-grade", G_TYPE_FLOAT, rl->lineal_factor_grade,
       "decrement-factor", G_TYPE_FLOAT, rl->decrement_factor,
       "threshold-factor", G_TYPE_FLOAT, rl->threshold_factor,
-      "up-losses", G_TYPE_INT, rl->up_losses, NULL);
+      "up-losses", G_TYPE_INT, rl->up_losses,
+      "transport-cc", G_TYPE_BOOLEAN, rl->transport_cc,
+      "controller", G_TYPE_STRING, rl->controller->name, NULL);
 }
 
 /* KmsRembLocal end */
@@ -631,6 +985,12 @@ kms_remb_remote_update (KmsRembRemote * rm,
         " A inconsistent management could take place", remb_packet->n_ssrcs);
   }
 
+  if (rm->transport_cc && rm->twcc_active) {
+    /* The transport-cc estimation drives the encoder, REMB only limits it */
+    rm->remb = remb_packet->bitrate;
+    return;
+  }
+
   br_send = remb_packet->bitrate;
   if (!rm->probed) {
     if ((remb_packet->bitrate < rm->remb_on_connect)
@@ -706,12 +1066,63 @@ end:
   kms_rtcp_psfb_afb_buffer_unmap (&afb_buffer);
 }
 
+static void
+process_rtpfb_twcc (GObject * sess, guint ssrc, GstBuffer * fci_buffer)
+{
+  KmsRembRemote *rm;
+  KmsRTCPTWCCPacket twcc_packet;
+  guint bitrate;
+
+  if (!G_IS_OBJECT (sess)) {
+    GST_WARNING ("Invalid session object");
+    return;
+  }
+
+  rm = g_object_get_qdata (sess, kms_remb_remote_quark ());
+
+  if (!rm) {
+    GST_WARNING ("Invalid RembRemote");
+    return;
+  }
+
+  if (!rm->transport_cc || rm->twcc_estimator == NULL) {
+    GST_TRACE_OBJECT (sess, "Transport-cc not enabled, ignoring feedback");
+    return;
+  }
+
+  if (!kms_rtcp_rtpfb_twcc_get_packet (fci_buffer, &twcc_packet)) {
+    GST_WARNING_OBJECT (fci_buffer, "Cannot get RTCP RTPFB TWCC packet");
+    return;
+  }
+
+  if (!kms_twcc_estimator_on_feedback (rm->twcc_estimator, &twcc_packet,
+          kms_utils_get_time_nsecs (), &bitrate)) {
+    return;
+  }
+
+  rm->twcc_active = TRUE;
+
+  if (rm->remb > 0) {
+    bitrate = MIN (bitrate, rm->remb);
+  }
+
+  send_remb_event (rm, bitrate, rm->local_ssrc);
+  kms_remb_base_update_stats (KMS_REMB_BASE (rm), rm->local_ssrc, bitrate);
+}
+
 static void
 on_feedback_rtcp (GObject * sess, guint type, guint fbtype,
     guint sender_ssrc, guint media_ssrc, GstBuffer * fci)
 {
   switch (type) {
     case GST_RTCP_TYPE_RTPFB:
+      switch (fbtype) {
+        case KMS_RTCP_RTPFB_TYPE_TWCC:
+          process_rtpfb_twcc (sess, sender_ssrc, fci);
+          break;
+        default:
+          break;
+      }
       break;
     case GST_RTCP_TYPE_PSFB:
       switch (fbtype) {
@@ -738,6 +1149,8 @@ kms_remb_remote_destroy (KmsRembRemote * rm)
     g_object_unref (rm->pad_event);
   }
 
+  kms_twcc_estimator_destroy (rm->twcc_estimator);
+
   kms_remb_base_destroy (KMS_REMB_BASE (rm));
 
   g_slice_free (KmsRembRemote, rm);
@@ -768,10 +1181,27 @@ kms_remb_remote_create (GObject * rtpsess, guint local_ssrc,
   return rm;
 }
 
+void
+kms_remb_remote_twcc_packet_sent (KmsRembRemote * rm, guint16 seq,
+    guint size, GstClockTime send_time)
+{
+  KmsTwccEstimator *est;
+
+  if (!rm->transport_cc) {
+    return;
+  }
+
+  est = g_atomic_pointer_get (&rm->twcc_estimator);
+  if (est != NULL) {
+    kms_twcc_estimator_packet_sent (est, seq, size, send_time);
+  }
+}
+
 void
 kms_remb_remote_set_params (KmsRembRemote * rm, GstStructure * params)
 {
   gint auxi;
+  gboolean auxb;
   gboolean is_set;
 
   is_set =
@@ -779,13 +1209,29 @@ kms_remb_remote_set_params (KmsRembRemote * rm, GstStructure * params)
   if (is_set) {
     rm->remb_on_connect = auxi;
   }
+
+  is_set =
+      gst_structure_get (params, "transport-cc", G_TYPE_BOOLEAN, &auxb, NULL);
+  if (is_set) {
+    if (auxb && rm->twcc_estimator == NULL) {
+      KmsTwccEstimator *est;
+
+      est = kms_twcc_estimator_new (rm->remb_on_connect,
+          rm->min_bw > 0 ? rm->min_bw * 1000 : REMB_MIN,
+          rm->max_bw > 0 ? rm->max_bw * 1000 : G_MAXUINT);
+      g_atomic_pointer_set (&rm->twcc_estimator, est);
+    }
+
+    rm->transport_cc = auxb;
+  }
 }
 
 void
 kms_remb_remote_get_params (KmsRembRemote * rm, GstStructure ** params)
 {
   gst_structure_set (*params,
-      "remb-on-connect", G_TYPE_INT, rm->remb_on_connect, NULL);
+      "remb-on-connect", G_TYPE_INT, rm->remb_on_connect,
+      "transport-cc", G_TYPE_BOOLEAN, rm->transport_cc, NULL);
 }
 
 /* KmsRembRemote end */
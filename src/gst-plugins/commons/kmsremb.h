@@ -19,6 +19,7 @@
 #define __KMS_REMB_H__
 
 #include "kmsutils.h" /* TODO: must be not needed */
+#include "kmstwcc.h"
 
 G_BEGIN_DECLS
 
@@ -42,6 +43,45 @@ struct _KmsRembBase
 /* KmsRembLocal begin */
 typedef struct _KmsRembLocal KmsRembLocal;
 
+/* Congestion controller interface begin */
+#define KMS_REMB_CONTROLLER_DEFAULT "default"
+#define KMS_REMB_CONTROLLER_DELAY_BASED "delay-based"
+
+typedef struct _KmsRembControllerInput KmsRembControllerInput;
+
+/* Receiver statistics of the last RTCP interval */
+struct _KmsRembControllerInput
+{
+  GstClockTime time;
+  guint64 bitrate;      /* bps */
+  guint64 bytes;
+  guint64 packets;
+  guint fraction_lost;  /* N/256 */
+};
+
+typedef struct _KmsRembController KmsRembController;
+
+struct _KmsRembController
+{
+  const gchar *name;
+
+  gpointer (*create) (KmsRembLocal * rl);
+  void (*destroy) (gpointer ctrl);
+
+  /* Optional. Called for every received video packet carrying the
+   * abs-send-time extension (24 bits, 6.18 fixed point seconds) */
+  void (*packet_received) (gpointer ctrl, guint32 abs_send_time,
+      GstClockTime arrival_time, guint size);
+
+  /* Returns FALSE if there is not enough data to estimate a bitrate */
+  gboolean (*update) (gpointer ctrl, const KmsRembControllerInput * input,
+      guint * bitrate);
+};
+
+gboolean kms_remb_controller_register (const KmsRembController * controller);
+const KmsRembController * kms_remb_controller_lookup (const gchar * name);
+/* Congestion controller interface end */
+
 struct _KmsRembLocal
 {
   KmsRembBase base;
@@ -70,14 +110,28 @@ struct _KmsRembLocal
   guint64 last_packets_received;
   guint64 fraction_lost_record;
   RembEventManager *event_manager;
+
+  gboolean transport_cc;
+  KmsTwccRecorder *twcc_recorder;
+
+  const KmsRembController *controller;
+  gpointer controller_data;
+  /* Cached from controller so the receive path needs no lock */
+  gint controller_needs_packets;
 };
 
+/* @rtpsess can be NULL to run the estimation offline (replays, benchmarks)
+ * through kms_remb_local_process */
 KmsRembLocal * kms_remb_local_create (GObject *rtpsess,
   guint min_bw, guint max_bw);
 void kms_remb_local_destroy (KmsRembLocal *rl);
 void kms_remb_local_add_remote_session (KmsRembLocal *rl, GObject *rtpsess, guint ssrc);
 void kms_remb_local_set_params (KmsRembLocal *rl, GstStructure *params);
 void kms_remb_local_get_params (KmsRembLocal *rl, GstStructure **params);
+void kms_remb_local_twcc_packet_received (KmsRembLocal *rl, guint16 seq, GstClockTime arrival_time);
+gboolean kms_remb_local_needs_packets (KmsRembLocal *rl);
+gboolean kms_remb_local_process (KmsRembLocal *rl, const KmsRembControllerInput *input, guint *bitrate);
+void kms_remb_local_packet_received (KmsRembLocal *rl, guint32 abs_send_time, GstClockTime arrival_time, guint size);
 /* KmsRembLocal end */
 
 /* KmsRembRemote begin */
@@ -96,6 +150,10 @@ struct _KmsRembRemote
   guint remb;
   gboolean probed;
   GstPad *pad_event;
+
+  gboolean transport_cc;
+  gboolean twcc_active;
+  KmsTwccEstimator *twcc_estimator;
 };
 
 KmsRembRemote * kms_remb_remote_create (GObject *rtpsess,
@@ -103,6 +161,7 @@ KmsRembRemote * kms_remb_remote_create (GObject *rtpsess,
 void kms_remb_remote_destroy (KmsRembRemote *rm);
 void kms_remb_remote_set_params (KmsRembRemote *rm, GstStructure *params);
 void kms_remb_remote_get_params (KmsRembRemote *rm, GstStructure **params);
+void kms_remb_remote_twcc_packet_sent (KmsRembRemote *rm, guint16 seq, guint size, GstClockTime send_time);
 /* KmsRembRemote end */
 
 G_END_DECLS
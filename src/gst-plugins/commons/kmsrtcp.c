@@ -251,3 +251,252 @@ kms_rtcp_psfb_afb_remb_marshall_packet (GstRTCPPacket * rtcp_packet,
 }
 
 /* REMB end */
+
+/* Transport-wide CC begin */
+
+//    0                   1                   2                   3
+//    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   |V=2|P|  FMT=15 |    PT=205     |           length              |
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   |                     SSRC of packet sender                     |
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   |                      SSRC of media source                     |
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   |      base sequence number     |      packet status count      |
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   |                 reference time                | fb pkt. count |
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   |          packet chunk         |         packet chunk          |
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   .                                                               .
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   |         packet chunk          |  recv delta   |  recv delta   |
+//   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+//   .                                                               .
+
+#define TWCC_HEADER_SIZE 8
+
+#define TWCC_STATUS_NOT_RECEIVED 0
+#define TWCC_STATUS_SMALL_DELTA 1
+#define TWCC_STATUS_LARGE_DELTA 2
+
+#define TWCC_TWO_BIT_VECTOR_SYMBOLS 7
+
+gboolean
+kms_rtcp_rtpfb_twcc_get_packet (GstBuffer * fci_buffer,
+    KmsRTCPTWCCPacket * twcc_packet)
+{
+  GstMapInfo map;
+  guint8 *fci, *fci_end;
+  guint8 *status;
+  guint idx, i;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (GST_IS_BUFFER (fci_buffer), FALSE);
+  g_return_val_if_fail (twcc_packet != NULL, FALSE);
+
+  if (!gst_buffer_map (fci_buffer, &map, GST_MAP_READ)) {
+    GST_ERROR ("Cannot map TWCC buffer");
+    return FALSE;
+  }
+
+  fci = map.data;
+  fci_end = map.data + map.size;
+
+  if (map.size < TWCC_HEADER_SIZE) {
+    GST_ERROR ("Inconsistent TWCC packet length");
+    goto end;
+  }
+
+  twcc_packet->base_seq = GST_READ_UINT16_BE (fci);
+  twcc_packet->packet_count = GST_READ_UINT16_BE (fci + 2);
+  /* 24 bits signed */
+  twcc_packet->reference_time = ((gint32) (GST_READ_UINT32_BE (fci + 4))) >> 8;
+  twcc_packet->fb_pkt_count = fci[7];
+  fci += TWCC_HEADER_SIZE;
+
+  if (twcc_packet->packet_count > KMS_RTCP_TWCC_MAX_PACKETS) {
+    GST_ERROR ("TWCC packet with too many packets (%u)",
+        twcc_packet->packet_count);
+    goto end;
+  }
+
+  status = g_alloca (twcc_packet->packet_count);
+
+  /* Packet chunks */
+  idx = 0;
+  while (idx < twcc_packet->packet_count) {
+    guint16 chunk;
+
+    if (fci + 2 > fci_end) {
+      GST_ERROR ("Inconsistent TWCC packet (chunks)");
+      goto end;
+    }
+
+    chunk = GST_READ_UINT16_BE (fci);
+    fci += 2;
+
+    if ((chunk & 0x8000) == 0) {
+      /* Run length chunk */
+      guint symbol = (chunk >> 13) & 0x03;
+      guint run = chunk & 0x1fff;
+
+      for (i = 0; i < run && idx < twcc_packet->packet_count; i++, idx++) {
+        status[idx] = symbol;
+      }
+    } else if ((chunk & 0x4000) == 0) {
+      /* Status vector chunk, 1 bit symbols */
+      for (i = 0; i < 14 && idx < twcc_packet->packet_count; i++, idx++) {
+        status[idx] = (chunk >> (13 - i)) & 0x01;
+      }
+    } else {
+      /* Status vector chunk, 2 bits symbols */
+      for (i = 0; i < TWCC_TWO_BIT_VECTOR_SYMBOLS
+          && idx < twcc_packet->packet_count; i++, idx++) {
+        status[idx] = (chunk >> (2 * (6 - i))) & 0x03;
+      }
+    }
+  }
+
+  /* Receive deltas */
+  for (idx = 0; idx < twcc_packet->packet_count; idx++) {
+    twcc_packet->received[idx] = status[idx] != TWCC_STATUS_NOT_RECEIVED;
+    twcc_packet->deltas[idx] = 0;
+
+    switch (status[idx]) {
+      case TWCC_STATUS_SMALL_DELTA:
+        if (fci + 1 > fci_end) {
+          GST_ERROR ("Inconsistent TWCC packet (deltas)");
+          goto end;
+        }
+        twcc_packet->deltas[idx] = *fci;
+        fci += 1;
+        break;
+      case TWCC_STATUS_LARGE_DELTA:
+        if (fci + 2 > fci_end) {
+          GST_ERROR ("Inconsistent TWCC packet (deltas)");
+          goto end;
+        }
+        twcc_packet->deltas[idx] = (gint16) GST_READ_UINT16_BE (fci);
+        fci += 2;
+        break;
+      default:
+        break;
+    }
+  }
+
+  ret = TRUE;
+
+end:
+  gst_buffer_unmap (fci_buffer, &map);
+
+  return ret;
+}
+
+static guint
+twcc_get_status (KmsRTCPTWCCPacket * twcc_packet, guint idx)
+{
+  gint32 delta;
+
+  if (!twcc_packet->received[idx]) {
+    return TWCC_STATUS_NOT_RECEIVED;
+  }
+
+  delta = twcc_packet->deltas[idx];
+
+  if (delta >= 0 && delta <= G_MAXUINT8) {
+    return TWCC_STATUS_SMALL_DELTA;
+  }
+
+  return TWCC_STATUS_LARGE_DELTA;
+}
+
+gboolean
+kms_rtcp_rtpfb_twcc_marshall_packet (GstRTCPPacket * rtcp_packet,
+    KmsRTCPTWCCPacket * twcc_packet, guint32 sender_ssrc, guint32 media_ssrc)
+{
+  guint n_chunks, deltas_size, size, idx, i;
+  guint8 *fci_data;
+  guint16 len;
+
+  g_return_val_if_fail (twcc_packet->packet_count <= KMS_RTCP_TWCC_MAX_PACKETS,
+      FALSE);
+
+  /* Only 2 bits status vector chunks are generated */
+  n_chunks = (twcc_packet->packet_count + TWCC_TWO_BIT_VECTOR_SYMBOLS - 1) /
+      TWCC_TWO_BIT_VECTOR_SYMBOLS;
+
+  deltas_size = 0;
+  for (idx = 0; idx < twcc_packet->packet_count; idx++) {
+    switch (twcc_get_status (twcc_packet, idx)) {
+      case TWCC_STATUS_SMALL_DELTA:
+        deltas_size += 1;
+        break;
+      case TWCC_STATUS_LARGE_DELTA:
+        if (twcc_packet->deltas[idx] < G_MININT16 ||
+            twcc_packet->deltas[idx] > G_MAXINT16) {
+          GST_ERROR ("TWCC delta out of range");
+          return FALSE;
+        }
+        deltas_size += 2;
+        break;
+      default:
+        break;
+    }
+  }
+
+  size = TWCC_HEADER_SIZE + 2 * n_chunks + deltas_size;
+
+  gst_rtcp_packet_fb_set_type (rtcp_packet, KMS_RTCP_RTPFB_TYPE_TWCC);
+  gst_rtcp_packet_fb_set_sender_ssrc (rtcp_packet, sender_ssrc);
+  gst_rtcp_packet_fb_set_media_ssrc (rtcp_packet, media_ssrc);
+
+  len = gst_rtcp_packet_fb_get_fci_length (rtcp_packet);
+  len += (size + 3) / 4;
+  if (!gst_rtcp_packet_fb_set_fci_length (rtcp_packet, len)) {
+    GST_ERROR ("Cannot increase FCI length (%d)", len);
+    return FALSE;
+  }
+
+  fci_data = gst_rtcp_packet_fb_get_fci (rtcp_packet);
+  memset (fci_data, 0, ((size + 3) / 4) * 4);
+
+  GST_WRITE_UINT16_BE (fci_data, twcc_packet->base_seq);
+  GST_WRITE_UINT16_BE (fci_data + 2, twcc_packet->packet_count);
+  GST_WRITE_UINT32_BE (fci_data + 4,
+      ((guint32) twcc_packet->reference_time << 8) | twcc_packet->fb_pkt_count);
+  fci_data += TWCC_HEADER_SIZE;
+
+  for (idx = 0; idx < twcc_packet->packet_count;) {
+    guint16 chunk = 0xc000;
+
+    for (i = 0; i < TWCC_TWO_BIT_VECTOR_SYMBOLS; i++, idx++) {
+      if (idx < twcc_packet->packet_count) {
+        chunk |= twcc_get_status (twcc_packet, idx) << (2 * (6 - i));
+      }
+    }
+
+    GST_WRITE_UINT16_BE (fci_data, chunk);
+    fci_data += 2;
+  }
+
+  for (idx = 0; idx < twcc_packet->packet_count; idx++) {
+    switch (twcc_get_status (twcc_packet, idx)) {
+      case TWCC_STATUS_SMALL_DELTA:
+        *fci_data = (guint8) twcc_packet->deltas[idx];
+        fci_data += 1;
+        break;
+      case TWCC_STATUS_LARGE_DELTA:
+        GST_WRITE_UINT16_BE (fci_data, (guint16) twcc_packet->deltas[idx]);
+        fci_data += 2;
+        break;
+      default:
+        break;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Transport-wide CC end */
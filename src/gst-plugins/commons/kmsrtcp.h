@@ -80,5 +80,36 @@ gboolean kms_rtcp_psfb_afb_remb_get_packet (KmsRTCPPSFBAFBPacket * afb_packet,
 
 gboolean kms_rtcp_psfb_afb_remb_marshall_packet (GstRTCPPacket *rtcp_packet, KmsRTCPPSFBAFBREMBPacket * remb_packet, guint32 sender_ssrc);
 
+/* Transport-wide congestion control feedback
+ * (draft-holmer-rmcat-transport-wide-cc-extensions) */
+
+#define KMS_RTCP_RTPFB_TYPE_TWCC 15
+
+#define KMS_RTCP_TWCC_MAX_PACKETS 512
+
+/* Units of the fields of the feedback packet */
+#define KMS_RTCP_TWCC_REFERENCE_TIME_UNIT (64 * GST_MSECOND)
+#define KMS_RTCP_TWCC_DELTA_UNIT (250 * GST_USECOND)
+
+typedef struct _KmsRTCPTWCCPacket KmsRTCPTWCCPacket;
+
+struct _KmsRTCPTWCCPacket
+{
+  guint16 base_seq;
+  guint16 packet_count;
+  gint32 reference_time;        /* KMS_RTCP_TWCC_REFERENCE_TIME_UNIT */
+  guint8 fb_pkt_count;
+
+  /* One entry per packet from base_seq */
+  gboolean received[KMS_RTCP_TWCC_MAX_PACKETS];
+  gint32 deltas[KMS_RTCP_TWCC_MAX_PACKETS];     /* KMS_RTCP_TWCC_DELTA_UNIT */
+};
+
+gboolean kms_rtcp_rtpfb_twcc_get_packet (GstBuffer * fci_buffer,
+    KmsRTCPTWCCPacket * twcc_packet);
+
+gboolean kms_rtcp_rtpfb_twcc_marshall_packet (GstRTCPPacket *rtcp_packet,
+    KmsRTCPTWCCPacket * twcc_packet, guint32 sender_ssrc, guint32 media_ssrc);
+
 G_END_DECLS
 #endif /* __KMS_RTCP_H__ */
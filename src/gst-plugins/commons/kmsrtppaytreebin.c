@@ -21,6 +21,7 @@
 
 #include "kmsrtppaytreebin.h"
 #include "kmsutils.h"
+#include "kmsfactorycache.h"
 
 #define GST_DEFAULT_NAME "rtppaytreebin"
 #define GST_CAT_DEFAULT kms_rtp_pay_tree_bin_debug
@@ -34,26 +35,10 @@ G_DEFINE_TYPE (KmsRtpPayTreeBin, kms_rtp_pay_tree_bin, KMS_TYPE_TREE_BIN);
 static GstElement *
 create_payloader_for_caps (const GstCaps * caps)
 {
-  GList *payloader_list, *filtered_list, *l;
-  GstElementFactory *payloader_factory = NULL;
-  GstElement *payloader = NULL;
-
-  payloader_list =
-      gst_element_factory_list_get_elements (GST_ELEMENT_FACTORY_TYPE_PAYLOADER,
-      GST_RANK_NONE);
-  filtered_list =
-      gst_element_factory_list_filter (payloader_list, caps, GST_PAD_SRC,
-      FALSE);
-
-  for (l = filtered_list; l != NULL && payloader_factory == NULL; l = l->next) {
-    payloader_factory = GST_ELEMENT_FACTORY (l->data);
-    if (gst_element_factory_get_num_pad_templates (payloader_factory) != 2)
-      payloader_factory = NULL;
-  }
+  GstElement *payloader;
 
-  if (payloader_factory != NULL) {
-    payloader = gst_element_factory_create (payloader_factory, NULL);
-  }
+  payloader = kms_factory_cache_create (GST_ELEMENT_FACTORY_TYPE_PAYLOADER,
+      NULL, caps);
 
   if (payloader) {
     GParamSpec *pspec;
@@ -75,9 +60,6 @@ create_payloader_for_caps (const GstCaps * caps)
     }
   }
 
-  gst_plugin_feature_list_free (filtered_list);
-  gst_plugin_feature_list_free (payloader_list);
-
   return payloader;
 }
 
@@ -0,0 +1,161 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "kmsscaletreebin.h"
+
+#define GST_DEFAULT_NAME "scaletreebin"
+#define GST_CAT_DEFAULT kms_scale_tree_bin_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+#define kms_scale_tree_bin_parent_class parent_class
+G_DEFINE_TYPE (KmsScaleTreeBin, kms_scale_tree_bin, KMS_TYPE_TREE_BIN);
+
+#define MIN_DIMENSION 16
+
+#define SCALE_DIVISOR "kms-scale-divisor"
+G_DEFINE_QUARK (SCALE_DIVISOR, scale_divisor);
+
+static gint
+scale_dimension (gint value, guint divisor)
+{
+  /* Encoders do not like odd dimensions */
+  return MAX (MIN_DIMENSION, (value / (gint) divisor) & ~1);
+}
+
+/*
+ * Sets the output dimensions before the scaler negotiates, so every input
+ * resolution change is followed without reconfiguring the bin.
+ */
+static GstPadProbeReturn
+input_caps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer capsfilter)
+{
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+  GstCaps *caps, *filter_caps;
+  GstStructure *st;
+  gint width, height;
+  guint divisor;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_event_parse_caps (event, &caps);
+  st = gst_caps_get_structure (caps, 0);
+
+  if (!gst_structure_get_int (st, "width", &width) ||
+      !gst_structure_get_int (st, "height", &height)) {
+    GST_WARNING_OBJECT (pad, "Unknown input dimensions: %" GST_PTR_FORMAT,
+        caps);
+    return GST_PAD_PROBE_OK;
+  }
+
+  divisor = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (capsfilter),
+          scale_divisor_quark ()));
+
+  filter_caps = gst_caps_new_simple ("video/x-raw",
+      "width", G_TYPE_INT, scale_dimension (width, divisor),
+      "height", G_TYPE_INT, scale_dimension (height, divisor), NULL);
+
+  GST_DEBUG_OBJECT (capsfilter, "Scaling %dx%d to %" GST_PTR_FORMAT, width,
+      height, filter_caps);
+
+  g_object_set (capsfilter, "caps", filter_caps, NULL);
+  gst_caps_unref (filter_caps);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+kms_scale_tree_bin_configure (KmsScaleTreeBin * self, guint divisor)
+{
+  KmsTreeBin *tree_bin = KMS_TREE_BIN (self);
+  GstElement *scale, *capsfilter, *output_tee;
+  GstPad *sink;
+
+  scale = gst_element_factory_make ("videoscale", NULL);
+  capsfilter = gst_element_factory_make ("capsfilter", NULL);
+
+  if (scale == NULL || capsfilter == NULL) {
+    GST_WARNING_OBJECT (self, "Cannot create scaler");
+    if (scale != NULL) {
+      gst_object_unref (scale);
+    }
+    if (capsfilter != NULL) {
+      gst_object_unref (capsfilter);
+    }
+    return FALSE;
+  }
+
+  g_object_set_qdata (G_OBJECT (capsfilter), scale_divisor_quark (),
+      GUINT_TO_POINTER (divisor));
+
+  sink = gst_element_get_static_pad (scale, "sink");
+  gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      input_caps_probe, capsfilter, NULL);
+  g_object_unref (sink);
+
+  gst_bin_add_many (GST_BIN (self), scale, capsfilter, NULL);
+  gst_element_sync_state_with_parent (capsfilter);
+  gst_element_sync_state_with_parent (scale);
+
+  kms_tree_bin_set_input_element (tree_bin, scale);
+  output_tee = kms_tree_bin_get_output_tee (tree_bin);
+  gst_element_link_many (scale, capsfilter, output_tee, NULL);
+
+  return TRUE;
+}
+
+KmsScaleTreeBin *
+kms_scale_tree_bin_new (guint divisor)
+{
+  GObject *scale;
+
+  g_return_val_if_fail (divisor > 0, NULL);
+
+  scale = g_object_new (KMS_TYPE_SCALE_TREE_BIN, NULL);
+  if (!kms_scale_tree_bin_configure (KMS_SCALE_TREE_BIN (scale), divisor)) {
+    g_object_unref (scale);
+    return NULL;
+  }
+
+  return KMS_SCALE_TREE_BIN (scale);
+}
+
+static void
+kms_scale_tree_bin_init (KmsScaleTreeBin * self)
+{
+  /* Nothing to do */
+}
+
+static void
+kms_scale_tree_bin_class_init (KmsScaleTreeBinClass * klass)
+{
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_set_details_simple (gstelement_class,
+      "ScaleTreeBin",
+      "Generic",
+      "Bin to scale and distribute RAW video.",
+      "Kurento <kurento@googlegroups.com>");
+
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,57 @@
+/*
+ * (C) Copyright 2014 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_SCALE_TREE_BIN_H__
+#define __KMS_SCALE_TREE_BIN_H__
+
+#include "kmstreebin.h"
+
+G_BEGIN_DECLS
+/* #defines don't like whitespacey bits */
+#define KMS_TYPE_SCALE_TREE_BIN \
+  (kms_scale_tree_bin_get_type())
+#define KMS_SCALE_TREE_BIN(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),KMS_TYPE_SCALE_TREE_BIN,KmsScaleTreeBin))
+#define KMS_SCALE_TREE_BIN_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),KMS_TYPE_SCALE_TREE_BIN,KmsScaleTreeBinClass))
+#define KMS_IS_SCALE_TREE_BIN(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),KMS_TYPE_SCALE_TREE_BIN))
+#define KMS_IS_SCALE_TREE_BIN_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),KMS_TYPE_SCALE_TREE_BIN))
+#define KMS_SCALE_TREE_BIN_CAST(obj) ((KmsScaleTreeBin*)(obj))
+
+typedef struct _KmsScaleTreeBin KmsScaleTreeBin;
+typedef struct _KmsScaleTreeBinClass KmsScaleTreeBinClass;
+
+struct _KmsScaleTreeBin
+{
+  KmsTreeBin parent;
+};
+
+struct _KmsScaleTreeBinClass
+{
+  KmsTreeBinClass parent_class;
+};
+
+GType kms_scale_tree_bin_get_type (void);
+
+/* Raw video is scaled down to 1/@divisor of the input dimensions, whatever
+ * they are */
+KmsScaleTreeBin * kms_scale_tree_bin_new (guint divisor);
+
+G_END_DECLS
+#endif /* __KMS_SCALE_TREE_BIN_H__ */
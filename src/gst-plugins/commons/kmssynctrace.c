@@ -0,0 +1,233 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "kmssynctrace.h"
+
+#define GST_CAT_DEFAULT kmssynctrace
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmssynctrace"
+
+/* Must be a power of two */
+#define RING_SIZE 8192
+#define RING_MASK (RING_SIZE - 1)
+
+#define WRITER_PERIOD (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct _RingSlot
+{
+  gint seq;
+  KmsSyncTraceRecord record;
+} RingSlot;
+
+struct _KmsSyncTrace
+{
+  /* Bounded multi-producer single-consumer ring. Each slot carries a
+   * sequence number telling whether it is free for the producer that
+   * reserved position "seq" or ready for the consumer at "seq - 1". */
+  RingSlot slots[RING_SIZE];
+  gint head;                    /* next position to reserve (producers) */
+  gint tail;                    /* next position to read (writer thread) */
+  gint dropped;
+
+  FILE *file;
+  GThread *writer;
+  GMutex mutex;
+  GCond cond;
+  gboolean stop;
+};
+
+static inline gint
+seq_diff (gint a, gint b)
+{
+  /* Positions wrap around, compare them as unsigned */
+  return (gint) ((guint) a - (guint) b);
+}
+
+gboolean
+kms_sync_trace_push (KmsSyncTrace * trace, const KmsSyncTraceRecord * record)
+{
+  RingSlot *slot;
+  gint pos, seq, diff;
+
+  pos = g_atomic_int_get (&trace->head);
+
+  for (;;) {
+    slot = &trace->slots[pos & RING_MASK];
+    seq = g_atomic_int_get (&slot->seq);
+    diff = seq_diff (seq, pos);
+
+    if (diff == 0) {
+      if (g_atomic_int_compare_and_exchange (&trace->head, pos,
+              (gint) ((guint) pos + 1))) {
+        break;
+      }
+    } else if (diff < 0) {
+      /* Writer is behind, never block the streaming thread */
+      g_atomic_int_inc (&trace->dropped);
+      return FALSE;
+    }
+
+    pos = g_atomic_int_get (&trace->head);
+  }
+
+  slot->record = *record;
+  g_atomic_int_set (&slot->seq, (gint) ((guint) pos + 1));
+
+  return TRUE;
+}
+
+/* Only called from the writer thread */
+static void
+kms_sync_trace_drain (KmsSyncTrace * trace)
+{
+  gint pos = trace->tail;
+
+  for (;;) {
+    RingSlot *slot = &trace->slots[pos & RING_MASK];
+    gint seq = g_atomic_int_get (&slot->seq);
+
+    if (seq_diff (seq, (gint) ((guint) pos + 1)) < 0) {
+      /* Empty */
+      break;
+    }
+
+    if (fwrite (&slot->record, sizeof (KmsSyncTraceRecord), 1,
+            trace->file) != 1) {
+      GST_WARNING ("Cannot write sync trace record");
+    }
+
+    g_atomic_int_set (&slot->seq, (gint) ((guint) pos + RING_SIZE));
+    pos = (gint) ((guint) pos + 1);
+  }
+
+  trace->tail = pos;
+}
+
+static gpointer
+kms_sync_trace_writer (gpointer data)
+{
+  KmsSyncTrace *trace = data;
+  gboolean stop;
+
+  do {
+    gint64 end_time;
+
+    kms_sync_trace_drain (trace);
+    fflush (trace->file);
+
+    end_time = g_get_monotonic_time () + WRITER_PERIOD;
+
+    g_mutex_lock (&trace->mutex);
+    while (!trace->stop) {
+      if (!g_cond_wait_until (&trace->cond, &trace->mutex, end_time)) {
+        break;
+      }
+    }
+    stop = trace->stop;
+    g_mutex_unlock (&trace->mutex);
+  } while (!stop);
+
+  kms_sync_trace_drain (trace);
+
+  return NULL;
+}
+
+KmsSyncTrace *
+kms_sync_trace_new (const gchar * file_name)
+{
+  KmsSyncTraceHeader header;
+  KmsSyncTrace *trace;
+  FILE *file;
+  guint i;
+
+  file = g_fopen (file_name, "wb");
+  if (file == NULL) {
+    GST_ERROR ("Sync trace file %s cannot be created", file_name);
+    return NULL;
+  }
+
+  memset (&header, 0, sizeof (header));
+  strncpy (header.magic, KMS_SYNC_TRACE_MAGIC, sizeof (header.magic));
+  header.version = KMS_SYNC_TRACE_VERSION;
+  header.record_size = sizeof (KmsSyncTraceRecord);
+
+  if (fwrite (&header, sizeof (header), 1, file) != 1) {
+    GST_ERROR ("Cannot write sync trace header to %s", file_name);
+    fclose (file);
+    return NULL;
+  }
+
+  trace = g_new0 (KmsSyncTrace, 1);
+  for (i = 0; i < RING_SIZE; i++) {
+    trace->slots[i].seq = i;
+  }
+
+  trace->file = file;
+  g_mutex_init (&trace->mutex);
+  g_cond_init (&trace->cond);
+  trace->writer =
+      g_thread_new ("kms-sync-trace", kms_sync_trace_writer, trace);
+
+  return trace;
+}
+
+void
+kms_sync_trace_destroy (KmsSyncTrace * trace)
+{
+  if (trace == NULL) {
+    return;
+  }
+
+  g_mutex_lock (&trace->mutex);
+  trace->stop = TRUE;
+  g_cond_signal (&trace->cond);
+  g_mutex_unlock (&trace->mutex);
+
+  g_thread_join (trace->writer);
+
+  if (trace->dropped > 0) {
+    GST_WARNING ("%d sync trace records were dropped", trace->dropped);
+  }
+
+  fclose (trace->file);
+  g_mutex_clear (&trace->mutex);
+  g_cond_clear (&trace->cond);
+
+  g_free (trace);
+}
+
+guint
+kms_sync_trace_get_dropped (KmsSyncTrace * trace)
+{
+  return g_atomic_int_get (&trace->dropped);
+}
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
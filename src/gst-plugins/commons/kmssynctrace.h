@@ -0,0 +1,71 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_SYNC_TRACE_H__
+#define __KMS_SYNC_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Binary A/V sync trace.
+ *
+ * File layout: one KmsSyncTraceHeader followed by a sequence of fixed-size
+ * KmsSyncTraceRecord, both in host byte order, so the file can be mapped
+ * and indexed directly.
+ */
+
+#define KMS_SYNC_TRACE_MAGIC "KMSSYNC"
+#define KMS_SYNC_TRACE_VERSION 1
+
+typedef struct _KmsSyncTraceHeader KmsSyncTraceHeader;
+typedef struct _KmsSyncTraceRecord KmsSyncTraceRecord;
+
+struct _KmsSyncTraceHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 record_size;
+};
+
+struct _KmsSyncTraceRecord
+{
+  guint32 ssrc;
+  guint32 clock_rate;
+  guint64 pts;
+  guint64 dts;
+  guint64 ext_ts;
+  guint64 sr_ntp_ns_time;
+  guint64 sr_ext_ts;
+};
+
+typedef struct _KmsSyncTrace KmsSyncTrace;
+
+KmsSyncTrace * kms_sync_trace_new (const gchar *file_name);
+void kms_sync_trace_destroy (KmsSyncTrace *trace);
+
+/* Lock-free, can be called from several streaming threads. Returns FALSE
+ * and drops the record if the ring is full. */
+gboolean kms_sync_trace_push (KmsSyncTrace *trace,
+    const KmsSyncTraceRecord *record);
+
+guint kms_sync_trace_get_dropped (KmsSyncTrace *trace);
+
+G_END_DECLS
+
+#endif /* __KMS_SYNC_TRACE_H__ */
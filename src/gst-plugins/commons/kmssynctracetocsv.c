@@ -0,0 +1,103 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/* Converts a binary sync trace generated by KmsBaseRtpEndpoint into the
+ * CSV format used by the former per-buffer stats files. */
+
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <string.h>
+
+#include "kmssynctrace.h"
+
+int
+main (int argc, char **argv)
+{
+  const KmsSyncTraceHeader *header;
+  const KmsSyncTraceRecord *records;
+  GMappedFile *mapped;
+  GError *err = NULL;
+  const gchar *data;
+  gsize len, n_records, i;
+  FILE *out = stdout;
+  int ret = 0;
+
+  if (argc < 2 || argc > 3) {
+    g_printerr ("Usage: %s <trace file> [<csv file>]\n", argv[0]);
+    return 1;
+  }
+
+  mapped = g_mapped_file_new (argv[1], FALSE, &err);
+  if (mapped == NULL) {
+    g_printerr ("Cannot open %s: %s\n", argv[1], err->message);
+    g_error_free (err);
+    return 1;
+  }
+
+  data = g_mapped_file_get_contents (mapped);
+  len = g_mapped_file_get_length (mapped);
+  header = (const KmsSyncTraceHeader *) data;
+
+  if (len < sizeof (KmsSyncTraceHeader)
+      || strncmp (header->magic, KMS_SYNC_TRACE_MAGIC,
+          sizeof (header->magic)) != 0) {
+    g_printerr ("%s is not a sync trace file\n", argv[1]);
+    ret = 1;
+    goto end;
+  }
+
+  if (header->version != KMS_SYNC_TRACE_VERSION
+      || header->record_size != sizeof (KmsSyncTraceRecord)) {
+    g_printerr ("Unsupported sync trace version %u (record size %u)\n",
+        header->version, header->record_size);
+    ret = 1;
+    goto end;
+  }
+
+  if (argc == 3) {
+    out = fopen (argv[2], "w");
+    if (out == NULL) {
+      g_printerr ("Cannot create %s\n", argv[2]);
+      ret = 1;
+      goto end;
+    }
+  }
+
+  records = (const KmsSyncTraceRecord *) (data + sizeof (KmsSyncTraceHeader));
+  n_records = (len - sizeof (KmsSyncTraceHeader)) / sizeof (KmsSyncTraceRecord);
+
+  g_fprintf (out, "SSRC,CLOCK_RATE,PTS,DTS,RTP,NTP_SR,RTP_SR\n");
+
+  for (i = 0; i < n_records; i++) {
+    const KmsSyncTraceRecord *r = &records[i];
+
+    g_fprintf (out,
+        "%" G_GUINT32_FORMAT ",%" G_GUINT32_FORMAT ",%" G_GUINT64_FORMAT
+        ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT
+        ",%" G_GUINT64_FORMAT "\n", r->ssrc, r->clock_rate, r->pts, r->dts,
+        r->ext_ts, r->sr_ntp_ns_time, r->sr_ext_ts);
+  }
+
+  if (out != stdout) {
+    fclose (out);
+  }
+
+end:
+  g_mapped_file_unref (mapped);
+
+  return ret;
+}
@@ -0,0 +1,471 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "kmstranscoderregistry.h"
+#include "kmsrefstruct.h"
+#include "kmsexecutor.h"
+
+#define GST_CAT_DEFAULT kms_transcoder_registry_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmstranscoderregistry"
+
+#define TRANSCODER_REGISTRY "kms-transcoder-registry"
+G_DEFINE_QUARK (TRANSCODER_REGISTRY, transcoder_registry);
+
+static GMutex registry_mutex;
+
+struct _KmsTranscoderRegistry
+{
+  KmsRefStruct ref;
+
+  GMutex mutex;
+  guint last_stream;
+  GHashTable *streams;          /* id -> StreamSamples */
+  GHashTable *memories;         /* root GstMemory -> stream id */
+  GList *encoders;              /* EncoderEntry */
+
+  KmsExecutorQueue *release_queue;
+};
+
+typedef struct _StreamSamples
+{
+  guint id;
+  GQueue samples;               /* Referenced root GstMemory */
+} StreamSamples;
+
+typedef struct _Subscriber
+{
+  GstPad *pad;
+  KmsTranscoderReleasedFunc func;
+} Subscriber;
+
+typedef struct _EncoderEntry
+{
+  guint stream;
+  GstCaps *caps;
+  gchar *bitrate_class;
+  GstElement *tee;
+  GSList *subscribers;
+} EncoderEntry;
+
+static void
+subscriber_destroy (Subscriber * sub)
+{
+  g_object_unref (sub->pad);
+  g_slice_free (Subscriber, sub);
+}
+
+static void
+encoder_entry_destroy (EncoderEntry * entry)
+{
+  g_slist_free_full (entry->subscribers, (GDestroyNotify) subscriber_destroy);
+  gst_caps_unref (entry->caps);
+  g_free (entry->bitrate_class);
+  g_object_unref (entry->tee);
+  g_slice_free (EncoderEntry, entry);
+}
+
+static void
+release_subscriber (Subscriber * sub)
+{
+  GST_DEBUG_OBJECT (sub->pad, "Shared encoder released");
+  sub->func (sub->pad);
+}
+
+static void
+stream_samples_destroy (StreamSamples * samples)
+{
+  g_queue_foreach (&samples->samples, (GFunc) gst_memory_unref, NULL);
+  g_queue_clear (&samples->samples);
+  g_slice_free (StreamSamples, samples);
+}
+
+static void
+kms_transcoder_registry_destroy (KmsTranscoderRegistry * reg)
+{
+  kms_executor_queue_free (reg->release_queue);
+
+  g_list_free_full (reg->encoders, (GDestroyNotify) encoder_entry_destroy);
+  g_hash_table_unref (reg->memories);
+  g_hash_table_unref (reg->streams);
+  g_mutex_clear (&reg->mutex);
+
+  g_slice_free (KmsTranscoderRegistry, reg);
+}
+
+static KmsTranscoderRegistry *
+kms_transcoder_registry_new (void)
+{
+  KmsTranscoderRegistry *reg = g_slice_new0 (KmsTranscoderRegistry);
+
+  kms_ref_struct_init (KMS_REF_STRUCT_CAST (reg),
+      (GDestroyNotify) kms_transcoder_registry_destroy);
+
+  g_mutex_init (&reg->mutex);
+  reg->streams = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) stream_samples_destroy);
+  reg->memories = g_hash_table_new (NULL, NULL);
+  reg->release_queue = kms_executor_queue_new ();
+
+  return reg;
+}
+
+KmsTranscoderRegistry *
+kms_transcoder_registry_ref (KmsTranscoderRegistry * reg)
+{
+  return (KmsTranscoderRegistry *)
+      kms_ref_struct_ref (KMS_REF_STRUCT_CAST (reg));
+}
+
+void
+kms_transcoder_registry_unref (KmsTranscoderRegistry * reg)
+{
+  kms_ref_struct_unref (KMS_REF_STRUCT_CAST (reg));
+}
+
+KmsTranscoderRegistry *
+kms_transcoder_registry_get (GstElement * element)
+{
+  KmsTranscoderRegistry *reg;
+  GstObject *top, *parent;
+
+  top = gst_object_ref (element);
+  while ((parent = gst_object_get_parent (top)) != NULL) {
+    gst_object_unref (top);
+    top = parent;
+  }
+
+  if (!GST_IS_PIPELINE (top)) {
+    gst_object_unref (top);
+    return NULL;
+  }
+
+  g_mutex_lock (&registry_mutex);
+  reg = g_object_get_qdata (G_OBJECT (top), transcoder_registry_quark ());
+  if (reg == NULL) {
+    reg = kms_transcoder_registry_new ();
+    g_object_set_qdata_full (G_OBJECT (top), transcoder_registry_quark (),
+        reg, (GDestroyNotify) kms_transcoder_registry_unref);
+    GST_DEBUG_OBJECT (top, "Transcoder registry created");
+  }
+  kms_transcoder_registry_ref (reg);
+  g_mutex_unlock (&registry_mutex);
+
+  gst_object_unref (top);
+
+  return reg;
+}
+
+/* Streams begin */
+
+static GstMemory *
+get_root_memory (GstMemory * mem)
+{
+  while (mem->parent != NULL) {
+    mem = mem->parent;
+  }
+
+  return mem;
+}
+
+static void
+stream_samples_drop_oldest (KmsTranscoderRegistry * reg,
+    StreamSamples * samples)
+{
+  GstMemory *mem = g_queue_pop_head (&samples->samples);
+
+  if (GPOINTER_TO_UINT (g_hash_table_lookup (reg->memories, mem)) ==
+      samples->id) {
+    g_hash_table_remove (reg->memories, mem);
+  }
+
+  gst_memory_unref (mem);
+}
+
+guint
+kms_transcoder_registry_new_stream (KmsTranscoderRegistry * reg)
+{
+  StreamSamples *samples = g_slice_new0 (StreamSamples);
+
+  g_queue_init (&samples->samples);
+
+  g_mutex_lock (&reg->mutex);
+  samples->id = ++reg->last_stream;
+  g_hash_table_insert (reg->streams, GUINT_TO_POINTER (samples->id), samples);
+  g_mutex_unlock (&reg->mutex);
+
+  return samples->id;
+}
+
+void
+kms_transcoder_registry_remove_stream (KmsTranscoderRegistry * reg,
+    guint stream)
+{
+  StreamSamples *samples;
+
+  g_mutex_lock (&reg->mutex);
+  samples = g_hash_table_lookup (reg->streams, GUINT_TO_POINTER (stream));
+  if (samples != NULL) {
+    while (!g_queue_is_empty (&samples->samples)) {
+      stream_samples_drop_oldest (reg, samples);
+    }
+    g_hash_table_remove (reg->streams, GUINT_TO_POINTER (stream));
+  }
+  g_mutex_unlock (&reg->mutex);
+}
+
+guint
+kms_transcoder_registry_lookup (KmsTranscoderRegistry * reg, guint stream,
+    GstBuffer * buffer)
+{
+  GstMemory *mem;
+  guint found;
+
+  if (gst_buffer_n_memory (buffer) == 0) {
+    return stream;
+  }
+
+  mem = get_root_memory (gst_buffer_peek_memory (buffer, 0));
+
+  /* Sampled memory is referenced, so its address cannot be reused */
+  g_mutex_lock (&reg->mutex);
+  found = GPOINTER_TO_UINT (g_hash_table_lookup (reg->memories, mem));
+  g_mutex_unlock (&reg->mutex);
+
+  return found != 0 ? found : stream;
+}
+
+void
+kms_transcoder_registry_sample (KmsTranscoderRegistry * reg, guint stream,
+    GstBuffer * buffer)
+{
+  StreamSamples *samples;
+  GstMemory *mem;
+
+  if (gst_buffer_n_memory (buffer) == 0) {
+    return;
+  }
+
+  mem = get_root_memory (gst_buffer_peek_memory (buffer, 0));
+
+  g_mutex_lock (&reg->mutex);
+
+  samples = g_hash_table_lookup (reg->streams, GUINT_TO_POINTER (stream));
+  if (samples != NULL && !g_hash_table_contains (reg->memories, mem)) {
+    if (g_queue_get_length (&samples->samples) >=
+        KMS_TRANSCODER_REGISTRY_MAX_SAMPLES) {
+      stream_samples_drop_oldest (reg, samples);
+    }
+
+    g_queue_push_tail (&samples->samples, gst_memory_ref (mem));
+    g_hash_table_insert (reg->memories, mem, GUINT_TO_POINTER (stream));
+  }
+
+  g_mutex_unlock (&reg->mutex);
+}
+
+/* Streams end */
+
+/* Encoders begin */
+
+static gboolean
+encoder_entry_matches (EncoderEntry * entry, guint stream,
+    const GstCaps * caps, const gchar * bitrate_class, GstElement * owner)
+{
+  if (entry->stream != stream
+      || g_strcmp0 (entry->bitrate_class, bitrate_class) != 0) {
+    return FALSE;
+  }
+
+  if (owner != NULL && gst_object_has_ancestor (GST_OBJECT (entry->tee),
+          GST_OBJECT (owner))) {
+    return FALSE;
+  }
+
+  return gst_caps_can_intersect (caps, entry->caps);
+}
+
+static EncoderEntry *
+kms_transcoder_registry_find (KmsTranscoderRegistry * reg, guint stream,
+    const GstCaps * caps, const gchar * bitrate_class, GstElement * owner)
+{
+  GList *l;
+
+  for (l = reg->encoders; l != NULL; l = l->next) {
+    if (encoder_entry_matches (l->data, stream, caps, bitrate_class, owner)) {
+      return l->data;
+    }
+  }
+
+  return NULL;
+}
+
+void
+kms_transcoder_registry_publish (KmsTranscoderRegistry * reg, guint stream,
+    const GstCaps * caps, const gchar * bitrate_class, GstElement * tee)
+{
+  EncoderEntry *entry = g_slice_new0 (EncoderEntry);
+
+  entry->stream = stream;
+  entry->caps = gst_caps_copy (caps);
+  entry->bitrate_class = g_strdup (bitrate_class);
+  entry->tee = g_object_ref (tee);
+
+  GST_DEBUG_OBJECT (tee, "Published for stream %u, class %s: %" GST_PTR_FORMAT,
+      stream, bitrate_class, caps);
+
+  g_mutex_lock (&reg->mutex);
+  reg->encoders = g_list_prepend (reg->encoders, entry);
+  g_mutex_unlock (&reg->mutex);
+}
+
+void
+kms_transcoder_registry_withdraw (KmsTranscoderRegistry * reg,
+    GstElement * tee)
+{
+  GList *l, *next;
+
+  g_mutex_lock (&reg->mutex);
+
+  for (l = reg->encoders; l != NULL; l = next) {
+    EncoderEntry *entry = l->data;
+    GSList *s;
+
+    next = l->next;
+
+    if (entry->tee != tee) {
+      continue;
+    }
+
+    GST_DEBUG_OBJECT (tee, "Withdrawn from stream %u", entry->stream);
+
+    /* Subscribers are notified without holding any lock */
+    for (s = entry->subscribers; s != NULL; s = s->next) {
+      kms_executor_queue_push (reg->release_queue,
+          (KmsExecutorFunc) release_subscriber, s->data,
+          (GDestroyNotify) subscriber_destroy);
+    }
+    g_slist_free (entry->subscribers);
+    entry->subscribers = NULL;
+
+    reg->encoders = g_list_delete_link (reg->encoders, l);
+    encoder_entry_destroy (entry);
+  }
+
+  g_mutex_unlock (&reg->mutex);
+}
+
+gboolean
+kms_transcoder_registry_contains (KmsTranscoderRegistry * reg, guint stream,
+    const GstCaps * caps, const gchar * bitrate_class, GstElement * owner)
+{
+  gboolean ret;
+
+  g_mutex_lock (&reg->mutex);
+  ret = kms_transcoder_registry_find (reg, stream, caps, bitrate_class,
+      owner) != NULL;
+  g_mutex_unlock (&reg->mutex);
+
+  return ret;
+}
+
+GstElement *
+kms_transcoder_registry_subscribe (KmsTranscoderRegistry * reg, guint stream,
+    const GstCaps * caps, const gchar * bitrate_class, GstElement * owner,
+    GstPad * pad, KmsTranscoderReleasedFunc func)
+{
+  EncoderEntry *entry;
+  GstElement *tee = NULL;
+
+  g_mutex_lock (&reg->mutex);
+
+  entry = kms_transcoder_registry_find (reg, stream, caps, bitrate_class,
+      owner);
+  if (entry != NULL) {
+    Subscriber *sub = g_slice_new0 (Subscriber);
+
+    sub->pad = g_object_ref (pad);
+    sub->func = func;
+    entry->subscribers = g_slist_prepend (entry->subscribers, sub);
+    tee = g_object_ref (entry->tee);
+  }
+
+  g_mutex_unlock (&reg->mutex);
+
+  return tee;
+}
+
+void
+kms_transcoder_registry_unsubscribe (KmsTranscoderRegistry * reg,
+    GstPad * pad)
+{
+  GList *l;
+
+  g_mutex_lock (&reg->mutex);
+
+  for (l = reg->encoders; l != NULL; l = l->next) {
+    EncoderEntry *entry = l->data;
+    GSList *s;
+
+    for (s = entry->subscribers; s != NULL; s = s->next) {
+      Subscriber *sub = s->data;
+
+      if (sub->pad == pad) {
+        entry->subscribers = g_slist_delete_link (entry->subscribers, s);
+        subscriber_destroy (sub);
+        break;
+      }
+    }
+  }
+
+  g_mutex_unlock (&reg->mutex);
+}
+
+gboolean
+kms_transcoder_registry_has_subscribers (KmsTranscoderRegistry * reg,
+    GstElement * tee)
+{
+  gboolean ret = FALSE;
+  GList *l;
+
+  g_mutex_lock (&reg->mutex);
+
+  for (l = reg->encoders; l != NULL && !ret; l = l->next) {
+    EncoderEntry *entry = l->data;
+
+    ret = entry->tee == tee && entry->subscribers != NULL;
+  }
+
+  g_mutex_unlock (&reg->mutex);
+
+  return ret;
+}
+
+/* Encoders end */
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,88 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_TRANSCODER_REGISTRY_H__
+#define __KMS_TRANSCODER_REGISTRY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Pipeline scoped registry of encoder output tees, so that elements whose
+ * input is the same stream can share their transcoders.
+ *
+ * Two inputs are considered the same stream when they carry the very same
+ * memory: forwarding elements (passthrough, hub ports) pass buffers as they
+ * are, while anything modifying the media produces new memory.
+ */
+typedef struct _KmsTranscoderRegistry KmsTranscoderRegistry;
+
+/* Called from an internal thread when the encoder used by @pad is gone */
+typedef void (*KmsTranscoderReleasedFunc) (GstPad * pad);
+
+/* Returns the registry of the pipeline containing @element, NULL if it is
+ * not in a pipeline yet */
+KmsTranscoderRegistry * kms_transcoder_registry_get (GstElement * element);
+KmsTranscoderRegistry * kms_transcoder_registry_ref (KmsTranscoderRegistry * reg);
+void kms_transcoder_registry_unref (KmsTranscoderRegistry * reg);
+
+/* Streams */
+guint kms_transcoder_registry_new_stream (KmsTranscoderRegistry * reg);
+void kms_transcoder_registry_remove_stream (KmsTranscoderRegistry * reg,
+    guint stream);
+
+/*
+ * Streams sample one every KMS_TRANSCODER_REGISTRY_SAMPLE_INTERVAL buffers.
+ * A stream looking for the one it comes from only needs to look up the
+ * KMS_TRANSCODER_REGISTRY_LOOKUP_BUFFERS buffers following a caps change.
+ */
+#define KMS_TRANSCODER_REGISTRY_SAMPLE_INTERVAL 8
+#define KMS_TRANSCODER_REGISTRY_MAX_SAMPLES 4
+#define KMS_TRANSCODER_REGISTRY_LOOKUP_BUFFERS \
+  (KMS_TRANSCODER_REGISTRY_SAMPLE_INTERVAL * \
+   KMS_TRANSCODER_REGISTRY_MAX_SAMPLES)
+
+/* Returns the stream that already carried the memory of @buffer, or @stream
+ * if it has not been sampled by any other */
+guint kms_transcoder_registry_lookup (KmsTranscoderRegistry * reg,
+    guint stream, GstBuffer * buffer);
+void kms_transcoder_registry_sample (KmsTranscoderRegistry * reg,
+    guint stream, GstBuffer * buffer);
+
+/* Encoders */
+void kms_transcoder_registry_publish (KmsTranscoderRegistry * reg,
+    guint stream, const GstCaps * caps, const gchar * bitrate_class,
+    GstElement * tee);
+void kms_transcoder_registry_withdraw (KmsTranscoderRegistry * reg,
+    GstElement * tee);
+gboolean kms_transcoder_registry_contains (KmsTranscoderRegistry * reg,
+    guint stream, const GstCaps * caps, const gchar * bitrate_class,
+    GstElement * exclude);
+
+/* Returns a new reference to an encoder tee, excluding those published by
+ * @owner. @func is called with @pad when the encoder is withdrawn */
+GstElement * kms_transcoder_registry_subscribe (KmsTranscoderRegistry * reg,
+    guint stream, const GstCaps * caps, const gchar * bitrate_class,
+    GstElement * owner, GstPad * pad, KmsTranscoderReleasedFunc func);
+void kms_transcoder_registry_unsubscribe (KmsTranscoderRegistry * reg,
+    GstPad * pad);
+gboolean kms_transcoder_registry_has_subscribers (KmsTranscoderRegistry * reg,
+    GstElement * tee);
+
+G_END_DECLS
+#endif /* __KMS_TRANSCODER_REGISTRY_H__ */
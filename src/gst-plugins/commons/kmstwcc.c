@@ -0,0 +1,742 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmstwcc.h"
+
+#define GST_CAT_DEFAULT kms_twcc_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+#define GST_DEFAULT_NAME "kmstwcc"
+
+/* KmsTwccRecorder begin */
+
+/* Must be a power of 2 */
+#define TWCC_RECORDER_SIZE 1024
+
+typedef struct _TwccArrival
+{
+  guint64 ext_seq;
+  GstClockTime arrival_time;
+} TwccArrival;
+
+struct _KmsTwccRecorder
+{
+  GMutex mutex;
+
+  gboolean has_seq;
+  guint64 max_seq;              /* Extended highest sequence number received */
+  guint64 next_seq;             /* Extended first sequence number to report */
+  guint8 fb_pkt_count;
+
+  TwccArrival arrivals[TWCC_RECORDER_SIZE];
+};
+
+static guint64
+twcc_unwrap_seq (guint64 last_ext_seq, guint16 seq)
+{
+  gint16 diff = (gint16) (seq - (guint16) last_ext_seq);
+
+  return last_ext_seq + diff;
+}
+
+KmsTwccRecorder *
+kms_twcc_recorder_new (void)
+{
+  KmsTwccRecorder *rec = g_slice_new0 (KmsTwccRecorder);
+
+  g_mutex_init (&rec->mutex);
+
+  return rec;
+}
+
+void
+kms_twcc_recorder_destroy (KmsTwccRecorder * rec)
+{
+  if (rec == NULL) {
+    return;
+  }
+
+  g_mutex_clear (&rec->mutex);
+  g_slice_free (KmsTwccRecorder, rec);
+}
+
+void
+kms_twcc_recorder_add (KmsTwccRecorder * rec, guint16 seq,
+    GstClockTime arrival_time)
+{
+  TwccArrival *arrival;
+  guint64 ext_seq;
+
+  g_mutex_lock (&rec->mutex);
+
+  if (!rec->has_seq) {
+    /* Start at the second cycle so that older packets can be unwrapped */
+    ext_seq = (guint64) seq + G_MAXUINT16 + 1;
+    rec->max_seq = rec->next_seq = ext_seq;
+    rec->has_seq = TRUE;
+  } else {
+    ext_seq = twcc_unwrap_seq (rec->max_seq, seq);
+  }
+
+  if (ext_seq < rec->next_seq) {
+    GST_TRACE ("Packet %u already reported", seq);
+    goto end;
+  }
+
+  if (ext_seq > rec->max_seq) {
+    rec->max_seq = ext_seq;
+  }
+
+  if (rec->max_seq - rec->next_seq >= TWCC_RECORDER_SIZE) {
+    /* Too many packets pending, the oldest ones will never be reported */
+    rec->next_seq = rec->max_seq - TWCC_RECORDER_SIZE + 1;
+  }
+
+  arrival = &rec->arrivals[ext_seq & (TWCC_RECORDER_SIZE - 1)];
+  arrival->ext_seq = ext_seq;
+  arrival->arrival_time = arrival_time;
+
+end:
+  g_mutex_unlock (&rec->mutex);
+}
+
+static TwccArrival *
+twcc_recorder_get_arrival (KmsTwccRecorder * rec, guint64 ext_seq)
+{
+  TwccArrival *arrival = &rec->arrivals[ext_seq & (TWCC_RECORDER_SIZE - 1)];
+
+  if (arrival->ext_seq != ext_seq) {
+    return NULL;
+  }
+
+  return arrival;
+}
+
+gboolean
+kms_twcc_recorder_build_feedback (KmsTwccRecorder * rec,
+    KmsRTCPTWCCPacket * twcc_packet, guint max_packets)
+{
+  TwccArrival *arrival = NULL;
+  GstClockTime reference, prev;
+  guint64 ext_seq;
+  guint count = 0;
+
+  max_packets = MIN (max_packets, KMS_RTCP_TWCC_MAX_PACKETS);
+
+  g_mutex_lock (&rec->mutex);
+
+  if (!rec->has_seq || rec->next_seq > rec->max_seq) {
+    goto end;
+  }
+
+  /* Packets lost before the first received one are reported as lost */
+  for (ext_seq = rec->next_seq; ext_seq <= rec->max_seq; ext_seq++) {
+    arrival = twcc_recorder_get_arrival (rec, ext_seq);
+    if (arrival != NULL) {
+      break;
+    }
+  }
+
+  if (arrival == NULL) {
+    rec->next_seq = rec->max_seq + 1;
+    goto end;
+  }
+
+  reference = arrival->arrival_time / KMS_RTCP_TWCC_REFERENCE_TIME_UNIT;
+  prev = reference * KMS_RTCP_TWCC_REFERENCE_TIME_UNIT;
+
+  for (ext_seq = rec->next_seq;
+      ext_seq <= rec->max_seq && count < max_packets; ext_seq++, count++) {
+    gint64 delta;
+
+    arrival = twcc_recorder_get_arrival (rec, ext_seq);
+    if (arrival == NULL) {
+      twcc_packet->received[count] = FALSE;
+      twcc_packet->deltas[count] = 0;
+      continue;
+    }
+
+    /* Reordered packets have negative deltas */
+    delta = GST_CLOCK_DIFF (prev, arrival->arrival_time);
+    delta /= (gint64) KMS_RTCP_TWCC_DELTA_UNIT;
+
+    if (delta < G_MININT16 || delta > G_MAXINT16) {
+      /* It will be the first one of the next feedback */
+      break;
+    }
+
+    twcc_packet->received[count] = TRUE;
+    twcc_packet->deltas[count] = delta;
+    prev += delta * (gint64) KMS_RTCP_TWCC_DELTA_UNIT;
+  }
+
+  twcc_packet->base_seq = (guint16) rec->next_seq;
+  twcc_packet->packet_count = count;
+  twcc_packet->reference_time = reference & 0xffffff;
+  twcc_packet->fb_pkt_count = rec->fb_pkt_count++;
+
+  rec->next_seq += count;
+
+end:
+  g_mutex_unlock (&rec->mutex);
+
+  return count > 0;
+}
+
+/* KmsTwccRecorder end */
+
+/* KmsTwccEstimator begin */
+
+/* Must be a power of 2 */
+#define TWCC_HISTORY_SIZE 4096
+
+/* Packets sent within this interval belong to the same group */
+#define TWCC_BURST_TIME (5 * GST_MSECOND)
+
+#define TWCC_TRENDLINE_SMOOTHING 0.9
+#define TWCC_TRENDLINE_WINDOW 20
+#define TWCC_TRENDLINE_GAIN 4.0
+#define TWCC_TRENDLINE_MAX_DELTAS 60
+
+#define TWCC_THRESHOLD_INITIAL 12.5     /* ms */
+#define TWCC_THRESHOLD_MIN 6.0  /* ms */
+#define TWCC_THRESHOLD_MAX 600.0        /* ms */
+#define TWCC_THRESHOLD_K_UP 0.0087
+#define TWCC_THRESHOLD_K_DOWN 0.039
+#define TWCC_THRESHOLD_MAX_UPDATE_OFFSET 15.0   /* ms */
+#define TWCC_OVERUSE_TIME 10.0  /* ms */
+
+#define TWCC_DECREASE_FACTOR 0.85
+#define TWCC_DECREASE_INTERVAL (200 * GST_MSECOND)
+#define TWCC_MULTIPLICATIVE_INCREASE 0.08       /* per second */
+#define TWCC_ADDITIVE_INCREASE 24000    /* bps per second */
+#define TWCC_MAX_ACKED_FACTOR 1.5
+#define TWCC_ACKED_SMOOTHING 0.8
+
+#define TWCC_LOSS_HIGH 0.10
+#define TWCC_LOSS_LOW 0.02
+
+typedef enum
+{
+  TWCC_USAGE_NORMAL,
+  TWCC_USAGE_OVERUSE,
+  TWCC_USAGE_UNDERUSE
+} TwccUsage;
+
+typedef struct _TwccSentPacket
+{
+  guint16 seq;
+  guint size;
+  GstClockTime send_time;       /* GST_CLOCK_TIME_NONE if unused */
+} TwccSentPacket;
+
+typedef struct _TwccGroup
+{
+  gboolean valid;
+  GstClockTime first_send_time;
+  GstClockTime last_send_time;
+  gint64 last_arrival_time;
+} TwccGroup;
+
+struct _KmsTwccEstimator
+{
+  GMutex mutex;
+
+  TwccSentPacket history[TWCC_HISTORY_SIZE];
+
+  /* Feedback unwrapping */
+  gboolean has_reference;
+  gint64 ext_reference_time;
+
+  /* Inter-arrival */
+  TwccGroup current;
+  TwccGroup prev;
+
+  /* Trendline filter */
+  guint num_deltas;
+  gdouble first_arrival_ms;
+  gdouble acc_delay;
+  gdouble smoothed_delay;
+  gdouble window_x[TWCC_TRENDLINE_WINDOW];
+  gdouble window_y[TWCC_TRENDLINE_WINDOW];
+  guint window_len;
+  guint window_pos;
+  gdouble trend;
+  gdouble prev_trend;
+
+  /* Overuse detector */
+  gdouble threshold;
+  gdouble last_threshold_update_ms;
+  gdouble time_over_using;
+  guint overuse_counter;
+  TwccUsage usage;
+
+  /* Rate control */
+  guint min_bitrate;
+  guint max_bitrate;
+  gdouble target_bitrate;
+  gdouble acked_bitrate;
+  guint64 acked_bytes;          /* Since last update */
+  gint64 acked_first_arrival;
+  gint64 acked_last_arrival;
+  gdouble bitrate_at_decrease;
+  gboolean near_max;
+  GstClockTime last_update;
+  GstClockTime last_decrease;
+};
+
+KmsTwccEstimator *
+kms_twcc_estimator_new (guint start_bitrate, guint min_bitrate,
+    guint max_bitrate)
+{
+  KmsTwccEstimator *est = g_slice_new0 (KmsTwccEstimator);
+  guint i;
+
+  g_mutex_init (&est->mutex);
+
+  for (i = 0; i < TWCC_HISTORY_SIZE; i++) {
+    est->history[i].send_time = GST_CLOCK_TIME_NONE;
+  }
+
+  est->first_arrival_ms = -1;
+  est->threshold = TWCC_THRESHOLD_INITIAL;
+  est->last_threshold_update_ms = -1;
+  est->time_over_using = -1;
+  est->usage = TWCC_USAGE_NORMAL;
+
+  est->min_bitrate = min_bitrate;
+  est->max_bitrate = MAX (min_bitrate, max_bitrate);
+  est->target_bitrate = CLAMP (start_bitrate, est->min_bitrate,
+      est->max_bitrate);
+  est->acked_first_arrival = -1;
+  est->acked_last_arrival = -1;
+  est->last_update = GST_CLOCK_TIME_NONE;
+  est->last_decrease = GST_CLOCK_TIME_NONE;
+
+  return est;
+}
+
+void
+kms_twcc_estimator_destroy (KmsTwccEstimator * est)
+{
+  if (est == NULL) {
+    return;
+  }
+
+  g_mutex_clear (&est->mutex);
+  g_slice_free (KmsTwccEstimator, est);
+}
+
+void
+kms_twcc_estimator_packet_sent (KmsTwccEstimator * est, guint16 seq,
+    guint size, GstClockTime send_time)
+{
+  TwccSentPacket *packet = &est->history[seq & (TWCC_HISTORY_SIZE - 1)];
+
+  g_mutex_lock (&est->mutex);
+  packet->seq = seq;
+  packet->size = size;
+  packet->send_time = send_time;
+  g_mutex_unlock (&est->mutex);
+}
+
+static gdouble
+twcc_trendline_slope (KmsTwccEstimator * est)
+{
+  gdouble sum_x = 0, sum_y = 0, avg_x, avg_y, num = 0, den = 0;
+  guint i;
+
+  for (i = 0; i < est->window_len; i++) {
+    sum_x += est->window_x[i];
+    sum_y += est->window_y[i];
+  }
+
+  avg_x = sum_x / est->window_len;
+  avg_y = sum_y / est->window_len;
+
+  for (i = 0; i < est->window_len; i++) {
+    gdouble x = est->window_x[i] - avg_x;
+
+    num += x * (est->window_y[i] - avg_y);
+    den += x * x;
+  }
+
+  if (den == 0) {
+    return est->trend;
+  }
+
+  return num / den;
+}
+
+static void
+twcc_update_threshold (KmsTwccEstimator * est, gdouble modified_trend,
+    gdouble now_ms)
+{
+  gdouble abs_trend = ABS (modified_trend);
+  gdouble k, elapsed;
+
+  if (est->last_threshold_update_ms < 0) {
+    est->last_threshold_update_ms = now_ms;
+  }
+
+  if (abs_trend > est->threshold + TWCC_THRESHOLD_MAX_UPDATE_OFFSET) {
+    /* Do not adapt to big latency spikes caused by sudden capacity drops */
+    est->last_threshold_update_ms = now_ms;
+    return;
+  }
+
+  k = abs_trend < est->threshold ? TWCC_THRESHOLD_K_DOWN : TWCC_THRESHOLD_K_UP;
+  elapsed = MIN (now_ms - est->last_threshold_update_ms, 100.0);
+
+  est->threshold += k * (abs_trend - est->threshold) * elapsed;
+  est->threshold = CLAMP (est->threshold, TWCC_THRESHOLD_MIN,
+      TWCC_THRESHOLD_MAX);
+  est->last_threshold_update_ms = now_ms;
+}
+
+static void
+twcc_detect (KmsTwccEstimator * est, gdouble send_delta_ms, gdouble now_ms)
+{
+  gdouble modified_trend;
+
+  if (est->num_deltas < 2) {
+    return;
+  }
+
+  modified_trend = MIN (est->num_deltas, TWCC_TRENDLINE_MAX_DELTAS) *
+      est->trend * TWCC_TRENDLINE_GAIN;
+
+  if (modified_trend > est->threshold) {
+    if (est->time_over_using < 0) {
+      est->time_over_using = send_delta_ms / 2;
+    } else {
+      est->time_over_using += send_delta_ms;
+    }
+
+    est->overuse_counter++;
+
+    if (est->time_over_using > TWCC_OVERUSE_TIME && est->overuse_counter > 1
+        && est->trend >= est->prev_trend) {
+      est->time_over_using = 0;
+      est->overuse_counter = 0;
+      est->usage = TWCC_USAGE_OVERUSE;
+    }
+  } else if (modified_trend < -est->threshold) {
+    est->time_over_using = -1;
+    est->overuse_counter = 0;
+    est->usage = TWCC_USAGE_UNDERUSE;
+  } else {
+    est->time_over_using = -1;
+    est->overuse_counter = 0;
+    est->usage = TWCC_USAGE_NORMAL;
+  }
+
+  est->prev_trend = est->trend;
+  twcc_update_threshold (est, modified_trend, now_ms);
+}
+
+static void
+twcc_update_trendline (KmsTwccEstimator * est, gdouble send_delta_ms,
+    gdouble arrival_delta_ms, gdouble arrival_ms)
+{
+  if (est->first_arrival_ms < 0) {
+    est->first_arrival_ms = arrival_ms;
+  }
+
+  est->num_deltas = MIN (est->num_deltas + 1, 1000);
+  est->acc_delay += arrival_delta_ms - send_delta_ms;
+  est->smoothed_delay = TWCC_TRENDLINE_SMOOTHING * est->smoothed_delay +
+      (1 - TWCC_TRENDLINE_SMOOTHING) * est->acc_delay;
+
+  est->window_x[est->window_pos] = arrival_ms - est->first_arrival_ms;
+  est->window_y[est->window_pos] = est->smoothed_delay;
+  est->window_pos = (est->window_pos + 1) % TWCC_TRENDLINE_WINDOW;
+  est->window_len = MIN (est->window_len + 1, TWCC_TRENDLINE_WINDOW);
+
+  if (est->window_len == TWCC_TRENDLINE_WINDOW) {
+    est->trend = twcc_trendline_slope (est);
+  }
+
+  twcc_detect (est, send_delta_ms, arrival_ms);
+}
+
+static void
+twcc_group_start (TwccGroup * group, GstClockTime send_time,
+    gint64 arrival_time)
+{
+  group->valid = TRUE;
+  group->first_send_time = send_time;
+  group->last_send_time = send_time;
+  group->last_arrival_time = arrival_time;
+}
+
+static void
+twcc_process_packet (KmsTwccEstimator * est, GstClockTime send_time,
+    gint64 arrival_time)
+{
+  TwccGroup *cur = &est->current;
+
+  if (!cur->valid) {
+    twcc_group_start (cur, send_time, arrival_time);
+    return;
+  }
+
+  if (send_time < cur->first_send_time) {
+    /* Reordered at the sender, not useful for the delay gradient */
+    return;
+  }
+
+  if (send_time - cur->first_send_time <= TWCC_BURST_TIME) {
+    cur->last_send_time = MAX (cur->last_send_time, send_time);
+    cur->last_arrival_time = MAX (cur->last_arrival_time, arrival_time);
+    return;
+  }
+
+  if (est->prev.valid) {
+    gdouble send_delta_ms, arrival_delta_ms;
+
+    send_delta_ms = (gdouble) GST_CLOCK_DIFF (est->prev.last_send_time,
+        cur->last_send_time) / GST_MSECOND;
+    arrival_delta_ms = (gdouble) (cur->last_arrival_time -
+        est->prev.last_arrival_time) / GST_MSECOND;
+
+    twcc_update_trendline (est, send_delta_ms, arrival_delta_ms,
+        (gdouble) cur->last_arrival_time / GST_MSECOND);
+  }
+
+  est->prev = *cur;
+  twcc_group_start (cur, send_time, arrival_time);
+}
+
+static void
+twcc_update_rate (KmsTwccEstimator * est, gdouble loss, GstClockTime now)
+{
+  gboolean can_decrease;
+  gdouble elapsed;
+
+  can_decrease = !GST_CLOCK_TIME_IS_VALID (est->last_decrease) ||
+      now - est->last_decrease >= TWCC_DECREASE_INTERVAL;
+
+  if (GST_CLOCK_TIME_IS_VALID (est->last_update)) {
+    elapsed = (gdouble) MIN (now - est->last_update, GST_SECOND) / GST_SECOND;
+  } else {
+    elapsed = 0;
+  }
+  est->last_update = now;
+
+  if (est->near_max && est->acked_bitrate > est->bitrate_at_decrease * 1.1) {
+    /* Available bandwidth has grown since the last decrease */
+    est->near_max = FALSE;
+  }
+
+  switch (est->usage) {
+    case TWCC_USAGE_OVERUSE:
+      if (can_decrease) {
+        gdouble base;
+
+        base = est->acked_bitrate > 0 ? est->acked_bitrate :
+            est->target_bitrate;
+        est->target_bitrate = MIN (est->target_bitrate,
+            TWCC_DECREASE_FACTOR * base);
+        est->bitrate_at_decrease = base;
+        est->near_max = TRUE;
+        est->last_decrease = now;
+        can_decrease = FALSE;
+      }
+      break;
+    case TWCC_USAGE_UNDERUSE:
+      /* Queues are draining, hold */
+      break;
+    case TWCC_USAGE_NORMAL:
+      if (loss >= TWCC_LOSS_LOW) {
+        break;
+      }
+
+      if (est->near_max) {
+        est->target_bitrate += TWCC_ADDITIVE_INCREASE * elapsed;
+      } else {
+        est->target_bitrate *= 1 + TWCC_MULTIPLICATIVE_INCREASE * elapsed;
+      }
+      break;
+  }
+
+  if (loss > TWCC_LOSS_HIGH && can_decrease) {
+    est->target_bitrate *= 1 - 0.5 * loss;
+    est->last_decrease = now;
+  }
+
+  if (est->acked_bitrate > 0) {
+    /* Do not go far beyond what is actually being delivered */
+    est->target_bitrate = MIN (est->target_bitrate,
+        TWCC_MAX_ACKED_FACTOR * est->acked_bitrate + 10000);
+  }
+
+  est->target_bitrate = CLAMP (est->target_bitrate, est->min_bitrate,
+      est->max_bitrate);
+}
+
+static void
+twcc_packet_arrived (KmsTwccEstimator * est, GstClockTime send_time,
+    gint64 arrival_time, guint size)
+{
+  est->acked_bytes += size;
+  if (est->acked_first_arrival < 0) {
+    est->acked_first_arrival = arrival_time;
+  }
+  est->acked_last_arrival = MAX (est->acked_last_arrival, arrival_time);
+
+  twcc_process_packet (est, send_time, arrival_time);
+}
+
+static void
+twcc_update (KmsTwccEstimator * est, gdouble loss, GstClockTime now)
+{
+  if (est->acked_last_arrival > est->acked_first_arrival) {
+    gdouble sample = (gdouble) est->acked_bytes * 8 * GST_SECOND /
+        (est->acked_last_arrival - est->acked_first_arrival);
+
+    if (est->acked_bitrate == 0) {
+      est->acked_bitrate = sample;
+    } else {
+      est->acked_bitrate = TWCC_ACKED_SMOOTHING * est->acked_bitrate +
+          (1 - TWCC_ACKED_SMOOTHING) * sample;
+    }
+  }
+
+  est->acked_bytes = 0;
+  est->acked_first_arrival = -1;
+  est->acked_last_arrival = -1;
+
+  twcc_update_rate (est, loss, now);
+
+  GST_TRACE ("Loss %f, trend %f, threshold %f, usage %d, acked %f, target %f",
+      loss, est->trend, est->threshold, est->usage, est->acked_bitrate,
+      est->target_bitrate);
+}
+
+gboolean
+kms_twcc_estimator_on_feedback (KmsTwccEstimator * est,
+    const KmsRTCPTWCCPacket * twcc_packet, GstClockTime now,
+    guint * target_bitrate)
+{
+  gint64 arrival_time;
+  guint received = 0, lost = 0, idx;
+
+  g_mutex_lock (&est->mutex);
+
+  if (!est->has_reference) {
+    est->ext_reference_time = twcc_packet->reference_time;
+    est->has_reference = TRUE;
+  } else {
+    gint32 diff;
+
+    /* Sign extend the 24 bits difference */
+    diff = (twcc_packet->reference_time - est->ext_reference_time) & 0xffffff;
+    diff = ((gint32) ((guint32) diff << 8)) >> 8;
+    est->ext_reference_time += diff;
+  }
+
+  arrival_time = est->ext_reference_time * KMS_RTCP_TWCC_REFERENCE_TIME_UNIT;
+
+  for (idx = 0; idx < twcc_packet->packet_count; idx++) {
+    TwccSentPacket *sent;
+    guint16 seq = twcc_packet->base_seq + idx;
+
+    if (!twcc_packet->received[idx]) {
+      lost++;
+      continue;
+    }
+
+    received++;
+    arrival_time += twcc_packet->deltas[idx] * KMS_RTCP_TWCC_DELTA_UNIT;
+
+    sent = &est->history[seq & (TWCC_HISTORY_SIZE - 1)];
+    if (sent->seq != seq || !GST_CLOCK_TIME_IS_VALID (sent->send_time)) {
+      continue;
+    }
+
+    twcc_packet_arrived (est, sent->send_time, arrival_time, sent->size);
+  }
+
+  if (received == 0 && lost == 0) {
+    g_mutex_unlock (&est->mutex);
+    return FALSE;
+  }
+
+  GST_TRACE ("Feedback %u: received %u, lost %u", twcc_packet->fb_pkt_count,
+      received, lost);
+  twcc_update (est, (gdouble) lost / (lost + received), now);
+
+  if (target_bitrate != NULL) {
+    *target_bitrate = est->target_bitrate;
+  }
+
+  g_mutex_unlock (&est->mutex);
+
+  return TRUE;
+}
+
+void
+kms_twcc_estimator_packet_arrived (KmsTwccEstimator * est,
+    GstClockTime send_time, gint64 arrival_time, guint size)
+{
+  g_mutex_lock (&est->mutex);
+  twcc_packet_arrived (est, send_time, arrival_time, size);
+  g_mutex_unlock (&est->mutex);
+}
+
+gboolean
+kms_twcc_estimator_update (KmsTwccEstimator * est, gdouble loss,
+    GstClockTime now, guint * target_bitrate)
+{
+  gboolean ret;
+
+  g_mutex_lock (&est->mutex);
+
+  ret = est->acked_bytes > 0;
+  twcc_update (est, loss, now);
+
+  if (target_bitrate != NULL) {
+    *target_bitrate = est->target_bitrate;
+  }
+
+  g_mutex_unlock (&est->mutex);
+
+  return ret;
+}
+
+guint
+kms_twcc_estimator_get_target_bitrate (KmsTwccEstimator * est)
+{
+  guint ret;
+
+  g_mutex_lock (&est->mutex);
+  ret = est->target_bitrate;
+  g_mutex_unlock (&est->mutex);
+
+  return ret;
+}
+
+/* KmsTwccEstimator end */
+
+static void init_debug (void) __attribute__ ((constructor));
+
+static void
+init_debug (void)
+{
+  GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, GST_DEFAULT_NAME, 0,
+      GST_DEFAULT_NAME);
+}
@@ -0,0 +1,84 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef __KMS_TWCC_H__
+#define __KMS_TWCC_H__
+
+#include <gst/gst.h>
+#include "kmsrtcp.h"
+
+G_BEGIN_DECLS
+
+/* KmsTwccRecorder begin */
+
+/*
+ * Receiver side: stores the arrival time of every packet carrying a
+ * transport-wide sequence number until it is reported in a feedback packet.
+ */
+typedef struct _KmsTwccRecorder KmsTwccRecorder;
+
+KmsTwccRecorder * kms_twcc_recorder_new (void);
+void kms_twcc_recorder_destroy (KmsTwccRecorder * rec);
+
+void kms_twcc_recorder_add (KmsTwccRecorder * rec, guint16 seq,
+    GstClockTime arrival_time);
+
+/* Fills @twcc_packet with at most @max_packets pending packets. Returns FALSE
+ * if there is nothing to report */
+gboolean kms_twcc_recorder_build_feedback (KmsTwccRecorder * rec,
+    KmsRTCPTWCCPacket * twcc_packet, guint max_packets);
+
+/* KmsTwccRecorder end */
+
+/* KmsTwccEstimator begin */
+
+/*
+ * Sender side: keeps the send history of the packets stamped with a
+ * transport-wide sequence number and runs a delay-gradient (trendline)
+ * estimator plus a loss based limit over the received feedback.
+ */
+typedef struct _KmsTwccEstimator KmsTwccEstimator;
+
+KmsTwccEstimator * kms_twcc_estimator_new (guint start_bitrate,
+    guint min_bitrate, guint max_bitrate);
+void kms_twcc_estimator_destroy (KmsTwccEstimator * est);
+
+void kms_twcc_estimator_packet_sent (KmsTwccEstimator * est, guint16 seq,
+    guint size, GstClockTime send_time);
+
+/* Returns TRUE and sets @target_bitrate (bps) when the feedback could be
+ * processed. @now is the time when the feedback was received */
+gboolean kms_twcc_estimator_on_feedback (KmsTwccEstimator * est,
+    const KmsRTCPTWCCPacket * twcc_packet, GstClockTime now,
+    guint * target_bitrate);
+
+/* Feeds a packet whose send and arrival times are already known (e.g. from
+ * the abs-send-time extension) instead of using the send history */
+void kms_twcc_estimator_packet_arrived (KmsTwccEstimator * est,
+    GstClockTime send_time, gint64 arrival_time, guint size);
+
+/* Runs the rate control over the packets arrived since the last update.
+ * Returns FALSE if there were no packets */
+gboolean kms_twcc_estimator_update (KmsTwccEstimator * est, gdouble loss,
+    GstClockTime now, guint * target_bitrate);
+
+guint kms_twcc_estimator_get_target_bitrate (KmsTwccEstimator * est);
+
+/* KmsTwccEstimator end */
+
+G_END_DECLS
+#endif /* __KMS_TWCC_H__ */
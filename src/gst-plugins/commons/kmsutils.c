@@ -26,9 +26,6 @@
 GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 #define GST_DEFAULT_NAME "kmsutils"
 
-#define LAST_KEY_FRAME_REQUEST_TIME "last-key-frame-request-time"
-G_DEFINE_QUARK (LAST_KEY_FRAME_REQUEST_TIME, last_key_frame_request_time);
-
 #define KMS_KEY_ID "kms-key-id"
 G_DEFINE_QUARK (KMS_KEY_ID, kms_key_id);
 
@@ -368,60 +365,337 @@ kms_utils_manage_gaps (GstPad * pad)
       gap_detection_probe, NULL, NULL);
 }
 
-static gboolean
-check_last_request_time (GstPad * pad)
+/* Key frame request coalescer begin */
+
+#define KEY_FRAME_REQUEST_COALESCER "kms-key-frame-request-coalescer"
+G_DEFINE_QUARK (KEY_FRAME_REQUEST_COALESCER, key_frame_request_coalescer);
+
+#define KEY_FRAME_COALESCED_FIELD "kms-coalesced"
+
+#define MIN_KEYFRAME_DISPERSION (250 * GST_MSECOND)
+#define MAX_KEYFRAME_DISPERSION (4 * GST_SECOND)
+#define KEYFRAME_REFERENCE_COST 10      /* keyframe size / delta frame size */
+#define KEYFRAME_REQUEST_TIMEOUT GST_SECOND
+#define KEYFRAME_NATURAL_MARGIN (200 * GST_MSECOND)
+#define KEYFRAME_AVG_WEIGHT 8
+
+struct _KeyFrameCoalescer
 {
-  GstClockTime *last, now;
-  GstClock *clock;
-  GstElement *element = gst_pad_get_parent_element (pad);
-  gboolean ret = FALSE;
+  GMutex mutex;
+
+  /* Key frames can be observed in the stream */
+  gboolean tracking;
+
+  gboolean pending;             /* A forwarded request is being served */
+  gboolean deferred;            /* A request waits for the dispersion */
+  GstClockTime last_forward;
+  GstClockTime last_keyframe;
+  GstClockTime deferred_until;
+
+  GstClockTime gop;             /* Average interval of natural keyframes */
+  guint64 keyframe_size;        /* Average sizes */
+  guint64 delta_size;
+
+  guint64 requested;
+  guint64 forwarded;
+  guint64 suppressed;
+};
+
+KeyFrameCoalescer *
+kms_utils_key_frame_coalescer_new (void)
+{
+  KeyFrameCoalescer *c = g_slice_new0 (KeyFrameCoalescer);
+
+  g_mutex_init (&c->mutex);
+  c->last_forward = GST_CLOCK_TIME_NONE;
+  c->last_keyframe = GST_CLOCK_TIME_NONE;
+  c->gop = GST_CLOCK_TIME_NONE;
+
+  return c;
+}
 
-  if (element == NULL) {
-    GST_ERROR_OBJECT (pad, "Cannot get parent object to get clock");
-    return TRUE;
+void
+kms_utils_key_frame_coalescer_destroy (KeyFrameCoalescer * c)
+{
+  g_mutex_clear (&c->mutex);
+  g_slice_free (KeyFrameCoalescer, c);
+}
+
+void
+kms_utils_key_frame_coalescer_reset (KeyFrameCoalescer * c, gboolean tracking)
+{
+  g_mutex_lock (&c->mutex);
+  c->tracking = tracking;
+  c->pending = FALSE;
+  c->deferred = FALSE;
+  c->last_keyframe = GST_CLOCK_TIME_NONE;
+  c->gop = GST_CLOCK_TIME_NONE;
+  c->keyframe_size = 0;
+  c->delta_size = 0;
+  g_mutex_unlock (&c->mutex);
+}
+
+static GstClockTime
+key_frame_coalescer_get_dispersion (KeyFrameCoalescer * c)
+{
+  GstClockTime dispersion = DEFAULT_KEYFRAME_DISPERSION;
+
+  if (!c->tracking) {
+    return dispersion;
   }
 
-  clock = gst_element_get_clock (element);
-  now = gst_clock_get_time (clock);
-  g_object_unref (clock);
-  g_object_unref (element);
+  /* The more expensive a keyframe is, the less often it is requested */
+  if (c->keyframe_size > 0 && c->delta_size > 0) {
+    dispersion = gst_util_uint64_scale (dispersion, c->keyframe_size,
+        c->delta_size * KEYFRAME_REFERENCE_COST);
+    dispersion = CLAMP (dispersion, MIN_KEYFRAME_DISPERSION,
+        MAX_KEYFRAME_DISPERSION);
+  }
 
-  GST_OBJECT_LOCK (pad);
+  /* Never wait longer than the encoder would do by itself */
+  if (GST_CLOCK_TIME_IS_VALID (c->gop)) {
+    dispersion = MIN (dispersion, c->gop);
+  }
+
+  return dispersion;
+}
+
+gboolean
+kms_utils_key_frame_coalescer_request (KeyFrameCoalescer * c,
+    GstClockTime now)
+{
+  GstClockTime dispersion, deadline;
+  gboolean forward = FALSE;
 
-  last =
-      g_object_get_qdata (G_OBJECT (pad), last_key_frame_request_time_quark ());
+  g_mutex_lock (&c->mutex);
+  c->requested++;
+  dispersion = key_frame_coalescer_get_dispersion (c);
 
-  if (last == NULL) {
-    last = g_slice_new (GstClockTime);
-    g_object_set_qdata_full (G_OBJECT (pad),
-        last_key_frame_request_time_quark (), last,
-        (GDestroyNotify) kms_utils_destroy_GstClockTime);
+  if (!c->tracking) {
+    forward = !GST_CLOCK_TIME_IS_VALID (c->last_forward) ||
+        now >= c->last_forward + dispersion;
+    goto end;
+  }
 
-    *last = now;
-    ret = TRUE;
-  } else if (((*last) + DEFAULT_KEYFRAME_DISPERSION) < now) {
-    ret = TRUE;
-    *last = now;
+  if (c->pending && now < c->last_forward + KEYFRAME_REQUEST_TIMEOUT) {
+    /* Merged, the requested keyframe will serve this one too */
+    goto end;
   }
 
-  GST_OBJECT_UNLOCK (pad);
+  if (c->deferred) {
+    goto end;
+  }
 
-  return ret;
+  c->pending = FALSE;
+
+  if (GST_CLOCK_TIME_IS_VALID (c->last_keyframe)) {
+    deadline = c->last_keyframe + dispersion;
+
+    if (GST_CLOCK_TIME_IS_VALID (c->gop) && c->last_keyframe + c->gop > now
+        && c->last_keyframe + c->gop <= now + dispersion) {
+      /* A natural keyframe is coming soon, give it some margin */
+      deadline = MAX (deadline,
+          c->last_keyframe + c->gop + KEYFRAME_NATURAL_MARGIN);
+    }
+
+    if (now < deadline) {
+      c->deferred = TRUE;
+      c->deferred_until = deadline;
+      goto end;
+    }
+  }
+
+  forward = TRUE;
+  c->pending = TRUE;
+
+end:
+  if (forward) {
+    c->forwarded++;
+    c->last_forward = now;
+  } else {
+    c->suppressed++;
+  }
+
+  g_mutex_unlock (&c->mutex);
+
+  return forward;
+}
+
+gboolean
+kms_utils_key_frame_coalescer_frame (KeyFrameCoalescer * c,
+    gboolean keyframe, gsize size, GstClockTime now)
+{
+  gboolean flush = FALSE;
+
+  g_mutex_lock (&c->mutex);
+
+  if (!c->tracking) {
+    goto end;
+  }
+
+  if (keyframe) {
+    if (!c->pending && GST_CLOCK_TIME_IS_VALID (c->last_keyframe)) {
+      GstClockTime interval = now - c->last_keyframe;
+
+      /* Only keyframes not requested by us give the GOP size */
+      if (GST_CLOCK_TIME_IS_VALID (c->gop)) {
+        c->gop = (c->gop * (KEYFRAME_AVG_WEIGHT - 1) + interval) /
+            KEYFRAME_AVG_WEIGHT;
+      } else {
+        c->gop = interval;
+      }
+    }
+
+    if (c->keyframe_size == 0) {
+      c->keyframe_size = size;
+    } else {
+      c->keyframe_size = (c->keyframe_size * (KEYFRAME_AVG_WEIGHT - 1) +
+          size) / KEYFRAME_AVG_WEIGHT;
+    }
+
+    c->last_keyframe = now;
+    c->pending = FALSE;
+    c->deferred = FALSE;
+    goto end;
+  }
+
+  if (c->delta_size == 0) {
+    c->delta_size = size;
+  } else {
+    c->delta_size = (c->delta_size * (KEYFRAME_AVG_WEIGHT - 1) + size) /
+        KEYFRAME_AVG_WEIGHT;
+  }
+
+  if (c->deferred && now >= c->deferred_until) {
+    c->deferred = FALSE;
+    c->pending = TRUE;
+    c->last_forward = now;
+    c->forwarded++;
+    flush = TRUE;
+  }
+
+end:
+  g_mutex_unlock (&c->mutex);
+
+  return flush;
+}
+
+GstStructure *
+kms_utils_key_frame_coalescer_get_stats (KeyFrameCoalescer * c)
+{
+  GstStructure *stats;
+
+  g_mutex_lock (&c->mutex);
+  stats = gst_structure_new ("key-frame-requests",
+      "requested", G_TYPE_UINT64, c->requested,
+      "forwarded", G_TYPE_UINT64, c->forwarded,
+      "suppressed", G_TYPE_UINT64, c->suppressed,
+      "dispersion", G_TYPE_UINT64, key_frame_coalescer_get_dispersion (c),
+      "gop", G_TYPE_UINT64, GST_CLOCK_TIME_IS_VALID (c->gop) ? c->gop : 0,
+      NULL);
+  g_mutex_unlock (&c->mutex);
+
+  return stats;
+}
+
+static void
+key_frame_coalescer_send_request (GstPad * pad)
+{
+  GstEvent *event;
+
+  event = gst_video_event_new_upstream_force_key_unit (GST_CLOCK_TIME_NONE,
+      TRUE, 0);
+  gst_structure_set (gst_event_writable_structure (event),
+      KEY_FRAME_COALESCED_FIELD, G_TYPE_BOOLEAN, TRUE, NULL);
+
+  GST_DEBUG_OBJECT (pad, "Sending deferred keyframe request");
+
+  if (GST_PAD_DIRECTION (pad) == GST_PAD_SRC) {
+    gst_pad_send_event (pad, event);
+  } else {
+    gst_pad_push_event (pad, event);
+  }
 }
 
 static GstPadProbeReturn
 control_duplicates (GstPad * pad, GstPadProbeInfo * info, gpointer data)
 {
+  KeyFrameCoalescer *c = data;
   GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
 
-  if (gst_video_event_is_force_key_unit (event)) {
-    if (check_last_request_time (pad)) {
-      GST_TRACE_OBJECT (pad, "Sending keyframe request");
-      return GST_PAD_PROBE_OK;
-    } else {
-      GST_TRACE_OBJECT (pad, "Dropping keyframe request");
-      return GST_PAD_PROBE_DROP;
+  if (!gst_video_event_is_force_key_unit (event)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (gst_structure_has_field (gst_event_get_structure (event),
+          KEY_FRAME_COALESCED_FIELD)) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (kms_utils_key_frame_coalescer_request (c, kms_utils_get_time_nsecs ())) {
+    GST_TRACE_OBJECT (pad, "Sending keyframe request");
+    return GST_PAD_PROBE_OK;
+  } else {
+    GST_TRACE_OBJECT (pad, "Dropping keyframe request");
+    return GST_PAD_PROBE_DROP;
+  }
+}
+
+static gboolean
+key_frame_coalescer_observe_buffer (GstBuffer ** buffer, guint idx,
+    gpointer data)
+{
+  gpointer *args = data;
+
+  if (kms_utils_key_frame_coalescer_frame (args[0],
+          !GST_BUFFER_FLAG_IS_SET (*buffer, GST_BUFFER_FLAG_DELTA_UNIT),
+          gst_buffer_get_size (*buffer), *(GstClockTime *) args[1])) {
+    args[2] = GINT_TO_POINTER (TRUE);
+  }
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+observe_key_frames (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  KeyFrameCoalescer *c = data;
+  GstClockTime now;
+  gpointer args[3];
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      /* Keyframes are only known for encoded, depayloaded media */
+      kms_utils_key_frame_coalescer_reset (c, !is_raw_caps (caps)
+          && !kms_utils_caps_are_rtp (caps));
     }
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  /* One clock read for the whole list */
+  now = kms_utils_get_time_nsecs ();
+  args[0] = c;
+  args[1] = &now;
+  args[2] = GINT_TO_POINTER (FALSE);
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    key_frame_coalescer_observe_buffer (&buffer, 0, args);
+  } else if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    gst_buffer_list_foreach (list, key_frame_coalescer_observe_buffer, args);
+  }
+
+  if (GPOINTER_TO_INT (args[2])) {
+    key_frame_coalescer_send_request (pad);
   }
 
   return GST_PAD_PROBE_OK;
@@ -430,10 +704,45 @@ control_duplicates (GstPad * pad, GstPadProbeInfo * info, gpointer data)
 void
 kms_utils_control_key_frames_request_duplicates (GstPad * pad)
 {
+  KeyFrameCoalescer *c;
+
+  GST_OBJECT_LOCK (pad);
+  c = g_object_get_qdata (G_OBJECT (pad),
+      key_frame_request_coalescer_quark ());
+  if (c != NULL) {
+    GST_OBJECT_UNLOCK (pad);
+    GST_DEBUG_OBJECT (pad, "Already controlling keyframe requests");
+    return;
+  }
+
+  c = kms_utils_key_frame_coalescer_new ();
+  g_object_set_qdata_full (G_OBJECT (pad),
+      key_frame_request_coalescer_quark (), c,
+      (GDestroyNotify) kms_utils_key_frame_coalescer_destroy);
+  GST_OBJECT_UNLOCK (pad);
+
   gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, control_duplicates,
-      NULL, NULL);
+      c, NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_BUFFER_LIST | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      observe_key_frames, c, NULL);
+}
+
+GstStructure *
+kms_utils_get_key_frames_request_stats (GstPad * pad)
+{
+  KeyFrameCoalescer *c;
+
+  c = g_object_get_qdata (G_OBJECT (pad), key_frame_request_coalescer_quark ());
+  if (c == NULL) {
+    return NULL;
+  }
+
+  return kms_utils_key_frame_coalescer_get_stats (c);
 }
 
+/* Key frame request coalescer end */
+
 static gboolean
 kms_element_iterate_pads (GstIterator * it, KmsPadCallback action,
     gpointer data)
@@ -489,6 +798,119 @@ kms_element_for_each_sink_pad (GstElement * element,
   return ret;
 }
 
+/* Linking across bins begin */
+
+static GstObject *
+kms_utils_common_ancestor (GstObject * a, GstObject * b)
+{
+  GstObject *ancestor = gst_object_get_parent (a);
+
+  while (ancestor != NULL && !gst_object_has_ancestor (b, ancestor)) {
+    GstObject *next = gst_object_get_parent (ancestor);
+
+    gst_object_unref (ancestor);
+    ancestor = next;
+  }
+
+  return ancestor;
+}
+
+/* Returns a new reference to the pad exposing @pad in the bin whose parent
+ * is @ancestor, ghosting it once per level */
+static GstPad *
+kms_utils_ghost_up_to (GstPad * pad, GstObject * ancestor, GSList ** ghosts)
+{
+  GstObject *element = gst_object_get_parent (GST_OBJECT (pad));
+
+  gst_object_ref (pad);
+
+  while (element != NULL) {
+    GstObject *bin = gst_object_get_parent (element);
+    GstPad *ghost;
+
+    gst_object_unref (element);
+
+    if (bin == NULL || bin == ancestor) {
+      g_clear_object (&bin);
+      break;
+    }
+
+    ghost = gst_ghost_pad_new (NULL, pad);
+    gst_pad_set_active (ghost, TRUE);
+    gst_element_add_pad (GST_ELEMENT (bin), ghost);
+    *ghosts = g_slist_prepend (*ghosts, gst_object_ref (ghost));
+
+    gst_object_unref (pad);
+    pad = gst_object_ref (ghost);
+    element = bin;
+  }
+
+  return pad;
+}
+
+gboolean
+kms_utils_link_pads_ghosting (GstPad * src, GstPad * sink, GSList ** ghosts)
+{
+  GstObject *src_element, *sink_element, *ancestor = NULL;
+  GstPad *outer_src = NULL, *outer_sink = NULL;
+  GstPadLinkReturn ret = GST_PAD_LINK_WRONG_HIERARCHY;
+
+  *ghosts = NULL;
+
+  src_element = gst_object_get_parent (GST_OBJECT (src));
+  sink_element = gst_object_get_parent (GST_OBJECT (sink));
+
+  if (src_element != NULL && sink_element != NULL) {
+    ancestor = kms_utils_common_ancestor (src_element, sink_element);
+  }
+
+  if (ancestor != NULL) {
+    outer_src = kms_utils_ghost_up_to (src, ancestor, ghosts);
+    outer_sink = kms_utils_ghost_up_to (sink, ancestor, ghosts);
+    ret = gst_pad_link_full (outer_src, outer_sink,
+        GST_PAD_LINK_CHECK_HIERARCHY);
+    gst_object_unref (outer_src);
+    gst_object_unref (outer_sink);
+    gst_object_unref (ancestor);
+  }
+
+  g_clear_object (&src_element);
+  g_clear_object (&sink_element);
+
+  if (GST_PAD_LINK_FAILED (ret)) {
+    GST_ERROR ("Linking %" GST_PTR_FORMAT " with %" GST_PTR_FORMAT
+        " result %d", src, sink, ret);
+    kms_utils_remove_ghost_pads (*ghosts);
+    *ghosts = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+kms_utils_remove_ghost_pad (GstPad * ghost)
+{
+  GstElement *parent = gst_pad_get_parent_element (ghost);
+
+  gst_ghost_pad_set_target (GST_GHOST_PAD (ghost), NULL);
+
+  if (parent != NULL) {
+    gst_element_remove_pad (parent, ghost);
+    g_object_unref (parent);
+  }
+
+  g_object_unref (ghost);
+}
+
+void
+kms_utils_remove_ghost_pads (GSList * ghosts)
+{
+  g_slist_free_full (ghosts, (GDestroyNotify) kms_utils_remove_ghost_pad);
+}
+
+/* Linking across bins end */
+
 typedef struct _PadBlockedData
 {
   KmsPadCallback callback;
@@ -676,28 +1098,40 @@ struct _RembEventManager
   GHashTable *remb_hash;
   GstPad *pad;
   gulong probe_id;
-  GstClockTime oldest_remb_time;
   GstClockTime clear_interval;
 
+  /* Entries indexed by bitrate (min-heap) and by last update (expiry queue,
+   * oldest first). Updates always use the current time so the expiry order
+   * is the update order */
+  GPtrArray *heap;
+  GQueue expiry;
+
   /* Callback */
   RembBitrateUpdatedCallback callback;
   gpointer user_data;
   GDestroyNotify user_data_destroy;
+  gfloat notify_threshold;
+  guint notified_min;
 };
 
 typedef struct _RembHashValue
 {
+  guint ssrc;
   guint bitrate;
   GstClockTime ts;
+  guint heap_index;
+  GList expiry_link;
 } RembHashValue;
 
 static RembHashValue *
-remb_hash_value_create (guint bitrate)
+remb_hash_value_create (guint ssrc, guint bitrate, GstClockTime ts)
 {
   RembHashValue *value = g_slice_new0 (RembHashValue);
 
+  value->ssrc = ssrc;
   value->bitrate = bitrate;
-  value->ts = kms_utils_get_time_nsecs ();
+  value->ts = ts;
+  value->expiry_link.data = value;
 
   return value;
 }
@@ -708,55 +1142,135 @@ remb_hash_value_destroy (gpointer value)
   g_slice_free (RembHashValue, value);
 }
 
+#define REMB_HEAP_VALUE(manager, i) \
+  ((RembHashValue *) g_ptr_array_index ((manager)->heap, (i)))
+
 static void
-remb_event_manager_set_min (RembEventManager * manager, guint min)
+remb_heap_set (RembEventManager * manager, guint i, RembHashValue * value)
+{
+  g_ptr_array_index (manager->heap, i) = value;
+  value->heap_index = i;
+}
+
+static void
+remb_heap_sift_up (RembEventManager * manager, guint i)
 {
-  if (manager->remb_min != min) {
-    manager->remb_min = min;
+  RembHashValue *value = REMB_HEAP_VALUE (manager, i);
+
+  while (i > 0) {
+    guint parent = (i - 1) / 2;
 
-    if (manager->callback) {
-      // TODO: Think about having a threshold to not notify in excess
-      manager->callback (manager, manager->remb_min, manager->user_data);
+    if (REMB_HEAP_VALUE (manager, parent)->bitrate <= value->bitrate) {
+      break;
     }
+
+    remb_heap_set (manager, i, REMB_HEAP_VALUE (manager, parent));
+    i = parent;
   }
+
+  remb_heap_set (manager, i, value);
 }
 
 static void
-remb_event_manager_calc_min (RembEventManager * manager, guint default_min)
+remb_heap_sift_down (RembEventManager * manager, guint i)
 {
-  guint remb_min = 0;
-  GstClockTime time = kms_utils_get_time_nsecs ();
-  GstClockTime oldest_time = GST_CLOCK_TIME_NONE;
-  GHashTableIter iter;
-  gpointer key, v;
-
-  g_hash_table_iter_init (&iter, manager->remb_hash);
-  while (g_hash_table_iter_next (&iter, &key, &v)) {
-    guint br = ((RembHashValue *) v)->bitrate;
-    GstClockTime ts = ((RembHashValue *) v)->ts;
-
-    if (time - ts > manager->clear_interval) {
-      GST_TRACE ("Remove entry %" G_GUINT32_FORMAT, GPOINTER_TO_UINT (key));
-      g_hash_table_iter_remove (&iter);
-      continue;
+  RembHashValue *value = REMB_HEAP_VALUE (manager, i);
+  guint len = manager->heap->len;
+
+  for (;;) {
+    guint child = 2 * i + 1;
+
+    if (child >= len) {
+      break;
     }
 
-    if (remb_min == 0) {
-      remb_min = br;
-    } else {
-      remb_min = MIN (remb_min, br);
+    if (child + 1 < len && REMB_HEAP_VALUE (manager, child + 1)->bitrate <
+        REMB_HEAP_VALUE (manager, child)->bitrate) {
+      child++;
+    }
+
+    if (value->bitrate <= REMB_HEAP_VALUE (manager, child)->bitrate) {
+      break;
+    }
+
+    remb_heap_set (manager, i, REMB_HEAP_VALUE (manager, child));
+    i = child;
+  }
+
+  remb_heap_set (manager, i, value);
+}
+
+static void
+remb_heap_remove (RembEventManager * manager, RembHashValue * value)
+{
+  guint i = value->heap_index;
+  RembHashValue *last;
+
+  last = g_ptr_array_remove_index (manager->heap, manager->heap->len - 1);
+  if (last == value) {
+    return;
+  }
+
+  remb_heap_set (manager, i, last);
+  remb_heap_sift_up (manager, i);
+  remb_heap_sift_down (manager, last->heap_index);
+}
+
+static void
+remb_event_manager_set_min (RembEventManager * manager, guint min)
+{
+  guint notified = manager->notified_min;
+
+  manager->remb_min = min;
+
+  if (notified == min) {
+    return;
+  }
+
+  /* Hysteresis: small variations do not reconfigure the listeners */
+  if (notified != 0 && min != 0 &&
+      ABS ((gint64) min - (gint64) notified) <=
+      notified * manager->notify_threshold) {
+    return;
+  }
+
+  manager->notified_min = min;
+
+  if (manager->callback) {
+    manager->callback (manager, min, manager->user_data);
+  }
+}
+
+static void
+remb_event_manager_expire (RembEventManager * manager, GstClockTime time)
+{
+  GList *link;
+
+  while ((link = g_queue_peek_head_link (&manager->expiry)) != NULL) {
+    RembHashValue *value = link->data;
+
+    if (time - value->ts <= manager->clear_interval) {
+      break;
     }
 
-    oldest_time = MIN (oldest_time, ts);
+    GST_TRACE ("Remove entry %" G_GUINT32_FORMAT, value->ssrc);
+    g_queue_unlink (&manager->expiry, link);
+    remb_heap_remove (manager, value);
+    g_hash_table_remove (manager->remb_hash, GUINT_TO_POINTER (value->ssrc));
   }
+}
 
-  if (remb_min == 0 && default_min > 0) {
-    GST_DEBUG_OBJECT (manager->pad, "Setting default value: %" G_GUINT32_FORMAT,
-        default_min);
-    remb_min = default_min;
+static void
+remb_event_manager_calc_min (RembEventManager * manager, GstClockTime time)
+{
+  guint remb_min = 0;
+
+  remb_event_manager_expire (manager, time);
+
+  if (manager->heap->len > 0) {
+    remb_min = REMB_HEAP_VALUE (manager, 0)->bitrate;
   }
 
-  manager->oldest_remb_time = oldest_time;
   remb_event_manager_set_min (manager, remb_min);
 }
 
@@ -764,38 +1278,37 @@ static void
 remb_event_manager_update_min (RembEventManager * manager, guint bitrate,
     guint ssrc)
 {
-  RembHashValue *last_value;
+  RembHashValue *value;
   GstClockTime time = kms_utils_get_time_nsecs ();
-  gboolean new_br = TRUE;
 
   g_mutex_lock (&manager->mutex);
-  last_value = g_hash_table_lookup (manager->remb_hash,
-      GUINT_TO_POINTER (ssrc));
+  remb_event_manager_expire (manager, time);
 
-  if (last_value != NULL) {
-    new_br = bitrate != last_value->bitrate;
-    last_value->bitrate = bitrate;
-    last_value->ts = kms_utils_get_time_nsecs ();
-  } else {
-    RembHashValue *value;
+  value = g_hash_table_lookup (manager->remb_hash, GUINT_TO_POINTER (ssrc));
 
-    value = remb_hash_value_create (bitrate);
-    g_hash_table_insert (manager->remb_hash, GUINT_TO_POINTER (ssrc), value);
-  }
+  if (value != NULL) {
+    guint old_bitrate = value->bitrate;
 
-  if (bitrate < manager->remb_min) {
-    remb_event_manager_set_min (manager, bitrate);
-  } else {
-    gboolean calc_min;
+    value->bitrate = bitrate;
+    value->ts = time;
+    g_queue_unlink (&manager->expiry, &value->expiry_link);
+    g_queue_push_tail_link (&manager->expiry, &value->expiry_link);
 
-    calc_min = new_br && (bitrate > manager->remb_min);
-    calc_min = calc_min
-        || (time - manager->oldest_remb_time > manager->clear_interval);
-    if (calc_min) {
-      remb_event_manager_calc_min (manager, bitrate);
+    if (bitrate < old_bitrate) {
+      remb_heap_sift_up (manager, value->heap_index);
+    } else if (bitrate > old_bitrate) {
+      remb_heap_sift_down (manager, value->heap_index);
     }
+  } else {
+    value = remb_hash_value_create (ssrc, bitrate, time);
+    g_hash_table_insert (manager->remb_hash, GUINT_TO_POINTER (ssrc), value);
+    g_queue_push_tail_link (&manager->expiry, &value->expiry_link);
+    g_ptr_array_add (manager->heap, value);
+    remb_heap_sift_up (manager, manager->heap->len - 1);
   }
 
+  remb_event_manager_set_min (manager, REMB_HEAP_VALUE (manager, 0)->bitrate);
+
   GST_TRACE_OBJECT (manager->pad, "remb_min: %" G_GUINT32_FORMAT,
       manager->remb_min);
 
@@ -832,8 +1345,9 @@ kms_utils_remb_event_manager_create (GstPad * pad)
   manager->pad = g_object_ref (pad);
   manager->probe_id = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
       remb_probe, manager, NULL);
-  manager->oldest_remb_time = kms_utils_get_time_nsecs ();
   manager->clear_interval = DEFAULT_CLEAR_INTERVAL;
+  manager->heap = g_ptr_array_new ();
+  g_queue_init (&manager->expiry);
 
   return manager;
 }
@@ -855,6 +1369,8 @@ kms_utils_remb_event_manager_destroy (RembEventManager * manager)
 
   gst_pad_remove_probe (manager->pad, manager->probe_id);
   g_object_unref (manager->pad);
+  /* Expiry links are embedded in the entries, freed with the hash table */
+  g_ptr_array_unref (manager->heap);
   g_hash_table_destroy (manager->remb_hash);
   g_mutex_clear (&manager->mutex);
   g_slice_free (RembEventManager, manager);
@@ -873,10 +1389,7 @@ kms_utils_remb_event_manager_get_min (RembEventManager * manager)
   guint ret;
 
   g_mutex_lock (&manager->mutex);
-  if (time - manager->oldest_remb_time > manager->clear_interval) {
-    remb_event_manager_calc_min (manager, 0);
-  }
-
+  remb_event_manager_calc_min (manager, time);
   ret = manager->remb_min;
   g_mutex_unlock (&manager->mutex);
 
@@ -909,6 +1422,21 @@ kms_utils_remb_event_manager_get_clear_interval (RembEventManager * manager)
   return manager->clear_interval;
 }
 
+void
+kms_utils_remb_event_manager_set_notify_threshold (RembEventManager * manager,
+    gfloat threshold)
+{
+  g_mutex_lock (&manager->mutex);
+  manager->notify_threshold = threshold;
+  g_mutex_unlock (&manager->mutex);
+}
+
+gfloat
+kms_utils_remb_event_manager_get_notify_threshold (RembEventManager * manager)
+{
+  return manager->notify_threshold;
+}
+
 /* REMB event end */
 
 /* time begin */
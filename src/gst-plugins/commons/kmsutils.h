@@ -31,6 +31,13 @@ void kms_element_for_each_src_pad (GstElement * element,
 gboolean kms_element_for_each_sink_pad (GstElement * element,
   KmsPadCallback action, gpointer data);
 
+/* Links pads of elements in different bins, ghosting them up to their common
+ * ancestor. The ghost pads created are returned in @ghosts, to be removed
+ * with kms_utils_remove_ghost_pads once the link is no longer needed */
+gboolean kms_utils_link_pads_ghosting (GstPad * src, GstPad * sink,
+  GSList ** ghosts);
+void kms_utils_remove_ghost_pads (GSList * ghosts);
+
 void kms_utils_debug_graph_delay (GstBin * bin, guint interval);
 gboolean kms_is_valid_uri (const gchar * url);
 
@@ -52,7 +59,18 @@ const gchar * kms_utils_get_caps_codec_name_from_sdp (const gchar * codec_name);
 /* key frame management */
 void kms_utils_drop_until_keyframe (GstPad *pad, gboolean all_headers);
 void kms_utils_manage_gaps (GstPad *pad);
+/* Coalesces the keyframe requests going upstream through @pad and adapts
+ * their dispersion to the GOP size and keyframe cost seen in the stream */
 void kms_utils_control_key_frames_request_duplicates (GstPad *pad);
+GstStructure * kms_utils_get_key_frames_request_stats (GstPad *pad);
+
+typedef struct _KeyFrameCoalescer KeyFrameCoalescer;
+KeyFrameCoalescer * kms_utils_key_frame_coalescer_new (void);
+void kms_utils_key_frame_coalescer_destroy (KeyFrameCoalescer * c);
+void kms_utils_key_frame_coalescer_reset (KeyFrameCoalescer * c, gboolean tracking);
+gboolean kms_utils_key_frame_coalescer_request (KeyFrameCoalescer * c, GstClockTime now);
+gboolean kms_utils_key_frame_coalescer_frame (KeyFrameCoalescer * c, gboolean keyframe, gsize size, GstClockTime now);
+GstStructure * kms_utils_key_frame_coalescer_get_stats (KeyFrameCoalescer * c);
 
 /* Pad blocked action */
 void kms_utils_execute_with_pad_blocked (GstPad * pad, gboolean drop, KmsPadCallback func, gpointer userData);
@@ -70,6 +88,10 @@ guint kms_utils_remb_event_manager_get_min (RembEventManager * manager);
 void kms_utils_remb_event_manager_set_callback (RembEventManager * manager, RembBitrateUpdatedCallback cb, gpointer data, GDestroyNotify destroy_notify);
 void kms_utils_remb_event_manager_set_clear_interval (RembEventManager * manager, GstClockTime interval);
 GstClockTime kms_utils_remb_event_manager_get_clear_interval (RembEventManager * manager);
+/* The callback is only called when the minimum changes more than @threshold
+ * (ratio over the last notified value). 0 notifies every change */
+void kms_utils_remb_event_manager_set_notify_threshold (RembEventManager * manager, gfloat threshold);
+gfloat kms_utils_remb_event_manager_get_notify_threshold (RembEventManager * manager);
 
 /* time */
 GstClockTime kms_utils_get_time_nsecs ();
@@ -616,6 +616,33 @@ sdp_utils_media_has_remb (const GstSDPMedia * media)
   return FALSE;
 }
 
+gboolean
+sdp_utils_media_has_transport_cc (const GstSDPMedia * media)
+{
+  const gchar *payload = gst_sdp_media_get_format (media, 0);
+  guint a;
+
+  if (payload == NULL) {
+    return FALSE;
+  }
+
+  for (a = 0;; a++) {
+    const gchar *attr;
+
+    attr = gst_sdp_media_get_attribute_val_n (media, RTCP_FB, a);
+    if (attr == NULL) {
+      break;
+    }
+
+    if (sdp_utils_rtcp_fb_attr_check_type (attr, payload,
+            RTCP_FB_TRANSPORT_CC)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
 gboolean
 sdp_utils_media_has_rtcp_nack (const GstSDPMedia * media)
 {
@@ -31,6 +31,7 @@
 #define RTCP_FB_NACK "nack"
 #define RTCP_FB_PLI "nack pli"
 #define RTCP_FB_REMB "goog-remb"
+#define RTCP_FB_TRANSPORT_CC "transport-cc"
 
 #define EXT_MAP "extmap"
 
@@ -58,6 +59,7 @@ gboolean sdp_utils_media_is_active (const GstSDPMedia * media, gboolean offerer)
 
 gboolean sdp_utils_rtcp_fb_attr_check_type (const gchar * attr, const gchar * pt, const gchar * type);
 gboolean sdp_utils_media_has_remb (const GstSDPMedia * media);
+gboolean sdp_utils_media_has_transport_cc (const GstSDPMedia * media);
 gboolean sdp_utils_media_has_rtcp_nack (const GstSDPMedia * media);
 
 gboolean sdp_utils_equal_medias (const GstSDPMedia * m1, const GstSDPMedia * m2);
@@ -374,8 +374,8 @@ kms_sdp_media_config_is_inactive (SdpMediaConfig * mconf)
       || (gst_sdp_media_get_port (mconf->media) == 0);
 }
 
-gint
-kms_sdp_media_config_get_abs_send_time_id (SdpMediaConfig * mconf)
+static gint
+kms_sdp_media_config_get_extmap_id (SdpMediaConfig * mconf, const gchar * uri)
 {
   GstSDPMedia *media = kms_sdp_media_config_get_sdp_media (mconf);
   guint a;
@@ -390,7 +390,7 @@ kms_sdp_media_config_get_abs_send_time_id (SdpMediaConfig * mconf)
     }
 
     tokens = g_strsplit (attr, " ", 0);
-    if (g_strcmp0 (RTP_HDR_EXT_ABS_SEND_TIME_URI, tokens[1]) == 0) {
+    if (g_strcmp0 (uri, tokens[1]) == 0) {
       gint ret = atoi (tokens[0]);
 
       g_strfreev (tokens);
@@ -403,6 +403,27 @@ kms_sdp_media_config_get_abs_send_time_id (SdpMediaConfig * mconf)
   return -1;
 }
 
+gint
+kms_sdp_media_config_get_abs_send_time_id (SdpMediaConfig * mconf)
+{
+  return kms_sdp_media_config_get_extmap_id (mconf,
+      RTP_HDR_EXT_ABS_SEND_TIME_URI);
+}
+
+gint
+kms_sdp_media_config_get_transport_cc_id (SdpMediaConfig * mconf)
+{
+  return kms_sdp_media_config_get_extmap_id (mconf,
+      RTP_HDR_EXT_TRANSPORT_CC_URI);
+}
+
+gint
+kms_sdp_media_config_get_audio_level_id (SdpMediaConfig * mconf)
+{
+  return kms_sdp_media_config_get_extmap_id (mconf,
+      RTP_HDR_EXT_AUDIO_LEVEL_URI);
+}
+
 static gboolean
 add_media_to_sdp_message (SdpMediaConfig * mconf, GstSDPMessage * msg,
     GError ** error)
@@ -52,6 +52,8 @@ SdpMediaGroup * kms_sdp_media_config_get_group (SdpMediaConfig * mconf);
 GstSDPMedia * kms_sdp_media_config_get_sdp_media (SdpMediaConfig * mconf);
 gboolean kms_sdp_media_config_is_inactive (SdpMediaConfig * mconf);
 gint kms_sdp_media_config_get_abs_send_time_id (SdpMediaConfig * mconf);
+gint kms_sdp_media_config_get_transport_cc_id (SdpMediaConfig * mconf);
+gint kms_sdp_media_config_get_audio_level_id (SdpMediaConfig * mconf);
 GstSDPMessage * kms_sdp_message_context_pack (SdpMessageContext *ctx, GError **error);
 SdpMediaGroup * kms_sdp_message_context_create_group (SdpMessageContext *ctx, guint gid);
 gboolean kms_sdp_message_context_has_groups (SdpMessageContext *ctx);
@@ -39,6 +39,7 @@ G_DEFINE_TYPE_WITH_CODE (KmsSdpRtpAvpfMediaHandler,
 
 #define DEFAULT_SDP_MEDIA_RTP_AVPF_NACK TRUE
 #define DEFAULT_SDP_MEDIA_RTP_GOOG_REMB TRUE
+#define DEFAULT_SDP_MEDIA_RTP_TRANSPORT_CC FALSE
 
 static gchar *video_rtcp_fb_enc[] = {
   "VP8",
@@ -59,6 +60,7 @@ enum
   PROP_0,
   PROP_NACK,
   PROP_GOOG_REMB,
+  PROP_TRANSPORT_CC,
   N_PROPERTIES
 };
 
@@ -66,6 +68,7 @@ struct _KmsSdpRtpAvpfMediaHandlerPrivate
 {
   gboolean nack;
   gboolean remb;
+  gboolean transport_cc;
 };
 
 static GObject *
@@ -168,6 +171,20 @@ no_nack:
   }
 
 no_remb:
+  if (self->priv->transport_cc) {
+    attr = g_strdup_printf ("%s %s", fmt, SDP_MEDIA_RTCP_FB_TRANSPORT_CC);
+
+    if (gst_sdp_media_add_attribute (media, SDP_MEDIA_RTCP_FB,
+            attr) != GST_SDP_OK) {
+      g_set_error (error, KMS_SDP_AGENT_ERROR, SDP_AGENT_UNEXPECTED_ERROR,
+          "Cannot add media attribute 'a=%s'", attr);
+      g_free (attr);
+      return FALSE;
+    }
+
+    g_free (attr);
+  }
+
   attr =
       g_strdup_printf ("%s %s %s", fmt, SDP_MEDIA_RTCP_FB_CCM,
       SDP_MEDIA_RTCP_FB_FIR);
@@ -286,6 +303,7 @@ static gboolean
 supported_rtcp_fb_val (const gchar * val)
 {
   return g_strcmp0 (val, SDP_MEDIA_RTCP_FB_GOOG_REMB) == 0 ||
+      g_strcmp0 (val, SDP_MEDIA_RTCP_FB_TRANSPORT_CC) == 0 ||
       g_strcmp0 (val, SDP_MEDIA_RTCP_FB_NACK) == 0 ||
       g_strcmp0 (val, SDP_MEDIA_RTCP_FB_CCM) == 0;
 
@@ -330,6 +348,13 @@ kms_sdp_rtp_avpf_media_handler_filter_rtcp_fb_attrs (KmsSdpMediaHandler *
       continue;
     }
 
+    if (g_strcmp0 (opts[1] /* rtcp-fb-val */ ,
+            SDP_MEDIA_RTCP_FB_TRANSPORT_CC) == 0 && !self->priv->transport_cc) {
+      /* ignore rtcp-fb transport-cc attribute */
+      g_strfreev (opts);
+      continue;
+    }
+
     if (!supported_rtcp_fb_val (opts[1] /* rtcp-fb-val */ )) {
       /* ignore unsupported rtcp-fb attribute */
       g_strfreev (opts);
@@ -511,6 +536,9 @@ kms_sdp_rtp_avpf_media_handler_get_property (GObject * object, guint prop_id,
     case PROP_GOOG_REMB:
       g_value_set_boolean (value, self->priv->remb);
       break;
+    case PROP_TRANSPORT_CC:
+      g_value_set_boolean (value, self->priv->transport_cc);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -530,6 +558,9 @@ kms_sdp_rtp_avpf_media_handler_set_property (GObject * object, guint prop_id,
     case PROP_GOOG_REMB:
       self->priv->remb = g_value_get_boolean (value);
       break;
+    case PROP_TRANSPORT_CC:
+      self->priv->transport_cc = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -577,6 +608,12 @@ kms_sdp_rtp_avpf_media_handler_class_init (KmsSdpRtpAvpfMediaHandlerClass *
           DEFAULT_SDP_MEDIA_RTP_GOOG_REMB,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_TRANSPORT_CC,
+      g_param_spec_boolean ("transport-cc", "transport-cc",
+          "Wheter transport-wide congestion control feedback is supported",
+          DEFAULT_SDP_MEDIA_RTP_TRANSPORT_CC,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
   g_type_class_add_private (klass, sizeof (KmsSdpRtpAvpfMediaHandlerPrivate));
 }
 
@@ -26,12 +26,39 @@
 #include "kmsdectreebin.h"
 #include "kmsenctreebin.h"
 #include "kmsrtppaytreebin.h"
+#include "kmsscaletreebin.h"
+#include "kmstranscoderregistry.h"
+#include "kmsencoderpool.h"
+#include "kmsgopcache.h"
+#include "kmsexecutor.h"
+#include "kmscapsindex.h"
 
 #define PLUGIN_NAME "agnosticbin"
 
 #define UNLINKING_DATA "unlinking-data"
 G_DEFINE_QUARK (UNLINKING_DATA, unlinking_data);
 
+#define LADDER_TIER "kms-ladder-tier"
+G_DEFINE_QUARK (LADDER_TIER, ladder_tier);
+
+#define SHARED_ENCODER "kms-shared-encoder"
+G_DEFINE_QUARK (SHARED_ENCODER, shared_encoder);
+
+#define LOCAL_ENCODER "kms-local-encoder"
+G_DEFINE_QUARK (LOCAL_ENCODER, local_encoder);
+
+#define ENCODER_CAPS "kms-encoder-caps"
+G_DEFINE_QUARK (ENCODER_CAPS, encoder_caps);
+
+#define SHARED_GHOSTS "kms-shared-ghosts"
+G_DEFINE_QUARK (SHARED_GHOSTS, shared_ghosts);
+
+#define DIRECT_LINK "kms-direct-link"
+G_DEFINE_QUARK (DIRECT_LINK, direct_link);
+
+#define KEYFRAME_READY "kms-keyframe-ready"
+G_DEFINE_QUARK (KEYFRAME_READY, keyframe_ready);
+
 #define KMS_AGNOSTIC_PAD_STARTED (GST_PAD_FLAG_LAST << 1)
 
 static GstStaticCaps static_raw_audio_caps =
@@ -67,6 +94,15 @@ G_DEFINE_TYPE (KmsAgnosticBin2, kms_agnostic_bin2, GST_TYPE_BIN);
 #define MIN_BITRATE_DEFAULT 0
 #define MAX_BITRATE_DEFAULT G_MAXINT
 #define LEAKY_TIME 600000000    /*600 ms */
+#define MAX_DECODE_LATENESS_DEFAULT -1
+#define SHARE_ENCODERS_DEFAULT FALSE
+#define DIRECT_PASSTHROUGH_DEFAULT FALSE
+
+/* Encoding ladder: every tier halves the dimensions of the previous one */
+#define LADDER_TIERS 3
+#define LADDER_TIER_DIVISOR 2
+#define LADDER_UP_MARGIN 1.2    /* Bandwidth over the tier bitrate to go up */
+static const gint ladder_bitrates[LADDER_TIERS] = { 1500000, 600000, 250000 };
 
 struct _KmsAgnosticBin2Private
 {
@@ -83,13 +119,37 @@ struct _KmsAgnosticBin2Private
   guint pad_count;
   gboolean started;
 
-  GThreadPool *remove_pool;
+  KmsExecutorQueue *remove_queue;
 
   gint max_bitrate;
   gint min_bitrate;
 
   GstStructure *codec_config;
   gboolean bitrate_unlimited;
+
+  gboolean ladder;
+  /* Cascaded scalers, tier 0 is fed by the decoder directly */
+  GstBin *ladder_scalers[LADDER_TIERS];
+
+  /* Encoders shared with the rest of the pipeline */
+  gboolean share_encoders;
+  KmsTranscoderRegistry *registry;
+  guint stream;
+  gint origin_stream;           /* Same stream seen upstream, 0 if none */
+  gchar *stream_id;
+  guint observed;               /* Input buffers since the last caps */
+
+  /* A single passthrough output is linked without a queue */
+  gboolean direct_passthrough;
+
+  /* Bytes of the last GOP kept to prime new outputs, 0 disables it */
+  guint gop_cache_size;
+
+  /* Lateness from which decoders drop frames, -1 disables it */
+  gint64 max_decode_lateness;
+
+  /* Resolves bins without querying them */
+  KmsCapsIndex *caps_index;
 };
 
 enum
@@ -98,6 +158,12 @@ enum
   PROP_MIN_BITRATE,
   PROP_MAX_BITRATE,
   PROP_CODEC_CONFIG,
+  PROP_KEY_FRAME_REQUESTS,
+  PROP_LADDER,
+  PROP_SHARE_ENCODERS,
+  PROP_DIRECT_PASSTHROUGH,
+  PROP_GOP_CACHE_SIZE,
+  PROP_MAX_DECODE_LATENESS,
   N_PROPERTIES
 };
 
@@ -114,10 +180,23 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src_%u",
 
 static gboolean kms_agnostic_bin2_process_pad (KmsAgnosticBin2 * self,
     GstPad * pad);
+static void kms_agnostic_bin2_link_pad (KmsAgnosticBin2 * self, GstPad * pad,
+    GstPad * peer);
 
 static GstBin *kms_agnostic_bin2_find_or_create_bin_for_caps (KmsAgnosticBin2 *
     self, GstCaps * caps);
 
+static void kms_agnostic_bin2_publish_encoder (KmsAgnosticBin2 * self,
+    GstCaps * caps, KmsEncTreeBin * enc_bin);
+static void kms_agnostic_bin2_withdraw_encoder (KmsAgnosticBin2 * self,
+    GstBin * bin);
+static GstElement *kms_agnostic_bin2_subscribe_shared_encoder (KmsAgnosticBin2 *
+    self, GstPad * pad, GstCaps * caps);
+static void kms_agnostic_bin2_unsubscribe_shared_encoder (GstPad * pad);
+static void kms_agnostic_bin2_link_shared_encoder (GstPad * pad,
+    GstElement * tee, GstElement * queue, gboolean keyframe_ready);
+static void kms_agnostic_bin2_forget_encoder (GstPad * pad);
+
 static void
 kms_agnostic_bin2_insert_bin (KmsAgnosticBin2 * self, GstBin * bin)
 {
@@ -159,8 +238,11 @@ tee_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
     GstEvent *event = gst_pad_probe_info_get_event (info);
 
     if (GST_EVENT_TYPE (event) == GST_EVENT_RECONFIGURE) {
-      // Request key frame to upstream elements
-      kms_utils_drop_until_keyframe (pad, TRUE);
+      if (g_object_get_qdata (G_OBJECT (pad), keyframe_ready_quark ()) ==
+          NULL) {
+        // Request key frame to upstream elements
+        kms_utils_drop_until_keyframe (pad, TRUE);
+      }
       return GST_PAD_PROBE_DROP;
     }
   }
@@ -168,8 +250,30 @@ tee_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
   return GST_PAD_PROBE_OK;
 }
 
+static GstPadProbeReturn
+clear_keyframe_ready_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  g_object_set_qdata (G_OBJECT (pad), keyframe_ready_quark (), NULL);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* The output fed by @tee_src does not need a keyframe, as it starts with the
+ * GOP cache or continues a stream already started, so reconfigurations are
+ * not taken as new outputs until the first buffer goes through */
+static void
+mark_keyframe_ready (GstPad * tee_src)
+{
+  g_object_set_qdata (G_OBJECT (tee_src), keyframe_ready_quark (),
+      GINT_TO_POINTER (TRUE));
+  gst_pad_add_probe (tee_src,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      clear_keyframe_ready_probe, NULL, NULL);
+}
+
 static void
-remove_on_unlinked_async (gpointer data, gpointer not_used)
+remove_on_unlinked_async (gpointer data)
 {
   GstElement *elem = GST_ELEMENT_CAST (data);
   GstObject *parent = gst_object_get_parent (GST_OBJECT (elem));
@@ -185,8 +289,6 @@ remove_on_unlinked_async (gpointer data, gpointer not_used)
     gst_bin_remove (GST_BIN (parent), elem);
     g_object_unref (parent);
   }
-
-  g_object_unref (data);
 }
 
 static GstPadProbeReturn
@@ -225,7 +327,11 @@ remove_on_unlinked_blocked (GstPad * pad, GstPadProbeInfo * info, gpointer elem)
 
   self = KMS_AGNOSTIC_BIN2 (GST_OBJECT_PARENT (elem));
 
-  g_thread_pool_push (self->priv->remove_pool, g_object_ref (elem), NULL);
+  if (self != NULL) {
+    kms_executor_queue_try_push (GST_OBJECT_GET_LOCK (self),
+        &self->priv->remove_queue, remove_on_unlinked_async,
+        g_object_ref (elem), g_object_unref);
+  }
 
   return GST_PAD_PROBE_PASS;
 }
@@ -270,7 +376,9 @@ remove_on_unlinked_cb (GstPad * pad, GstPad * peer, gpointer user_data)
       }
     }
 
-    g_thread_pool_push (self->priv->remove_pool, g_object_ref (elem), NULL);
+    kms_executor_queue_try_push (GST_OBJECT_GET_LOCK (self),
+        &self->priv->remove_queue, remove_on_unlinked_async,
+        g_object_ref (elem), g_object_unref);
   }
 
 end:
@@ -294,6 +402,14 @@ remove_element_on_unlinked (GstElement * element, const gchar * pad_name,
   g_object_unref (pad);
 }
 
+/* Pads exposing encoders shared with other elements are not outputs, they
+ * are created without a template */
+static gboolean
+kms_agnostic_bin2_is_output (GstPad * pad)
+{
+  return GST_PAD_PAD_TEMPLATE (pad) != NULL;
+}
+
 static void
 remove_tee_pad_on_unlink (GstPad * pad, GstPad * peer, gpointer user_data)
 {
@@ -308,7 +424,8 @@ remove_tee_pad_on_unlink (GstPad * pad, GstPad * peer, gpointer user_data)
 }
 
 static void
-link_element_to_tee (GstElement * tee, GstElement * element)
+link_element_to_tee_full (GstElement * tee, GstElement * element,
+    gboolean keyframe_ready)
 {
   GstPad *tee_src = gst_element_get_request_pad (tee, "src_%u");
   GstPad *element_sink = gst_element_get_static_pad (element, "sink");
@@ -318,6 +435,10 @@ link_element_to_tee (GstElement * tee, GstElement * element)
   g_signal_connect (tee_src, "unlinked", G_CALLBACK (remove_tee_pad_on_unlink),
       NULL);
 
+  if (keyframe_ready) {
+    mark_keyframe_ready (tee_src);
+  }
+
   gst_pad_add_probe (tee_src, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, tee_src_probe,
       NULL, NULL);
 
@@ -332,6 +453,12 @@ link_element_to_tee (GstElement * tee, GstElement * element)
   g_object_unref (tee_src);
 }
 
+static void
+link_element_to_tee (GstElement * tee, GstElement * element)
+{
+  link_element_to_tee_full (tee, element, FALSE);
+}
+
 static GstPadProbeReturn
 remove_target_pad_block (GstPad * pad, GstPadProbeInfo * info, gpointer gp)
 {
@@ -349,6 +476,9 @@ remove_target_pad (GstPad * pad)
 
   GST_DEBUG_OBJECT (pad, "Removing target pad");
 
+  kms_agnostic_bin2_unsubscribe_shared_encoder (pad);
+  kms_agnostic_bin2_forget_encoder (pad);
+
   if (target == NULL) {
     return;
   }
@@ -357,6 +487,17 @@ remove_target_pad (GstPad * pad)
       remove_target_pad_block, NULL, NULL);
   gst_ghost_pad_set_target (GST_GHOST_PAD (pad), NULL);
 
+  if (g_object_get_qdata (G_OBJECT (pad), direct_link_quark ()) != NULL) {
+    GstElement *tee = gst_pad_get_parent_element (target);
+
+    /* Target was a pad requested to the tee */
+    g_object_set_qdata (G_OBJECT (pad), direct_link_quark (), NULL);
+    if (tee != NULL) {
+      gst_element_release_request_pad (tee, target);
+      g_object_unref (tee);
+    }
+  }
+
   g_object_unref (target);
 }
 
@@ -399,11 +540,94 @@ proxy_src_pad_query_function (GstPad * pad, GstObject * parent,
   return ret;
 }
 
+typedef enum
+{
+  CONVERSION_NONE,
+  CONVERSION_FORMAT,            /* only the convert element */
+  CONVERSION_FULL
+} Conversion;
+
+/* Caps accepting any sample or pixel format of @caps */
+static GstCaps *
+kms_agnostic_bin2_any_format (GstCaps * caps)
+{
+  GstCaps *ret = gst_caps_copy (caps);
+  guint i;
+
+  for (i = 0; i < gst_caps_get_size (ret); i++) {
+    GstStructure *st = gst_caps_get_structure (ret, i);
+
+    if (kms_utils_caps_are_audio (caps)) {
+      gst_structure_remove_fields (st, "format", "layout", "channels",
+          "channel-mask", NULL);
+    } else {
+      gst_structure_remove_fields (st, "format", "colorimetry",
+          "chroma-site", NULL);
+    }
+  }
+
+  return ret;
+}
+
+/*
+ * Raw outputs only need converters when the tee does not already carry a
+ * format accepted downstream, and only the convert element when the rate
+ * and size are accepted (e.g. S16LE from opusdec to an F32LE mixer). If the
+ * input changes to a format that is not accepted, the output is processed
+ * again and gets them.
+ */
+static Conversion
+kms_agnostic_bin2_get_conversion (GstElement * tee, GstCaps * caps)
+{
+  Conversion ret = CONVERSION_FULL;
+  GstCaps *current, *any_format;
+  GstPad *tee_sink;
+
+  if (gst_caps_is_any (caps) || gst_caps_is_empty (caps)
+      || !kms_utils_caps_are_raw (caps)) {
+    return CONVERSION_NONE;
+  }
+
+  tee_sink = gst_element_get_static_pad (tee, "sink");
+  current = gst_pad_get_current_caps (tee_sink);
+  if (current == NULL) {
+    /* Outputs are linked while the first caps event goes to the tee */
+    GstPad *peer = gst_pad_get_peer (tee_sink);
+
+    if (peer != NULL) {
+      current = gst_pad_get_current_caps (peer);
+      g_object_unref (peer);
+    }
+  }
+  g_object_unref (tee_sink);
+
+  if (current == NULL) {
+    return CONVERSION_FULL;
+  }
+
+  if (gst_caps_is_fixed (current)) {
+    if (gst_caps_is_subset (current, caps)) {
+      ret = CONVERSION_NONE;
+    } else {
+      any_format = kms_agnostic_bin2_any_format (caps);
+      if (gst_caps_is_subset (current, any_format)) {
+        ret = CONVERSION_FORMAT;
+      }
+      gst_caps_unref (any_format);
+    }
+  }
+
+  gst_caps_unref (current);
+
+  return ret;
+}
+
 static void
 kms_agnostic_bin2_link_to_tee (KmsAgnosticBin2 * self, GstPad * pad,
-    GstElement * tee, GstCaps * caps)
+    GstElement * tee, GstCaps * caps, gboolean primed)
 {
   GstElement *queue = gst_element_factory_make ("queue", NULL);
+  Conversion conversion;
   GstPad *target;
   GstProxyPad *proxy;
 
@@ -411,15 +635,25 @@ kms_agnostic_bin2_link_to_tee (KmsAgnosticBin2 * self, GstPad * pad,
   gst_element_sync_state_with_parent (queue);
 
   if (!(gst_caps_is_any (caps) || gst_caps_is_empty (caps))
-      && kms_utils_caps_are_raw (caps)) {
+      && kms_utils_caps_are_raw (caps) && kms_utils_caps_are_video (caps)) {
+    g_object_set (queue, "leaky", 2, "max-size-time", LEAKY_TIME, NULL);
+  }
+
+  conversion = kms_agnostic_bin2_get_conversion (tee, caps);
+
+  if (conversion == CONVERSION_FORMAT) {
+    GstElement *convert = kms_utils_create_convert_for_caps (caps);
+
+    remove_element_on_unlinked (convert, "src", "sink");
+    gst_bin_add (GST_BIN (self), convert);
+    gst_element_sync_state_with_parent (convert);
+    gst_element_link (queue, convert);
+    target = gst_element_get_static_pad (convert, "src");
+  } else if (conversion == CONVERSION_FULL) {
     GstElement *convert = kms_utils_create_convert_for_caps (caps);
     GstElement *rate = kms_utils_create_rate_for_caps (caps);
     GstElement *mediator = kms_utils_create_mediator_element (caps);
 
-    if (kms_utils_caps_are_video (caps)) {
-      g_object_set (queue, "leaky", 2, "max-size-time", LEAKY_TIME, NULL);
-    }
-
     remove_element_on_unlinked (convert, "src", "sink");
     if (rate) {
       remove_element_on_unlinked (rate, "src", "sink");
@@ -458,9 +692,225 @@ kms_agnostic_bin2_link_to_tee (KmsAgnosticBin2 * self, GstPad * pad,
   g_object_unref (proxy);
 
   g_object_unref (target);
-  link_element_to_tee (tee, queue);
+
+  if (g_object_get_qdata (G_OBJECT (pad), shared_encoder_quark ()) == tee) {
+    kms_agnostic_bin2_link_shared_encoder (pad, tee, queue, primed);
+  } else {
+    link_element_to_tee_full (tee, queue, primed);
+  }
+}
+
+/* Direct passthrough begin */
+
+static void
+count_other_output (GstPad * pad, gpointer data)
+{
+  gpointer *params = data;
+
+  if (pad != params[0] && kms_agnostic_bin2_is_output (pad)
+      && gst_pad_is_linked (pad)) {
+    params[1] = GUINT_TO_POINTER (GPOINTER_TO_UINT (params[1]) + 1);
+  }
+}
+
+/* Passthrough outputs are linked straight to the tee, so that buffers do
+ * not go through a queue and its thread, when they are the only output */
+static gboolean
+kms_agnostic_bin2_can_link_direct (KmsAgnosticBin2 * self, GstPad * pad,
+    GstBin * bin, GstCaps * caps)
+{
+  gpointer params[] = { pad, GUINT_TO_POINTER (0) };
+
+  if (!self->priv->direct_passthrough || bin != self->priv->input_bin
+      || gst_caps_is_any (caps) || gst_caps_is_empty (caps)
+      || kms_utils_caps_are_raw (caps)) {
+    return FALSE;
+  }
+
+  kms_element_for_each_src_pad (GST_ELEMENT (self), count_other_output,
+      params);
+
+  return GPOINTER_TO_UINT (params[1]) == 0;
+}
+
+static void
+kms_agnostic_bin2_link_direct (KmsAgnosticBin2 * self, GstPad * pad,
+    GstElement * tee, gboolean primed)
+{
+  GstPad *tee_src = gst_element_get_request_pad (tee, "src_%u");
+  GstProxyPad *proxy;
+
+  GST_DEBUG_OBJECT (pad, "Linking directly to %" GST_PTR_FORMAT, tee);
+
+  if (primed) {
+    mark_keyframe_ready (tee_src);
+  }
+  gst_pad_add_probe (tee_src, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, tee_src_probe,
+      NULL, NULL);
+
+  g_object_set_qdata (G_OBJECT (pad), direct_link_quark (),
+      GINT_TO_POINTER (TRUE));
+  gst_ghost_pad_set_target (GST_GHOST_PAD (pad), tee_src);
+
+  proxy = gst_proxy_pad_get_internal (GST_PROXY_PAD (pad));
+  gst_pad_set_query_function (GST_PAD_CAST (proxy),
+      proxy_src_pad_query_function);
+  g_object_unref (proxy);
+
+  g_object_unref (tee_src);
+}
+
+typedef struct _DirectRelink
+{
+  GstPad *pad;
+  GstElement *queue;
+} DirectRelink;
+
+static void
+direct_relink_destroy (DirectRelink * relink)
+{
+  g_object_unref (relink->pad);
+  g_object_unref (relink->queue);
+  g_slice_free (DirectRelink, relink);
+}
+
+/* Called when no data is flowing through the tee pad, so the output is
+ * moved to the queue without losing or repeating any buffer */
+static GstPadProbeReturn
+retarget_direct_output (GstPad * tee_src, GstPadProbeInfo * info,
+    gpointer data)
+{
+  DirectRelink *relink = data;
+  GstElement *tee = gst_pad_get_parent_element (tee_src);
+  GstPad *queue_src;
+
+  if (tee == NULL) {
+    return GST_PAD_PROBE_REMOVE;
+  }
+
+  GST_DEBUG_OBJECT (relink->pad, "Moving to %" GST_PTR_FORMAT, relink->queue);
+
+  queue_src = gst_element_get_static_pad (relink->queue, "src");
+  gst_ghost_pad_set_target (GST_GHOST_PAD (relink->pad), queue_src);
+  g_object_unref (queue_src);
+
+  link_element_to_tee_full (tee, relink->queue, TRUE);
+  gst_element_release_request_pad (tee, tee_src);
+  g_object_unref (tee);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/* Puts a queue between the tee and a direct output. Caps and timestamps do
+ * not change, so the output keeps flowing without waiting for a keyframe */
+static void
+relink_direct_output (GstPad * pad, KmsAgnosticBin2 * self)
+{
+  DirectRelink *relink;
+  GstElement *queue;
+  GstPad *target;
+
+  if (g_object_get_qdata (G_OBJECT (pad), direct_link_quark ()) == NULL) {
+    return;
+  }
+
+  target = gst_ghost_pad_get_target (GST_GHOST_PAD (pad));
+  if (target == NULL) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (pad, "Another output appeared, linking through a queue");
+  g_object_set_qdata (G_OBJECT (pad), direct_link_quark (), NULL);
+
+  queue = gst_element_factory_make ("queue", NULL);
+  gst_bin_add (GST_BIN (self), queue);
+  gst_element_sync_state_with_parent (queue);
+
+  relink = g_slice_new0 (DirectRelink);
+  relink->pad = g_object_ref (pad);
+  relink->queue = g_object_ref (queue);
+
+  gst_pad_add_probe (target, GST_PAD_PROBE_TYPE_IDLE, retarget_direct_output,
+      relink, (GDestroyNotify) direct_relink_destroy);
+  g_object_unref (target);
+}
+
+/* Direct passthrough end */
+
+/* GOP cache begin */
+
+/* Starts @pad with the last GOP of @tee instead of waiting for a keyframe.
+ * The cache is enabled on the first output, later outputs use it */
+static gboolean
+kms_agnostic_bin2_prime_output (KmsAgnosticBin2 * self, GstPad * pad,
+    GstElement * tee, GstCaps * caps)
+{
+  if (self->priv->gop_cache_size == 0 || kms_utils_caps_are_raw (caps)) {
+    return FALSE;
+  }
+
+  kms_gop_cache_enable (tee, self->priv->gop_cache_size);
+
+  if (!kms_gop_cache_prime (tee, pad)) {
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (pad, "Primed with the GOP cached in %" GST_PTR_FORMAT,
+      tee);
+
+  return TRUE;
+}
+
+/* GOP cache end */
+
+/* Caps index begin */
+
+static void
+kms_agnostic_bin2_index_bin (KmsAgnosticBin2 * self, GstCaps * caps,
+    GstBin * bin)
+{
+  if (bin == NULL || bin == self->priv->input_bin) {
+    return;
+  }
+
+  kms_caps_index_add (self->priv->caps_index, caps, bin);
+}
+
+static void
+kms_agnostic_bin2_unindex_bin (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  kms_caps_index_remove (self->priv->caps_index, bin);
+}
+
+/*
+ * Resolves the bin for @caps without walking all the bins. A hit is checked
+ * against the negotiated caps of the bin if any, otherwise the requested
+ * caps have to be the same ones the entry was created for.
+ */
+static GstBin *
+kms_agnostic_bin2_lookup_bin (KmsAgnosticBin2 * self, GstCaps * caps)
+{
+  GstCaps *current_caps, *indexed_caps;
+  gboolean valid;
+  GstBin *bin;
+
+  bin = kms_caps_index_lookup (self->priv->caps_index, caps, &indexed_caps);
+  if (bin == NULL) {
+    return NULL;
+  }
+
+  current_caps = kms_tree_bin_get_input_caps (KMS_TREE_BIN (bin));
+  if (current_caps != NULL) {
+    valid = gst_caps_can_intersect (caps, current_caps);
+  } else {
+    valid = gst_caps_is_equal (caps, indexed_caps);
+  }
+
+  return valid ? bin : NULL;
 }
 
+/* Caps index end */
+
 static gboolean
 check_bin (KmsTreeBin * tree_bin, const GstCaps * caps)
 {
@@ -502,19 +952,31 @@ kms_agnostic_bin2_find_bin_for_caps (KmsAgnosticBin2 * self, GstCaps * caps)
   }
 
   if (check_bin (KMS_TREE_BIN (self->priv->input_bin), caps)) {
-    bin = self->priv->input_bin;
+    return self->priv->input_bin;
+  }
+
+  bin = kms_agnostic_bin2_lookup_bin (self, caps);
+  if (bin != NULL) {
+    return bin;
   }
 
   bins = g_hash_table_get_values (self->priv->bins);
   for (l = bins; l != NULL && bin == NULL; l = l->next) {
     KmsTreeBin *tree_bin = KMS_TREE_BIN (l->data);
 
+    /* Ladder bins are only used through their tier */
+    if (g_object_get_qdata (G_OBJECT (tree_bin), ladder_tier_quark ())) {
+      continue;
+    }
+
     if (check_bin (tree_bin, caps)) {
       bin = GST_BIN_CAST (tree_bin);
     }
   }
   g_list_free (bins);
 
+  kms_agnostic_bin2_index_bin (self, caps, bin);
+
   return bin;
 }
 
@@ -549,6 +1011,9 @@ kms_agnostic_bin2_create_dec_bin (KmsAgnosticBin2 * self,
     return NULL;
   }
 
+  g_object_set (dec_bin, "max-lateness", self->priv->max_decode_lateness,
+      NULL);
+
   gst_bin_add (GST_BIN (self), GST_ELEMENT (dec_bin));
   gst_element_sync_state_with_parent (GST_ELEMENT (dec_bin));
 
@@ -583,6 +1048,7 @@ kms_agnostic_bin2_get_or_create_dec_bin (KmsAgnosticBin2 * self, GstCaps * caps)
 
       if (dec_bin != NULL) {
         kms_agnostic_bin2_insert_bin (self, dec_bin);
+        kms_agnostic_bin2_index_bin (self, raw_caps, dec_bin);
       }
     }
 
@@ -623,12 +1089,33 @@ kms_agnostic_bin2_create_rtp_pay_bin (KmsAgnosticBin2 * self, GstCaps * caps)
   kms_agnostic_bin2_insert_bin (self, GST_BIN (bin));
   gst_caps_unref (input_caps);
 
+  /* Keeps the encoder from being released while the payloader uses it */
+  g_object_set_qdata (G_OBJECT (bin), local_encoder_quark (),
+      KMS_IS_ENC_TREE_BIN (enc_bin) ? enc_bin : NULL);
+
   output_tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (enc_bin));
   link_element_to_tee (output_tee, input_element);
 
   return GST_BIN (bin);
 }
 
+/* Encoders may come from the pool, already used by other agnosticbins */
+static KmsEncTreeBin *
+kms_agnostic_bin2_new_enc_bin (KmsAgnosticBin2 * self, GstCaps * caps,
+    gint target_bitrate, gint min_bitrate, gint max_bitrate)
+{
+  KmsEncTreeBin *enc_bin;
+
+  enc_bin = kms_encoder_pool_acquire (caps, target_bitrate, min_bitrate,
+      max_bitrate, self->priv->codec_config);
+  if (enc_bin != NULL) {
+    g_object_set_qdata (G_OBJECT (enc_bin), ladder_tier_quark (), NULL);
+    g_object_set_qdata (G_OBJECT (enc_bin), encoder_caps_quark (), NULL);
+  }
+
+  return enc_bin;
+}
+
 static GstBin *
 kms_agnostic_bin2_create_bin_for_caps (KmsAgnosticBin2 * self, GstCaps * caps)
 {
@@ -650,9 +1137,8 @@ kms_agnostic_bin2_create_bin_for_caps (KmsAgnosticBin2 * self, GstCaps * caps)
   }
 
   enc_bin =
-      kms_enc_tree_bin_new (caps, TARGET_BITRATE_DEFAULT,
-      self->priv->min_bitrate, self->priv->max_bitrate,
-      self->priv->codec_config);
+      kms_agnostic_bin2_new_enc_bin (self, caps, TARGET_BITRATE_DEFAULT,
+      self->priv->min_bitrate, self->priv->max_bitrate);
   if (enc_bin == NULL) {
     return NULL;
   }
@@ -665,6 +1151,7 @@ kms_agnostic_bin2_create_bin_for_caps (KmsAgnosticBin2 * self, GstCaps * caps)
   link_element_to_tee (output_tee, input_element);
 
   kms_agnostic_bin2_insert_bin (self, GST_BIN (enc_bin));
+  kms_agnostic_bin2_publish_encoder (self, caps, enc_bin);
 
   return GST_BIN (enc_bin);
 }
@@ -679,51 +1166,324 @@ kms_agnostic_bin2_find_or_create_bin_for_caps (KmsAgnosticBin2 * self,
 
   if (bin == NULL) {
     bin = kms_agnostic_bin2_create_bin_for_caps (self, caps);
+    kms_agnostic_bin2_index_bin (self, caps, bin);
     GST_DEBUG_OBJECT (self, "Created bin: %" GST_PTR_FORMAT, bin);
   }
 
   return bin;
 }
 
-/**
- * Link a pad internally
- *
- * @self: The #KmsAgnosticBin2 owner of the pad
- * @pad: (transfer full): The pad to be linked
- * @peer: (transfer full): The peer pad
- */
-static void
-kms_agnostic_bin2_link_pad (KmsAgnosticBin2 * self, GstPad * pad, GstPad * peer)
-{
-  GstCaps *caps;
-  GstBin *bin;
+/* Encoding ladder begin */
 
-  GST_INFO_OBJECT (self, "Linking: %" GST_PTR_FORMAT, pad);
+static gint
+kms_agnostic_bin2_ladder_bitrate (KmsAgnosticBin2 * self, guint tier)
+{
+  return MAX (self->priv->min_bitrate, MIN (self->priv->max_bitrate,
+          ladder_bitrates[tier]));
+}
 
-  caps = gst_pad_query_caps (peer, NULL);
+static gboolean
+kms_agnostic_bin2_ladder_applies (KmsAgnosticBin2 * self, GstCaps * caps)
+{
+  if (!self->priv->ladder || self->priv->input_bin == NULL) {
+    return FALSE;
+  }
+
+  if (gst_caps_is_any (caps) || gst_caps_is_empty (caps)
+      || !kms_utils_caps_are_video (caps) || kms_utils_caps_are_raw (caps)
+      || kms_utils_caps_are_rtp (caps)) {
+    return FALSE;
+  }
+
+  /* Input can be forwarded without transcoding */
+  return !check_bin (KMS_TREE_BIN (self->priv->input_bin), caps);
+}
+
+/* Best tier that fits in @bitrate, going up requires some headroom */
+static guint
+kms_agnostic_bin2_ladder_select_tier (KmsAgnosticBin2 * self, guint bitrate,
+    guint current)
+{
+  guint tier;
+
+  for (tier = 0; tier < LADDER_TIERS - 1; tier++) {
+    gdouble needed = kms_agnostic_bin2_ladder_bitrate (self, tier);
+
+    if (tier < current) {
+      needed *= LADDER_UP_MARGIN;
+    }
+
+    if (bitrate >= needed) {
+      break;
+    }
+  }
+
+  return tier;
+}
+
+static guint
+kms_agnostic_bin2_get_pad_tier (KmsAgnosticBin2 * self, GstPad * pad)
+{
+  guint tier;
+
+  tier = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (pad),
+          ladder_tier_quark ()));
+
+  if (tier == 0) {
+    /* Start as the non ladder encoders do */
+    tier = kms_agnostic_bin2_ladder_select_tier (self, TARGET_BITRATE_DEFAULT,
+        LADDER_TIERS - 1) + 1;
+    g_object_set_qdata (G_OBJECT (pad), ladder_tier_quark (),
+        GUINT_TO_POINTER (tier));
+  }
+
+  return tier - 1;
+}
+
+static GstElement *
+kms_agnostic_bin2_get_ladder_tee (KmsAgnosticBin2 * self, GstCaps * caps,
+    guint tier)
+{
+  KmsScaleTreeBin *scaler;
+  GstElement *input_tee, *input_element;
+
+  if (tier == 0) {
+    GstBin *dec_bin = kms_agnostic_bin2_get_or_create_dec_bin (self, caps);
+
+    if (dec_bin == NULL) {
+      return NULL;
+    }
+
+    return kms_tree_bin_get_output_tee (KMS_TREE_BIN (dec_bin));
+  }
+
+  if (self->priv->ladder_scalers[tier] != NULL) {
+    return
+        kms_tree_bin_get_output_tee (KMS_TREE_BIN (self->
+            priv->ladder_scalers[tier]));
+  }
+
+  /* Each tier is scaled from the next larger one */
+  input_tee = kms_agnostic_bin2_get_ladder_tee (self, caps, tier - 1);
+  if (input_tee == NULL) {
+    return NULL;
+  }
+
+  scaler = kms_scale_tree_bin_new (LADDER_TIER_DIVISOR);
+  if (scaler == NULL) {
+    return NULL;
+  }
+
+  g_object_set_qdata (G_OBJECT (scaler), ladder_tier_quark (),
+      GUINT_TO_POINTER (tier + 1));
+
+  gst_bin_add (GST_BIN (self), GST_ELEMENT (scaler));
+  gst_element_sync_state_with_parent (GST_ELEMENT (scaler));
+
+  input_element = kms_tree_bin_get_input_element (KMS_TREE_BIN (scaler));
+  link_element_to_tee (input_tee, input_element);
+
+  kms_agnostic_bin2_insert_bin (self, GST_BIN (scaler));
+  self->priv->ladder_scalers[tier] = GST_BIN (scaler);
+
+  return kms_tree_bin_get_output_tee (KMS_TREE_BIN (scaler));
+}
+
+static GstBin *
+kms_agnostic_bin2_find_ladder_bin (KmsAgnosticBin2 * self, GstCaps * caps,
+    guint tier)
+{
+  GList *bins, *l;
+  GstBin *bin = NULL;
+
+  bins = g_hash_table_get_values (self->priv->bins);
+  for (l = bins; l != NULL && bin == NULL; l = l->next) {
+    if (!KMS_IS_ENC_TREE_BIN (l->data)) {
+      continue;
+    }
+
+    if (GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (l->data),
+                ladder_tier_quark ())) != tier + 1) {
+      continue;
+    }
+
+    if (check_bin (KMS_TREE_BIN (l->data), caps)) {
+      bin = GST_BIN_CAST (l->data);
+    }
+  }
+  g_list_free (bins);
+
+  return bin;
+}
+
+static GstBin *
+kms_agnostic_bin2_get_or_create_ladder_bin (KmsAgnosticBin2 * self,
+    GstCaps * caps, guint tier)
+{
+  KmsEncTreeBin *enc_bin;
+  GstElement *input_element, *tee;
+  GstBin *bin;
+  gint bitrate;
+
+  bin = kms_agnostic_bin2_find_ladder_bin (self, caps, tier);
+  if (bin != NULL) {
+    return bin;
+  }
+
+  tee = kms_agnostic_bin2_get_ladder_tee (self, caps, tier);
+  if (tee == NULL) {
+    return NULL;
+  }
+
+  /* Tiers are encoded at a fixed bitrate, outputs move between them */
+  bitrate = kms_agnostic_bin2_ladder_bitrate (self, tier);
+  enc_bin = kms_agnostic_bin2_new_enc_bin (self, caps, bitrate, bitrate,
+      bitrate);
+  if (enc_bin == NULL) {
+    return NULL;
+  }
+
+  g_object_set_qdata (G_OBJECT (enc_bin), ladder_tier_quark (),
+      GUINT_TO_POINTER (tier + 1));
+
+  gst_bin_add (GST_BIN (self), GST_ELEMENT (enc_bin));
+  gst_element_sync_state_with_parent (GST_ELEMENT (enc_bin));
+
+  input_element = kms_tree_bin_get_input_element (KMS_TREE_BIN (enc_bin));
+  link_element_to_tee (tee, input_element);
+
+  kms_agnostic_bin2_insert_bin (self, GST_BIN (enc_bin));
+
+  GST_DEBUG_OBJECT (self, "Created ladder tier %u encoder: %" GST_PTR_FORMAT,
+      tier, enc_bin);
+
+  return GST_BIN (enc_bin);
+}
+
+/* Encoding ladder end */
+
+/**
+ * Link a pad internally
+ *
+ * @self: The #KmsAgnosticBin2 owner of the pad
+ * @pad: (transfer full): The pad to be linked
+ * @peer: (transfer full): The peer pad
+ */
+static void
+kms_agnostic_bin2_link_pad (KmsAgnosticBin2 * self, GstPad * pad, GstPad * peer)
+{
+  gboolean primed = FALSE;
+  GstCaps *caps;
+  GstBin *bin;
+
+  GST_INFO_OBJECT (self, "Linking: %" GST_PTR_FORMAT, pad);
+
+  caps = gst_pad_query_caps (peer, NULL);
 
   if (caps == NULL) {
     goto end;
   }
 
   GST_DEBUG ("Query caps are: %" GST_PTR_FORMAT, caps);
-  bin = kms_agnostic_bin2_find_or_create_bin_for_caps (self, caps);
+
+  if (kms_agnostic_bin2_ladder_applies (self, caps)) {
+    bin = kms_agnostic_bin2_get_or_create_ladder_bin (self, caps,
+        kms_agnostic_bin2_get_pad_tier (self, pad));
+  } else {
+    GstElement *shared_tee;
+
+    g_object_set_qdata (G_OBJECT (pad), ladder_tier_quark (), NULL);
+    bin = kms_agnostic_bin2_find_bin_for_caps (self, caps);
+
+    if (bin == NULL) {
+      shared_tee =
+          kms_agnostic_bin2_subscribe_shared_encoder (self, pad, caps);
+
+      if (shared_tee != NULL) {
+        g_object_set_qdata (G_OBJECT (pad), local_encoder_quark (), NULL);
+        primed = kms_agnostic_bin2_prime_output (self, pad, shared_tee, caps);
+        if (!primed) {
+          kms_utils_drop_until_keyframe (pad, TRUE);
+        }
+        kms_agnostic_bin2_link_to_tee (self, pad, shared_tee, caps, primed);
+        g_object_unref (shared_tee);
+        goto unref_caps;
+      }
+
+      bin = kms_agnostic_bin2_create_bin_for_caps (self, caps);
+      kms_agnostic_bin2_index_bin (self, caps, bin);
+      GST_DEBUG_OBJECT (self, "Created bin: %" GST_PTR_FORMAT, bin);
+    }
+  }
+
+  g_object_set_qdata (G_OBJECT (pad), local_encoder_quark (),
+      KMS_IS_ENC_TREE_BIN (bin) ? bin : NULL);
 
   if (bin != NULL) {
     GstElement *tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
 
     if (!kms_utils_caps_are_rtp (caps)) {
-      kms_utils_drop_until_keyframe (pad, TRUE);
+      primed = kms_agnostic_bin2_prime_output (self, pad, tee, caps);
+      if (!primed) {
+        kms_utils_drop_until_keyframe (pad, TRUE);
+      }
+    }
+
+    if (kms_agnostic_bin2_can_link_direct (self, pad, bin, caps)) {
+      kms_agnostic_bin2_link_direct (self, pad, tee, primed);
+    } else {
+      kms_element_for_each_src_pad (GST_ELEMENT (self),
+          (KmsPadIterationAction) relink_direct_output, self);
+      kms_agnostic_bin2_link_to_tee (self, pad, tee, caps, primed);
     }
-    kms_agnostic_bin2_link_to_tee (self, pad, tee, caps);
   }
 
+unref_caps:
   gst_caps_unref (caps);
 
 end:
   g_object_unref (peer);
 }
 
+/*
+ * Moves a ladder output to the tier that fits the bandwidth reported by its
+ * REMB. It should be always called with the agnostic lock held.
+ */
+static void
+kms_agnostic_bin2_ladder_remb (KmsAgnosticBin2 * self, GstPad * pad,
+    guint bitrate)
+{
+  guint current, tier;
+  GstPad *peer;
+
+  current = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (pad),
+          ladder_tier_quark ()));
+
+  if (!self->priv->ladder || current == 0) {
+    /* Not served by the ladder */
+    return;
+  }
+
+  tier = kms_agnostic_bin2_ladder_select_tier (self, bitrate, current - 1);
+  if (tier == current - 1) {
+    return;
+  }
+
+  peer = gst_pad_get_peer (pad);
+  if (peer == NULL) {
+    return;
+  }
+
+  GST_INFO_OBJECT (pad, "Switching from tier %u to %u, REMB: %u", current - 1,
+      tier, bitrate);
+
+  g_object_set_qdata (G_OBJECT (pad), ladder_tier_quark (),
+      GUINT_TO_POINTER (tier + 1));
+
+  remove_target_pad (pad);
+  kms_agnostic_bin2_link_pad (self, pad, peer);
+}
+
 /**
  * Process a pad for connecting or disconnecting, it should be always called
  * whint the agnostic lock hold.
@@ -787,7 +1547,7 @@ kms_agnostic_bin2_process_pad (KmsAgnosticBin2 * self, GstPad * pad)
 static void
 add_linked_pads (GstPad * pad, KmsAgnosticBin2 * self)
 {
-  if (!gst_pad_is_linked (pad)) {
+  if (!kms_agnostic_bin2_is_output (pad) || !gst_pad_is_linked (pad)) {
     return;
   }
 
@@ -839,10 +1599,529 @@ static void
 remove_bin (gpointer key, gpointer value, gpointer agnosticbin)
 {
   GST_DEBUG_OBJECT (agnosticbin, "Removing %" GST_PTR_FORMAT, value);
+  kms_agnostic_bin2_unindex_bin (KMS_AGNOSTIC_BIN2 (agnosticbin), value);
+  kms_agnostic_bin2_withdraw_encoder (KMS_AGNOSTIC_BIN2 (agnosticbin), value);
   gst_bin_remove (GST_BIN (agnosticbin), value);
   gst_element_set_state (value, GST_STATE_NULL);
+
+  if (KMS_IS_ENC_TREE_BIN (value)) {
+    kms_encoder_pool_release (KMS_ENC_TREE_BIN (value));
+  }
+}
+
+/* Unused encoders begin */
+
+static void
+check_pad_uses_encoder (GstPad * pad, gpointer data)
+{
+  gpointer *params = data;
+
+  if (g_object_get_qdata (G_OBJECT (pad), local_encoder_quark ()) ==
+      params[0]) {
+    params[1] = GINT_TO_POINTER (TRUE);
+  }
+}
+
+static gboolean
+check_bin_uses_encoder (gpointer key, GstBin * user, GstBin * bin)
+{
+  return g_object_get_qdata (G_OBJECT (user), local_encoder_quark ()) == bin;
+}
+
+static gboolean
+kms_agnostic_bin2_encoder_in_use (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  gpointer params[] = { bin, GINT_TO_POINTER (FALSE) };
+  KmsTranscoderRegistry *reg = self->priv->registry;
+
+  kms_element_for_each_src_pad (GST_ELEMENT (self), check_pad_uses_encoder,
+      params);
+
+  if (GPOINTER_TO_INT (params[1])) {
+    return TRUE;
+  }
+
+  /* RTP payloaders are fed by an encoder instead of an output */
+  if (g_hash_table_find (self->priv->bins, (GHRFunc) check_bin_uses_encoder,
+          bin) != NULL) {
+    return TRUE;
+  }
+
+  /* Other elements may be using it */
+  return reg != NULL && kms_transcoder_registry_has_subscribers (reg,
+      kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin)));
+}
+
+/* Removes the encoders no output uses any more, giving them back to the
+ * encoder pool */
+static void
+kms_agnostic_bin2_release_unused_encoders (gpointer data)
+{
+  KmsAgnosticBin2 *self = data;
+  GList *bins, *l;
+
+  KMS_AGNOSTIC_BIN2_LOCK (self);
+
+  bins = g_hash_table_get_values (self->priv->bins);
+  for (l = bins; l != NULL; l = l->next) {
+    GstBin *bin = l->data;
+
+    if (!KMS_IS_ENC_TREE_BIN (bin)
+        || kms_agnostic_bin2_encoder_in_use (self, bin)) {
+      continue;
+    }
+
+    GST_DEBUG_OBJECT (self, "No outputs left for %" GST_PTR_FORMAT, bin);
+    g_object_ref (bin);
+    kms_tree_bin_unlink_input_element_from_tee (KMS_TREE_BIN (bin));
+    g_hash_table_remove (self->priv->bins, GST_OBJECT_NAME (bin));
+    remove_bin (NULL, bin, self);
+    g_object_unref (bin);
+  }
+  g_list_free (bins);
+
+  KMS_AGNOSTIC_BIN2_UNLOCK (self);
+}
+
+/* The encoder of @pad is released later if no other output takes it in the
+ * meantime, as the pad is usually linked again right away */
+static void
+kms_agnostic_bin2_forget_encoder (GstPad * pad)
+{
+  KmsAgnosticBin2 *self = KMS_AGNOSTIC_BIN2 (GST_OBJECT_PARENT (pad));
+
+  if (g_object_get_qdata (G_OBJECT (pad), local_encoder_quark ()) == NULL) {
+    return;
+  }
+
+  g_object_set_qdata (G_OBJECT (pad), local_encoder_quark (), NULL);
+
+  if (self != NULL) {
+    kms_executor_queue_try_push (GST_OBJECT_GET_LOCK (self),
+        &self->priv->remove_queue, kms_agnostic_bin2_release_unused_encoders,
+        g_object_ref (self), g_object_unref);
+  }
+}
+
+/* Unused encoders end */
+
+/* Transcoder sharing begin */
+
+static KmsTranscoderRegistry *
+kms_agnostic_bin2_get_registry (KmsAgnosticBin2 * self)
+{
+  KmsTranscoderRegistry *reg;
+  guint stream;
+
+  reg = g_atomic_pointer_get (&self->priv->registry);
+  if (reg != NULL) {
+    return reg;
+  }
+
+  reg = kms_transcoder_registry_get (GST_ELEMENT (self));
+  if (reg == NULL) {
+    /* Not in a pipeline yet */
+    return NULL;
+  }
+
+  stream = kms_transcoder_registry_new_stream (reg);
+  self->priv->stream = stream;
+
+  if (!g_atomic_pointer_compare_and_exchange (&self->priv->registry, NULL,
+          reg)) {
+    kms_transcoder_registry_remove_stream (reg, stream);
+    kms_transcoder_registry_unref (reg);
+    reg = g_atomic_pointer_get (&self->priv->registry);
+  }
+
+  return reg;
+}
+
+static guint
+kms_agnostic_bin2_get_stream (KmsAgnosticBin2 * self)
+{
+  guint origin = g_atomic_int_get (&self->priv->origin_stream);
+
+  return origin != 0 ? origin : self->priv->stream;
+}
+
+static gchar *
+kms_agnostic_bin2_get_bitrate_class (KmsAgnosticBin2 * self)
+{
+  gchar *config = NULL, *bitrate_class;
+
+  if (self->priv->codec_config != NULL) {
+    config = gst_structure_to_string (self->priv->codec_config);
+  }
+
+  bitrate_class = g_strdup_printf ("%d-%d;%s", self->priv->min_bitrate,
+      self->priv->max_bitrate, config != NULL ? config : "");
+  g_free (config);
+
+  return bitrate_class;
+}
+
+static KmsTranscoderRegistry *
+kms_agnostic_bin2_sharing_registry (KmsAgnosticBin2 * self, GstCaps * caps)
+{
+  if (!self->priv->share_encoders || gst_caps_is_any (caps)
+      || gst_caps_is_empty (caps) || kms_utils_caps_are_raw (caps)
+      || kms_utils_caps_are_rtp (caps)) {
+    return NULL;
+  }
+
+  return kms_agnostic_bin2_get_registry (self);
 }
 
+static void
+kms_agnostic_bin2_publish_encoder (KmsAgnosticBin2 * self, GstCaps * caps,
+    KmsEncTreeBin * enc_bin)
+{
+  KmsTranscoderRegistry *reg;
+  gchar *bitrate_class;
+
+  reg = kms_agnostic_bin2_sharing_registry (self, caps);
+  if (reg == NULL) {
+    return;
+  }
+
+  g_object_set_qdata_full (G_OBJECT (enc_bin), encoder_caps_quark (),
+      gst_caps_copy (caps), (GDestroyNotify) gst_caps_unref);
+
+  bitrate_class = kms_agnostic_bin2_get_bitrate_class (self);
+  kms_transcoder_registry_publish (reg, kms_agnostic_bin2_get_stream (self),
+      caps, bitrate_class,
+      kms_tree_bin_get_output_tee (KMS_TREE_BIN (enc_bin)));
+  g_free (bitrate_class);
+}
+
+static void
+kms_agnostic_bin2_withdraw_encoder (KmsAgnosticBin2 * self, GstBin * bin)
+{
+  KmsTranscoderRegistry *reg = g_atomic_pointer_get (&self->priv->registry);
+
+  if (reg == NULL || !KMS_IS_ENC_TREE_BIN (bin)) {
+    return;
+  }
+
+  kms_transcoder_registry_withdraw (reg,
+      kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin)));
+}
+
+static void
+kms_agnostic_bin2_shared_encoder_released (GstPad * pad)
+{
+  GstElement *parent = gst_pad_get_parent_element (pad);
+  KmsAgnosticBin2 *self;
+
+  if (parent == NULL) {
+    return;
+  }
+
+  self = KMS_AGNOSTIC_BIN2 (parent);
+
+  KMS_AGNOSTIC_BIN2_LOCK (self);
+  if (g_object_get_qdata (G_OBJECT (pad), shared_encoder_quark ()) != NULL) {
+    GST_DEBUG_OBJECT (pad, "Shared encoder gone, relinking");
+    remove_target_pad (pad);
+    kms_agnostic_bin2_process_pad (self, pad);
+  }
+  KMS_AGNOSTIC_BIN2_UNLOCK (self);
+
+  g_object_unref (parent);
+}
+
+/* Returns a new reference to the output tee of an equivalent encoder owned
+ * by another element of the pipeline */
+static GstElement *
+kms_agnostic_bin2_subscribe_shared_encoder (KmsAgnosticBin2 * self,
+    GstPad * pad, GstCaps * caps)
+{
+  KmsTranscoderRegistry *reg;
+  gchar *bitrate_class;
+  GstElement *tee;
+
+  reg = kms_agnostic_bin2_sharing_registry (self, caps);
+  if (reg == NULL) {
+    return NULL;
+  }
+
+  bitrate_class = kms_agnostic_bin2_get_bitrate_class (self);
+  tee = kms_transcoder_registry_subscribe (reg,
+      kms_agnostic_bin2_get_stream (self), caps, bitrate_class,
+      GST_ELEMENT (self), pad, kms_agnostic_bin2_shared_encoder_released);
+  g_free (bitrate_class);
+
+  if (tee != NULL) {
+    GST_INFO_OBJECT (pad, "Using shared encoder %" GST_PTR_FORMAT, tee);
+    g_object_set_qdata (G_OBJECT (pad), shared_encoder_quark (), tee);
+  }
+
+  return tee;
+}
+
+static void
+kms_agnostic_bin2_unsubscribe_shared_encoder (GstPad * pad)
+{
+  KmsAgnosticBin2 *self = KMS_AGNOSTIC_BIN2 (GST_OBJECT_PARENT (pad));
+  KmsTranscoderRegistry *reg;
+
+  if (g_object_get_qdata (G_OBJECT (pad), shared_encoder_quark ()) == NULL) {
+    return;
+  }
+
+  g_object_set_qdata (G_OBJECT (pad), shared_encoder_quark (), NULL);
+  /* Unlinks the shared tee, which releases its pad */
+  g_object_set_qdata (G_OBJECT (pad), shared_ghosts_quark (), NULL);
+
+  reg = g_atomic_pointer_get (&self->priv->registry);
+  if (reg != NULL) {
+    kms_transcoder_registry_unsubscribe (reg, pad);
+  }
+}
+
+/* The shared tee belongs to another element, so it is exposed through ghost
+ * pads on its owner and on the bins in between, until the pad unsubscribes */
+static void
+kms_agnostic_bin2_link_shared_encoder (GstPad * pad, GstElement * tee,
+    GstElement * queue, gboolean keyframe_ready)
+{
+  GstPad *tee_src = gst_element_get_request_pad (tee, "src_%u");
+  GstPad *queue_sink = gst_element_get_static_pad (queue, "sink");
+  GSList *ghosts;
+
+  remove_element_on_unlinked (queue, "src", "sink");
+  g_signal_connect (tee_src, "unlinked", G_CALLBACK (remove_tee_pad_on_unlink),
+      NULL);
+  if (keyframe_ready) {
+    mark_keyframe_ready (tee_src);
+  }
+  gst_pad_add_probe (tee_src, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, tee_src_probe,
+      NULL, NULL);
+
+  if (kms_utils_link_pads_ghosting (tee_src, queue_sink, &ghosts)) {
+    g_object_set_qdata_full (G_OBJECT (pad), shared_ghosts_quark (), ghosts,
+        (GDestroyNotify) kms_utils_remove_ghost_pads);
+  } else {
+    gst_element_release_request_pad (tee, tee_src);
+  }
+
+  g_object_unref (queue_sink);
+  g_object_unref (tee_src);
+}
+
+static void
+relink_pad_if_encoder_retired (GstPad * pad, GSList * retired)
+{
+  KmsAgnosticBin2 *self = KMS_AGNOSTIC_BIN2 (GST_OBJECT_PARENT (pad));
+  gpointer enc_bin;
+  GstPad *peer;
+
+  enc_bin = g_object_get_qdata (G_OBJECT (pad), local_encoder_quark ());
+  if (enc_bin == NULL || g_slist_find (retired, enc_bin) == NULL) {
+    return;
+  }
+
+  peer = gst_pad_get_peer (pad);
+  if (peer == NULL) {
+    return;
+  }
+
+  remove_target_pad (pad);
+  kms_agnostic_bin2_link_pad (self, pad, peer);
+}
+
+/*
+ * The input has been found to be a stream already seen by another element.
+ * Encoders also existing there are retired and their outputs moved to the
+ * shared ones, the rest are published under the new stream. It should be
+ * always called with the agnostic lock held.
+ */
+static void
+kms_agnostic_bin2_adopt_stream (KmsAgnosticBin2 * self)
+{
+  KmsTranscoderRegistry *reg = self->priv->registry;
+  GSList *retired = NULL, *s;
+  gchar *bitrate_class;
+  GList *bins, *l;
+  guint stream;
+
+  stream = kms_agnostic_bin2_get_stream (self);
+  bitrate_class = kms_agnostic_bin2_get_bitrate_class (self);
+
+  bins = g_hash_table_get_values (self->priv->bins);
+  for (l = bins; l != NULL; l = l->next) {
+    GstElement *tee;
+    GstCaps *caps;
+
+    caps = g_object_get_qdata (G_OBJECT (l->data), encoder_caps_quark ());
+    if (caps == NULL) {
+      continue;
+    }
+
+    tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (l->data));
+    kms_transcoder_registry_withdraw (reg, tee);
+
+    if (kms_transcoder_registry_contains (reg, stream, caps, bitrate_class,
+            GST_ELEMENT (self))) {
+      GST_DEBUG_OBJECT (self, "Retiring %" GST_PTR_FORMAT, l->data);
+      retired = g_slist_prepend (retired, g_object_ref (l->data));
+      kms_tree_bin_unlink_input_element_from_tee (KMS_TREE_BIN (l->data));
+      g_hash_table_remove (self->priv->bins, GST_OBJECT_NAME (l->data));
+    } else {
+      kms_transcoder_registry_publish (reg, stream, caps, bitrate_class, tee);
+    }
+  }
+  g_list_free (bins);
+  g_free (bitrate_class);
+
+  if (retired == NULL) {
+    return;
+  }
+
+  kms_element_for_each_src_pad (GST_ELEMENT (self),
+      (KmsPadIterationAction) relink_pad_if_encoder_retired, retired);
+
+  for (s = retired; s != NULL; s = s->next) {
+    remove_bin (NULL, s->data, self);
+  }
+  g_slist_free_full (retired, g_object_unref);
+}
+
+static void
+kms_agnostic_bin2_adopt_stream_async (gpointer data)
+{
+  KmsAgnosticBin2 *self = data;
+
+  KMS_AGNOSTIC_BIN2_LOCK (self);
+  if (self->priv->registry != NULL
+      && g_atomic_int_get (&self->priv->origin_stream) != 0) {
+    kms_agnostic_bin2_adopt_stream (self);
+  }
+  KMS_AGNOSTIC_BIN2_UNLOCK (self);
+}
+
+static void
+release_shared_encoder (GstPad * pad, KmsAgnosticBin2 * self)
+{
+  GstPad *peer;
+
+  if (g_object_get_qdata (G_OBJECT (pad), shared_encoder_quark ()) == NULL) {
+    return;
+  }
+
+  peer = gst_pad_get_peer (pad);
+  remove_target_pad (pad);
+
+  if (peer != NULL) {
+    kms_agnostic_bin2_link_pad (self, pad, peer);
+  }
+}
+
+/*
+ * Input buffers are looked up in the registry only after a caps change, for
+ * as long as a stream lagging behind needs to be found. Other than that, the
+ * registry is only reached to sample one every few buffers.
+ */
+static GstPadProbeReturn
+kms_agnostic_bin2_sink_stream_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  KmsAgnosticBin2 *self = user_data;
+  KmsTranscoderRegistry *reg;
+  GstBuffer *buffer;
+  guint stream, observed;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = gst_pad_probe_info_get_event (info);
+    const gchar *stream_id;
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS) {
+      self->priv->observed = 0;
+      return GST_PAD_PROBE_OK;
+    }
+
+    if (GST_EVENT_TYPE (event) != GST_EVENT_STREAM_START) {
+      return GST_PAD_PROBE_OK;
+    }
+
+    gst_event_parse_stream_start (event, &stream_id);
+
+    KMS_AGNOSTIC_BIN2_LOCK (self);
+    if (g_strcmp0 (stream_id, self->priv->stream_id) != 0) {
+      /* Different source, outputs cannot be shared on its behalf any more */
+      g_free (self->priv->stream_id);
+      self->priv->stream_id = g_strdup (stream_id);
+      self->priv->observed = 0;
+
+      if (g_atomic_int_get (&self->priv->origin_stream) != 0) {
+        g_atomic_int_set (&self->priv->origin_stream, 0);
+        kms_element_for_each_src_pad (GST_ELEMENT (self),
+            (KmsPadIterationAction) release_shared_encoder, self);
+      }
+    }
+    KMS_AGNOSTIC_BIN2_UNLOCK (self);
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (!self->priv->share_encoders
+      || g_atomic_int_get (&self->priv->origin_stream) != 0) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  observed = self->priv->observed++;
+  if (observed >= KMS_TRANSCODER_REGISTRY_LOOKUP_BUFFERS
+      && observed % KMS_TRANSCODER_REGISTRY_SAMPLE_INTERVAL != 0) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  reg = kms_agnostic_bin2_get_registry (self);
+  if (reg == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  } else {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    if (gst_buffer_list_length (list) == 0) {
+      return GST_PAD_PROBE_OK;
+    }
+
+    buffer = gst_buffer_list_get (list, 0);
+  }
+
+  if (observed < KMS_TRANSCODER_REGISTRY_LOOKUP_BUFFERS) {
+    stream = kms_transcoder_registry_lookup (reg, self->priv->stream, buffer);
+
+    if (stream != self->priv->stream) {
+      GST_INFO_OBJECT (self, "Input already seen as stream %u, sharing "
+          "encoders", stream);
+
+      /* Encoders are retired and outputs relinked out of the streaming
+       * thread */
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_atomic_int_set (&self->priv->origin_stream, stream);
+      kms_executor_queue_try_push (GST_OBJECT_GET_LOCK (self),
+          &self->priv->remove_queue, kms_agnostic_bin2_adopt_stream_async,
+          g_object_ref (self), g_object_unref);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+
+      return GST_PAD_PROBE_OK;
+    }
+  }
+
+  if (observed % KMS_TRANSCODER_REGISTRY_SAMPLE_INTERVAL == 0) {
+    kms_transcoder_registry_sample (reg, self->priv->stream, buffer);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* Transcoder sharing end */
+
 static void
 kms_agnostic_bin2_configure_input (KmsAgnosticBin2 * self, const GstCaps * caps)
 {
@@ -850,6 +2129,7 @@ kms_agnostic_bin2_configure_input (KmsAgnosticBin2 * self, const GstCaps * caps)
   GstElement *parser;
   GstPad *parser_src;
   GstElement *input_element;
+  guint i;
 
   KMS_AGNOSTIC_BIN2_LOCK (self);
 
@@ -878,6 +2158,9 @@ kms_agnostic_bin2_configure_input (KmsAgnosticBin2 * self, const GstCaps * caps)
   GST_DEBUG ("Removing old treebins");
   g_hash_table_foreach (self->priv->bins, remove_bin, self);
   g_hash_table_remove_all (self->priv->bins);
+  for (i = 0; i < LADDER_TIERS; i++) {
+    self->priv->ladder_scalers[i] = NULL;
+  }
 
   KMS_AGNOSTIC_BIN2_UNLOCK (self);
 }
@@ -947,6 +2230,7 @@ kms_agnostic_bin2_src_reconfigure_probe (GstPad * pad, GstPadProbeInfo * info,
 {
   KmsAgnosticBin2 *self = KMS_AGNOSTIC_BIN2 (gst_pad_get_parent_element (pad));
   GstPadProbeReturn ret = GST_PAD_PROBE_OK;
+  guint bitrate, ssrc;
   GstEvent *event;
 
   if (self == NULL) {
@@ -965,6 +2249,10 @@ kms_agnostic_bin2_src_reconfigure_probe (GstPad * pad, GstPadProbeInfo * info,
       GST_OBJECT_FLAG_SET (pad, KMS_AGNOSTIC_PAD_STARTED);
       kms_agnostic_bin2_process_pad (self, pad);
       KMS_AGNOSTIC_BIN2_UNLOCK (self);
+    } else if (kms_utils_remb_event_upstream_parse (event, &bitrate, &ssrc)) {
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      kms_agnostic_bin2_ladder_remb (self, pad, bitrate);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
     }
   }
 
@@ -1028,11 +2316,20 @@ static void
 kms_agnostic_bin2_dispose (GObject * object)
 {
   KmsAgnosticBin2 *self = KMS_AGNOSTIC_BIN2 (object);
+  KmsExecutorQueue *queue;
 
   GST_DEBUG_OBJECT (object, "dispose");
 
+  GST_OBJECT_LOCK (self);
+  queue = self->priv->remove_queue;
+  self->priv->remove_queue = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (queue != NULL) {
+    kms_executor_queue_free (queue);
+  }
+
   KMS_AGNOSTIC_BIN2_LOCK (self);
-  g_thread_pool_free (self->priv->remove_pool, FALSE, FALSE);
 
   if (self->priv->input_bin_src_caps) {
     gst_caps_unref (self->priv->input_bin_src_caps);
@@ -1049,6 +2346,20 @@ kms_agnostic_bin2_dispose (GObject * object)
     self->priv->codec_config = NULL;
   }
 
+  /* Encoders are withdrawn and given back to the encoder pool */
+  g_hash_table_foreach (self->priv->bins, remove_bin, self);
+  g_hash_table_remove_all (self->priv->bins);
+
+  if (self->priv->registry) {
+    kms_transcoder_registry_remove_stream (self->priv->registry,
+        self->priv->stream);
+    kms_transcoder_registry_unref (self->priv->registry);
+    self->priv->registry = NULL;
+  }
+
+  g_free (self->priv->stream_id);
+  self->priv->stream_id = NULL;
+
   KMS_AGNOSTIC_BIN2_UNLOCK (self);
 
   /* chain up */
@@ -1065,6 +2376,7 @@ kms_agnostic_bin2_finalize (GObject * object)
   g_rec_mutex_clear (&self->priv->thread_mutex);
 
   g_hash_table_unref (self->priv->bins);
+  kms_caps_index_destroy (self->priv->caps_index);
 
   /* chain up */
   G_OBJECT_CLASS (kms_agnostic_bin2_parent_class)->finalize (object);
@@ -1077,7 +2389,21 @@ kms_agnostic_bin_set_encoders_bitrate (KmsAgnosticBin2 * self)
 
   bins = g_hash_table_get_values (self->priv->bins);
   for (l = bins; l != NULL; l = l->next) {
-    if (KMS_IS_ENC_TREE_BIN (l->data)) {
+    guint tier;
+
+    if (!KMS_IS_ENC_TREE_BIN (l->data)) {
+      continue;
+    }
+
+    tier = GPOINTER_TO_UINT (g_object_get_qdata (G_OBJECT (l->data),
+            ladder_tier_quark ()));
+
+    if (tier > 0) {
+      gint bitrate = kms_agnostic_bin2_ladder_bitrate (self, tier - 1);
+
+      kms_enc_tree_bin_set_bitrate_limits (KMS_ENC_TREE_BIN (l->data),
+          bitrate, bitrate);
+    } else {
       kms_enc_tree_bin_set_bitrate_limits (KMS_ENC_TREE_BIN (l->data),
           self->priv->min_bitrate, self->priv->max_bitrate);
     }
@@ -1140,6 +2466,31 @@ kms_agnostic_bin2_set_property (GObject * object, guint property_id,
       self->priv->codec_config = g_value_dup_boxed (value);
       KMS_AGNOSTIC_BIN2_UNLOCK (self);
       break;
+    case PROP_LADDER:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->ladder = g_value_get_boolean (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_SHARE_ENCODERS:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->share_encoders = g_value_get_boolean (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_DIRECT_PASSTHROUGH:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->direct_passthrough = g_value_get_boolean (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->gop_cache_size = g_value_get_uint (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_MAX_DECODE_LATENESS:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      self->priv->max_decode_lateness = g_value_get_int64 (value);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1172,6 +2523,35 @@ kms_agnostic_bin2_get_property (GObject * object, guint property_id,
       g_value_set_boxed (value, self->priv->codec_config);
       KMS_AGNOSTIC_BIN2_UNLOCK (self);
       break;
+    case PROP_KEY_FRAME_REQUESTS:
+      g_value_take_boxed (value,
+          kms_utils_get_key_frames_request_stats (self->priv->sink));
+      break;
+    case PROP_LADDER:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_boolean (value, self->priv->ladder);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_SHARE_ENCODERS:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_boolean (value, self->priv->share_encoders);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_DIRECT_PASSTHROUGH:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_boolean (value, self->priv->direct_passthrough);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_GOP_CACHE_SIZE:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_uint (value, self->priv->gop_cache_size);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
+    case PROP_MAX_DECODE_LATENESS:
+      KMS_AGNOSTIC_BIN2_LOCK (self);
+      g_value_set_int64 (value, self->priv->max_decode_lateness);
+      KMS_AGNOSTIC_BIN2_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -1222,6 +2602,40 @@ kms_agnostic_bin2_class_init (KmsAgnosticBin2Class * klass)
       g_param_spec_boxed ("codec-config", "codec config",
           "Codec configuration", GST_TYPE_STRUCTURE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_KEY_FRAME_REQUESTS,
+      g_param_spec_boxed ("key-frame-requests", "key frame requests",
+          "Keyframe requests received from the outputs: requested, forwarded "
+          "upstream and suppressed", GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class, PROP_LADDER,
+      g_param_spec_boolean ("ladder", "ladder",
+          "Transcode video once per resolution tier, from one decoder and "
+          "cascaded scalers, and serve each output the tier fitting its REMB",
+          FALSE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_SHARE_ENCODERS,
+      g_param_spec_boolean ("share-encoders", "share encoders",
+          "Share encoders with the elements of the pipeline whose input is "
+          "the same stream", SHARE_ENCODERS_DEFAULT, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_DIRECT_PASSTHROUGH,
+      g_param_spec_boolean ("direct-passthrough", "direct passthrough",
+          "Link a single passthrough output without a queue, in the "
+          "streaming thread of the input", DIRECT_PASSTHROUGH_DEFAULT,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE_SIZE,
+      g_param_spec_uint ("gop-cache-size", "GOP cache size",
+          "Maximum bytes of the last GOP kept to start new outputs without "
+          "waiting for a keyframe (0 = disabled)", 0, G_MAXUINT, 0,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_DECODE_LATENESS,
+      g_param_spec_int64 ("max-decode-lateness", "max decode lateness",
+          "Lateness (ns) from which frames are dropped before being decoded "
+          "when transcoding cannot keep up (-1 = never drop)", -1,
+          G_MAXINT64, MAX_DECODE_LATENESS_DEFAULT, G_PARAM_READWRITE));
+
   GST_DEBUG_CATEGORY_INIT (GST_CAT_DEFAULT, PLUGIN_NAME, 0, PLUGIN_NAME);
 
   g_type_class_add_private (klass, sizeof (KmsAgnosticBin2Private));
@@ -1307,6 +2721,8 @@ kms_agnostic_bin2_init (KmsAgnosticBin2 * self)
 
   self->priv = KMS_AGNOSTIC_BIN2_GET_PRIVATE (self);
 
+  kms_encoder_pool_warm_up ();
+
   tee = gst_element_factory_make ("tee", NULL);
   self->priv->input_tee = tee;
   fakesink = gst_element_factory_make ("fakesink", NULL);
@@ -1324,6 +2740,11 @@ kms_agnostic_bin2_init (KmsAgnosticBin2 * self)
   gst_pad_set_chain_list_function (self->priv->sink,
       kms_agnostic_bin2_sink_chain_list);
   kms_utils_manage_gaps (self->priv->sink);
+  /* Every output shares the source, merge their keyframe requests */
+  kms_utils_control_key_frames_request_duplicates (self->priv->sink);
+  gst_pad_add_probe (self->priv->sink, GST_PAD_PROBE_TYPE_BUFFER |
+      GST_PAD_PROBE_TYPE_BUFFER_LIST | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      kms_agnostic_bin2_sink_stream_probe, self, NULL);
   g_object_unref (templ);
   g_object_unref (target);
 
@@ -1335,14 +2756,18 @@ kms_agnostic_bin2_init (KmsAgnosticBin2 * self)
   gst_element_add_pad (GST_ELEMENT (self), self->priv->sink);
 
   self->priv->started = FALSE;
-  self->priv->remove_pool =
-      g_thread_pool_new (remove_on_unlinked_async, NULL, -1, FALSE, NULL);
+  self->priv->remove_queue = kms_executor_queue_new ();
   self->priv->bins =
       g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+  self->priv->caps_index = kms_caps_index_new ();
   g_rec_mutex_init (&self->priv->thread_mutex);
   self->priv->min_bitrate = MIN_BITRATE_DEFAULT;
   self->priv->max_bitrate = MAX_BITRATE_DEFAULT;
   self->priv->bitrate_unlimited = FALSE;
+  self->priv->ladder = FALSE;
+  self->priv->share_encoders = SHARE_ENCODERS_DEFAULT;
+  self->priv->direct_passthrough = DIRECT_PASSTHROUGH_DEFAULT;
+  self->priv->max_decode_lateness = MAX_DECODE_LATENESS_DEFAULT;
 }
 
 gboolean
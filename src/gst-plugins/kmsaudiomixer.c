@@ -20,16 +20,27 @@
 #endif
 
 #include <gst/gst.h>
+#include <string.h>
 
 #include "kmsaudiomixer.h"
-#include "kmsloop.h"
 #include "kmsrefstruct.h"
 #include "kmsagnosticbin.h"
+#include "kmsmixminus.h"
 
 #define PLUGIN_NAME "kmsaudiomixer"
 
 #define LATENCY 150             //ms
 
+#define MAX_SPEAKERS_DEFAULT 0
+
+enum
+{
+  PROP_0,
+  PROP_MAX_SPEAKERS,
+  PROP_CAPS,
+  N_PROPERTIES
+};
+
 #define KMS_AUDIO_MIXER_LOCK(mixer) \
   (g_rec_mutex_lock (&(mixer)->priv->mutex))
 
@@ -50,14 +61,14 @@ GST_DEBUG_CATEGORY_STATIC (kms_audio_mixer_debug_category);
 #define KEY_SINK_PAD_NAME "kms-key-sink-pad-name"
 G_DEFINE_QUARK (KEY_SINK_PAD_NAME, key_sink_pad_name);
 
-#define KEY_TEE "tee-key"
-G_DEFINE_QUARK (KEY_TEE, key_tee);
-
 #define KEY_FAKESINK "fakesink-key"
 G_DEFINE_QUARK (KEY_FAKESINK, key_fakesink);
 
-#define KEY_SRC "src-key"
-G_DEFINE_QUARK (KEY_SRC, key_src);
+#define KEY_MIX_PAD "mix-pad-key"
+G_DEFINE_QUARK (KEY_MIX_PAD, key_mix_pad);
+
+#define KEY_CAPSFILTER "capsfilter-key"
+G_DEFINE_QUARK (KEY_CAPSFILTER, key_capsfilter);
 
 #define KEY_PAD "pad-key"
 G_DEFINE_QUARK (KEY_PAD, key_pad);
@@ -65,11 +76,11 @@ G_DEFINE_QUARK (KEY_PAD, key_pad);
 struct _KmsAudioMixerPrivate
 {
   GRecMutex mutex;
-  GHashTable *adders;
+  GstElement *mixer;
+  GHashTable *outputs;
   GHashTable *agnostics;
   GHashTable *typefinds;
   GstCaps *filtercaps;
-  KmsLoop *loop;
   guint count;
 };
 
@@ -91,7 +102,6 @@ GST_STATIC_PAD_TEMPLATE (AUDIO_SRC_PAD,
     );
 
 static void unlink_agnosticbin (GstElement * agnosticbin);
-static void unlink_adder_sources (GstElement * adder);
 
 /* class initialization */
 
@@ -100,154 +110,80 @@ G_DEFINE_TYPE_WITH_CODE (KmsAudioMixer, kms_audio_mixer,
     GST_DEBUG_CATEGORY_INIT (kms_audio_mixer_debug_category,
         PLUGIN_NAME, 0, "debug category for " PLUGIN_NAME " element"));
 
-static GstPadProbeReturn
-cb_latency (GstPad * pad, GstPadProbeInfo * info, gpointer data)
-{
-  if (GST_QUERY_TYPE (GST_PAD_PROBE_INFO_QUERY (info)) != GST_QUERY_LATENCY) {
-    return GST_PAD_PROBE_OK;
-  }
-
-  GST_LOG_OBJECT (pad, "Modifing latency query. New latency %ld",
-      LATENCY * GST_MSECOND);
-
-  gst_query_set_latency (GST_PAD_PROBE_INFO_QUERY (info),
-      TRUE, 0, LATENCY * GST_MSECOND);
-
-  return GST_PAD_PROBE_HANDLED;
-}
-
 static GstElement *
 kms_audio_selector_create_capsfilter (KmsAudioMixer * self)
 {
   GstElement *capsfilter = gst_element_factory_make ("capsfilter", NULL);
 
-  if (!self->priv->filtercaps) {
-    self->priv->filtercaps =
-        gst_caps_new_simple ("audio/x-raw", "format", G_TYPE_STRING, "S16LE",
-        "rate", G_TYPE_INT, 48000, "channels", G_TYPE_INT, 2, NULL);
-  }
   g_object_set (G_OBJECT (capsfilter), "caps", self->priv->filtercaps, NULL);
 
   return capsfilter;
 }
 
 static void
-link_new_agnosticbin (gchar * key, GstElement * adder, GstElement * agnosticbin)
+link_agnosticbin (KmsAudioMixer * self, GstElement * agnosticbin,
+    GstPad * mixpad)
 {
-  GstPad *srcpad = NULL, *sinkpad = NULL;
-  char *padname;
-  KmsAudioMixer *self = KMS_AUDIO_MIXER (GST_OBJECT_PARENT (agnosticbin));
+  GstPad *srcpad, *capsfilter_src;
   GstElement *capsfilter;
 
-  padname =
-      g_object_get_qdata (G_OBJECT (agnosticbin), key_sink_pad_name_quark ());
-  if (padname == NULL) {
-    GST_ERROR ("No pad associated with %" GST_PTR_FORMAT, agnosticbin);
-    goto end;
-  }
-
-  if (g_str_equal (key, padname)) {
-    /* Do not connect the origin audio input */
-    GST_TRACE ("Do not connect echo audio input %" GST_PTR_FORMAT, agnosticbin);
-    goto end;
-  }
-
   srcpad = gst_element_get_request_pad (agnosticbin, "src_%u");
   if (srcpad == NULL) {
     GST_ERROR ("Could not get src pad in %" GST_PTR_FORMAT, agnosticbin);
-    goto end;
-  }
-
-  sinkpad = gst_element_get_request_pad (adder, "sink_%u");
-  if (sinkpad == NULL) {
-    GST_ERROR ("Could not get sink pad in %" GST_PTR_FORMAT, adder);
-    gst_element_release_request_pad (agnosticbin, srcpad);
-    goto end;
+    return;
   }
 
-  GST_DEBUG ("Linking %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, srcpad,
-      sinkpad);
-
-  gst_pad_add_probe (sinkpad,
-      GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
-      (GstPadProbeCallback) cb_latency, NULL, NULL);
-
   capsfilter = kms_audio_selector_create_capsfilter (self);
 
   gst_bin_add (GST_BIN (self), capsfilter);
   gst_element_sync_state_with_parent (capsfilter);
 
-  gst_element_link_pads (capsfilter, NULL, adder, GST_OBJECT_NAME (sinkpad));
-  gst_element_link_pads (agnosticbin, GST_OBJECT_NAME (srcpad), capsfilter,
-      NULL);
+  GST_DEBUG ("Linking %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, srcpad,
+      mixpad);
 
-end:
-  if (srcpad != NULL) {
-    g_object_unref (srcpad);
+  capsfilter_src = gst_element_get_static_pad (capsfilter, "src");
+  if (gst_pad_link (capsfilter_src, mixpad) != GST_PAD_LINK_OK) {
+    GST_ERROR ("Could not link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT,
+        capsfilter_src, mixpad);
   }
+  g_object_unref (capsfilter_src);
 
-  if (sinkpad != NULL) {
-    g_object_unref (sinkpad);
-  }
+  gst_element_link_pads (agnosticbin, GST_OBJECT_NAME (srcpad), capsfilter,
+      NULL);
+  g_object_set_qdata (G_OBJECT (agnosticbin), key_capsfilter_quark (),
+      capsfilter);
+
+  g_object_unref (srcpad);
 }
 
-static void
-link_new_adder (gchar * key, GstElement * agnosticbin, GstElement * adder)
+/* Upstream elements are asked for the mixing format, so that they convert
+ * once, if needed, and the inputs reach the mixer without converters */
+static gboolean
+kms_audio_mixer_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
 {
-  char *padname;
-  GstPad *srcpad = NULL, *sinkpad = NULL;
-  KmsAudioMixer *self = KMS_AUDIO_MIXER (GST_OBJECT_PARENT (adder));
-  GstElement *capsfilter;
+  KmsAudioMixer *self = KMS_AUDIO_MIXER (parent);
+  GstCaps *filter, *caps;
 
-  padname = g_object_get_qdata (G_OBJECT (adder), key_sink_pad_name_quark ());
-  if (padname == NULL) {
-    GST_ERROR ("No pad associated with %" GST_PTR_FORMAT, adder);
-    return;
-  }
-
-  if (g_str_equal (key, padname)) {
-    /* Do not connect the origin audio input */
-    GST_TRACE ("Do not connect echo audio input %" GST_PTR_FORMAT, agnosticbin);
-    return;
+  if (GST_QUERY_TYPE (query) != GST_QUERY_CAPS) {
+    return gst_proxy_pad_query_default (pad, parent, query);
   }
 
-  GST_DEBUG ("Linking %s to %s", GST_ELEMENT_NAME (agnosticbin),
-      GST_ELEMENT_NAME (adder));
+  gst_query_parse_caps (query, &filter);
 
-  srcpad = gst_element_get_request_pad (agnosticbin, "src_%u");
-  if (srcpad == NULL) {
-    GST_ERROR ("Could not get src pad in %" GST_PTR_FORMAT, agnosticbin);
-    goto end;
-  }
-
-  sinkpad = gst_element_get_request_pad (adder, "sink_%u");
-  if (sinkpad == NULL) {
-    GST_ERROR ("Could not get sink pad in %" GST_PTR_FORMAT, adder);
-    gst_element_release_request_pad (agnosticbin, srcpad);
-    goto end;
+  KMS_AUDIO_MIXER_LOCK (self);
+  if (filter != NULL) {
+    caps = gst_caps_intersect_full (filter, self->priv->filtercaps,
+        GST_CAPS_INTERSECT_FIRST);
+  } else {
+    caps = gst_caps_ref (self->priv->filtercaps);
   }
+  KMS_AUDIO_MIXER_UNLOCK (self);
 
-  gst_pad_add_probe (sinkpad,
-      GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
-      (GstPadProbeCallback) cb_latency, NULL, NULL);
-
-  capsfilter = kms_audio_selector_create_capsfilter (self);
-
-  gst_bin_add (GST_BIN (self), capsfilter);
-  gst_element_sync_state_with_parent (capsfilter);
-
-  gst_element_link_pads (capsfilter, NULL, adder, GST_OBJECT_NAME (sinkpad));
-  gst_element_link_pads (agnosticbin, GST_OBJECT_NAME (srcpad), capsfilter,
-      NULL);
-
-end:
-  if (srcpad != NULL) {
-    g_object_unref (srcpad);
-  }
+  gst_query_set_caps_result (query, caps);
+  gst_caps_unref (caps);
 
-  if (sinkpad != NULL) {
-    g_object_unref (sinkpad);
-  }
+  return TRUE;
 }
 
 static gint
@@ -270,26 +206,17 @@ get_stream_id_from_padname (const gchar * name)
 
 static void
 kms_audio_mixer_remove_sometimes_src_pad (KmsAudioMixer * self,
-    GstElement * adder)
+    GstElement * tee)
 {
-  GstPad *pad, *peer = NULL, *adder_src;
+  GstPad *pad;
 
-  pad = g_object_get_qdata (G_OBJECT (adder), key_pad_quark ());
-  g_object_set_qdata (G_OBJECT (adder), key_pad_quark (), NULL);
+  pad = g_object_get_qdata (G_OBJECT (tee), key_pad_quark ());
+  g_object_set_qdata (G_OBJECT (tee), key_pad_quark (), NULL);
 
   if (!pad) {
     return;
   }
 
-  adder_src = gst_element_get_static_pad (adder, "src");
-  if (adder_src) {
-    peer = gst_pad_get_peer (adder_src);
-
-    if (peer) {
-      gst_pad_send_event (peer, gst_event_new_flush_start ());
-    }
-  }
-
   gst_ghost_pad_set_target (GST_GHOST_PAD (pad), NULL);
 
   if (GST_STATE (self) < GST_STATE_PAUSED
@@ -301,15 +228,6 @@ kms_audio_mixer_remove_sometimes_src_pad (KmsAudioMixer * self,
   GST_DEBUG ("Removing source pad %" GST_PTR_FORMAT, pad);
 
   gst_element_remove_pad (GST_ELEMENT (self), GST_PAD (pad));
-
-  if (peer) {
-    gst_pad_send_event (peer, gst_event_new_flush_stop (FALSE));
-    g_object_unref (peer);
-  }
-
-  if (adder_src) {
-    g_object_unref (adder_src);
-  }
 }
 
 static void
@@ -322,43 +240,39 @@ remove_element (GstBin * bin, GstElement * element)
   gst_object_unref (element);
 }
 
-static gboolean
-remove_adder (GstElement * adder)
+static void
+remove_output (GstElement * tee)
 {
   KmsAudioMixer *self;
-  GstElement *fakesink, *tee, *testsrc;
+  GstElement *fakesink;
+  GstPad *mixpad;
 
-  self = (KmsAudioMixer *) gst_element_get_parent (adder);
+  self = (KmsAudioMixer *) gst_element_get_parent (tee);
   if (self == NULL) {
-    GST_WARNING_OBJECT (adder, "No parent element");
-    return FALSE;
+    GST_WARNING_OBJECT (tee, "No parent element");
+    return;
   }
 
-  GST_DEBUG ("Removing element %" GST_PTR_FORMAT, adder);
+  GST_DEBUG ("Removing element %" GST_PTR_FORMAT, tee);
 
-  kms_audio_mixer_remove_sometimes_src_pad (self, adder);
+  kms_audio_mixer_remove_sometimes_src_pad (self, tee);
 
-  tee = g_object_get_qdata (G_OBJECT (adder), key_tee_quark ());
-  fakesink = g_object_get_qdata (G_OBJECT (adder), key_fakesink_quark ());
-  testsrc = g_object_get_qdata (G_OBJECT (adder), key_src_quark ());
+  fakesink = g_object_get_qdata (G_OBJECT (tee), key_fakesink_quark ());
+  mixpad = g_object_steal_qdata (G_OBJECT (tee), key_mix_pad_quark ());
 
-  if (testsrc) {
-    remove_element (GST_BIN (self), testsrc);
+  if (mixpad != NULL) {
+    /* Also removes the mixer source pad linked to the tee */
+    gst_element_release_request_pad (self->priv->mixer, mixpad);
+    g_object_unref (mixpad);
   }
 
-  remove_element (GST_BIN (self), adder);
-
-  if (tee) {
-    remove_element (GST_BIN (self), tee);
-  }
+  remove_element (GST_BIN (self), tee);
 
   if (fakesink) {
     remove_element (GST_BIN (self), fakesink);
   }
 
   gst_object_unref (self);
-
-  return G_SOURCE_REMOVE;
 }
 
 static void
@@ -438,12 +352,9 @@ end:
 }
 
 static gboolean
-remove_adder_cb (gpointer key, gpointer value, gpointer user_data)
+remove_output_cb (gpointer key, gpointer value, gpointer user_data)
 {
-  GstElement *adder = GST_ELEMENT (value);
-
-  unlink_adder_sources (adder);
-  remove_adder (adder);
+  remove_output (GST_ELEMENT (value));
 
   return TRUE;
 }
@@ -475,10 +386,10 @@ kms_audio_mixer_dispose (GObject * object)
     self->priv->agnostics = NULL;
   }
 
-  if (self->priv->adders != NULL) {
-    g_hash_table_foreach_remove (self->priv->adders, remove_adder_cb, self);
-    g_hash_table_unref (self->priv->adders);
-    self->priv->adders = NULL;
+  if (self->priv->outputs != NULL) {
+    g_hash_table_foreach_remove (self->priv->outputs, remove_output_cb, self);
+    g_hash_table_unref (self->priv->outputs);
+    self->priv->outputs = NULL;
   }
 
   if (self->priv->filtercaps) {
@@ -486,8 +397,6 @@ kms_audio_mixer_dispose (GObject * object)
     self->priv->filtercaps = NULL;
   }
 
-  g_clear_object (&self->priv->loop);
-
   KMS_AUDIO_MIXER_UNLOCK (self);
 
   G_OBJECT_CLASS (kms_audio_mixer_parent_class)->dispose (object);
@@ -511,7 +420,7 @@ kms_audio_mixer_have_type (GstElement * typefind, guint arg0, GstCaps * caps,
     gpointer data)
 {
   KmsAudioMixer *self = KMS_AUDIO_MIXER (data);
-  GstElement *audiorate, *agnosticbin;
+  GstElement *audiorate, *agnosticbin, *tee;
   gchar *padname;
   gint id;
 
@@ -539,8 +448,11 @@ kms_audio_mixer_have_type (GstElement * typefind, guint arg0, GstCaps * caps,
   gst_bin_add_many (GST_BIN (self), audiorate, agnosticbin, NULL);
   gst_element_link_many (typefind, audiorate, agnosticbin, NULL);
 
-  g_hash_table_foreach (self->priv->adders, (GHFunc) link_new_agnosticbin,
-      agnosticbin);
+  tee = g_hash_table_lookup (self->priv->outputs, padname);
+  if (tee != NULL) {
+    link_agnosticbin (self, agnosticbin,
+        g_object_get_qdata (G_OBJECT (tee), key_mix_pad_quark ()));
+  }
 
   g_hash_table_insert (self->priv->agnostics, g_strdup (padname), agnosticbin);
 
@@ -555,38 +467,30 @@ static void
 unlink_agnosticbin_source (const GValue * item, gpointer user_data)
 {
   GstElement *capsfilter = NULL, *agnosticbin = GST_ELEMENT (user_data);
-  GstPad *srcpad, *sinkpad = NULL, *capsfilter_src = NULL, *capsfilter_sink;
-  GstElement *adder = NULL;
+  GstPad *srcpad, *sinkpad = NULL, *capsfilter_src = NULL;
 
   srcpad = g_value_get_object (item);
 
-  capsfilter_sink = gst_pad_get_peer (srcpad);
-  if (capsfilter_sink == NULL) {
+  capsfilter = g_object_steal_qdata (G_OBJECT (agnosticbin),
+      key_capsfilter_quark ());
+  if (capsfilter == NULL) {
     GST_WARNING_OBJECT (srcpad, "Not linked");
     goto end;
   }
 
-  capsfilter = gst_pad_get_parent_element (capsfilter_sink);
   capsfilter_src = gst_element_get_static_pad (capsfilter, "src");
   sinkpad = gst_pad_get_peer (capsfilter_src);
 
-  g_object_unref (capsfilter_sink);
-
-  adder = gst_pad_get_parent_element (sinkpad);
-  if (adder == NULL) {
-    GST_ERROR_OBJECT (sinkpad, "No parent element");
-    goto end;
-  }
-
-  GST_DEBUG ("Unlink %" GST_PTR_FORMAT " and %" GST_PTR_FORMAT,
-      srcpad, sinkpad);
-
-  if (!gst_pad_unlink (capsfilter_src, sinkpad)) {
-    GST_ERROR ("Can not unlink %" GST_PTR_FORMAT " and %" GST_PTR_FORMAT,
+  if (sinkpad != NULL) {
+    GST_DEBUG ("Unlink %" GST_PTR_FORMAT " and %" GST_PTR_FORMAT,
         srcpad, sinkpad);
+
+    if (!gst_pad_unlink (capsfilter_src, sinkpad)) {
+      GST_ERROR ("Can not unlink %" GST_PTR_FORMAT " and %" GST_PTR_FORMAT,
+          srcpad, sinkpad);
+    }
   }
 
-  gst_element_release_request_pad (adder, sinkpad);
   gst_element_release_request_pad (agnosticbin, srcpad);
 
 end:
@@ -594,18 +498,12 @@ end:
     gst_object_unref (sinkpad);
   }
 
-  if (adder != NULL) {
-    gst_object_unref (adder);
-  }
-
   if (capsfilter_src) {
     g_object_unref (capsfilter_src);
   }
 
   if (capsfilter) {
-    gst_bin_remove (GST_BIN (GST_OBJECT_PARENT (capsfilter)), capsfilter);
-    gst_element_set_state (capsfilter, GST_STATE_NULL);
-    g_object_unref (capsfilter);
+    remove_element (GST_BIN (GST_OBJECT_PARENT (capsfilter)), capsfilter);
   }
 }
 
@@ -626,7 +524,7 @@ unlink_agnosticbin (GstElement * agnosticbin)
 
 static void
 kms_audio_mixer_remove_elements (KmsAudioMixer * self,
-    GstElement * agnosticbin, GstElement * adder)
+    GstElement * agnosticbin, GstElement * tee)
 {
   /* Unlink elements holding the mutex to avoid race */
   /* condition under massive disconnections */
@@ -636,97 +534,21 @@ kms_audio_mixer_remove_elements (KmsAudioMixer * self,
     unlink_agnosticbin (agnosticbin);
   }
 
-  if (adder != NULL) {
-    unlink_adder_sources (adder);
-  }
-
   KMS_AUDIO_MIXER_UNLOCK (self);
 
   if (agnosticbin != NULL) {
     remove_agnostic_bin (agnosticbin);
   }
 
-  if (adder != NULL) {
-    remove_adder (adder);
-  }
-}
-
-static void
-unlink_adder_sink (const GValue * item, gpointer user_data)
-{
-  GstElement *capsfilter = NULL, *adder = GST_ELEMENT (user_data);
-  GstPad *sinkpad, *srcpad = NULL, *capsfilter_src = NULL, *capsfilter_sink;
-  GstElement *src = NULL;
-
-  sinkpad = g_value_get_object (item);
-
-  capsfilter_src = gst_pad_get_peer (sinkpad);
-  if (capsfilter_src == NULL) {
-    GST_WARNING_OBJECT (sinkpad, "Not linked");
-    goto end;
-  }
-
-  capsfilter = gst_pad_get_parent_element (capsfilter_src);
-  capsfilter_sink = gst_element_get_static_pad (capsfilter, "sink");
-  srcpad = gst_pad_get_peer (capsfilter_sink);
-
-  g_object_unref (capsfilter_sink);
-
-  src = gst_pad_get_parent_element (srcpad);
-  if (src == NULL) {
-    GST_ERROR_OBJECT (srcpad, "No parent element");
-    goto end;
-  }
-
-  GST_DEBUG ("Unlink %" GST_PTR_FORMAT " and %" GST_PTR_FORMAT,
-      srcpad, sinkpad);
-
-  if (!gst_pad_unlink (capsfilter_src, sinkpad)) {
-    GST_ERROR ("Can not unlink %" GST_PTR_FORMAT " and %" GST_PTR_FORMAT,
-        srcpad, sinkpad);
-  }
-
-  gst_element_release_request_pad (adder, sinkpad);
-
-  if (GST_PAD_TEMPLATE_PRESENCE (GST_PAD_PAD_TEMPLATE (srcpad)) ==
-      GST_PAD_REQUEST) {
-    gst_element_release_request_pad (src, srcpad);
-  }
-
-end:
-  g_clear_object (&srcpad);
-  g_clear_object (&src);
-
-  if (capsfilter_src) {
-    g_object_unref (capsfilter_src);
-  }
-
-  if (capsfilter) {
-    gst_bin_remove (GST_BIN (GST_OBJECT_PARENT (capsfilter)), capsfilter);
-    gst_element_set_state (capsfilter, GST_STATE_NULL);
-    g_object_unref (capsfilter);
-  }
-}
-
-static void
-unlink_adder_sources (GstElement * adder)
-{
-  GstIterator *it;
-
-  it = gst_element_iterate_sink_pads (adder);
-
-  while (gst_iterator_foreach (it, unlink_adder_sink,
-          adder) == GST_ITERATOR_RESYNC) {
-    gst_iterator_resync (it);
+  if (tee != NULL) {
+    remove_output (tee);
   }
-
-  gst_iterator_free (it);
 }
 
 static void
 unlinked_pad (GstPad * pad, GstPad * peer, gpointer user_data)
 {
-  GstElement *agnostic = NULL, *adder = NULL, *typefind = NULL, *parent;
+  GstElement *agnostic = NULL, *tee = NULL, *typefind = NULL, *parent;
   KmsAudioMixer *self;
   gchar *padname;
 
@@ -755,9 +577,9 @@ unlinked_pad (GstPad * pad, GstPad * peer, gpointer user_data)
     g_hash_table_remove (self->priv->agnostics, padname);
   }
 
-  if (self->priv->adders != NULL) {
-    adder = g_hash_table_lookup (self->priv->adders, padname);
-    g_hash_table_remove (self->priv->adders, padname);
+  if (self->priv->outputs != NULL) {
+    tee = g_hash_table_lookup (self->priv->outputs, padname);
+    g_hash_table_remove (self->priv->outputs, padname);
   }
 
   KMS_AUDIO_MIXER_UNLOCK (self);
@@ -769,17 +591,17 @@ unlinked_pad (GstPad * pad, GstPad * peer, gpointer user_data)
       || GST_STATE_TARGET (parent) >= GST_STATE_PAUSED) {
     if (typefind != NULL) {
       GST_WARNING_OBJECT (pad, "Removed before connecting branch");
-      kms_audio_mixer_remove_elements (self, agnostic, adder);
+      kms_audio_mixer_remove_elements (self, agnostic, tee);
       gst_object_ref (typefind);
       gst_element_set_locked_state (typefind, TRUE);
       gst_element_set_state (typefind, GST_STATE_NULL);
       gst_bin_remove (GST_BIN (self), typefind);
       gst_object_unref (typefind);
     } else {
-      kms_audio_mixer_remove_elements (self, agnostic, adder);
+      kms_audio_mixer_remove_elements (self, agnostic, tee);
     }
   } else {
-    kms_audio_mixer_remove_elements (self, agnostic, adder);
+    kms_audio_mixer_remove_elements (self, agnostic, tee);
   }
 
   gst_ghost_pad_set_target (GST_GHOST_PAD (pad), NULL);
@@ -812,10 +634,8 @@ remove_target_cb (GstPad * pad, GstPad * peer, gpointer tee)
 static gboolean
 kms_audio_mixer_add_src_pad (KmsAudioMixer * self, const char *padname)
 {
-  GstPad *srcpad = NULL, *pad, *sinkpad = NULL;
-  GstElement *adder;
-  GstElement *audiotestsrc;
-  GstElement *tee, *fakesink, *capsfilter;
+  GstPad *srcpad, *pad, *mixpad;
+  GstElement *tee, *fakesink;
   gchar *srcname;
   gint id;
 
@@ -824,70 +644,42 @@ kms_audio_mixer_add_src_pad (KmsAudioMixer * self, const char *padname)
     return FALSE;
   }
 
-  adder = gst_element_factory_make ("audiomixer", NULL);
+  mixpad = gst_element_get_request_pad (self->priv->mixer,
+      MIX_MINUS_SINK_PAD_PREFIX "%u");
+  if (mixpad == NULL) {
+    GST_ERROR ("Could not get sink pad in %" GST_PTR_FORMAT,
+        self->priv->mixer);
+    return FALSE;
+  }
+
+  /* The mixer names each output after its input */
+  srcname = g_strconcat (MIX_MINUS_SRC_PAD_PREFIX,
+      GST_OBJECT_NAME (mixpad) + strlen (MIX_MINUS_SINK_PAD_PREFIX), NULL);
+  srcpad = gst_element_get_static_pad (self->priv->mixer, srcname);
+  g_free (srcname);
+
   tee = gst_element_factory_make ("tee", NULL);
   fakesink = gst_element_factory_make ("fakesink", NULL);
 
   g_object_set (tee, "allow-not-linked", TRUE, NULL);
   g_object_set (fakesink, "sync", FALSE, "async", FALSE, NULL);
-  g_object_set (adder, "latency", LATENCY * GST_MSECOND, NULL);
-
-  g_object_set_qdata_full (G_OBJECT (adder), key_sink_pad_name_quark (),
-      g_strdup (padname), g_free);
-  audiotestsrc = gst_element_factory_make ("audiotestsrc", NULL);
-  g_object_set (audiotestsrc, "is-live", TRUE, "wave", /*silence */ 4, NULL);
-
-  capsfilter = kms_audio_selector_create_capsfilter (self);
-
-  gst_bin_add_many (GST_BIN (self), audiotestsrc, capsfilter, adder, tee,
-      fakesink, NULL);
 
-  gst_element_link (audiotestsrc, capsfilter);
-  srcpad = gst_element_get_static_pad (capsfilter, "src");
-  if (srcpad == NULL) {
-    GST_ERROR ("Could not get src pad in %" GST_PTR_FORMAT, audiotestsrc);
-    goto no_audiotestsrc;
-  }
-
-  sinkpad = gst_element_get_request_pad (adder, "sink_%u");
-  if (sinkpad == NULL) {
-    GST_ERROR ("Could not get sink pad in %" GST_PTR_FORMAT, adder);
-    goto no_audiotestsrc;
-  }
-
-  gst_pad_add_probe (sinkpad,
-      GST_PAD_PROBE_TYPE_QUERY_UPSTREAM,
-      (GstPadProbeCallback) cb_latency, NULL, NULL);
+  gst_bin_add_many (GST_BIN (self), tee, fakesink, NULL);
+  gst_element_link (tee, fakesink);
 
-  GST_DEBUG ("Linking %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, srcpad,
-      sinkpad);
-
-  if (gst_pad_link (srcpad, sinkpad) != GST_PAD_LINK_OK) {
-    GST_ERROR ("Could not link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, srcpad,
-        sinkpad);
-    gst_element_release_request_pad (adder, sinkpad);
-  }
-
-  gst_element_link_many (adder, tee, fakesink, NULL);
-
-no_audiotestsrc:
-  if (srcpad != NULL) {
-    g_object_unref (srcpad);
-  }
-  if (sinkpad != NULL) {
-    g_object_unref (sinkpad);
+  if (!gst_element_link_pads (self->priv->mixer, GST_OBJECT_NAME (srcpad),
+          tee, NULL)) {
+    GST_ERROR ("Could not link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT,
+        srcpad, tee);
   }
+  g_object_unref (srcpad);
 
   gst_element_sync_state_with_parent (fakesink);
   gst_element_sync_state_with_parent (tee);
-  gst_element_sync_state_with_parent (capsfilter);
-  gst_element_sync_state_with_parent (adder);
-  gst_element_sync_state_with_parent (audiotestsrc);
 
   KMS_AUDIO_MIXER_LOCK (self);
 
-  g_hash_table_foreach (self->priv->agnostics, (GHFunc) link_new_adder, adder);
-  g_hash_table_insert (self->priv->adders, g_strdup (padname), adder);
+  g_hash_table_insert (self->priv->outputs, g_strdup (padname), tee);
 
   srcname = g_strdup_printf ("src_%u", id);
 
@@ -897,10 +689,9 @@ no_audiotestsrc:
       0);
   g_free (srcname);
 
-  g_object_set_qdata (G_OBJECT (adder), key_tee_quark (), tee);
-  g_object_set_qdata (G_OBJECT (adder), key_fakesink_quark (), fakesink);
-  g_object_set_qdata (G_OBJECT (adder), key_pad_quark (), pad);
-  g_object_set_qdata (G_OBJECT (adder), key_src_quark (), audiotestsrc);
+  g_object_set_qdata (G_OBJECT (tee), key_fakesink_quark (), fakesink);
+  g_object_set_qdata (G_OBJECT (tee), key_pad_quark (), pad);
+  g_object_set_qdata (G_OBJECT (tee), key_mix_pad_quark (), mixpad);
 
   if (GST_STATE (self) >= GST_STATE_PAUSED
       || GST_STATE_PENDING (self) >= GST_STATE_PAUSED
@@ -915,18 +706,13 @@ no_audiotestsrc:
 
   /* ERROR */
   GST_ERROR_OBJECT (self, "Can not add pad %" GST_PTR_FORMAT, pad);
-  g_hash_table_remove (self->priv->adders, padname);
+  g_hash_table_remove (self->priv->outputs, padname);
+  g_object_set_qdata (G_OBJECT (tee), key_pad_quark (), NULL);
 
   KMS_AUDIO_MIXER_UNLOCK (self);
 
-  unlink_adder_sources (adder);
-
   gst_object_unref (pad);
-
-  gst_element_set_locked_state (adder, TRUE);
-  gst_element_set_state (adder, GST_STATE_NULL);
-
-  gst_bin_remove (GST_BIN (self), adder);
+  remove_output (tee);
 
   return FALSE;
 }
@@ -961,6 +747,7 @@ kms_audio_mixer_request_new_pad (GstElement * element,
 
   pad = gst_ghost_pad_new (padname, sinkpad);
   g_object_unref (sinkpad);
+  gst_pad_set_query_function (pad, kms_audio_mixer_sink_query);
 
   if (GST_STATE (element) >= GST_STATE_PAUSED
       || GST_STATE_PENDING (element) >= GST_STATE_PAUSED
@@ -1021,6 +808,53 @@ kms_audio_mixer_release_pad (GstElement * element, GstPad * pad)
   gst_element_remove_pad (element, pad);
 }
 
+static void
+kms_audio_mixer_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsAudioMixer *self = KMS_AUDIO_MIXER (object);
+
+  switch (property_id) {
+    case PROP_MAX_SPEAKERS:
+      g_object_set_property (G_OBJECT (self->priv->mixer), "max-speakers",
+          value);
+      break;
+    case PROP_CAPS:
+      /* The mixer refuses formats it can not mix or changes with inputs */
+      KMS_AUDIO_MIXER_LOCK (self);
+      g_object_set_property (G_OBJECT (self->priv->mixer), "caps", value);
+      gst_caps_unref (self->priv->filtercaps);
+      g_object_get (self->priv->mixer, "caps", &self->priv->filtercaps, NULL);
+      KMS_AUDIO_MIXER_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+kms_audio_mixer_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsAudioMixer *self = KMS_AUDIO_MIXER (object);
+
+  switch (property_id) {
+    case PROP_MAX_SPEAKERS:
+      g_object_get_property (G_OBJECT (self->priv->mixer), "max-speakers",
+          value);
+      break;
+    case PROP_CAPS:
+      KMS_AUDIO_MIXER_LOCK (self);
+      g_value_set_boxed (value, self->priv->filtercaps);
+      KMS_AUDIO_MIXER_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
 static void
 kms_audio_mixer_class_init (KmsAudioMixerClass * klass)
 {
@@ -1041,9 +875,25 @@ kms_audio_mixer_class_init (KmsAudioMixerClass * klass)
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&audio_src_factory));
 
+  gobject_class->set_property = kms_audio_mixer_set_property;
+  gobject_class->get_property = kms_audio_mixer_get_property;
   gobject_class->dispose = GST_DEBUG_FUNCPTR (kms_audio_mixer_dispose);
   gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_audio_mixer_finalize);
 
+  g_object_class_install_property (gobject_class, PROP_MAX_SPEAKERS,
+      g_param_spec_uint ("max-speakers", "Max speakers",
+          "Only mix the loudest participants, up to this number (0 mixes all)."
+          " Levels come from the RFC 6464 audio level RTP header extension"
+          " or are measured from the samples",
+          0, G_MAXUINT, MAX_SPEAKERS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CAPS,
+      g_param_spec_boxed ("caps", "Caps",
+          "Format used to mix the participants (S16LE or F32LE). Defaults to"
+          " 48 kHz mono F32LE, suited to voice. Set it before adding pads",
+          GST_TYPE_CAPS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /* Registers a private structure for the instantiatable type */
   g_type_class_add_private (klass, sizeof (KmsAudioMixerPrivate));
 }
@@ -1053,15 +903,19 @@ kms_audio_mixer_init (KmsAudioMixer * self)
 {
   self->priv = KMS_AUDIO_MIXER_GET_PRIVATE (self);
 
-  self->priv->adders = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
-      NULL);
+  self->priv->outputs = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
   self->priv->agnostics =
       g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
   self->priv->typefinds =
       g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   g_rec_mutex_init (&self->priv->mutex);
-  self->priv->loop = kms_loop_new ();
+
+  self->priv->mixer = gst_element_factory_make ("kmsmixminus", NULL);
+  g_object_set (self->priv->mixer, "latency", LATENCY * GST_MSECOND, NULL);
+  g_object_get (self->priv->mixer, "caps", &self->priv->filtercaps, NULL);
+  gst_bin_add (GST_BIN (self), self->priv->mixer);
 }
 
 gboolean
@@ -22,7 +22,7 @@
 #include <gst/gst.h>
 
 #include "kmsaudiomixerbin.h"
-#include "kmsloop.h"
+#include "kmsexecutor.h"
 
 #define PLUGIN_NAME "audiomixerbin"
 
@@ -51,7 +51,7 @@ struct _KmsAudioMixerBinPrivate
 {
   GstElement *adder;
   GRecMutex mutex;
-  KmsLoop *loop;
+  KmsExecutorQueue *remove_queue;
   GstPad *srcpad;
   guint count;
 };
@@ -299,7 +299,7 @@ kms_audio_mixer_bin_remove_elements (KmsAudioMixerBin * self,
   gst_bin_remove_many (GST_BIN (self), typefind, agnosticbin, NULL);
 }
 
-static gboolean
+static void
 remove_elements (RefCounter * refdata)
 {
   ProbeData *data;
@@ -310,8 +310,6 @@ remove_elements (RefCounter * refdata)
       data->agnosticbin);
   kms_audio_mixer_bin_remove_elements (data->audiomixer, data->typefind,
       data->agnosticbin);
-
-  return G_SOURCE_REMOVE;
 }
 
 static GstElement *
@@ -408,9 +406,9 @@ event_probe_cb (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
 
   /* We can not access to some GstPad functions because of mutex deadlocks */
   /* So we are going to manage all the stuff in a separate thread */
-  kms_loop_idle_add_full (data->audiomixer->priv->loop, G_PRIORITY_DEFAULT,
-      (GSourceFunc) remove_elements, ref_counter_inc (refdata),
-      (GDestroyNotify) ref_counter_dec);
+  kms_executor_queue_try_push (GST_OBJECT_GET_LOCK (data->audiomixer),
+      &data->audiomixer->priv->remove_queue, (KmsExecutorFunc) remove_elements,
+      ref_counter_inc (refdata), (GDestroyNotify) ref_counter_dec);
 
   return GST_PAD_PROBE_DROP;
 }
@@ -626,13 +624,22 @@ static void
 kms_audio_mixer_bin_dispose (GObject * object)
 {
   KmsAudioMixerBin *self = KMS_AUDIO_MIXER_BIN (object);
+  KmsExecutorQueue *queue;
 
   GST_DEBUG_OBJECT (self, "dispose");
 
   KMS_AUDIO_MIXER_BIN_LOCK (self);
 
   kms_audio_mixer_bin_tear_down (self);
-  g_clear_object (&self->priv->loop);
+
+  GST_OBJECT_LOCK (self);
+  queue = self->priv->remove_queue;
+  self->priv->remove_queue = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  if (queue != NULL) {
+    kms_executor_queue_free (queue);
+  }
 
   KMS_AUDIO_MIXER_BIN_UNLOCK (self);
 
@@ -696,7 +703,7 @@ kms_audio_mixer_bin_init (KmsAudioMixerBin * self)
   gst_element_sync_state_with_parent (self->priv->adder);
 
   g_rec_mutex_init (&self->priv->mutex);
-  self->priv->loop = kms_loop_new ();
+  self->priv->remove_queue = kms_executor_queue_new ();
 }
 
 gboolean
@@ -23,6 +23,8 @@
 #include <kmsfilterelement.h>
 #include <kmsaudiomixer.h>
 #include <kmsaudiomixerbin.h>
+#include <kmsmixminus.h>
+#include <kmsselectivehub.h>
 #include <kmsbitratefilter.h>
 #include <kmsbufferinjector.h>
 #include <kmspassthrough.h>
@@ -54,6 +56,12 @@ kurento_init (GstPlugin * kurento)
   if (!kms_audio_mixer_bin_plugin_init (kurento))
     return FALSE;
 
+  if (!kms_mix_minus_plugin_init (kurento))
+    return FALSE;
+
+  if (!kms_selective_hub_plugin_init (kurento))
+    return FALSE;
+
   if (!kms_bitrate_filter_plugin_init (kurento))
     return FALSE;
 
@@ -0,0 +1,1336 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "kmsmixminus.h"
+#include "kmsmixkernels.h"
+#include "kmsaudiolevelmeta.h"
+
+#define PLUGIN_NAME "kmsmixminus"
+
+GST_DEBUG_CATEGORY_STATIC (kms_mix_minus_debug_category);
+#define GST_CAT_DEFAULT kms_mix_minus_debug_category
+
+#define KMS_MIX_MINUS_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (          \
+    (obj),                               \
+    KMS_TYPE_MIX_MINUS,                  \
+    KmsMixMinusPrivate                   \
+  )                                      \
+)
+
+#define KMS_MIX_MINUS_LOCK(self) \
+  (g_mutex_lock (&(self)->priv->mutex))
+
+#define KMS_MIX_MINUS_UNLOCK(self) \
+  (g_mutex_unlock (&(self)->priv->mutex))
+
+#define TICK_DURATION (10 * GST_MSECOND)
+/* Audio kept for each input, enough to cover the latency */
+#define RING_DURATION (500 * GST_MSECOND)
+
+/* Voice rooms: mono float, whose frames are already planar */
+#define CAPS_DEFAULT "audio/x-raw, format=(string)F32LE, rate=(int)48000, " \
+  "channels=(int)1, layout=(string)interleaved"
+#define LATENCY_DEFAULT (150 * GST_MSECOND)
+#define MAX_SPEAKERS_DEFAULT 0
+
+/* Weight of each buffer in the power of an input */
+#define POWER_SMOOTHING 0.3
+/* Power advantage of inputs being mixed, 3 dB */
+#define SPEAKER_HYSTERESIS 2.0
+
+enum
+{
+  PROP_0,
+  PROP_CAPS,
+  PROP_LATENCY,
+  PROP_MAX_SPEAKERS,
+  N_PROPERTIES
+};
+
+typedef struct _KmsMixMinusInput
+{
+  GstPad *sinkpad;
+  GstPad *srcpad;
+  GstSegment segment;
+
+  /* Audio received from @start to @end, in frames of running time */
+  guint8 *ring;
+  guint64 start;
+  guint64 end;
+  gboolean has_data;
+
+  /* Contribution to the tick being mixed */
+  guint8 *tick;
+  gboolean active;
+
+  /* Smoothed power, to choose the loudest speakers */
+  gdouble power;
+  gdouble score;
+  gboolean selected;
+  gboolean speaking;
+
+  /* Level under which the input is not decoded upstream */
+  guint8 gate_level;
+
+  gboolean need_events;
+  gboolean discont;
+} KmsMixMinusInput;
+
+typedef struct _KmsMixMinusOutput
+{
+  GstPad *srcpad;
+  GstBuffer *buffer;
+  GstCaps *caps;
+} KmsMixMinusOutput;
+
+typedef struct _KmsMixMinusGate
+{
+  GstPad *sinkpad;
+  guint8 level;
+} KmsMixMinusGate;
+
+struct _KmsMixMinusPrivate
+{
+  GMutex mutex;
+  GList *inputs;
+  guint count;
+
+  GstCaps *caps;
+  gboolean f32;
+  gint rate;
+  gint bpf;                     /* bytes per frame */
+  guint samples;                /* samples in a tick, of all the channels */
+  guint tick_frames;
+  guint ring_frames;
+  gpointer mix;
+
+  GstClockTime latency;
+  GstClockTime upstream_latency;
+  guint max_speakers;
+  GPtrArray *ranking;
+
+  GstTask *task;
+  GRecMutex task_lock;
+  GstClockID clock_id;
+  gboolean flushing;
+  gboolean started;
+  guint64 position;             /* first frame of the next tick */
+};
+
+static GstStaticPadTemplate sink_factory =
+GST_STATIC_PAD_TEMPLATE (MIX_MINUS_SINK_PAD_PREFIX "%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("audio/x-raw")
+    );
+
+static GstStaticPadTemplate src_factory =
+GST_STATIC_PAD_TEMPLATE (MIX_MINUS_SRC_PAD_PREFIX "%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS ("audio/x-raw")
+    );
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (KmsMixMinus, kms_mix_minus,
+    GST_TYPE_ELEMENT,
+    GST_DEBUG_CATEGORY_INIT (kms_mix_minus_debug_category,
+        PLUGIN_NAME, 0, "debug category for " PLUGIN_NAME " element"));
+
+static GstClockTime
+kms_mix_minus_frames_to_time (KmsMixMinus * self, guint64 frames)
+{
+  return gst_util_uint64_scale (frames, GST_SECOND, self->priv->rate);
+}
+
+static guint64
+kms_mix_minus_time_to_frames (KmsMixMinus * self, GstClockTime time)
+{
+  return gst_util_uint64_scale_round (time, self->priv->rate, GST_SECOND);
+}
+
+static gboolean
+kms_mix_minus_set_format (KmsMixMinus * self, GstCaps * caps)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  GstStructure *st;
+  const gchar *format, *layout;
+  gint rate, channels, width;
+
+  if (caps == NULL || !gst_caps_is_fixed (caps)) {
+    return FALSE;
+  }
+
+  st = gst_caps_get_structure (caps, 0);
+  format = gst_structure_get_string (st, "format");
+
+  if (!gst_structure_has_name (st, "audio/x-raw") || format == NULL
+      || !gst_structure_get_int (st, "rate", &rate)
+      || !gst_structure_get_int (st, "channels", &channels)
+      || rate <= 0 || channels <= 0) {
+    return FALSE;
+  }
+
+  /* Samples are mixed in frame order, planar only fits a single channel */
+  layout = gst_structure_get_string (st, "layout");
+  if (layout != NULL && !g_str_equal (layout, "interleaved") && channels > 1) {
+    return FALSE;
+  }
+
+  if (g_str_equal (format, "S16LE")) {
+    priv->f32 = FALSE;
+    width = sizeof (gint16);
+  } else if (g_str_equal (format, "F32LE")) {
+    priv->f32 = TRUE;
+    width = sizeof (gfloat);
+  } else {
+    return FALSE;
+  }
+
+  gst_caps_replace (&priv->caps, caps);
+  priv->rate = rate;
+  priv->bpf = width * channels;
+  priv->tick_frames = kms_mix_minus_time_to_frames (self, TICK_DURATION);
+  priv->ring_frames = kms_mix_minus_time_to_frames (self, RING_DURATION);
+  priv->samples = priv->tick_frames * channels;
+
+  /* Both the S16 accumulator and the F32 mix use 32 bits samples */
+  g_free (priv->mix);
+  priv->mix = g_malloc0 (priv->samples * sizeof (gint32));
+
+  return TRUE;
+}
+
+/* Latency of the outputs: the configured one over the maximum of the live
+ * inputs. Must be called with the lock held */
+static GstClockTime
+kms_mix_minus_get_latency (KmsMixMinus * self)
+{
+  return self->priv->latency + self->priv->upstream_latency;
+}
+
+static GstClockTime
+kms_mix_minus_query_upstream_latency (KmsMixMinus * self)
+{
+  GstClockTime upstream = 0;
+  GList *pads = NULL, *l;
+
+  KMS_MIX_MINUS_LOCK (self);
+  for (l = self->priv->inputs; l != NULL; l = l->next) {
+    pads = g_list_prepend (pads,
+        g_object_ref (((KmsMixMinusInput *) l->data)->sinkpad));
+  }
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  for (l = pads; l != NULL; l = l->next) {
+    GstQuery *query = gst_query_new_latency ();
+    GstClockTime min, max;
+    gboolean live;
+
+    if (gst_pad_peer_query (l->data, query)) {
+      gst_query_parse_latency (query, &live, &min, &max);
+
+      if (live && GST_CLOCK_TIME_IS_VALID (min)) {
+        upstream = MAX (upstream, min);
+      }
+    }
+
+    gst_query_unref (query);
+  }
+  g_list_free_full (pads, g_object_unref);
+
+  return upstream;
+}
+
+/* Ring buffers begin */
+
+static void
+kms_mix_minus_ring_write (KmsMixMinus * self, guint8 * ring, guint64 pos,
+    const guint8 * data, guint64 frames)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+
+  while (frames > 0) {
+    guint offset = pos % priv->ring_frames;
+    guint chunk = MIN (frames, priv->ring_frames - offset);
+
+    if (data != NULL) {
+      memcpy (ring + offset * priv->bpf, data, chunk * priv->bpf);
+      data += chunk * priv->bpf;
+    } else {
+      memset (ring + offset * priv->bpf, 0, chunk * priv->bpf);
+    }
+
+    pos += chunk;
+    frames -= chunk;
+  }
+}
+
+static void
+kms_mix_minus_ring_read (KmsMixMinus * self, const guint8 * ring,
+    guint64 pos, guint8 * data, guint64 frames)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+
+  while (frames > 0) {
+    guint offset = pos % priv->ring_frames;
+    guint chunk = MIN (frames, priv->ring_frames - offset);
+
+    memcpy (data, ring + offset * priv->bpf, chunk * priv->bpf);
+    data += chunk * priv->bpf;
+    pos += chunk;
+    frames -= chunk;
+  }
+}
+
+static void
+kms_mix_minus_input_write (KmsMixMinus * self, KmsMixMinusInput * input,
+    guint64 pos, const guint8 * data, guint64 frames)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  guint64 end = pos + frames;
+
+  if (priv->started && pos < priv->position) {
+    if (end <= priv->position) {
+      GST_LOG_OBJECT (input->sinkpad, "Dropping audio arrived too late");
+      return;
+    }
+
+    data += (priv->position - pos) * priv->bpf;
+    pos = priv->position;
+  }
+
+  if (!input->has_data) {
+    input->start = input->end = pos;
+    input->has_data = TRUE;
+  } else if (pos < input->end) {
+    /* Overlaps audio already stored */
+    if (end <= input->end) {
+      return;
+    }
+
+    data += (input->end - pos) * priv->bpf;
+    pos = input->end;
+  } else if (pos - input->end >= priv->ring_frames) {
+    input->start = input->end = pos;
+  } else if (pos > input->end) {
+    /* Missing audio is silence */
+    kms_mix_minus_ring_write (self, input->ring, input->end, NULL,
+        pos - input->end);
+  }
+
+  /* Keep only the newest audio when the input gets too far ahead */
+  if (end - pos > priv->ring_frames) {
+    data += (end - priv->ring_frames - pos) * priv->bpf;
+    pos = end - priv->ring_frames;
+  }
+
+  kms_mix_minus_ring_write (self, input->ring, pos, data, end - pos);
+  input->end = end;
+
+  if (input->end - input->start > priv->ring_frames) {
+    input->start = input->end - priv->ring_frames;
+  }
+}
+
+static gboolean
+kms_mix_minus_input_read (KmsMixMinus * self, KmsMixMinusInput * input)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  guint64 end = priv->position + priv->tick_frames;
+  guint64 from, to;
+
+  if (!input->has_data) {
+    return FALSE;
+  }
+
+  from = MAX (priv->position, input->start);
+  to = MIN (end, input->end);
+
+  if (from >= to) {
+    return FALSE;
+  }
+
+  if (from > priv->position || to < end) {
+    memset (input->tick, 0, priv->tick_frames * priv->bpf);
+  }
+
+  kms_mix_minus_ring_read (self, input->ring, from,
+      input->tick + (from - priv->position) * priv->bpf, to - from);
+
+  return TRUE;
+}
+
+/* Ring buffers end */
+
+/* Mixing begins */
+
+static void
+kms_mix_minus_output_free (KmsMixMinusOutput * output)
+{
+  g_object_unref (output->srcpad);
+
+  if (output->buffer != NULL) {
+    gst_buffer_unref (output->buffer);
+  }
+
+  if (output->caps != NULL) {
+    gst_caps_unref (output->caps);
+  }
+
+  g_slice_free (KmsMixMinusOutput, output);
+}
+
+static void
+kms_mix_minus_gate_free (KmsMixMinusGate * gate)
+{
+  g_object_unref (gate->sinkpad);
+  g_slice_free (KmsMixMinusGate, gate);
+}
+
+static gint
+kms_mix_minus_compare_score (gconstpointer a, gconstpointer b)
+{
+  const KmsMixMinusInput *ia = *(KmsMixMinusInput **) a;
+  const KmsMixMinusInput *ib = *(KmsMixMinusInput **) b;
+
+  return (ia->score < ib->score) - (ia->score > ib->score);
+}
+
+/* When every place is taken, inputs not mixed are asked not to decode audio
+ * that could not replace the quietest speaker */
+static void
+kms_mix_minus_update_gates (KmsMixMinus * self, GQueue * gates)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  gdouble min_power = G_MAXDOUBLE;
+  gboolean full;
+  GList *l;
+  guint i;
+
+  full = priv->max_speakers > 0 && priv->ranking->len == priv->max_speakers;
+
+  for (i = 0; full && i < priv->ranking->len; i++) {
+    KmsMixMinusInput *input = g_ptr_array_index (priv->ranking, i);
+
+    min_power = MIN (min_power, input->power);
+  }
+
+  for (l = priv->inputs; l != NULL; l = l->next) {
+    KmsMixMinusInput *input = l->data;
+    guint8 level = KMS_AUDIO_LEVEL_SILENCE;
+    KmsMixMinusGate *gate;
+
+    if (full && !input->selected) {
+      level = kms_audio_level_from_power (min_power * SPEAKER_HYSTERESIS);
+    }
+
+    if (level == input->gate_level) {
+      continue;
+    }
+
+    input->gate_level = level;
+
+    gate = g_slice_new0 (KmsMixMinusGate);
+    gate->sinkpad = g_object_ref (input->sinkpad);
+    gate->level = level;
+    g_queue_push_tail (gates, gate);
+  }
+}
+
+static void
+kms_mix_minus_select_speakers (KmsMixMinus * self, GQueue * gates)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  GList *l;
+  guint i;
+
+  g_ptr_array_set_size (priv->ranking, 0);
+
+  for (l = priv->inputs; l != NULL; l = l->next) {
+    KmsMixMinusInput *input = l->data;
+
+    input->selected = FALSE;
+
+    if (!input->active) {
+      continue;
+    }
+
+    /* Current speakers are only replaced by clearly louder ones */
+    input->score = input->power * (input->speaking ? SPEAKER_HYSTERESIS : 1.0);
+    g_ptr_array_add (priv->ranking, input);
+  }
+
+  if (priv->max_speakers > 0 && priv->ranking->len > priv->max_speakers) {
+    g_ptr_array_sort (priv->ranking, kms_mix_minus_compare_score);
+    g_ptr_array_set_size (priv->ranking, priv->max_speakers);
+  }
+
+  for (i = 0; i < priv->ranking->len; i++) {
+    ((KmsMixMinusInput *) g_ptr_array_index (priv->ranking, i))->selected =
+        TRUE;
+  }
+
+  for (l = priv->inputs; l != NULL; l = l->next) {
+    KmsMixMinusInput *input = l->data;
+
+    if (input->active && input->selected != input->speaking) {
+      GST_DEBUG_OBJECT (input->sinkpad, "%s mixed",
+          input->selected ? "Now" : "No longer");
+    }
+
+    if (input->active) {
+      input->speaking = input->selected;
+    }
+  }
+
+  kms_mix_minus_update_gates (self, gates);
+}
+
+static GstBuffer *
+kms_mix_minus_new_buffer (KmsMixMinus * self, KmsMixMinusInput * input)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  const guint8 *own = NULL;
+  GstBuffer *buffer;
+  GstClockTime pts;
+  GstMapInfo info;
+
+  if (input != NULL && input->selected) {
+    own = input->tick;
+  }
+
+  buffer = gst_buffer_new_allocate (NULL, priv->tick_frames * priv->bpf, NULL);
+
+  gst_buffer_map (buffer, &info, GST_MAP_WRITE);
+  if (priv->f32) {
+    kms_mix_kernels_subtract_f32 ((gfloat *) info.data, priv->mix,
+        (const gfloat *) own, priv->samples);
+  } else {
+    kms_mix_kernels_subtract_s16 ((gint16 *) info.data, priv->mix,
+        (const gint16 *) own, priv->samples);
+  }
+  gst_buffer_unmap (buffer, &info);
+
+  pts = kms_mix_minus_frames_to_time (self, priv->position);
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DURATION (buffer) =
+      kms_mix_minus_frames_to_time (self,
+      priv->position + priv->tick_frames) - pts;
+
+  return buffer;
+}
+
+static void
+kms_mix_minus_mix (KmsMixMinus * self, GQueue * outputs, GQueue * gates)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  GstBuffer *full_mix = NULL;
+  GList *l;
+
+  memset (priv->mix, 0, priv->samples * sizeof (gint32));
+
+  for (l = priv->inputs; l != NULL; l = l->next) {
+    KmsMixMinusInput *input = l->data;
+
+    input->active = kms_mix_minus_input_read (self, input);
+  }
+
+  kms_mix_minus_select_speakers (self, gates);
+
+  for (l = priv->inputs; l != NULL; l = l->next) {
+    KmsMixMinusInput *input = l->data;
+
+    if (!input->selected) {
+      continue;
+    }
+
+    if (priv->f32) {
+      kms_mix_kernels_accumulate_f32 (priv->mix,
+          (const gfloat *) input->tick, priv->samples);
+    } else {
+      kms_mix_kernels_accumulate_s16 (priv->mix,
+          (const gint16 *) input->tick, priv->samples);
+    }
+  }
+
+  for (l = priv->inputs; l != NULL; l = l->next) {
+    KmsMixMinusInput *input = l->data;
+    KmsMixMinusOutput *output;
+
+    if (!gst_pad_is_linked (input->srcpad)) {
+      continue;
+    }
+
+    output = g_slice_new0 (KmsMixMinusOutput);
+    output->srcpad = g_object_ref (input->srcpad);
+
+    if (input->selected) {
+      output->buffer = kms_mix_minus_new_buffer (self, input);
+    } else {
+      /* Everyone not mixed gets the same audio */
+      if (full_mix == NULL) {
+        full_mix = kms_mix_minus_new_buffer (self, NULL);
+      }
+
+      output->buffer = input->discont ?
+          gst_buffer_copy (full_mix) : gst_buffer_ref (full_mix);
+    }
+
+    if (input->discont) {
+      GST_BUFFER_FLAG_SET (output->buffer, GST_BUFFER_FLAG_DISCONT);
+      input->discont = FALSE;
+    }
+
+    if (input->need_events) {
+      output->caps = gst_caps_ref (priv->caps);
+      input->need_events = FALSE;
+    }
+
+    g_queue_push_tail (outputs, output);
+  }
+
+  if (full_mix != NULL) {
+    gst_buffer_unref (full_mix);
+  }
+}
+
+static void
+kms_mix_minus_push (KmsMixMinus * self, KmsMixMinusOutput * output)
+{
+  GstFlowReturn ret;
+
+  if (output->caps != NULL) {
+    GstSegment segment;
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id (output->srcpad,
+        GST_ELEMENT (self), NULL);
+    gst_pad_push_event (output->srcpad,
+        gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+
+    gst_pad_push_event (output->srcpad, gst_event_new_caps (output->caps));
+
+    /* Timestamps are running times */
+    gst_segment_init (&segment, GST_FORMAT_TIME);
+    gst_pad_push_event (output->srcpad, gst_event_new_segment (&segment));
+  }
+
+  ret = gst_pad_push (output->srcpad, output->buffer);
+  output->buffer = NULL;
+
+  if (ret != GST_FLOW_OK && ret != GST_FLOW_FLUSHING
+      && ret != GST_FLOW_NOT_LINKED) {
+    GST_WARNING_OBJECT (output->srcpad, "Error pushing mix: %s",
+        gst_flow_get_name (ret));
+  }
+}
+
+static void
+kms_mix_minus_loop (KmsMixMinus * self)
+{
+  KmsMixMinusPrivate *priv = self->priv;
+  GstClockTime base_time, now, deadline, latency;
+  GQueue outputs = G_QUEUE_INIT;
+  GQueue gates = G_QUEUE_INIT;
+  GstClockReturn ret;
+  GstClockID id;
+  GstClock *clock;
+  GList *l;
+
+  clock = gst_element_get_clock (GST_ELEMENT (self));
+  if (clock == NULL) {
+    GST_DEBUG_OBJECT (self, "No clock, pausing");
+    gst_task_pause (priv->task);
+    return;
+  }
+
+  base_time = gst_element_get_base_time (GST_ELEMENT (self));
+  now = gst_clock_get_time (clock);
+  now = now > base_time ? now - base_time : 0;
+
+  KMS_MIX_MINUS_LOCK (self);
+
+  if (priv->flushing) {
+    KMS_MIX_MINUS_UNLOCK (self);
+    gst_object_unref (clock);
+    return;
+  }
+
+  latency = kms_mix_minus_get_latency (self);
+
+  if (!priv->started || now > kms_mix_minus_frames_to_time (self,
+          priv->position) + latency + RING_DURATION) {
+    /* First tick, or too late to catch up: mix what is arriving now */
+    now = now > latency ? now - latency : 0;
+    priv->position = kms_mix_minus_time_to_frames (self, now);
+    priv->started = TRUE;
+
+    GST_DEBUG_OBJECT (self, "Mixing from %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (now));
+
+    for (l = priv->inputs; l != NULL; l = l->next) {
+      ((KmsMixMinusInput *) l->data)->discont = TRUE;
+    }
+  }
+
+  deadline = base_time + latency +
+      kms_mix_minus_frames_to_time (self, priv->position + priv->tick_frames);
+  id = priv->clock_id = gst_clock_new_single_shot_id (clock, deadline);
+
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  gst_object_unref (clock);
+  ret = gst_clock_id_wait (id, NULL);
+
+  KMS_MIX_MINUS_LOCK (self);
+
+  priv->clock_id = NULL;
+  gst_clock_id_unref (id);
+
+  if (ret == GST_CLOCK_UNSCHEDULED || priv->flushing) {
+    KMS_MIX_MINUS_UNLOCK (self);
+    return;
+  }
+
+  kms_mix_minus_mix (self, &outputs, &gates);
+  priv->position += priv->tick_frames;
+
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  for (l = outputs.head; l != NULL; l = l->next) {
+    kms_mix_minus_push (self, l->data);
+  }
+
+  g_queue_clear_full (&outputs, (GDestroyNotify) kms_mix_minus_output_free);
+
+  for (l = gates.head; l != NULL; l = l->next) {
+    KmsMixMinusGate *gate = l->data;
+
+    gst_pad_push_event (gate->sinkpad,
+        kms_audio_level_gate_event_new (gate->level));
+  }
+
+  g_queue_clear_full (&gates, (GDestroyNotify) kms_mix_minus_gate_free);
+}
+
+static void
+kms_mix_minus_start (KmsMixMinus * self)
+{
+  KMS_MIX_MINUS_LOCK (self);
+  self->priv->flushing = FALSE;
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  gst_task_start (self->priv->task);
+}
+
+static void
+kms_mix_minus_stop (KmsMixMinus * self, gboolean join)
+{
+  KMS_MIX_MINUS_LOCK (self);
+
+  self->priv->flushing = TRUE;
+
+  if (self->priv->clock_id != NULL) {
+    gst_clock_id_unschedule (self->priv->clock_id);
+  }
+
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  if (join) {
+    gst_task_join (self->priv->task);
+  } else {
+    gst_task_pause (self->priv->task);
+  }
+}
+
+/* Mixing ends */
+
+/* Pads begin */
+
+static GstCaps *
+kms_mix_minus_get_caps (KmsMixMinus * self, GstCaps * filter)
+{
+  GstCaps *caps;
+
+  KMS_MIX_MINUS_LOCK (self);
+
+  if (filter != NULL) {
+    caps = gst_caps_intersect_full (filter, self->priv->caps,
+        GST_CAPS_INTERSECT_FIRST);
+  } else {
+    caps = gst_caps_ref (self->priv->caps);
+  }
+
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  return caps;
+}
+
+static gdouble
+kms_mix_minus_buffer_power (KmsMixMinus * self, GstBuffer * buffer,
+    GstMapInfo * info)
+{
+  KmsAudioLevelMeta *meta = kms_buffer_get_audio_level_meta (buffer);
+
+  /* Prefer the level sent by the client, when there is one */
+  if (meta != NULL) {
+    return kms_audio_level_to_power (meta->level);
+  }
+
+  if (self->priv->f32) {
+    return kms_mix_kernels_power_f32 ((const gfloat *) info->data,
+        info->size / sizeof (gfloat));
+  } else {
+    return kms_mix_kernels_power_s16 ((const gint16 *) info->data,
+        info->size / sizeof (gint16));
+  }
+}
+
+static GstFlowReturn
+kms_mix_minus_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (parent);
+  KmsMixMinusInput *input = gst_pad_get_element_private (pad);
+  GstClockTime running_time;
+  gdouble power = 0.0;
+  gboolean ranked;
+  GstMapInfo info;
+  guint64 pos;
+
+  running_time = gst_segment_to_running_time (&input->segment,
+      GST_FORMAT_TIME, GST_BUFFER_PTS (buffer));
+
+  if (!GST_CLOCK_TIME_IS_VALID (running_time)) {
+    GST_LOG_OBJECT (pad, "Dropping buffer without running time");
+    goto end;
+  }
+
+  if (!gst_buffer_map (buffer, &info, GST_MAP_READ)) {
+    GST_WARNING_OBJECT (pad, "Can not map buffer");
+    goto end;
+  }
+
+  ranked = g_atomic_int_get (&self->priv->max_speakers) > 0;
+  if (ranked) {
+    power = kms_mix_minus_buffer_power (self, buffer, &info);
+  }
+
+  KMS_MIX_MINUS_LOCK (self);
+  pos = kms_mix_minus_time_to_frames (self, running_time);
+  kms_mix_minus_input_write (self, input, pos, info.data,
+      info.size / self->priv->bpf);
+  if (ranked) {
+    input->power += (power - input->power) * POWER_SMOOTHING;
+  }
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  gst_buffer_unmap (buffer, &info);
+
+end:
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+kms_mix_minus_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (parent);
+  KmsMixMinusInput *input = gst_pad_get_element_private (pad);
+  gboolean ret = TRUE;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:{
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+
+      KMS_MIX_MINUS_LOCK (self);
+      ret = gst_caps_is_subset (caps, self->priv->caps);
+      KMS_MIX_MINUS_UNLOCK (self);
+
+      if (!ret) {
+        GST_WARNING_OBJECT (pad, "Not supported caps %" GST_PTR_FORMAT, caps);
+        break;
+      }
+
+      /* The latency of the new input may be higher */
+      gst_element_post_message (GST_ELEMENT (self),
+          gst_message_new_latency (GST_OBJECT (self)));
+      break;
+    }
+    case GST_EVENT_SEGMENT:{
+      const GstSegment *segment;
+
+      gst_event_parse_segment (event, &segment);
+
+      if (segment->format != GST_FORMAT_TIME) {
+        GST_WARNING_OBJECT (pad, "Segment not in time format");
+        ret = FALSE;
+        break;
+      }
+
+      gst_segment_copy_into (segment, &input->segment);
+      break;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      gst_segment_init (&input->segment, GST_FORMAT_TIME);
+
+      KMS_MIX_MINUS_LOCK (self);
+      input->has_data = FALSE;
+      KMS_MIX_MINUS_UNLOCK (self);
+      break;
+    default:
+      /* Outputs keep going after EOS or any other input event */
+      break;
+  }
+
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static gboolean
+kms_mix_minus_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (parent);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:{
+      GstCaps *filter, *caps;
+
+      gst_query_parse_caps (query, &filter);
+      caps = kms_mix_minus_get_caps (self, filter);
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+
+      return TRUE;
+    }
+    case GST_QUERY_ACCEPT_CAPS:{
+      GstCaps *caps;
+
+      gst_query_parse_accept_caps (query, &caps);
+
+      KMS_MIX_MINUS_LOCK (self);
+      gst_query_set_accept_caps_result (query,
+          gst_caps_is_subset (caps, self->priv->caps));
+      KMS_MIX_MINUS_UNLOCK (self);
+
+      return TRUE;
+    }
+    case GST_QUERY_LATENCY:{
+      GstClockTime upstream;
+
+      if (GST_PAD_IS_SINK (pad)) {
+        break;
+      }
+
+      /* Inputs are mixed once all of them could have arrived */
+      upstream = kms_mix_minus_query_upstream_latency (self);
+
+      KMS_MIX_MINUS_LOCK (self);
+      self->priv->upstream_latency = upstream;
+      gst_query_set_latency (query, TRUE, kms_mix_minus_get_latency (self),
+          GST_CLOCK_TIME_NONE);
+      KMS_MIX_MINUS_UNLOCK (self);
+
+      return TRUE;
+    }
+    default:
+      break;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+static GstIterator *
+kms_mix_minus_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  KmsMixMinusInput *input = gst_pad_get_element_private (pad);
+  GstIterator *it;
+  GValue val = G_VALUE_INIT;
+
+  if (input == NULL) {
+    return NULL;
+  }
+
+  /* Each input is only related to its own output */
+  g_value_init (&val, GST_TYPE_PAD);
+  g_value_set_object (&val,
+      GST_PAD_IS_SINK (pad) ? input->srcpad : input->sinkpad);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &val);
+  g_value_unset (&val);
+
+  return it;
+}
+
+static void
+kms_mix_minus_input_free (KmsMixMinusInput * input)
+{
+  g_free (input->ring);
+  g_free (input->tick);
+
+  g_slice_free (KmsMixMinusInput, input);
+}
+
+static gboolean
+kms_mix_minus_is_active (GstElement * element)
+{
+  return GST_STATE (element) >= GST_STATE_PAUSED
+      || GST_STATE_PENDING (element) >= GST_STATE_PAUSED
+      || GST_STATE_TARGET (element) >= GST_STATE_PAUSED;
+}
+
+static GstPad *
+kms_mix_minus_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (element);
+  KmsMixMinusInput *input;
+  gchar *padname;
+  guint id;
+
+  if (templ != gst_element_class_get_pad_template (GST_ELEMENT_GET_CLASS
+          (element), MIX_MINUS_SINK_PAD_PREFIX "%u")) {
+    return NULL;
+  }
+
+  input = g_slice_new0 (KmsMixMinusInput);
+  gst_segment_init (&input->segment, GST_FORMAT_TIME);
+  input->need_events = TRUE;
+  input->discont = TRUE;
+  input->gate_level = KMS_AUDIO_LEVEL_SILENCE;
+
+  KMS_MIX_MINUS_LOCK (self);
+  id = self->priv->count++;
+  input->ring = g_malloc0 (self->priv->ring_frames * self->priv->bpf);
+  input->tick = g_malloc0 (self->priv->tick_frames * self->priv->bpf);
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  padname = g_strdup_printf (MIX_MINUS_SINK_PAD_PREFIX "%u", id);
+  input->sinkpad = gst_pad_new_from_static_template (&sink_factory, padname);
+  g_free (padname);
+
+  padname = g_strdup_printf (MIX_MINUS_SRC_PAD_PREFIX "%u", id);
+  input->srcpad = gst_pad_new_from_static_template (&src_factory, padname);
+  g_free (padname);
+
+  gst_pad_set_element_private (input->sinkpad, input);
+  gst_pad_set_chain_function (input->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_mix_minus_chain));
+  gst_pad_set_event_function (input->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_mix_minus_sink_event));
+  gst_pad_set_query_function (input->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_mix_minus_query));
+  gst_pad_set_iterate_internal_links_function (input->sinkpad,
+      GST_DEBUG_FUNCPTR (kms_mix_minus_iterate_internal_links));
+
+  gst_pad_set_element_private (input->srcpad, input);
+  gst_pad_set_query_function (input->srcpad,
+      GST_DEBUG_FUNCPTR (kms_mix_minus_query));
+  gst_pad_set_iterate_internal_links_function (input->srcpad,
+      GST_DEBUG_FUNCPTR (kms_mix_minus_iterate_internal_links));
+
+  GST_OBJECT_FLAG_SET (input->sinkpad, GST_PAD_FLAG_NEED_PARENT);
+  GST_OBJECT_FLAG_SET (input->srcpad, GST_PAD_FLAG_NEED_PARENT);
+
+  if (kms_mix_minus_is_active (element)) {
+    gst_pad_set_active (input->srcpad, TRUE);
+    gst_pad_set_active (input->sinkpad, TRUE);
+  }
+
+  gst_element_add_pad (element, input->srcpad);
+  gst_element_add_pad (element, input->sinkpad);
+
+  KMS_MIX_MINUS_LOCK (self);
+  self->priv->inputs = g_list_append (self->priv->inputs, input);
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  GST_DEBUG_OBJECT (self, "Added input %u", id);
+
+  return input->sinkpad;
+}
+
+static void
+kms_mix_minus_release_pad (GstElement * element, GstPad * pad)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (element);
+  KmsMixMinusInput *input = gst_pad_get_element_private (pad);
+
+  if (!GST_PAD_IS_SINK (pad) || input == NULL) {
+    return;
+  }
+
+  GST_DEBUG_OBJECT (self, "Release pad %" GST_PTR_FORMAT, pad);
+
+  KMS_MIX_MINUS_LOCK (self);
+  self->priv->inputs = g_list_remove (self->priv->inputs, input);
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  /* Wait for the streaming threads to leave the pads */
+  gst_pad_set_active (input->sinkpad, FALSE);
+  gst_pad_set_active (input->srcpad, FALSE);
+
+  gst_pad_set_element_private (input->sinkpad, NULL);
+  gst_pad_set_element_private (input->srcpad, NULL);
+
+  gst_element_remove_pad (element, input->srcpad);
+  gst_element_remove_pad (element, input->sinkpad);
+
+  kms_mix_minus_input_free (input);
+}
+
+/* Pads end */
+
+static GstStateChangeReturn
+kms_mix_minus_change_state (GstElement * element, GstStateChange transition)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (element);
+  GstStateChangeReturn ret;
+  GList *l;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      kms_mix_minus_start (self);
+      break;
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      kms_mix_minus_stop (self, FALSE);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      kms_mix_minus_stop (self, TRUE);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (kms_mix_minus_parent_class)->change_state (element,
+      transition);
+
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    return ret;
+  }
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      /* Outputs are live */
+      ret = GST_STATE_CHANGE_NO_PREROLL;
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      KMS_MIX_MINUS_LOCK (self);
+      self->priv->started = FALSE;
+      for (l = self->priv->inputs; l != NULL; l = l->next) {
+        KmsMixMinusInput *input = l->data;
+
+        input->has_data = FALSE;
+        input->need_events = TRUE;
+      }
+      KMS_MIX_MINUS_UNLOCK (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+kms_mix_minus_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (object);
+
+  KMS_MIX_MINUS_LOCK (self);
+
+  switch (property_id) {
+    case PROP_CAPS:{
+      GstCaps *caps = g_value_get_boxed (value);
+
+      if (self->priv->inputs != NULL) {
+        GST_WARNING_OBJECT (self, "Can not change caps with inputs");
+      } else if (!kms_mix_minus_set_format (self, caps)) {
+        GST_WARNING_OBJECT (self, "Not supported caps %" GST_PTR_FORMAT, caps);
+      }
+      break;
+    }
+    case PROP_LATENCY:
+      self->priv->latency = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_SPEAKERS:
+      g_atomic_int_set (&self->priv->max_speakers, g_value_get_uint (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_MIX_MINUS_UNLOCK (self);
+
+  if (property_id == PROP_LATENCY) {
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_latency (GST_OBJECT (self)));
+  }
+}
+
+static void
+kms_mix_minus_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (object);
+
+  KMS_MIX_MINUS_LOCK (self);
+
+  switch (property_id) {
+    case PROP_CAPS:
+      g_value_set_boxed (value, self->priv->caps);
+      break;
+    case PROP_LATENCY:
+      g_value_set_uint64 (value, self->priv->latency);
+      break;
+    case PROP_MAX_SPEAKERS:
+      g_value_set_uint (value, self->priv->max_speakers);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_MIX_MINUS_UNLOCK (self);
+}
+
+static void
+kms_mix_minus_dispose (GObject * object)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (object);
+
+  GST_DEBUG_OBJECT (self, "dispose");
+
+  kms_mix_minus_stop (self, TRUE);
+
+  G_OBJECT_CLASS (kms_mix_minus_parent_class)->dispose (object);
+}
+
+static void
+kms_mix_minus_finalize (GObject * object)
+{
+  KmsMixMinus *self = KMS_MIX_MINUS (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  g_list_free_full (self->priv->inputs,
+      (GDestroyNotify) kms_mix_minus_input_free);
+  gst_object_unref (self->priv->task);
+  g_rec_mutex_clear (&self->priv->task_lock);
+  gst_caps_unref (self->priv->caps);
+  g_free (self->priv->mix);
+  g_ptr_array_unref (self->priv->ranking);
+  g_mutex_clear (&self->priv->mutex);
+
+  G_OBJECT_CLASS (kms_mix_minus_parent_class)->finalize (object);
+}
+
+static void
+kms_mix_minus_class_init (KmsMixMinusClass * klass)
+{
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gst_element_class_set_static_metadata (gstelement_class,
+      "MixMinus", "Generic/Audio",
+      "Mixes all the inputs but its own one for each output",
+      "Kurento <kurento@googlegroups.com>");
+
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (kms_mix_minus_request_new_pad);
+  gstelement_class->release_pad =
+      GST_DEBUG_FUNCPTR (kms_mix_minus_release_pad);
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (kms_mix_minus_change_state);
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+
+  gobject_class->set_property = kms_mix_minus_set_property;
+  gobject_class->get_property = kms_mix_minus_get_property;
+  gobject_class->dispose = GST_DEBUG_FUNCPTR (kms_mix_minus_dispose);
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_mix_minus_finalize);
+
+  g_object_class_install_property (gobject_class, PROP_CAPS,
+      g_param_spec_boxed ("caps", "Caps",
+          "Format of the inputs and outputs (S16LE or F32LE)",
+          GST_TYPE_CAPS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LATENCY,
+      g_param_spec_uint64 ("latency", "Latency",
+          "Time waited for the inputs before mixing them (ns), over the "
+          "latency of the inputs",
+          0, G_MAXUINT64, LATENCY_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_SPEAKERS,
+      g_param_spec_uint ("max-speakers", "Max speakers",
+          "Only mix the loudest inputs, up to this number (0 mixes all)."
+          " The others are asked upstream not to decode quieter audio",
+          0, G_MAXUINT, MAX_SPEAKERS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /* Registers a private structure for the instantiatable type */
+  g_type_class_add_private (klass, sizeof (KmsMixMinusPrivate));
+}
+
+static void
+kms_mix_minus_init (KmsMixMinus * self)
+{
+  GstCaps *caps;
+
+  self->priv = KMS_MIX_MINUS_GET_PRIVATE (self);
+
+  g_mutex_init (&self->priv->mutex);
+  self->priv->latency = LATENCY_DEFAULT;
+  self->priv->max_speakers = MAX_SPEAKERS_DEFAULT;
+  self->priv->ranking = g_ptr_array_new ();
+
+  caps = gst_caps_from_string (CAPS_DEFAULT);
+  kms_mix_minus_set_format (self, caps);
+  gst_caps_unref (caps);
+
+  g_rec_mutex_init (&self->priv->task_lock);
+  self->priv->task = gst_task_new ((GstTaskFunction) kms_mix_minus_loop,
+      self, NULL);
+  gst_task_set_lock (self->priv->task, &self->priv->task_lock);
+
+  GST_DEBUG_OBJECT (self, "Using %s mixing kernels",
+      kms_mix_kernels_get_name ());
+}
+
+gboolean
+kms_mix_minus_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_MIX_MINUS);
+}
@@ -0,0 +1,83 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _KMS_MIX_MINUS_H_
+#define _KMS_MIX_MINUS_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+#define KMS_TYPE_MIX_MINUS kms_mix_minus_get_type()
+
+#define KMS_MIX_MINUS(obj) ( \
+  G_TYPE_CHECK_INSTANCE_CAST(\
+    (obj),                   \
+    KMS_TYPE_MIX_MINUS,      \
+    KmsMixMinus              \
+  )                          \
+)
+
+#define KMS_MIX_MINUS_CLASS(klass) ( \
+  G_TYPE_CHECK_CLASS_CAST (          \
+    (klass),                         \
+    KMS_TYPE_MIX_MINUS,              \
+    KmsMixMinusClass                 \
+  )                                  \
+)
+#define KMS_IS_MIX_MINUS(obj) ( \
+  G_TYPE_CHECK_INSTANCE_TYPE (  \
+    (obj),                      \
+    KMS_TYPE_MIX_MINUS          \
+  )                             \
+)
+#define KMS_IS_MIX_MINUS_CLASS(klass) ( \
+  G_TYPE_CHECK_CLASS_TYPE((klass),      \
+  KMS_TYPE_MIX_MINUS)                   \
+)
+
+#define MIX_MINUS_SINK_PAD_PREFIX "sink_"
+#define MIX_MINUS_SRC_PAD_PREFIX "src_"
+
+typedef struct _KmsMixMinus KmsMixMinus;
+typedef struct _KmsMixMinusClass KmsMixMinusClass;
+typedef struct _KmsMixMinusPrivate KmsMixMinusPrivate;
+
+/*
+ * Live mixer producing, for each input, the mix of all the other inputs.
+ * Requesting sink_%u adds src_%u with the same id. Every tick the mix of
+ * all the inputs is computed once and each output is that mix minus its
+ * own input, so the cost grows linearly with the number of inputs.
+ */
+struct _KmsMixMinus
+{
+  GstElement parent;
+
+  /*< private > */
+  KmsMixMinusPrivate *priv;
+};
+
+struct _KmsMixMinusClass
+{
+  GstElementClass parent_class;
+};
+
+GType kms_mix_minus_get_type (void);
+
+gboolean kms_mix_minus_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* _KMS_MIX_MINUS_H_ */
@@ -0,0 +1,856 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "kmsselectivehub.h"
+#include "kmsaudiolevelmeta.h"
+#include "kmsmixminus.h"
+#include "kmsexecutor.h"
+#include "kmsloop.h"
+#include "kmsutils.h"
+#include "kms-core-enumtypes.h"
+#include "kms-core-marshal.h"
+#include "kmsforwardingmode.h"
+
+#define PLUGIN_NAME "selectivehub"
+
+GST_DEBUG_CATEGORY_STATIC (kms_selective_hub_debug_category);
+#define GST_CAT_DEFAULT kms_selective_hub_debug_category
+
+#define KMS_SELECTIVE_HUB_GET_PRIVATE(obj) ( \
+  G_TYPE_INSTANCE_GET_PRIVATE (              \
+    (obj),                                   \
+    KMS_TYPE_SELECTIVE_HUB,                  \
+    KmsSelectiveHubPrivate                   \
+  )                                          \
+)
+
+#define KMS_SELECTIVE_HUB_LOCK(self) \
+  (g_mutex_lock (&(self)->priv->mutex))
+
+#define KMS_SELECTIVE_HUB_UNLOCK(self) \
+  (g_mutex_unlock (&(self)->priv->mutex))
+
+#define MODE_DEFAULT KMS_FORWARDING_MODE_ACTIVE_SPEAKER
+#define PINNED_DEFAULT -1
+#define ROTATION_INTERVAL_DEFAULT (10 * GST_SECOND)
+#define MAX_SPEAKERS_DEFAULT 0
+
+/* Time between two choices of the forwarded port */
+#define SELECTION_INTERVAL (250 * GST_MSECOND)
+/* Weight of each audio buffer in the power of a port */
+#define POWER_SMOOTHING 0.3
+/* Power is kept in billionths of full scale, -90 dB is the quietest */
+#define POWER_SCALE 1e9
+/* Power advantage of the port being forwarded, 3 dB */
+#define SPEAKER_HYSTERESIS 2.0
+
+enum
+{
+  PROP_0,
+  PROP_MODE,
+  PROP_PINNED,
+  PROP_ROTATION_INTERVAL,
+  PROP_MAX_SPEAKERS,
+  N_PROPERTIES
+};
+
+enum
+{
+  SIGNAL_SELECT_SOURCE,
+  LAST_SIGNAL
+};
+
+static guint kms_selective_hub_signals[LAST_SIGNAL] = { 0 };
+
+typedef struct _KmsSelectiveHubStream
+{
+  GstElement *tee;              /* media received from the port */
+  GstElement *output;           /* media forwarded to the port */
+  gint source;                  /* port feeding @output, -1 if none */
+} KmsSelectiveHubStream;
+
+typedef struct _KmsSelectiveHubPort
+{
+  KmsSelectiveHub *hub;
+  gint id;
+  GstPad *audio;                /* mixer input of the port */
+  KmsSelectiveHubStream video;
+
+  gint selected;                /* set by select-source, -1 follows the mode */
+
+  /* Written by the audio streaming thread, atomic */
+  gint power;
+  gint has_level;
+} KmsSelectiveHubPort;
+
+struct _KmsSelectiveHubPrivate
+{
+  GMutex mutex;
+  GHashTable *ports;
+
+  /* Mixes for each port the audio of the others */
+  GstElement *mixer;
+
+  KmsForwardingMode mode;
+  gint pinned;
+  GstClockTime rotation_interval;
+
+  /* Port forwarded to everybody else, and the one before it, forwarded to
+   * @featured itself */
+  gint featured;
+  gint previous;
+  GstClockTime last_rotation;
+  guint selection_id;
+
+  KmsExecutorQueue *executor;
+  gboolean apply_pending;
+};
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (KmsSelectiveHub, kms_selective_hub,
+    KMS_TYPE_BASE_HUB,
+    GST_DEBUG_CATEGORY_INIT (kms_selective_hub_debug_category,
+        PLUGIN_NAME, 0, "debug category for " PLUGIN_NAME " element"));
+
+/* Runs the selection of every hub */
+static KmsLoop *
+kms_selective_hub_get_loop (void)
+{
+  static gsize init = 0;
+  static KmsLoop *loop;
+
+  if (g_once_init_enter (&init)) {
+    loop = kms_loop_new ();
+    g_once_init_leave (&init, 1);
+  }
+
+  return loop;
+}
+
+static GstClockTime
+kms_selective_hub_now (void)
+{
+  return g_get_monotonic_time () * GST_USECOND;
+}
+
+static KmsSelectiveHubPort *
+kms_selective_hub_get_port (KmsSelectiveHub * self, gint id)
+{
+  if (id < 0) {
+    return NULL;
+  }
+
+  return g_hash_table_lookup (self->priv->ports, GINT_TO_POINTER (id));
+}
+
+/* Linking begin */
+
+static void
+kms_selective_hub_unlink_stream (KmsSelectiveHubStream * stream)
+{
+  GstPad *sink, *peer;
+
+  sink = gst_element_get_static_pad (stream->output, "sink");
+  peer = gst_pad_get_peer (sink);
+
+  if (peer != NULL) {
+    GstElement *tee = gst_pad_get_parent_element (peer);
+
+    gst_pad_unlink (peer, sink);
+
+    if (tee != NULL) {
+      gst_element_release_request_pad (tee, peer);
+      gst_object_unref (tee);
+    }
+
+    g_object_unref (peer);
+  }
+
+  g_object_unref (sink);
+  stream->source = -1;
+}
+
+/* Returns TRUE when the output gets a new port */
+static gboolean
+kms_selective_hub_link_stream (KmsSelectiveHubStream * stream,
+    KmsSelectiveHubStream * source, gint source_id)
+{
+  GstPad *sink, *src;
+  gboolean ret = FALSE;
+
+  if (stream->source == source_id) {
+    return FALSE;
+  }
+
+  kms_selective_hub_unlink_stream (stream);
+
+  if (source == NULL) {
+    return FALSE;
+  }
+
+  sink = gst_element_get_static_pad (stream->output, "sink");
+  src = gst_element_get_request_pad (source->tee, "src_%u");
+
+  if (gst_pad_link (src, sink) == GST_PAD_LINK_OK) {
+    stream->source = source_id;
+    ret = TRUE;
+  } else {
+    GST_ERROR ("Cannot link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, src,
+        sink);
+    gst_element_release_request_pad (source->tee, src);
+  }
+
+  g_object_unref (src);
+  g_object_unref (sink);
+
+  return ret;
+}
+
+/* Linking end */
+
+/* Selection begin */
+
+static gint
+kms_selective_hub_next_port (KmsSelectiveHub * self, gint after)
+{
+  GHashTableIter iter;
+  gpointer key;
+  gint first = -1, next = -1;
+
+  g_hash_table_iter_init (&iter, self->priv->ports);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    gint id = GPOINTER_TO_INT (key);
+
+    if (first < 0 || id < first) {
+      first = id;
+    }
+
+    if (id > after && (next < 0 || id < next)) {
+      next = id;
+    }
+  }
+
+  return next >= 0 ? next : first;
+}
+
+/* Returns -1 when no port sends its audio level */
+static gint
+kms_selective_hub_loudest_port (KmsSelectiveHub * self)
+{
+  KmsSelectiveHubPort *current, *loudest = NULL;
+  gint loudest_power = 0;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, self->priv->ports);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsSelectiveHubPort *port = value;
+    gint power = g_atomic_int_get (&port->power);
+
+    if (!g_atomic_int_get (&port->has_level)) {
+      continue;
+    }
+
+    if (loudest == NULL || power > loudest_power) {
+      loudest = port;
+      loudest_power = power;
+    }
+  }
+
+  if (loudest == NULL) {
+    return -1;
+  }
+
+  current = kms_selective_hub_get_port (self, self->priv->featured);
+
+  /* The current speaker is only replaced by a clearly louder one */
+  if (current == NULL || loudest_power >
+      g_atomic_int_get (&current->power) * SPEAKER_HYSTERESIS) {
+    return loudest->id;
+  }
+
+  return current->id;
+}
+
+/* Port forwarded to @port, always another one */
+static gint
+kms_selective_hub_choose_source (KmsSelectiveHub * self,
+    KmsSelectiveHubPort * port)
+{
+  KmsSelectiveHubPrivate *priv = self->priv;
+  gint source;
+
+  if (port->selected != port->id
+      && kms_selective_hub_get_port (self, port->selected) != NULL) {
+    return port->selected;
+  }
+
+  if (priv->featured != port->id
+      && kms_selective_hub_get_port (self, priv->featured) != NULL) {
+    return priv->featured;
+  }
+
+  if (priv->previous != port->id
+      && kms_selective_hub_get_port (self, priv->previous) != NULL) {
+    return priv->previous;
+  }
+
+  source = kms_selective_hub_next_port (self, port->id);
+
+  return source != port->id ? source : -1;
+}
+
+static void
+kms_selective_hub_apply (KmsSelectiveHub * self)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GSList *keyframes = NULL, *l;
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+
+  self->priv->apply_pending = FALSE;
+
+  g_hash_table_iter_init (&iter, self->priv->ports);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsSelectiveHubPort *port = value, *source;
+    gint source_id;
+
+    source_id = kms_selective_hub_choose_source (self, port);
+    source = kms_selective_hub_get_port (self, source_id);
+
+    if (port->video.source != source_id) {
+      GST_DEBUG_OBJECT (self, "Forwarding video of port %d to port %d",
+          source_id, port->id);
+    }
+
+    if (kms_selective_hub_link_stream (&port->video,
+            source != NULL ? &source->video : NULL, source_id)) {
+      keyframes = g_slist_prepend (keyframes,
+          gst_element_get_static_pad (port->video.output, "sink"));
+    }
+  }
+
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+
+  /* Encoded video can only be decoded from a key frame of the new port. It
+   * is requested upstream, so it is done without the lock */
+  for (l = keyframes; l != NULL; l = l->next) {
+    kms_utils_drop_until_keyframe (GST_PAD (l->data), TRUE);
+  }
+
+  g_slist_free_full (keyframes, g_object_unref);
+}
+
+/* Relinking is done out of the streaming threads. Must be called with the
+ * hub lock held */
+static void
+kms_selective_hub_schedule_apply (KmsSelectiveHub * self)
+{
+  if (self->priv->apply_pending) {
+    return;
+  }
+
+  self->priv->apply_pending = TRUE;
+  kms_executor_queue_push (self->priv->executor,
+      (KmsExecutorFunc) kms_selective_hub_apply, g_object_ref (self),
+      g_object_unref);
+}
+
+/* Must be called with the hub lock held */
+static gint
+kms_selective_hub_rotate (KmsSelectiveHub * self, GstClockTime now)
+{
+  KmsSelectiveHubPrivate *priv = self->priv;
+
+  if (kms_selective_hub_get_port (self, priv->featured) == NULL
+      || now >= priv->last_rotation + priv->rotation_interval) {
+    priv->last_rotation = now;
+    return kms_selective_hub_next_port (self, priv->featured);
+  }
+
+  return priv->featured;
+}
+
+/* Must be called with the hub lock held */
+static void
+kms_selective_hub_update_featured (KmsSelectiveHub * self, gboolean force)
+{
+  KmsSelectiveHubPrivate *priv = self->priv;
+  GstClockTime now = kms_selective_hub_now ();
+  gint featured = priv->featured;
+
+  switch (priv->mode) {
+    case KMS_FORWARDING_MODE_ACTIVE_SPEAKER:
+      featured = kms_selective_hub_loudest_port (self);
+      if (featured < 0) {
+        /* Without audio levels there is no speaker to follow */
+        featured = kms_selective_hub_rotate (self, now);
+      }
+      break;
+    case KMS_FORWARDING_MODE_PINNED:
+      featured = priv->pinned;
+      break;
+    case KMS_FORWARDING_MODE_ROUND_ROBIN:
+      featured = kms_selective_hub_rotate (self, now);
+      break;
+  }
+
+  if (featured != priv->featured) {
+    GST_DEBUG_OBJECT (self, "Featured port %d, was %d", featured,
+        priv->featured);
+    priv->previous = priv->featured;
+    priv->featured = featured;
+  } else if (!force) {
+    return;
+  }
+
+  kms_selective_hub_schedule_apply (self);
+}
+
+/* Only the streaming thread of the port writes its power, so it does not
+ * need the hub lock */
+static GstPadProbeReturn
+kms_selective_hub_audio_probe (GstPad * pad, GstPadProbeInfo * info,
+    KmsSelectiveHubPort * port)
+{
+  KmsAudioLevelMeta *meta;
+  gdouble power;
+
+  meta = kms_buffer_get_audio_level_meta (GST_PAD_PROBE_INFO_BUFFER (info));
+  if (meta == NULL) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  power = g_atomic_int_get (&port->power);
+  power += (kms_audio_level_to_power (meta->level) * POWER_SCALE - power) *
+      POWER_SMOOTHING;
+
+  g_atomic_int_set (&port->power, (gint) power);
+  g_atomic_int_set (&port->has_level, TRUE);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+kms_selective_hub_selection_timeout (GWeakRef * ref)
+{
+  KmsSelectiveHub *self = g_weak_ref_get (ref);
+
+  if (self == NULL) {
+    return G_SOURCE_REMOVE;
+  }
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+  kms_selective_hub_update_featured (self, FALSE);
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+
+  g_object_unref (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+kms_selective_hub_weak_ref_free (GWeakRef * ref)
+{
+  g_weak_ref_clear (ref);
+  g_slice_free (GWeakRef, ref);
+}
+
+/* Selection end */
+
+/* Ports begin */
+
+static GstElement *
+kms_selective_hub_add_element (KmsSelectiveHub * self, const gchar * factory)
+{
+  GstElement *element = gst_element_factory_make (factory, NULL);
+
+  gst_bin_add (GST_BIN (self), element);
+  gst_element_sync_state_with_parent (element);
+
+  return element;
+}
+
+static void
+kms_selective_hub_remove_element (KmsSelectiveHub * self, GstElement * element)
+{
+  gst_element_set_locked_state (element, TRUE);
+  gst_element_set_state (element, GST_STATE_NULL);
+  gst_bin_remove (GST_BIN (self), element);
+}
+
+static void
+kms_selective_hub_init_stream (KmsSelectiveHub * self,
+    KmsSelectiveHubStream * stream)
+{
+  stream->source = -1;
+
+  stream->tee = kms_selective_hub_add_element (self, "tee");
+  g_object_set (stream->tee, "allow-not-linked", TRUE, NULL);
+
+  /* Outputs have no thread, they are pushed by the forwarded port */
+  stream->output = kms_selective_hub_add_element (self, "identity");
+  g_object_set (stream->output, "silent", TRUE, NULL);
+}
+
+static void
+kms_selective_hub_port_destroy (KmsSelectiveHubPort * port)
+{
+  /* Also removes the mixer output of the port */
+  gst_element_release_request_pad (port->hub->priv->mixer, port->audio);
+  g_object_unref (port->audio);
+
+  kms_selective_hub_remove_element (port->hub, port->video.tee);
+  kms_selective_hub_remove_element (port->hub, port->video.output);
+
+  g_slice_free (KmsSelectiveHubPort, port);
+}
+
+static gint
+kms_selective_hub_handle_port (KmsBaseHub * hub, GstElement * hub_port)
+{
+  KmsSelectiveHub *self = KMS_SELECTIVE_HUB (hub);
+  KmsSelectiveHubPort *port;
+  gchar *audio_src;
+  gint id;
+
+  id = KMS_BASE_HUB_CLASS (kms_selective_hub_parent_class)->handle_port (hub,
+      hub_port);
+
+  if (id < 0) {
+    return id;
+  }
+
+  GST_DEBUG_OBJECT (self, "Handle port %d", id);
+
+  port = g_slice_new0 (KmsSelectiveHubPort);
+  port->hub = self;
+  port->id = id;
+  port->selected = -1;
+
+  kms_selective_hub_init_stream (self, &port->video);
+
+  port->audio = gst_element_get_request_pad (self->priv->mixer,
+      MIX_MINUS_SINK_PAD_PREFIX "%u");
+
+  /* The mixer names each output after its input */
+  audio_src = g_strconcat (MIX_MINUS_SRC_PAD_PREFIX,
+      GST_OBJECT_NAME (port->audio) + strlen (MIX_MINUS_SINK_PAD_PREFIX),
+      NULL);
+
+  /* Audio levels choose the active speaker */
+  gst_pad_add_probe (port->audio, GST_PAD_PROBE_TYPE_BUFFER,
+      (GstPadProbeCallback) kms_selective_hub_audio_probe, port, NULL);
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+  g_hash_table_insert (self->priv->ports, GINT_TO_POINTER (id), port);
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+
+  kms_base_hub_link_audio_sink (hub, id, self->priv->mixer,
+      GST_OBJECT_NAME (port->audio), FALSE);
+  kms_base_hub_link_video_sink (hub, id, port->video.tee, "sink", FALSE);
+  kms_base_hub_link_audio_src (hub, id, self->priv->mixer, audio_src, FALSE);
+  kms_base_hub_link_video_src (hub, id, port->video.output, "src", FALSE);
+  g_free (audio_src);
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+  kms_selective_hub_update_featured (self, TRUE);
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+
+  return id;
+}
+
+static void
+kms_selective_hub_unhandle_port (KmsBaseHub * hub, gint id)
+{
+  KmsSelectiveHub *self = KMS_SELECTIVE_HUB (hub);
+  KmsSelectiveHubPort *port;
+  GHashTableIter iter;
+  gpointer value;
+
+  GST_DEBUG_OBJECT (self, "Unhandle port %d", id);
+
+  KMS_BASE_HUB_CLASS (kms_selective_hub_parent_class)->unhandle_port (hub,
+      id);
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+
+  port = kms_selective_hub_get_port (self, id);
+  if (port == NULL) {
+    KMS_SELECTIVE_HUB_UNLOCK (self);
+    return;
+  }
+
+  g_hash_table_iter_init (&iter, self->priv->ports);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    KmsSelectiveHubPort *other = value;
+
+    if (other->video.source == id) {
+      kms_selective_hub_unlink_stream (&other->video);
+    }
+  }
+
+  kms_selective_hub_unlink_stream (&port->video);
+
+  g_hash_table_steal (self->priv->ports, GINT_TO_POINTER (id));
+  kms_selective_hub_update_featured (self, TRUE);
+
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+
+  kms_selective_hub_port_destroy (port);
+}
+
+static gboolean
+kms_selective_hub_select_source (KmsSelectiveHub * self, gint port_id,
+    gint source_id)
+{
+  KmsSelectiveHubPort *port;
+  gboolean ret = FALSE;
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+
+  port = kms_selective_hub_get_port (self, port_id);
+
+  if (port == NULL) {
+    GST_WARNING_OBJECT (self, "No port %d", port_id);
+  } else if (source_id >= 0 && (source_id == port_id
+          || kms_selective_hub_get_port (self, source_id) == NULL)) {
+    GST_WARNING_OBJECT (self, "Cannot forward port %d to port %d", source_id,
+        port_id);
+  } else {
+    port->selected = source_id;
+    kms_selective_hub_schedule_apply (self);
+    ret = TRUE;
+  }
+
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+
+  return ret;
+}
+
+/* Ports end */
+
+static void
+kms_selective_hub_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  KmsSelectiveHub *self = KMS_SELECTIVE_HUB (object);
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+
+  switch (property_id) {
+    case PROP_MODE:
+      self->priv->mode = g_value_get_enum (value);
+      break;
+    case PROP_PINNED:
+      self->priv->pinned = g_value_get_int (value);
+      break;
+    case PROP_ROTATION_INTERVAL:
+      self->priv->rotation_interval = g_value_get_uint64 (value);
+      break;
+    case PROP_MAX_SPEAKERS:
+      g_object_set (self->priv->mixer, "max-speakers",
+          g_value_get_uint (value), NULL);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  kms_selective_hub_update_featured (self, TRUE);
+
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+}
+
+static void
+kms_selective_hub_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  KmsSelectiveHub *self = KMS_SELECTIVE_HUB (object);
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+
+  switch (property_id) {
+    case PROP_MODE:
+      g_value_set_enum (value, self->priv->mode);
+      break;
+    case PROP_PINNED:
+      g_value_set_int (value, self->priv->pinned);
+      break;
+    case PROP_ROTATION_INTERVAL:
+      g_value_set_uint64 (value, self->priv->rotation_interval);
+      break;
+    case PROP_MAX_SPEAKERS:{
+      guint max_speakers;
+
+      g_object_get (self->priv->mixer, "max-speakers", &max_speakers, NULL);
+      g_value_set_uint (value, max_speakers);
+      break;
+    }
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+}
+
+static void
+kms_selective_hub_dispose (GObject * object)
+{
+  KmsSelectiveHub *self = KMS_SELECTIVE_HUB (object);
+  GList *ports;
+
+  GST_DEBUG_OBJECT (self, "dispose");
+
+  if (self->priv->selection_id != 0) {
+    kms_loop_remove (kms_selective_hub_get_loop (), self->priv->selection_id);
+    self->priv->selection_id = 0;
+  }
+
+  KMS_SELECTIVE_HUB_LOCK (self);
+  ports = g_hash_table_get_values (self->priv->ports);
+  g_hash_table_steal_all (self->priv->ports);
+  KMS_SELECTIVE_HUB_UNLOCK (self);
+
+  g_list_free_full (ports, (GDestroyNotify) kms_selective_hub_port_destroy);
+
+  G_OBJECT_CLASS (kms_selective_hub_parent_class)->dispose (object);
+}
+
+static void
+kms_selective_hub_finalize (GObject * object)
+{
+  KmsSelectiveHub *self = KMS_SELECTIVE_HUB (object);
+
+  GST_DEBUG_OBJECT (self, "finalize");
+
+  kms_executor_queue_free (self->priv->executor);
+  g_hash_table_unref (self->priv->ports);
+  g_mutex_clear (&self->priv->mutex);
+
+  G_OBJECT_CLASS (kms_selective_hub_parent_class)->finalize (object);
+}
+
+static void
+kms_selective_hub_class_init (KmsSelectiveHubClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  KmsBaseHubClass *base_hub_class = KMS_BASE_HUB_CLASS (klass);
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
+      "SelectiveHub", "Generic",
+      "Hub sending each port the video of the selected port and the audio "
+      "of the others",
+      "Kurento <kurento@googlegroups.com>");
+
+  gobject_class->set_property = kms_selective_hub_set_property;
+  gobject_class->get_property = kms_selective_hub_get_property;
+  gobject_class->dispose = GST_DEBUG_FUNCPTR (kms_selective_hub_dispose);
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (kms_selective_hub_finalize);
+
+  base_hub_class->handle_port =
+      GST_DEBUG_FUNCPTR (kms_selective_hub_handle_port);
+  base_hub_class->unhandle_port =
+      GST_DEBUG_FUNCPTR (kms_selective_hub_unhandle_port);
+
+  klass->select_source = GST_DEBUG_FUNCPTR (kms_selective_hub_select_source);
+
+  g_object_class_install_property (gobject_class, PROP_MODE,
+      g_param_spec_enum ("mode", "Mode",
+          "How the port whose video is forwarded to the others is chosen."
+          " Loudest speaker needs the audio level RTP header extension, ports"
+          " are rotated while no port sends it",
+          KMS_TYPE_FORWARDING_MODE, MODE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PINNED,
+      g_param_spec_int ("pinned", "Pinned",
+          "Port whose video is forwarded to the others in pinned mode (-1 for"
+          " none)",
+          -1, G_MAXINT, PINNED_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ROTATION_INTERVAL,
+      g_param_spec_uint64 ("rotation-interval", "Rotation interval",
+          "Time each port is forwarded in round-robin mode (ns)",
+          SELECTION_INTERVAL, G_MAXUINT64, ROTATION_INTERVAL_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_SPEAKERS,
+      g_param_spec_uint ("max-speakers", "Max speakers",
+          "Only send each port the audio of the loudest other ports, up to "
+          "this number (0 sends all)", 0, G_MAXUINT, MAX_SPEAKERS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /* Forwards the video of a port to another one whatever the mode, -1 as
+   * source returns the output to the mode */
+  kms_selective_hub_signals[SIGNAL_SELECT_SOURCE] =
+      g_signal_new ("select-source",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_ACTION | G_SIGNAL_RUN_LAST,
+      G_STRUCT_OFFSET (KmsSelectiveHubClass, select_source), NULL, NULL,
+      __kms_core_marshal_BOOLEAN__INT_INT, G_TYPE_BOOLEAN, 2, G_TYPE_INT,
+      G_TYPE_INT);
+
+  /* Registers a private structure for the instantiatable type */
+  g_type_class_add_private (klass, sizeof (KmsSelectiveHubPrivate));
+}
+
+static void
+kms_selective_hub_init (KmsSelectiveHub * self)
+{
+  GWeakRef *ref;
+
+  self->priv = KMS_SELECTIVE_HUB_GET_PRIVATE (self);
+
+  g_mutex_init (&self->priv->mutex);
+  self->priv->ports = g_hash_table_new (NULL, NULL);
+
+  self->priv->mode = MODE_DEFAULT;
+  self->priv->pinned = PINNED_DEFAULT;
+  self->priv->rotation_interval = ROTATION_INTERVAL_DEFAULT;
+  self->priv->featured = -1;
+  self->priv->previous = -1;
+
+  self->priv->executor = kms_executor_queue_new ();
+
+  self->priv->mixer = kms_selective_hub_add_element (self, "kmsmixminus");
+
+  ref = g_slice_new0 (GWeakRef);
+  g_weak_ref_init (ref, self);
+  self->priv->selection_id =
+      kms_loop_timeout_add_full (kms_selective_hub_get_loop (),
+      G_PRIORITY_DEFAULT, SELECTION_INTERVAL / GST_MSECOND,
+      (GSourceFunc) kms_selective_hub_selection_timeout, ref,
+      (GDestroyNotify) kms_selective_hub_weak_ref_free);
+}
+
+gboolean
+kms_selective_hub_plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, PLUGIN_NAME, GST_RANK_NONE,
+      KMS_TYPE_SELECTIVE_HUB);
+}
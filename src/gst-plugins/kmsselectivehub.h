@@ -0,0 +1,92 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef _KMS_SELECTIVE_HUB_H_
+#define _KMS_SELECTIVE_HUB_H_
+
+#include "kmsbasehub.h"
+
+G_BEGIN_DECLS
+#define KMS_TYPE_SELECTIVE_HUB kms_selective_hub_get_type()
+
+#define KMS_SELECTIVE_HUB(obj) ( \
+  G_TYPE_CHECK_INSTANCE_CAST(    \
+    (obj),                       \
+    KMS_TYPE_SELECTIVE_HUB,      \
+    KmsSelectiveHub              \
+  )                              \
+)
+
+#define KMS_SELECTIVE_HUB_CLASS(klass) ( \
+  G_TYPE_CHECK_CLASS_CAST (              \
+    (klass),                             \
+    KMS_TYPE_SELECTIVE_HUB,              \
+    KmsSelectiveHubClass                 \
+  )                                      \
+)
+#define KMS_IS_SELECTIVE_HUB(obj) ( \
+  G_TYPE_CHECK_INSTANCE_TYPE (      \
+    (obj),                          \
+    KMS_TYPE_SELECTIVE_HUB          \
+  )                                 \
+)
+#define KMS_IS_SELECTIVE_HUB_CLASS(klass) ( \
+  G_TYPE_CHECK_CLASS_TYPE((klass),          \
+  KMS_TYPE_SELECTIVE_HUB)                   \
+)
+
+typedef struct _KmsSelectiveHub KmsSelectiveHub;
+typedef struct _KmsSelectiveHubClass KmsSelectiveHubClass;
+typedef struct _KmsSelectiveHubPrivate KmsSelectiveHubPrivate;
+
+/*
+ * Hub forwarding the video of one port to each of the others, as received,
+ * without decoding it. The forwarded port is chosen by the "mode" property
+ * (loudest speaker, pinned port or round-robin) unless "select-source" fixes
+ * it for an output. A port never receives its own media.
+ *
+ * Audio is not switched: each port receives the mix of the audio of all the
+ * other ports, or of the "max-speakers" loudest ones, so people talking at
+ * once are all heard.
+ *
+ * The loudest speaker is chosen from the RFC 6464 audio level of the ports,
+ * so ports not sending it are never chosen by level. While no port sends
+ * it, ports are rotated as in round-robin mode.
+ */
+struct _KmsSelectiveHub
+{
+  KmsBaseHub parent;
+
+  /*< private > */
+  KmsSelectiveHubPrivate *priv;
+};
+
+struct _KmsSelectiveHubClass
+{
+  KmsBaseHubClass parent_class;
+
+  /* Actions */
+  gboolean (*select_source) (KmsSelectiveHub * self, gint port_id,
+      gint source_id);
+};
+
+GType kms_selective_hub_get_type (void);
+
+gboolean kms_selective_hub_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* _KMS_SELECTIVE_HUB_H_ */
@@ -270,6 +270,8 @@ BaseRtpEndpointImpl::getRembParams ()
   GstStructure *params;
   gint auxi;
   gfloat auxf;
+  gboolean auxb;
+  gchar *auxs;
 
   g_object_get (G_OBJECT (element), REMB_PARAMS, &params, NULL);
 
@@ -306,6 +308,16 @@ BaseRtpEndpointImpl::getRembParams ()
   ret->setRembOnConnect (auxi);
   /* REMB remote end */
 
+  if (gst_structure_get (params, "transport-cc", G_TYPE_BOOLEAN, &auxb,
+                         NULL) ) {
+    ret->setTransportCc (auxb);
+  }
+
+  if (gst_structure_get (params, "controller", G_TYPE_STRING, &auxs, NULL) ) {
+    ret->setController (auxs);
+    g_free (auxs);
+  }
+
   gst_structure_free (params);
 
   return ret;
@@ -378,6 +390,20 @@ BaseRtpEndpointImpl::setRembParams (std::shared_ptr<RembParams> rembParams)
 
   /* REMB remote end */
 
+  if (rembParams->isSetTransportCc () ) {
+    gst_structure_set (params, "transport-cc", G_TYPE_BOOLEAN,
+                       rembParams->getTransportCc(), NULL);
+    GST_DEBUG_OBJECT (element, "New 'transport-cc' value %d",
+                      rembParams->getTransportCc() );
+  }
+
+  if (rembParams->isSetController () ) {
+    gst_structure_set (params, "controller", G_TYPE_STRING,
+                       rembParams->getController().c_str(), NULL);
+    GST_DEBUG_OBJECT (element, "New 'controller' value %s",
+                      rembParams->getController().c_str() );
+  }
+
   g_object_set (G_OBJECT (element), REMB_PARAMS, params, NULL);
   gst_structure_free (params);
 }
@@ -56,6 +56,123 @@ HubImpl::HubImpl (const boost::property_tree::ptree &config,
   pipe->addElement (element);
 }
 
+std::vector<int>
+HubImpl::handlePorts (const std::vector<GstElement *> &ports)
+{
+  GPtrArray *array = g_ptr_array_sized_new (ports.size() );
+  GArray *ids = NULL;
+  std::vector<int> ret;
+
+  for (GstElement *port : ports) {
+    g_ptr_array_add (array, port);
+  }
+
+  g_signal_emit_by_name (element, "handle-ports", array, &ids);
+  g_ptr_array_unref (array);
+
+  if (ids != NULL) {
+    ret.assign ( (gint *) ids->data, (gint *) ids->data + ids->len);
+    g_array_unref (ids);
+  }
+
+  return ret;
+}
+
+void
+HubImpl::unhandlePorts (const std::vector<int> &ids)
+{
+  GArray *array = g_array_sized_new (FALSE, FALSE, sizeof (gint), ids.size() );
+
+  for (int id : ids) {
+    g_array_append_val (array, id);
+  }
+
+  g_signal_emit_by_name (element, "unhandle-ports", array);
+  g_array_unref (array);
+}
+
+/*
+ * The first caller runs the transaction with every operation queued so far,
+ * the others wait until theirs has been run by someone.
+ */
+void
+HubImpl::runPortOperation (PortOperation &operation,
+                           std::vector<PortOperation *> &queue)
+{
+  std::unique_lock<std::mutex> lock (portsMutex);
+
+  queue.push_back (&operation);
+
+  while (!operation.done) {
+    if (committing) {
+      portsCond.wait (lock);
+      continue;
+    }
+
+    std::vector<PortOperation *> unhandles;
+    std::vector<PortOperation *> handles;
+    std::vector<GstElement *> ports;
+    std::vector<int> ids;
+
+    committing = true;
+    unhandles.swap (pendingUnhandles);
+    handles.swap (pendingHandles);
+    lock.unlock ();
+
+    for (PortOperation *op : unhandles) {
+      ids.push_back (op->id);
+    }
+
+    for (PortOperation *op : handles) {
+      ports.push_back (op->port);
+    }
+
+    if (!ids.empty() ) {
+      GST_DEBUG ("Detaching %zu ports from %" GST_PTR_FORMAT, ids.size(),
+                 element);
+      unhandlePorts (ids);
+    }
+
+    if (!ports.empty() ) {
+      GST_DEBUG ("Attaching %zu ports to %" GST_PTR_FORMAT, ports.size(),
+                 element);
+      ids = handlePorts (ports);
+    }
+
+    lock.lock ();
+
+    for (PortOperation *op : unhandles) {
+      op->done = true;
+    }
+
+    for (size_t i = 0; i < handles.size(); i++) {
+      handles[i]->id = i < ids.size() ? ids[i] : -1;
+      handles[i]->done = true;
+    }
+
+    committing = false;
+    portsCond.notify_all ();
+  }
+}
+
+int
+HubImpl::handlePort (GstElement *port)
+{
+  PortOperation operation = {port, -1, false};
+
+  runPortOperation (operation, pendingHandles);
+
+  return operation.id;
+}
+
+void
+HubImpl::unhandlePort (int id)
+{
+  PortOperation operation = {NULL, id, false};
+
+  runPortOperation (operation, pendingUnhandles);
+}
+
 HubImpl::~HubImpl()
 {
   std::shared_ptr<MediaPipelineImpl> pipe;
@@ -21,6 +21,9 @@
 #include "Hub.hpp"
 #include <EventHandler.hpp>
 #include <gst/gst.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 
 namespace kurento
 {
@@ -49,6 +52,15 @@ public:
   virtual std::string getGstreamerDot (std::shared_ptr<GstreamerDotDetails>
                                        details);
 
+  /* Attach or detach several ports in one hub transaction */
+  std::vector<int> handlePorts (const std::vector<GstElement *> &ports);
+  void unhandlePorts (const std::vector<int> &ids);
+
+  /* Single port operations. Those requested while a transaction is running
+   * are grouped in the next one */
+  int handlePort (GstElement *port);
+  void unhandlePort (int id);
+
   /* Next methods are automatically implemented by code generator */
   virtual bool connect (const std::string &eventType,
                         std::shared_ptr<EventHandler> handler);
@@ -64,6 +76,21 @@ protected:
 
 private:
 
+  struct PortOperation {
+    GstElement *port;
+    int id;
+    bool done;
+  };
+
+  void runPortOperation (PortOperation &operation,
+                         std::vector<PortOperation *> &queue);
+
+  std::mutex portsMutex;
+  std::condition_variable portsCond;
+  std::vector<PortOperation *> pendingHandles;
+  std::vector<PortOperation *> pendingUnhandles;
+  bool committing = false;
+
   class StaticConstructor
   {
   public:
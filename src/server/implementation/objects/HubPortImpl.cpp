@@ -34,15 +34,13 @@ namespace kurento
 HubPortImpl::HubPortImpl (const boost::property_tree::ptree &config,
                           std::shared_ptr<HubImpl> hub) : MediaElementImpl (config, hub, FACTORY_NAME)
 {
-  g_signal_emit_by_name (hub->getGstreamerElement(), "handle-port",
-                         element, &handlerId);
+  handlerId = hub->handlePort (element);
 }
 
 HubPortImpl::~HubPortImpl()
 {
-  g_signal_emit_by_name (std::dynamic_pointer_cast<HubImpl>
-                         (getParent() )->getGstreamerElement(),
-                         "unhandle-port", handlerId);
+  std::dynamic_pointer_cast<HubImpl> (getParent() )->unhandlePort (
+    handlerId);
 }
 
 MediaObjectImpl *
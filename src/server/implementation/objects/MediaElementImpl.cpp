@@ -45,6 +45,7 @@ GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
 
 #define MIN_OUTPUT_BITRATE "min-output-bitrate"
 #define MAX_OUTPUT_BITRATE "max-output-bitrate"
+#define SHARE_ENCODERS "share-encoders"
 
 #define TYPE_VIDEO "video_"
 #define TYPE_AUDIO "audio_"
@@ -568,6 +569,18 @@ MediaElementImpl::MediaElementImpl (const boost::property_tree::ptree &config,
   } catch (boost::property_tree::ptree_error &e) {
   }
 
+  //read default configuration for encoder sharing
+  try {
+    bool share = getConfigValue<bool, MediaElement> ("shareEncoders");
+    GST_DEBUG ("Encoder sharing configured to %d", share);
+
+    if (g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+                                      SHARE_ENCODERS) != NULL) {
+      g_object_set (G_OBJECT (element), SHARE_ENCODERS, (gboolean) share,
+                    NULL);
+    }
+  } catch (boost::property_tree::ptree_error &e) {
+  }
 }
 
 MediaElementImpl::~MediaElementImpl ()
@@ -1144,6 +1144,663 @@ GST_START_TEST (video_dimension_change_force_output)
 
 GST_END_TEST;
 
+static gboolean
+send_remb_idle (gpointer pad)
+{
+  GstEvent *event = gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
+      gst_structure_new ("REMB", "bitrate", G_TYPE_UINT, 5000000, "ssrc",
+          G_TYPE_UINT, 1, NULL));
+
+  GST_DEBUG_OBJECT (pad, "Sending REMB");
+  gst_pad_push_event (GST_PAD (pad), event);
+
+  return G_SOURCE_REMOVE;
+}
+
+static GstPadProbeReturn
+ladder_caps_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+  gint *expected_width = data;
+  GstCaps *caps;
+  gint width;
+
+  if (GST_EVENT_TYPE (event) != GST_EVENT_CAPS) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  gst_event_parse_caps (event, &caps);
+  fail_unless (gst_structure_get_int (gst_caps_get_structure (caps, 0),
+          "width", &width));
+
+  GST_DEBUG_OBJECT (pad, "Received caps: %" GST_PTR_FORMAT, caps);
+
+  if (width != *expected_width) {
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (*expected_width == 160) {
+    /* Lowest tier at start, enough bandwidth for the full resolution */
+    *expected_width = 640;
+    g_idle_add_full (G_PRIORITY_DEFAULT, send_remb_idle, g_object_ref (pad),
+        g_object_unref);
+  } else {
+    g_idle_add (quit_main_loop_idle, loop);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (ladder_switch)
+{
+  GstElement *fakesink;
+  GstPad *sink;
+  gint expected_width = 160;
+  GstElement *pipeline =
+      gst_parse_launch
+      ("videotestsrc is-live=true ! video/x-raw,format=(string)I420,width=(int)640,height=(int)480 ! agnosticbin ladder=true ! video/x-vp8 ! fakesink async=false sync=true name=sink",
+      NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+
+  fakesink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  sink = gst_element_get_static_pad (fakesink, "sink");
+  gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      ladder_caps_probe, &expected_width, NULL);
+  g_object_unref (sink);
+  g_object_unref (fakesink);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  g_timeout_add_seconds (10, timeout_check, pipeline);
+
+  mark_point ();
+  g_main_loop_run (loop);
+  mark_point ();
+
+  fail_unless (expected_width == 640);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
+static GThread *input_thread;
+
+static GstPadProbeReturn
+input_thread_probe (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  g_atomic_pointer_set (&input_thread, g_thread_self ());
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+fakesink_hand_off_direct (GstElement * fakesink, GstBuffer * buf,
+    GstPad * pad, gpointer data)
+{
+  static int count = 0;
+  GMainLoop *loop = (GMainLoop *) data;
+
+  /* A single passthrough output runs in the thread of the input */
+  fail_unless (g_atomic_pointer_get (&input_thread) == g_thread_self ());
+
+  if (count++ > 40) {
+    g_object_set (G_OBJECT (fakesink), "signal-handoffs", FALSE, NULL);
+    g_idle_add (quit_main_loop_idle, loop);
+  }
+}
+
+GST_START_TEST (direct_passthrough)
+{
+  GstElement *fakesink, *agnosticbin;
+  GstPad *sink;
+  GstElement *pipeline =
+      gst_parse_launch
+      ("videotestsrc is-live=true ! vp8enc deadline=1 ! agnosticbin name=agnostic direct-passthrough=true ! video/x-vp8 ! fakesink async=false sync=false name=sink signal-handoffs=true",
+      NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+
+  agnosticbin = gst_bin_get_by_name (GST_BIN (pipeline), "agnostic");
+  sink = gst_element_get_static_pad (agnosticbin, "sink");
+  gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_BUFFER, input_thread_probe,
+      NULL, NULL);
+  g_object_unref (sink);
+  g_object_unref (agnosticbin);
+
+  fakesink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  g_signal_connect (G_OBJECT (fakesink), "handoff",
+      G_CALLBACK (fakesink_hand_off_direct), loop);
+  g_object_unref (fakesink);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  mark_point ();
+  g_main_loop_run (loop);
+  mark_point ();
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
+typedef struct _DirectRelinkData
+{
+  GstElement *pipeline;
+  GstElement *agnosticbin;
+  GstClockTime last_pts;
+  gint buffers;
+  gint buffers_after_relink;
+} DirectRelinkData;
+
+static gboolean
+add_second_output (gpointer user_data)
+{
+  DirectRelinkData *data = user_data;
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  GstPad *pad = gst_element_get_request_pad (data->agnosticbin, "src_%u");
+
+  g_object_set (fakesink, "async", FALSE, "sync", FALSE, NULL);
+  gst_bin_add (GST_BIN (data->pipeline), fakesink);
+  gst_element_sync_state_with_parent (fakesink);
+  gst_element_link_pads (data->agnosticbin, GST_OBJECT_NAME (pad), fakesink,
+      NULL);
+  g_object_unref (pad);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fakesink_hand_off_relink (GstElement * fakesink, GstBuffer * buf,
+    GstPad * pad, gpointer user_data)
+{
+  DirectRelinkData *data = user_data;
+
+  /* The first output is not stopped waiting for a keyframe */
+  if (GST_CLOCK_TIME_IS_VALID (data->last_pts)) {
+    fail_unless (GST_BUFFER_PTS (buf) - data->last_pts < 2 * GST_SECOND / 30,
+        "Gap of %" GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_PTS (buf) -
+            data->last_pts));
+  }
+  data->last_pts = GST_BUFFER_PTS (buf);
+
+  if (++data->buffers == 20) {
+    g_idle_add (add_second_output, data);
+  } else if (data->buffers > 20 && ++data->buffers_after_relink == 60) {
+    g_object_set (G_OBJECT (fakesink), "signal-handoffs", FALSE, NULL);
+    g_idle_add (quit_main_loop_idle, loop);
+  }
+}
+
+GST_START_TEST (direct_relink)
+{
+  DirectRelinkData data = { NULL, NULL, GST_CLOCK_TIME_NONE, 0, 0 };
+  GstElement *fakesink;
+  GstBus *bus;
+
+  data.pipeline =
+      gst_parse_launch
+      ("videotestsrc is-live=true ! vp8enc deadline=1 ! agnosticbin name=agnostic direct-passthrough=true ! video/x-vp8 ! fakesink async=false sync=false name=sink signal-handoffs=true",
+      NULL);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (data.pipeline));
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), data.pipeline);
+
+  data.agnosticbin = gst_bin_get_by_name (GST_BIN (data.pipeline), "agnostic");
+  fakesink = gst_bin_get_by_name (GST_BIN (data.pipeline), "sink");
+  g_signal_connect (G_OBJECT (fakesink), "handoff",
+      G_CALLBACK (fakesink_hand_off_relink), &data);
+  g_object_unref (fakesink);
+
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+
+  mark_point ();
+  g_main_loop_run (loop);
+  mark_point ();
+
+  fail_unless (data.buffers_after_relink == 60);
+
+  gst_element_set_state (data.pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (data.agnosticbin);
+  g_object_unref (data.pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
+typedef struct _GopCacheData
+{
+  GstElement *pipeline;
+  GstElement *agnosticbin;
+  gint buffers;
+  gint late_buffers;
+  gint late_cached;
+  gboolean late_started_with_keyframe;
+} GopCacheData;
+
+static GstPadProbeReturn
+drop_keyframe_requests (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  GstEvent *event = gst_pad_probe_info_get_event (info);
+
+  /* The encoder only produces its first keyframe */
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_UPSTREAM
+      && gst_structure_has_name (gst_event_get_structure (event),
+          "GstForceKeyUnit")) {
+    return GST_PAD_PROBE_DROP;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+fakesink_hand_off_late (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    gpointer user_data)
+{
+  GopCacheData *data = user_data;
+
+  if (data->late_buffers++ == 0) {
+    data->late_started_with_keyframe =
+        !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+
+  if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DECODE_ONLY)) {
+    data->late_cached++;
+  } else if (data->late_buffers - data->late_cached == 10) {
+    g_object_set (G_OBJECT (fakesink), "signal-handoffs", FALSE, NULL);
+    g_idle_add (quit_main_loop_idle, loop);
+  }
+}
+
+static gboolean
+add_late_output (gpointer user_data)
+{
+  GopCacheData *data = user_data;
+  GstElement *capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  GstCaps *caps = gst_caps_from_string ("video/x-vp8");
+  GstPad *pad;
+
+  g_object_set (capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  g_object_set (fakesink, "async", FALSE, "sync", FALSE, "signal-handoffs",
+      TRUE, NULL);
+  g_signal_connect (G_OBJECT (fakesink), "handoff",
+      G_CALLBACK (fakesink_hand_off_late), data);
+
+  gst_bin_add_many (GST_BIN (data->pipeline), capsfilter, fakesink, NULL);
+  gst_element_link (capsfilter, fakesink);
+  gst_element_sync_state_with_parent (fakesink);
+  gst_element_sync_state_with_parent (capsfilter);
+
+  pad = gst_element_get_request_pad (data->agnosticbin, "src_%u");
+  gst_element_link_pads (data->agnosticbin, GST_OBJECT_NAME (pad), capsfilter,
+      NULL);
+  g_object_unref (pad);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+fakesink_hand_off_first (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    gpointer user_data)
+{
+  GopCacheData *data = user_data;
+
+  if (++data->buffers == 30) {
+    g_object_set (G_OBJECT (fakesink), "signal-handoffs", FALSE, NULL);
+    g_idle_add (add_late_output, data);
+  }
+}
+
+GST_START_TEST (gop_cache_late_output)
+{
+  GopCacheData data = { NULL, NULL, 0, 0, 0, FALSE };
+  GstElement *fakesink;
+  GstPad *sink;
+  GstBus *bus;
+
+  data.pipeline =
+      gst_parse_launch
+      ("videotestsrc is-live=true ! video/x-raw,width=(int)320,height=(int)240 ! vp8enc deadline=1 keyframe-max-dist=10000 ! agnosticbin name=agnostic gop-cache-size=10000000 ! video/x-vp8 ! fakesink async=false sync=false name=sink signal-handoffs=true",
+      NULL);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (data.pipeline));
+
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), data.pipeline);
+
+  data.agnosticbin = gst_bin_get_by_name (GST_BIN (data.pipeline), "agnostic");
+  sink = gst_element_get_static_pad (data.agnosticbin, "sink");
+  gst_pad_add_probe (sink, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM,
+      drop_keyframe_requests, NULL, NULL);
+  g_object_unref (sink);
+
+  fakesink = gst_bin_get_by_name (GST_BIN (data.pipeline), "sink");
+  g_signal_connect (G_OBJECT (fakesink), "handoff",
+      G_CALLBACK (fakesink_hand_off_first), &data);
+  g_object_unref (fakesink);
+
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+  g_timeout_add_seconds (10, quit_main_loop_idle, loop);
+
+  mark_point ();
+  g_main_loop_run (loop);
+  mark_point ();
+
+  /* The late output starts with the cached GOP, without a new keyframe */
+  fail_unless (data.late_started_with_keyframe);
+  fail_unless (data.late_cached >= 30, "%d cached buffers", data.late_cached);
+  fail_unless (data.late_buffers - data.late_cached >= 10);
+
+  gst_element_set_state (data.pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (data.agnosticbin);
+  g_object_unref (data.pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
+typedef struct _SharedEncoderData
+{
+  GstElement *pipeline;
+  gint buffers[2];
+  gint buffers_when_shared[2];
+  gboolean shared;
+} SharedEncoderData;
+
+static void
+count_vp8_encoders (const GValue * item, gpointer count)
+{
+  GstElement *element = g_value_get_object (item);
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  if (factory != NULL && g_strcmp0 (GST_OBJECT_NAME (factory), "vp8enc") == 0) {
+    (*(guint *) count)++;
+  }
+}
+
+static guint
+pipeline_count_vp8_encoders (GstElement * pipeline)
+{
+  GstIterator *it = gst_bin_iterate_recurse (GST_BIN (pipeline));
+  guint count = 0;
+
+  gst_iterator_foreach (it, count_vp8_encoders, &count);
+  gst_iterator_free (it);
+
+  return count;
+}
+
+static void
+fakesink_hand_off_shared (GstElement * fakesink, GstBuffer * buf,
+    GstPad * pad, gpointer data)
+{
+  g_atomic_int_inc ((gint *) data);
+}
+
+static gboolean
+check_shared_encoder (gpointer user_data)
+{
+  SharedEncoderData *data = user_data;
+  guint encoders = pipeline_count_vp8_encoders (data->pipeline);
+  gint a = g_atomic_int_get (&data->buffers[0]);
+  gint b = g_atomic_int_get (&data->buffers[1]);
+
+  if (!data->shared) {
+    if (encoders == 1 && a > 0 && b > 0) {
+      data->shared = TRUE;
+      data->buffers_when_shared[0] = a;
+      data->buffers_when_shared[1] = b;
+    }
+
+    return TRUE;
+  }
+
+  /* Both outputs keep flowing from the encoder left */
+  fail_unless (encoders == 1);
+
+  if (a > data->buffers_when_shared[0] + 20
+      && b > data->buffers_when_shared[1] + 20) {
+    g_main_loop_quit (loop);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Each agnosticbin in its own bin, as they are in endpoints */
+static void
+add_shared_encoder_branch (GstElement * pipeline, GstElement * tee,
+    gint * buffers)
+{
+  GstElement *bin = gst_bin_new (NULL);
+  GstElement *queue = gst_element_factory_make ("queue", NULL);
+  GstElement *agnosticbin = gst_element_factory_make ("agnosticbin", NULL);
+  GstElement *filter = gst_element_factory_make ("capsfilter", NULL);
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  GstCaps *caps = gst_caps_from_string ("video/x-vp8");
+  GstPad *sink;
+
+  g_object_set (agnosticbin, "share-encoders", TRUE, NULL);
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  g_object_set (fakesink, "async", FALSE, "sync", FALSE, "signal-handoffs",
+      TRUE, NULL);
+  g_signal_connect (fakesink, "handoff",
+      G_CALLBACK (fakesink_hand_off_shared), buffers);
+
+  gst_bin_add_many (GST_BIN (bin), queue, agnosticbin, filter, fakesink,
+      NULL);
+  gst_element_link_many (queue, agnosticbin, filter, fakesink, NULL);
+
+  sink = gst_element_get_static_pad (queue, "sink");
+  gst_element_add_pad (bin, gst_ghost_pad_new ("sink", sink));
+  g_object_unref (sink);
+
+  gst_bin_add (GST_BIN (pipeline), bin);
+  fail_unless (gst_element_link (tee, bin));
+}
+
+GST_START_TEST (shared_encoder)
+{
+  SharedEncoderData data = { 0 };
+  GstElement *pipeline = gst_pipeline_new (__FUNCTION__);
+  GstElement *videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  GstElement *tee = gst_element_factory_make ("tee", NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+
+  loop = g_main_loop_new (NULL, TRUE);
+  data.pipeline = pipeline;
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), pipeline);
+
+  g_object_set (videotestsrc, "is-live", TRUE, NULL);
+  gst_bin_add_many (GST_BIN (pipeline), videotestsrc, tee, NULL);
+  gst_element_link (videotestsrc, tee);
+
+  /* Both inputs carry the very same buffers */
+  add_shared_encoder_branch (pipeline, tee, &data.buffers[0]);
+  add_shared_encoder_branch (pipeline, tee, &data.buffers[1]);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  g_timeout_add (100, check_shared_encoder, &data);
+  g_timeout_add_seconds (10, timeout_check, pipeline);
+
+  mark_point ();
+  g_main_loop_run (loop);
+  mark_point ();
+
+  fail_unless (data.shared);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
+static void
+fakesink_hand_off_first (GstElement * fakesink, GstBuffer * buf,
+    GstPad * pad, gpointer data)
+{
+  g_object_set (G_OBJECT (fakesink), "signal-handoffs", FALSE, NULL);
+  g_idle_add (quit_main_loop_idle, data);
+}
+
+static guint
+count_elements (GstBin * bin, const gchar * factory_name)
+{
+  GstIterator *it = gst_bin_iterate_elements (bin);
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+  guint count = 0;
+
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElementFactory *factory =
+            gst_element_get_factory (g_value_get_object (&item));
+
+        if (factory != NULL && g_str_equal (factory_name,
+                gst_plugin_feature_get_name (factory))) {
+          count++;
+        }
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (it);
+        count = 0;
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return count;
+}
+
+/* Runs S16LE stereo audio through agnosticbin to an output with @out_caps,
+ * returns the agnosticbin once media reaches the output */
+static GstElement *
+run_raw_audio (GstElement ** pipeline, const gchar * out_caps)
+{
+  GstElement *fakesink, *agnosticbin;
+  gchar *desc;
+  GstBus *bus;
+
+  desc = g_strdup_printf ("audiotestsrc is-live=true ! "
+      "audio/x-raw,format=S16LE,rate=48000,channels=2 ! agnosticbin name=ag "
+      "! %s ! fakesink async=false sync=false name=sink signal-handoffs=true",
+      out_caps);
+  *pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (*pipeline));
+  loop = g_main_loop_new (NULL, TRUE);
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), *pipeline);
+
+  fakesink = gst_bin_get_by_name (GST_BIN (*pipeline), "sink");
+  g_signal_connect (G_OBJECT (fakesink), "handoff",
+      G_CALLBACK (fakesink_hand_off_first), loop);
+  g_object_unref (fakesink);
+
+  gst_element_set_state (*pipeline, GST_STATE_PLAYING);
+
+  mark_point ();
+  g_main_loop_run (loop);
+  mark_point ();
+
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_main_loop_unref (loop);
+
+  agnosticbin = gst_bin_get_by_name (GST_BIN (*pipeline), "ag");
+
+  return agnosticbin;
+}
+
+GST_START_TEST (raw_audio_no_conversion)
+{
+  GstElement *pipeline, *agnosticbin;
+
+  /* Same format as the input, no converter is needed */
+  agnosticbin = run_raw_audio (&pipeline,
+      "audio/x-raw,format=S16LE,rate=48000,channels=2");
+
+  fail_unless (count_elements (GST_BIN (agnosticbin), "audioconvert") == 0);
+  fail_unless (count_elements (GST_BIN (agnosticbin), "audioresample") == 0);
+
+  g_object_unref (agnosticbin);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (raw_audio_format_conversion)
+{
+  GstElement *pipeline, *agnosticbin;
+
+  /* Same rate as the input, only the sample format is converted */
+  agnosticbin = run_raw_audio (&pipeline,
+      "audio/x-raw,format=F32LE,rate=48000,channels=1");
+
+  fail_unless (count_elements (GST_BIN (agnosticbin), "audioconvert") == 1);
+  fail_unless (count_elements (GST_BIN (agnosticbin), "audioresample") == 0);
+
+  g_object_unref (agnosticbin);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_object_unref (pipeline);
+
+  /* A different rate still needs resampling */
+  agnosticbin = run_raw_audio (&pipeline,
+      "audio/x-raw,format=F32LE,rate=16000,channels=1");
+
+  fail_unless (count_elements (GST_BIN (agnosticbin), "audioconvert") == 1);
+  fail_unless (count_elements (GST_BIN (agnosticbin), "audioresample") == 1);
+
+  g_object_unref (agnosticbin);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  g_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_raw_to_rtp)
 {
   GstElement *fakesink;
@@ -1216,6 +1873,140 @@ GST_START_TEST (test_codec_to_rtp)
 
 GST_END_TEST;
 
+typedef struct _RtpOutputData
+{
+  GstElement *pipeline;
+  GstElement *agnosticbin;
+  GstElement *filter;
+  GstElement *fakesink;
+  gint buffers[2];
+  gint buffers_when_released;
+  gboolean released;
+  gboolean survived;
+} RtpOutputData;
+
+static GstElement *
+add_rtp_output_branch (RtpOutputData * data, const gchar * caps_str,
+    gint * buffers)
+{
+  GstElement *filter = gst_element_factory_make ("capsfilter", NULL);
+  GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+  GstCaps *caps = gst_caps_from_string (caps_str);
+
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  g_object_set (fakesink, "async", FALSE, "sync", FALSE, "signal-handoffs",
+      TRUE, NULL);
+  g_signal_connect (fakesink, "handoff",
+      G_CALLBACK (fakesink_hand_off_shared), buffers);
+
+  gst_bin_add_many (GST_BIN (data->pipeline), filter, fakesink, NULL);
+  gst_element_link_many (data->agnosticbin, filter, fakesink, NULL);
+
+  data->fakesink = fakesink;
+
+  return filter;
+}
+
+static void
+release_vp8_output (RtpOutputData * data)
+{
+  GstPad *sink, *src;
+
+  sink = gst_element_get_static_pad (data->filter, "sink");
+  src = gst_pad_get_peer (sink);
+
+  gst_pad_unlink (src, sink);
+  gst_element_release_request_pad (data->agnosticbin, src);
+  g_object_unref (src);
+  g_object_unref (sink);
+
+  gst_element_set_state (data->filter, GST_STATE_NULL);
+  gst_element_set_state (data->fakesink, GST_STATE_NULL);
+  gst_bin_remove_many (GST_BIN (data->pipeline), data->filter,
+      data->fakesink, NULL);
+}
+
+static gboolean
+check_rtp_output (gpointer user_data)
+{
+  RtpOutputData *data = user_data;
+  gint rtp = g_atomic_int_get (&data->buffers[0]);
+
+  if (!data->released) {
+    if (rtp > 0 && g_atomic_int_get (&data->buffers[1]) > 0) {
+      release_vp8_output (data);
+      data->released = TRUE;
+      data->buffers_when_released = rtp;
+    }
+
+    return TRUE;
+  }
+
+  /* The payloader keeps being fed by the encoder both outputs shared */
+  if (rtp > data->buffers_when_released + 50) {
+    data->survived = TRUE;
+    g_main_loop_quit (loop);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+quit_rtp_output (gpointer user_data)
+{
+  g_main_loop_quit (loop);
+
+  return FALSE;
+}
+
+GST_START_TEST (rtp_output_after_release)
+{
+  RtpOutputData data = { 0 };
+  GstElement *videotestsrc = gst_element_factory_make ("videotestsrc", NULL);
+  GstBus *bus;
+  guint timeout;
+
+  loop = g_main_loop_new (NULL, TRUE);
+  data.pipeline = gst_pipeline_new (__FUNCTION__);
+  data.agnosticbin = gst_element_factory_make ("agnosticbin", NULL);
+  bus = gst_pipeline_get_bus (GST_PIPELINE (data.pipeline));
+
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (bus_msg), data.pipeline);
+
+  g_object_set (videotestsrc, "is-live", TRUE, NULL);
+  gst_bin_add_many (GST_BIN (data.pipeline), videotestsrc, data.agnosticbin,
+      NULL);
+  gst_element_link (videotestsrc, data.agnosticbin);
+
+  add_rtp_output_branch (&data, "application/x-rtp,media=(string)video,"
+      "encoding-name=(string)VP8,clock-rate=(int)90000", &data.buffers[0]);
+  data.filter = add_rtp_output_branch (&data, "video/x-vp8",
+      &data.buffers[1]);
+
+  gst_element_set_state (data.pipeline, GST_STATE_PLAYING);
+  g_timeout_add (100, check_rtp_output, &data);
+  timeout = g_timeout_add_seconds (10, quit_rtp_output, NULL);
+
+  mark_point ();
+  g_main_loop_run (loop);
+  mark_point ();
+
+  fail_unless (data.released);
+  fail_unless (data.survived);
+  g_source_remove (timeout);
+
+  gst_element_set_state (data.pipeline, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (data.pipeline);
+  g_main_loop_unref (loop);
+}
+
+GST_END_TEST;
+
 static void
 check_properties (GstElement * encoder, const GstStructure * config)
 {
@@ -1421,6 +2212,13 @@ agnostic2_suite (void)
   tcase_add_test (tc_chain, h264_encoding_odd_dimension);
   tcase_add_test (tc_chain, video_dimension_change);
   tcase_add_test (tc_chain, video_dimension_change_force_output);
+  tcase_add_test (tc_chain, ladder_switch);
+  tcase_add_test (tc_chain, direct_passthrough);
+  tcase_add_test (tc_chain, direct_relink);
+  tcase_add_test (tc_chain, gop_cache_late_output);
+  tcase_add_test (tc_chain, shared_encoder);
+  tcase_add_test (tc_chain, raw_audio_no_conversion);
+  tcase_add_test (tc_chain, raw_audio_format_conversion);
 
   tcase_add_test (tc_chain, test_codec_config_vp8);
   tcase_add_test (tc_chain, test_codec_config_x264);
@@ -1428,6 +2226,7 @@ agnostic2_suite (void)
 
   tcase_add_test (tc_chain, test_raw_to_rtp);
   tcase_add_test (tc_chain, test_codec_to_rtp);
+  tcase_add_test (tc_chain, rtp_output_after_release);
 
   return s;
 }
@@ -0,0 +1,388 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <glib.h>
+
+#include "kmsaudiolevelmeta.h"
+
+#define INPUTS 3
+#define TICK (10 * GST_MSECOND)
+#define MAX_TICKS 150
+#define TICK_SAMPLES 480        /* mono 48 kHz */
+#define UPSTREAM_LATENCY (50 * GST_MSECOND)
+
+/* Without level meta */
+#define NO_LEVEL -1
+
+typedef struct _Output
+{
+  gfloat samples[MAX_TICKS];
+  gboolean received[MAX_TICKS];
+} Output;
+
+static GMutex mutex;
+static GCond cond;
+static Output outputs[INPUTS];
+static gint gate_levels[INPUTS];
+
+static void
+hand_off (GstElement * fakesink, GstBuffer * buf, GstPad * pad, gpointer data)
+{
+  Output *output = data;
+  guint64 tick = GST_BUFFER_PTS (buf) / TICK;
+  GstMapInfo info;
+
+  gst_buffer_map (buf, &info, GST_MAP_READ);
+  fail_unless (info.size == TICK_SAMPLES * sizeof (gfloat));
+
+  g_mutex_lock (&mutex);
+  if (tick < MAX_TICKS) {
+    output->samples[tick] = ((gfloat *) info.data)[TICK_SAMPLES / 2];
+    output->received[tick] = TRUE;
+  }
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&mutex);
+
+  gst_buffer_unmap (buf, &info);
+}
+
+static gboolean
+upstream_latency_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  if (GST_QUERY_TYPE (query) != GST_QUERY_LATENCY) {
+    return gst_pad_query_default (pad, parent, query);
+  }
+
+  gst_query_set_latency (query, TRUE, UPSTREAM_LATENCY, GST_CLOCK_TIME_NONE);
+
+  return TRUE;
+}
+
+static gboolean
+gate_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  guint8 level;
+
+  if (kms_audio_level_gate_event_parse (event, &level)) {
+    g_atomic_int_set (&gate_levels[GPOINTER_TO_UINT
+            (gst_pad_get_element_private (pad))], level);
+  }
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+/* Links @srcs to a new mixer in a playing pipeline */
+static GstElement *
+create_pipeline (GstPad * srcs[INPUTS], guint max_speakers)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *mix = gst_element_factory_make ("kmsmixminus", "mix");
+  guint i;
+
+  fail_unless (mix != NULL);
+  g_object_set (mix, "max-speakers", max_speakers, NULL);
+  gst_bin_add (GST_BIN (pipeline), mix);
+
+  memset (outputs, 0, sizeof (outputs));
+
+  for (i = 0; i < INPUTS; i++) {
+    GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+    GstPad *sink;
+    gchar *name;
+
+    sink = gst_element_get_request_pad (mix, "sink_%u");
+
+    srcs[i] = gst_pad_new (NULL, GST_PAD_SRC);
+    gst_pad_set_element_private (srcs[i], GUINT_TO_POINTER (i));
+    gst_pad_set_event_function (srcs[i], gate_event);
+    g_atomic_int_set (&gate_levels[i], KMS_AUDIO_LEVEL_SILENCE);
+    gst_pad_set_active (srcs[i], TRUE);
+    fail_unless (gst_pad_link (srcs[i], sink) == GST_PAD_LINK_OK);
+    g_object_unref (sink);
+
+    g_object_set (fakesink, "async", FALSE, "sync", FALSE,
+        "signal-handoffs", TRUE, NULL);
+    g_signal_connect (fakesink, "handoff", G_CALLBACK (hand_off),
+        &outputs[i]);
+    gst_bin_add (GST_BIN (pipeline), fakesink);
+
+    name = g_strdup_printf ("src_%u", i);
+    fail_unless (gst_element_link_pads (mix, name, fakesink, NULL));
+    g_free (name);
+  }
+
+  return pipeline;
+}
+
+static void
+start_inputs (GstPad * srcs[INPUTS])
+{
+  GstCaps *caps = gst_caps_from_string ("audio/x-raw, format=(string)F32LE, "
+      "rate=(int)48000, channels=(int)1, layout=(string)interleaved");
+  GstSegment segment;
+  guint i;
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+
+  for (i = 0; i < INPUTS; i++) {
+    gst_pad_push_event (srcs[i], gst_event_new_stream_start ("test"));
+    gst_pad_push_event (srcs[i], gst_event_new_caps (caps));
+    gst_pad_push_event (srcs[i], gst_event_new_segment (&segment));
+  }
+
+  gst_caps_unref (caps);
+}
+
+static void
+destroy_pipeline (GstElement * pipeline, GstPad * srcs[INPUTS])
+{
+  guint i;
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  for (i = 0; i < INPUTS; i++) {
+    g_object_unref (srcs[i]);
+  }
+  g_object_unref (pipeline);
+}
+
+static void
+push_tick (GstPad * src, gfloat value, guint tick, gint level)
+{
+  GstBuffer *buffer;
+  GstMapInfo info;
+  guint i;
+
+  buffer = gst_buffer_new_allocate (NULL, TICK_SAMPLES * sizeof (gfloat),
+      NULL);
+  gst_buffer_map (buffer, &info, GST_MAP_WRITE);
+  for (i = 0; i < TICK_SAMPLES; i++) {
+    ((gfloat *) info.data)[i] = value;
+  }
+  gst_buffer_unmap (buffer, &info);
+
+  GST_BUFFER_PTS (buffer) = tick * TICK;
+  GST_BUFFER_DURATION (buffer) = TICK;
+
+  if (level != NO_LEVEL) {
+    kms_buffer_add_audio_level_meta (buffer, level, TRUE);
+  }
+
+  fail_unless (gst_pad_push (src, buffer) == GST_FLOW_OK);
+}
+
+/* Waits until every output has received @tick. Call with the mutex held */
+static void
+wait_for_tick (guint tick)
+{
+  gint64 end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+  while (!outputs[0].received[tick] || !outputs[1].received[tick]
+      || !outputs[2].received[tick]) {
+    if (!g_cond_wait_until (&cond, &mutex, end_time)) {
+      break;
+    }
+  }
+}
+
+/* Mix minus */
+
+#define MIX_TICKS 30
+
+/* Input 1 is late, input 2 has a gap */
+#define LATE_INPUT 1
+#define LATE_FROM 20
+#define GAP_INPUT 2
+#define GAP_FROM 10
+#define GAP_TO 15
+
+static const gfloat values[INPUTS] = { 0.125, 0.25, 0.5 };
+
+static gboolean
+input_present (guint input, guint tick)
+{
+  return input != GAP_INPUT || tick < GAP_FROM || tick >= GAP_TO;
+}
+
+GST_START_TEST (mix_minus_own)
+{
+  GstPad *srcs[INPUTS];
+  GstElement *pipeline, *mix;
+  GstQuery *query;
+  GstClockTime min;
+  gboolean live;
+  guint i, j, t;
+
+  pipeline = create_pipeline (srcs, 0);
+  mix = gst_bin_get_by_name (GST_BIN (pipeline), "mix");
+  gst_pad_set_query_function (srcs[LATE_INPUT], upstream_latency_query);
+
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  /* The latency of the inputs is added to the one of the mixer */
+  query = gst_query_new_latency ();
+  fail_unless (gst_element_query (mix, query));
+  gst_query_parse_latency (query, &live, &min, NULL);
+  fail_unless (live);
+  fail_unless (min == 150 * GST_MSECOND + UPSTREAM_LATENCY,
+      "Latency %" GST_TIME_FORMAT, GST_TIME_ARGS (min));
+  gst_query_unref (query);
+  g_object_unref (mix);
+
+  start_inputs (srcs);
+
+  for (i = 0; i < INPUTS; i++) {
+    for (t = 0; t < MIX_TICKS; t++) {
+      if (input_present (i, t) && (i != LATE_INPUT || t < LATE_FROM)) {
+        push_tick (srcs[i], values[i], t, NO_LEVEL);
+      }
+    }
+  }
+
+  /* Arrives later than the others, but within the latency */
+  g_usleep (100 * G_TIME_SPAN_MILLISECOND);
+  for (t = LATE_FROM; t < MIX_TICKS; t++) {
+    push_tick (srcs[LATE_INPUT], values[LATE_INPUT], t, NO_LEVEL);
+  }
+
+  g_mutex_lock (&mutex);
+  wait_for_tick (MIX_TICKS - 1);
+
+  /* Each output is the sum of the other inputs present */
+  for (i = 0; i < INPUTS; i++) {
+    fail_unless (outputs[i].received[GAP_FROM]);
+    fail_unless (outputs[i].received[MIX_TICKS - 1]);
+
+    for (t = 0; t < MIX_TICKS; t++) {
+      gfloat expected = 0.0;
+
+      if (!outputs[i].received[t]) {
+        continue;
+      }
+
+      for (j = 0; j < INPUTS; j++) {
+        if (j != i && input_present (j, t)) {
+          expected += values[j];
+        }
+      }
+
+      fail_unless (ABS (outputs[i].samples[t] - expected) < 1e-5,
+          "Output %u, tick %u: %f instead of %f", i, t,
+          outputs[i].samples[t], expected);
+    }
+  }
+  g_mutex_unlock (&mutex);
+
+  destroy_pipeline (pipeline, srcs);
+}
+
+GST_END_TEST;
+
+/* Loudest speakers */
+
+#define SPEAKER_TICKS MAX_TICKS
+#define PHASE_TICKS 50
+#define LISTENER 2
+
+/* Input 0 is mixed first. Input 1 gets 2 dB louder, that is not enough to
+ * replace it, then 10 dB louder */
+static const gint speaker_levels[][INPUTS] = {
+  {20, 30, KMS_AUDIO_LEVEL_SILENCE},
+  {20, 18, KMS_AUDIO_LEVEL_SILENCE},
+  {20, 10, KMS_AUDIO_LEVEL_SILENCE},
+};
+
+static const gfloat speaker_values[INPUTS] = { 0.125, 0.25, 0.0 };
+
+GST_START_TEST (loudest_speakers)
+{
+  GstPad *srcs[INPUTS];
+  GstElement *pipeline;
+  gint64 start;
+  guint i, t;
+  gint level;
+
+  pipeline = create_pipeline (srcs, 1);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  start_inputs (srcs);
+
+  /* Power is measured on arrival, so audio is pushed in real time */
+  start = g_get_monotonic_time ();
+  for (t = 0; t < SPEAKER_TICKS; t++) {
+    gint64 wait = start + t * TICK / GST_USECOND - g_get_monotonic_time ();
+
+    if (wait > 0) {
+      g_usleep (wait);
+    }
+
+    for (i = 0; i < INPUTS; i++) {
+      push_tick (srcs[i], speaker_values[i], t,
+          speaker_levels[t / PHASE_TICKS][i]);
+    }
+
+    if (t == 2 * PHASE_TICKS - 1) {
+      /* Only audio that could replace input 0 is asked for */
+      level = g_atomic_int_get (&gate_levels[1]);
+      fail_unless (level >= 15 && level <= 17, "Gate at %d", level);
+      fail_unless (g_atomic_int_get (&gate_levels[LISTENER]) == level);
+      fail_unless (g_atomic_int_get (&gate_levels[0]) ==
+          KMS_AUDIO_LEVEL_SILENCE);
+    }
+  }
+
+  g_mutex_lock (&mutex);
+  wait_for_tick (SPEAKER_TICKS - 1);
+
+  /* Inputs not mixed hear the only speaker mixed. Ticks are mixed after
+   * the latency, so the last ones of each phase may see the next one */
+  for (t = 20; t <= 80; t++) {
+    fail_unless (outputs[LISTENER].received[t]);
+    fail_unless (ABS (outputs[LISTENER].samples[t] - speaker_values[0]) <
+        1e-5, "Tick %u: %f", t, outputs[LISTENER].samples[t]);
+  }
+
+  fail_unless (outputs[LISTENER].received[SPEAKER_TICKS - 1]);
+  fail_unless (ABS (outputs[LISTENER].samples[SPEAKER_TICKS - 1] -
+          speaker_values[1]) < 1e-5);
+  g_mutex_unlock (&mutex);
+
+  level = g_atomic_int_get (&gate_levels[0]);
+  fail_unless (level >= 5 && level <= 7, "Gate at %d", level);
+  fail_unless (g_atomic_int_get (&gate_levels[1]) == KMS_AUDIO_LEVEL_SILENCE);
+
+  destroy_pipeline (pipeline, srcs);
+}
+
+GST_END_TEST;
+
+static Suite *
+mixminus_suite (void)
+{
+  Suite *s = suite_create ("mixminus");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, mix_minus_own);
+  tcase_add_test (tc_chain, loudest_speakers);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mixminus);
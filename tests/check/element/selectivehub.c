@@ -0,0 +1,476 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <gst/gst.h>
+#include <glib.h>
+#include <string.h>
+
+#define KMS_ELEMENT_PAD_TYPE_AUDIO 1
+#define KMS_ELEMENT_PAD_TYPE_VIDEO 2
+#define KMS_FORWARDING_MODE_PINNED 1
+
+#define AUDIO_CAPS "audio/x-raw, format=(string)S16LE, rate=(int)8000, " \
+  "channels=(int)1, layout=(string)interleaved"
+#define VIDEO_CAPS "video/x-raw, format=(string)GRAY8, width=(int)16, " \
+  "height=(int)10, framerate=(fraction)100/1"
+#define BUFFER_SIZE 160         /* 10 ms of audio, a frame of video */
+#define AUDIO_AMPLITUDE 1000
+#define AUDIO_TOLERANCE 250
+#define MAX_PORTS 3
+
+/* Media received by the output of a port */
+typedef struct _Output
+{
+  /* Video buffers, by the port that sent them */
+  guint received[MAX_PORTS + 1];
+  gboolean changed;
+
+  /* Last audio sample */
+  gint sample;
+} Output;
+
+typedef struct _MediaTest
+{
+  GstElement *pipeline;
+  GstElement *hub;
+  GstElement *srcs[MAX_PORTS];
+  gint ids[MAX_PORTS];
+  Output outputs[MAX_PORTS];
+  guint n_ports;
+  gboolean audio;
+
+  GMutex mutex;
+  GCond cond;
+  GThread *thread;
+  gboolean stop;
+} MediaTest;
+
+/* Each port sends video frames filled with its index plus one, and audio
+ * whose samples are that number of times AUDIO_AMPLITUDE */
+static void
+fill_buffer (MediaTest * test, GstBuffer * buffer, guint index)
+{
+  GstMapInfo info;
+  guint i;
+
+  if (!test->audio) {
+    gst_buffer_memset (buffer, 0, index + 1, BUFFER_SIZE);
+    return;
+  }
+
+  gst_buffer_map (buffer, &info, GST_MAP_WRITE);
+  for (i = 0; i < BUFFER_SIZE / sizeof (gint16); i++) {
+    GST_WRITE_UINT16_LE (info.data + i * sizeof (gint16),
+        (index + 1) * AUDIO_AMPLITUDE);
+  }
+  gst_buffer_unmap (buffer, &info);
+}
+
+static gpointer
+push_media (MediaTest * test)
+{
+  while (!g_atomic_int_get (&test->stop)) {
+    guint i;
+
+    for (i = 0; i < test->n_ports; i++) {
+      GstBuffer *buffer = gst_buffer_new_allocate (NULL, BUFFER_SIZE, NULL);
+      GstFlowReturn ret;
+
+      fill_buffer (test, buffer, i);
+      g_signal_emit_by_name (test->srcs[i], "push-buffer", buffer, &ret);
+      gst_buffer_unref (buffer);
+    }
+
+    g_usleep (10 * G_TIME_SPAN_MILLISECOND);
+  }
+
+  return NULL;
+}
+
+static void
+hand_off (GstElement * fakesink, GstBuffer * buf, GstPad * pad,
+    MediaTest * test)
+{
+  Output *output = g_object_get_data (G_OBJECT (fakesink), "output");
+  guint8 data[BUFFER_SIZE], expected[BUFFER_SIZE];
+  gsize size;
+
+  size = gst_buffer_extract (buf, 0, data, BUFFER_SIZE);
+
+  g_mutex_lock (&test->mutex);
+
+  if (test->audio) {
+    if (size >= sizeof (gint16)) {
+      /* Away from the edges of the buffer */
+      output->sample = (gint16) GST_READ_UINT16_LE (data + (size / 2 &
+              ~(sizeof (gint16) - 1)));
+      g_cond_broadcast (&test->cond);
+    }
+    g_mutex_unlock (&test->mutex);
+    return;
+  }
+
+  memset (expected, data[0], BUFFER_SIZE);
+
+  if (size != BUFFER_SIZE || gst_buffer_get_size (buf) != BUFFER_SIZE
+      || memcmp (data, expected, BUFFER_SIZE) != 0 || data[0] == 0
+      || data[0] > test->n_ports) {
+    output->changed = TRUE;
+  } else {
+    output->received[data[0]]++;
+  }
+  g_cond_broadcast (&test->cond);
+  g_mutex_unlock (&test->mutex);
+}
+
+static void
+media_test_start (MediaTest * test, guint n_ports, gboolean audio)
+{
+  GstCaps *caps = gst_caps_from_string (audio ? AUDIO_CAPS : VIDEO_CAPS);
+  guint i;
+
+  memset (test, 0, sizeof (MediaTest));
+  g_mutex_init (&test->mutex);
+  g_cond_init (&test->cond);
+  test->n_ports = n_ports;
+  test->audio = audio;
+
+  test->pipeline = gst_pipeline_new (NULL);
+  test->hub = gst_element_factory_make ("selectivehub", NULL);
+  gst_bin_add (GST_BIN (test->pipeline), test->hub);
+
+  for (i = 0; i < n_ports; i++) {
+    GstElement *port = gst_element_factory_make ("hubport", NULL);
+    GstElement *capsfilter = gst_element_factory_make ("capsfilter", NULL);
+    GstElement *fakesink = gst_element_factory_make ("fakesink", NULL);
+    gchar *padname;
+
+    test->srcs[i] = gst_element_factory_make ("appsrc", NULL);
+    g_object_set (test->srcs[i], "is-live", TRUE, "do-timestamp", TRUE,
+        "format", GST_FORMAT_TIME, "caps", caps, NULL);
+    g_object_set (capsfilter, "caps", caps, NULL);
+    g_object_set (fakesink, "async", FALSE, "sync", FALSE,
+        "signal-handoffs", TRUE, NULL);
+    g_object_set_data (G_OBJECT (fakesink), "output", &test->outputs[i]);
+    g_signal_connect (fakesink, "handoff", G_CALLBACK (hand_off), test);
+
+    gst_bin_add_many (GST_BIN (test->pipeline), port, test->srcs[i],
+        capsfilter, fakesink, NULL);
+
+    g_signal_emit_by_name (test->hub, "handle-port", port, &test->ids[i]);
+    fail_unless (test->ids[i] >= 0);
+
+    fail_unless (gst_element_link_pads (test->srcs[i], "src", port,
+            audio ? "sink_audio_default" : "sink_video_default"));
+
+    g_signal_emit_by_name (port, "request-new-pad",
+        audio ? KMS_ELEMENT_PAD_TYPE_AUDIO : KMS_ELEMENT_PAD_TYPE_VIDEO, NULL,
+        GST_PAD_SRC, &padname);
+    fail_if (padname == NULL);
+    fail_unless (gst_element_link_pads (port, padname, capsfilter, NULL));
+    fail_unless (gst_element_link (capsfilter, fakesink));
+    g_free (padname);
+  }
+
+  gst_caps_unref (caps);
+
+  gst_element_set_state (test->pipeline, GST_STATE_PLAYING);
+  test->thread = g_thread_new ("push_media", (GThreadFunc) push_media, test);
+}
+
+static void
+media_test_stop (MediaTest * test)
+{
+  g_atomic_int_set (&test->stop, TRUE);
+  g_thread_join (test->thread);
+
+  gst_element_set_state (test->pipeline, GST_STATE_NULL);
+  g_object_unref (test->pipeline);
+
+  g_mutex_clear (&test->mutex);
+  g_cond_clear (&test->cond);
+}
+
+/* Clears what the outputs received. Call with the mutex held */
+static void
+media_test_reset (MediaTest * test)
+{
+  guint i;
+
+  for (i = 0; i < test->n_ports; i++) {
+    memset (test->outputs[i].received, 0,
+        sizeof (test->outputs[i].received));
+  }
+}
+
+/* Waits until the output of port @index receives @count buffers of port
+ * @source. Call with the mutex held */
+static gboolean
+media_test_wait (MediaTest * test, guint index, guint source, guint count)
+{
+  gint64 end_time = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+
+  while (test->outputs[index].received[source + 1] < count) {
+    if (!g_cond_wait_until (&test->cond, &test->mutex, end_time)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Waits until the output of port @index receives audio samples of @sample.
+ * Call with the mutex held */
+static gboolean
+media_test_wait_sample (MediaTest * test, guint index, gint sample)
+{
+  gint64 end_time = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+
+  while (ABS (test->outputs[index].sample - sample) > AUDIO_TOLERANCE) {
+    if (!g_cond_wait_until (&test->cond, &test->mutex, end_time)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+GST_START_TEST (forward_media)
+{
+  MediaTest test;
+  guint i;
+
+  media_test_start (&test, 2, FALSE);
+
+  g_mutex_lock (&test.mutex);
+  fail_unless (media_test_wait (&test, 0, 1, 20));
+  fail_unless (media_test_wait (&test, 1, 0, 20));
+
+  /* Each port gets the buffers of the other one, as they were sent */
+  for (i = 0; i < 2; i++) {
+    fail_if (test.outputs[i].changed);
+    fail_unless (test.outputs[i].received[i + 1] == 0);
+  }
+  g_mutex_unlock (&test.mutex);
+
+  media_test_stop (&test);
+}
+
+GST_END_TEST
+GST_START_TEST (switch_source)
+{
+  MediaTest test;
+  gboolean ret;
+  guint i;
+
+  media_test_start (&test, 3, FALSE);
+
+  /* select-source forwards a given port to an output */
+  g_signal_emit_by_name (test.hub, "select-source", test.ids[2], test.ids[0],
+      &ret);
+  fail_unless (ret);
+
+  g_mutex_lock (&test.mutex);
+  fail_unless (media_test_wait (&test, 2, 0, 1));
+  media_test_reset (&test);
+  fail_unless (media_test_wait (&test, 2, 0, 20));
+  fail_unless (test.outputs[2].received[2] == 0);
+  g_mutex_unlock (&test.mutex);
+
+  g_signal_emit_by_name (test.hub, "select-source", test.ids[2], test.ids[1],
+      &ret);
+  fail_unless (ret);
+
+  g_mutex_lock (&test.mutex);
+  fail_unless (media_test_wait (&test, 2, 1, 1));
+  media_test_reset (&test);
+  fail_unless (media_test_wait (&test, 2, 1, 20));
+  fail_unless (test.outputs[2].received[1] == 0);
+  g_mutex_unlock (&test.mutex);
+
+  /* Pinned mode forwards the pinned port to every other output */
+  g_signal_emit_by_name (test.hub, "select-source", test.ids[2], -1, &ret);
+  fail_unless (ret);
+  g_object_set (test.hub, "pinned", test.ids[0], "mode",
+      KMS_FORWARDING_MODE_PINNED, NULL);
+
+  g_mutex_lock (&test.mutex);
+  fail_unless (media_test_wait (&test, 1, 0, 1));
+  fail_unless (media_test_wait (&test, 2, 0, 1));
+  media_test_reset (&test);
+  fail_unless (media_test_wait (&test, 1, 0, 20));
+  fail_unless (media_test_wait (&test, 2, 0, 20));
+  fail_unless (test.outputs[1].received[3] == 0);
+  fail_unless (test.outputs[2].received[2] == 0);
+
+  for (i = 0; i < 3; i++) {
+    fail_if (test.outputs[i].changed);
+    fail_unless (test.outputs[i].received[i + 1] == 0);
+  }
+  g_mutex_unlock (&test.mutex);
+
+  media_test_stop (&test);
+}
+
+GST_END_TEST
+GST_START_TEST (mix_audio)
+{
+  MediaTest test;
+  gboolean ret;
+
+  media_test_start (&test, 3, TRUE);
+
+  /* Whatever video is featured, everybody hears all the others */
+  g_signal_emit_by_name (test.hub, "select-source", test.ids[2], test.ids[0],
+      &ret);
+  fail_unless (ret);
+
+  g_mutex_lock (&test.mutex);
+  fail_unless (media_test_wait_sample (&test, 0, 5 * AUDIO_AMPLITUDE));
+  fail_unless (media_test_wait_sample (&test, 1, 4 * AUDIO_AMPLITUDE));
+  fail_unless (media_test_wait_sample (&test, 2, 3 * AUDIO_AMPLITUDE));
+  g_mutex_unlock (&test.mutex);
+
+  /* Only the two loudest ports are mixed */
+  g_object_set (test.hub, "max-speakers", 2, NULL);
+
+  g_mutex_lock (&test.mutex);
+  fail_unless (media_test_wait_sample (&test, 0, 5 * AUDIO_AMPLITUDE));
+  fail_unless (media_test_wait_sample (&test, 1, 3 * AUDIO_AMPLITUDE));
+  fail_unless (media_test_wait_sample (&test, 2, 2 * AUDIO_AMPLITUDE));
+  g_mutex_unlock (&test.mutex);
+
+  media_test_stop (&test);
+}
+
+GST_END_TEST
+
+GST_START_TEST (select_source)
+{
+  GstBin *pipe = (GstBin *) gst_pipeline_new ("select_source");
+  GstElement *hub = gst_element_factory_make ("selectivehub", NULL);
+  GstElement *port1 = gst_element_factory_make ("hubport", NULL);
+  GstElement *port2 = gst_element_factory_make ("hubport", NULL);
+  gint id1, id2;
+  gboolean ret;
+
+  fail_unless (hub != NULL);
+  gst_bin_add_many (pipe, hub, port1, port2, NULL);
+
+  g_signal_emit_by_name (hub, "handle-port", port1, &id1);
+  g_signal_emit_by_name (hub, "handle-port", port2, &id2);
+  fail_unless (id1 >= 0 && id2 >= 0 && id1 != id2);
+
+  /* Ports never receive their own media */
+  g_signal_emit_by_name (hub, "select-source", id1, id1, &ret);
+  fail_if (ret);
+
+  g_signal_emit_by_name (hub, "select-source", id1, id2 + 1, &ret);
+  fail_if (ret);
+
+  g_signal_emit_by_name (hub, "select-source", id1, id2, &ret);
+  fail_unless (ret);
+
+  /* Back to the mode */
+  g_signal_emit_by_name (hub, "select-source", id1, -1, &ret);
+  fail_unless (ret);
+
+  g_signal_emit_by_name (hub, "unhandle-port", id2);
+  g_signal_emit_by_name (hub, "select-source", id1, id2, &ret);
+  fail_if (ret);
+
+  g_signal_emit_by_name (hub, "unhandle-port", id1);
+
+  g_object_unref (pipe);
+}
+
+GST_END_TEST
+GST_START_TEST (handle_ports)
+{
+  GstBin *pipe = (GstBin *) gst_pipeline_new ("handle_ports");
+  GstElement *hub = gst_element_factory_make ("selectivehub", NULL);
+  GPtrArray *ports = g_ptr_array_new ();
+  GArray *ids = NULL;
+  gint id1, id2;
+  gboolean ret;
+
+  gst_bin_add (pipe, hub);
+  g_ptr_array_add (ports, gst_element_factory_make ("hubport", NULL));
+  g_ptr_array_add (ports, gst_element_factory_make ("hubport", NULL));
+  gst_bin_add_many (pipe, g_ptr_array_index (ports, 0),
+      g_ptr_array_index (ports, 1), NULL);
+
+  g_signal_emit_by_name (hub, "handle-ports", ports, &ids);
+  fail_unless (ids != NULL && ids->len == 2);
+
+  id1 = g_array_index (ids, gint, 0);
+  id2 = g_array_index (ids, gint, 1);
+  fail_unless (id1 >= 0 && id2 >= 0 && id1 != id2);
+
+  g_signal_emit_by_name (hub, "select-source", id1, id2, &ret);
+  fail_unless (ret);
+
+  g_signal_emit_by_name (hub, "unhandle-ports", ids);
+  g_signal_emit_by_name (hub, "select-source", id1, id2, &ret);
+  fail_if (ret);
+
+  g_array_unref (ids);
+  g_ptr_array_unref (ports);
+  g_object_unref (pipe);
+}
+
+GST_END_TEST
+GST_START_TEST (create_element)
+{
+  GstElement *hub;
+  guint max_speakers;
+  gint pinned;
+
+  hub = gst_element_factory_make ("selectivehub", NULL);
+
+  fail_unless (hub != NULL);
+
+  g_object_set (hub, "pinned", 3, NULL);
+  g_object_get (hub, "pinned", &pinned, NULL);
+  fail_unless (pinned == 3);
+
+  g_object_set (hub, "max-speakers", 2, NULL);
+  g_object_get (hub, "max-speakers", &max_speakers, NULL);
+  fail_unless (max_speakers == 2);
+
+  g_object_unref (hub);
+}
+
+GST_END_TEST static Suite *
+selectivehub_suite (void)
+{
+  Suite *s = suite_create ("selectivehub");
+  TCase *tc_chain = tcase_create ("element");
+
+  suite_add_tcase (s, tc_chain);
+
+  tcase_add_test (tc_chain, create_element);
+  tcase_add_test (tc_chain, select_source);
+  tcase_add_test (tc_chain, handle_ports);
+  tcase_add_test (tc_chain, forward_media);
+  tcase_add_test (tc_chain, switch_source);
+  tcase_add_test (tc_chain, mix_audio);
+
+  return s;
+}
+
+GST_CHECK_MAIN (selectivehub);
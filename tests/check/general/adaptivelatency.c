@@ -0,0 +1,128 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsadaptivelatency.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#define CLOCK_RATE 90000
+#define PACKET_INTERVAL 20      /* ms */
+#define PACKETS_PER_UPDATE (1000 / PACKET_INTERVAL)
+
+/* Feeds one second of packets whose arrival deviates up to @jitter ms from
+ * the sending time and runs an update. Returns the resulting latency */
+static guint
+run_second (KmsAdaptiveLatency * al, guint second, guint jitter, guint64 late)
+{
+  GstClockTime base = 10 * GST_SECOND + second * GST_SECOND;
+  guint i, latency;
+
+  for (i = 0; i < PACKETS_PER_UPDATE; i++) {
+    guint32 ts = (second * PACKETS_PER_UPDATE + i) * PACKET_INTERVAL *
+        (CLOCK_RATE / 1000);
+    GstClockTime arrival = base + i * PACKET_INTERVAL * GST_MSECOND;
+
+    if (i % 2) {
+      arrival += jitter * GST_MSECOND;
+    }
+
+    kms_adaptive_latency_packet_received (al, ts, CLOCK_RATE, arrival);
+  }
+
+  kms_adaptive_latency_update (al, PACKETS_PER_UPDATE - late, late,
+      base + GST_SECOND, &latency);
+
+  return latency;
+}
+
+GST_START_TEST (check_steady_network)
+{
+  KmsAdaptiveLatency *al;
+  guint i, latency = 0;
+
+  al = kms_adaptive_latency_new (500, 20, 1000);
+
+  for (i = 0; i < 60; i++) {
+    latency = run_second (al, i, 0, 0);
+  }
+
+  fail_unless (kms_adaptive_latency_get_jitter (al) < GST_MSECOND);
+  fail_unless (latency == 20, "Latency: %u", latency);
+  fail_unless (kms_adaptive_latency_get_latency (al) == latency);
+
+  kms_adaptive_latency_destroy (al);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_jitter_increase)
+{
+  KmsAdaptiveLatency *al;
+  guint i, latency = 0;
+
+  al = kms_adaptive_latency_new (20, 20, 1000);
+
+  for (i = 0; i < 10; i++) {
+    latency = run_second (al, i, 60, 0);
+  }
+
+  fail_unless (kms_adaptive_latency_get_jitter (al) > 40 * GST_MSECOND);
+  fail_unless (latency > 150, "Latency: %u", latency);
+  fail_unless (latency <= 1000);
+
+  kms_adaptive_latency_destroy (al);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_late_packets)
+{
+  KmsAdaptiveLatency *al;
+  guint latency, held;
+
+  al = kms_adaptive_latency_new (100, 20, 1000);
+
+  /* Late packets grow the latency even without jitter */
+  latency = run_second (al, 0, 0, 5);
+  fail_unless (latency > 100, "Latency: %u", latency);
+
+  /* Decreases are held for a while after the drop-outs */
+  held = run_second (al, 1, 0, 0);
+  fail_unless (held == latency, "Latency: %u", held);
+
+  kms_adaptive_latency_destroy (al);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+adaptivelatency_suite (void)
+{
+  Suite *s = suite_create ("adaptivelatency");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_steady_network);
+  tcase_add_test (tc_chain, check_jitter_increase);
+  tcase_add_test (tc_chain, check_late_packets);
+
+  return s;
+}
+
+GST_CHECK_MAIN (adaptivelatency);
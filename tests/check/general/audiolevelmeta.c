@@ -0,0 +1,145 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "kmsaudiolevelmeta.h"
+
+#include <gst/check/gstcheck.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <glib.h>
+
+#define EXT_ID 1
+
+static GstBuffer *
+create_rtp_buffer (guint8 id, const guint8 * ext, guint size)
+{
+  GstRTPBuffer rtp = { NULL, };
+  GstBuffer *buffer;
+
+  buffer = gst_rtp_buffer_new_allocate (20, 0, 0);
+
+  if (ext != NULL) {
+    gst_rtp_buffer_map (buffer, GST_MAP_READWRITE, &rtp);
+    fail_unless (gst_rtp_buffer_add_extension_onebyte_header (&rtp, id, ext,
+            size));
+    gst_rtp_buffer_unmap (&rtp);
+  }
+
+  return buffer;
+}
+
+GST_START_TEST (check_rtp_extension)
+{
+  guint8 ext[2] = { 0x80 | 42, 0 };
+  KmsAudioLevelMeta *meta;
+  GstBuffer *buffer;
+
+  /* V bit set and 42 dB under the overload point */
+  buffer = create_rtp_buffer (EXT_ID, ext, 1);
+  meta = kms_buffer_add_audio_level_meta_from_rtp (buffer, EXT_ID);
+  fail_if (meta == NULL);
+  fail_unless (meta->level == 42);
+  fail_unless (meta->voice);
+  fail_unless (kms_buffer_get_audio_level_meta (buffer) == meta);
+  gst_buffer_unref (buffer);
+
+  ext[0] = KMS_AUDIO_LEVEL_SILENCE;
+  buffer = create_rtp_buffer (EXT_ID, ext, 1);
+  meta = kms_buffer_add_audio_level_meta_from_rtp (buffer, EXT_ID);
+  fail_if (meta == NULL);
+  fail_unless (meta->level == KMS_AUDIO_LEVEL_SILENCE);
+  fail_if (meta->voice);
+  gst_buffer_unref (buffer);
+
+  /* Other extensions, other sizes or no extension at all are ignored */
+  buffer = create_rtp_buffer (EXT_ID + 1, ext, 1);
+  fail_unless (kms_buffer_add_audio_level_meta_from_rtp (buffer,
+          EXT_ID) == NULL);
+  fail_unless (kms_buffer_get_audio_level_meta (buffer) == NULL);
+  gst_buffer_unref (buffer);
+
+  buffer = create_rtp_buffer (EXT_ID, ext, 2);
+  fail_unless (kms_buffer_add_audio_level_meta_from_rtp (buffer,
+          EXT_ID) == NULL);
+  gst_buffer_unref (buffer);
+
+  buffer = create_rtp_buffer (EXT_ID, NULL, 0);
+  fail_unless (kms_buffer_add_audio_level_meta_from_rtp (buffer,
+          EXT_ID) == NULL);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_level_power)
+{
+  guint8 level;
+
+  fail_unless (kms_audio_level_to_power (0) == 1.0);
+  fail_unless (kms_audio_level_to_power (KMS_AUDIO_LEVEL_SILENCE) == 0.0);
+
+  /* 10 dB less is a tenth of the power */
+  fail_unless (ABS (kms_audio_level_to_power (30) -
+          kms_audio_level_to_power (20) / 10.0) < 1e-9);
+
+  for (level = 0; level < KMS_AUDIO_LEVEL_SILENCE; level++) {
+    fail_unless (kms_audio_level_from_power (kms_audio_level_to_power
+            (level)) == level);
+  }
+
+  /* Quietest level at least as loud as the power asked for */
+  level = kms_audio_level_from_power (kms_audio_level_to_power (20) * 1.5);
+  fail_unless (level == 18, "Level %u", level);
+  fail_unless (kms_audio_level_from_power (0.0) == KMS_AUDIO_LEVEL_SILENCE);
+  fail_unless (kms_audio_level_from_power (2.0) == 0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_gate_event)
+{
+  GstEvent *event;
+  guint8 level = 0;
+
+  event = kms_audio_level_gate_event_new (35);
+  fail_unless (GST_EVENT_IS_UPSTREAM (event));
+  fail_unless (kms_audio_level_gate_event_parse (event, &level));
+  fail_unless (level == 35);
+  gst_event_unref (event);
+
+  event = gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
+      gst_structure_new_empty ("other"));
+  fail_if (kms_audio_level_gate_event_parse (event, &level));
+  gst_event_unref (event);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+audiolevelmeta_suite (void)
+{
+  Suite *s = suite_create ("audiolevelmeta");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_rtp_extension);
+  tcase_add_test (tc_chain, check_level_power);
+  tcase_add_test (tc_chain, check_gate_event);
+
+  return s;
+}
+
+GST_CHECK_MAIN (audiolevelmeta);
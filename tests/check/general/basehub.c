@@ -18,6 +18,152 @@
 #include "kmsbasehub.h"
 #include "kmsmixerport.h"
 
+static GstBusSyncReply
+count_latency_messages (GstBus * bus, GstMessage * message, gpointer data)
+{
+  gint *count = data;
+
+  if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_LATENCY) {
+    g_atomic_int_inc (count);
+  }
+
+  return GST_BUS_DROP;
+}
+
+static void
+post_latency (GstElement * element)
+{
+  gst_element_post_message (element,
+      gst_message_new_latency (GST_OBJECT (element)));
+}
+
+GST_START_TEST (batch_latency)
+{
+  GstElement *pipe = gst_pipeline_new (NULL);
+  KmsBaseHub *hub = g_object_new (KMS_TYPE_BASE_HUB, NULL);
+  GstElement *identity = gst_element_factory_make ("identity", NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipe));
+  gint count = 0;
+
+  gst_bus_set_sync_handler (bus, count_latency_messages, &count, NULL);
+  gst_bin_add (GST_BIN (pipe), GST_ELEMENT (hub));
+  gst_bin_add (GST_BIN (hub), identity);
+
+  kms_base_hub_begin_batch (hub);
+  post_latency (identity);
+  post_latency (identity);
+  post_latency (identity);
+  fail_unless (g_atomic_int_get (&count) == 0);
+  kms_base_hub_end_batch (hub);
+  fail_unless (g_atomic_int_get (&count) == 1);
+
+  /* Only the outermost batch posts the message */
+  kms_base_hub_begin_batch (hub);
+  kms_base_hub_begin_batch (hub);
+  post_latency (identity);
+  kms_base_hub_end_batch (hub);
+  fail_unless (g_atomic_int_get (&count) == 1);
+  post_latency (identity);
+  kms_base_hub_end_batch (hub);
+  fail_unless (g_atomic_int_get (&count) == 2);
+
+  /* No message is posted by batches without latency changes */
+  kms_base_hub_begin_batch (hub);
+  kms_base_hub_end_batch (hub);
+  fail_unless (g_atomic_int_get (&count) == 2);
+
+  post_latency (identity);
+  fail_unless (g_atomic_int_get (&count) == 3);
+
+  gst_bus_set_sync_handler (bus, NULL, NULL, NULL);
+  g_object_unref (bus);
+  g_object_unref (pipe);
+}
+
+GST_END_TEST
+#define BATCH_BUFFERS 10
+#define BATCH_DURATION 200      /* ms */
+typedef struct _BatchTest
+{
+  KmsBaseHub *hub;
+  GMainLoop *loop;
+  gint buffers;
+} BatchTest;
+
+static void
+batch_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    BatchTest * test)
+{
+  g_atomic_int_inc (&test->buffers);
+}
+
+static gboolean
+batch_end (BatchTest * test)
+{
+  fail_unless (g_atomic_int_get (&test->buffers) == 0);
+  kms_base_hub_end_batch (test->hub);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+batch_bus_message (GstBus * bus, GstMessage * message, BatchTest * test)
+{
+  switch (GST_MESSAGE_TYPE (message)) {
+    case GST_MESSAGE_ERROR:
+      fail ("Error received on bus");
+      break;
+    case GST_MESSAGE_EOS:
+      g_main_loop_quit (test->loop);
+      break;
+    default:
+      break;
+  }
+}
+
+GST_START_TEST (batch_block_pad)
+{
+  GstElement *pipe = gst_pipeline_new (NULL);
+  GstElement *src = gst_element_factory_make ("fakesrc", NULL);
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+  GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipe));
+  GstPad *pad;
+  BatchTest test;
+
+  test.hub = g_object_new (KMS_TYPE_BASE_HUB, NULL);
+  test.loop = g_main_loop_new (NULL, FALSE);
+  test.buffers = 0;
+
+  g_object_set (src, "num-buffers", BATCH_BUFFERS, NULL);
+  g_object_set (sink, "async", FALSE, "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (batch_handoff), &test);
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message", G_CALLBACK (batch_bus_message), &test);
+
+  gst_bin_add_many (GST_BIN (pipe), src, sink, NULL);
+  fail_unless (gst_element_link (src, sink));
+
+  kms_base_hub_begin_batch (test.hub);
+  pad = gst_element_get_static_pad (src, "src");
+  kms_base_hub_batch_block_pad (test.hub, pad);
+  g_object_unref (pad);
+
+  gst_element_set_state (pipe, GST_STATE_PLAYING);
+  g_timeout_add (BATCH_DURATION, (GSourceFunc) batch_end, &test);
+
+  g_main_loop_run (test.loop);
+
+  fail_unless (g_atomic_int_get (&test.buffers) == BATCH_BUFFERS);
+
+  gst_element_set_state (pipe, GST_STATE_NULL);
+  gst_bus_remove_signal_watch (bus);
+  g_object_unref (bus);
+  g_object_unref (pipe);
+  g_object_unref (test.hub);
+  g_main_loop_unref (test.loop);
+}
+
+GST_END_TEST
 GST_START_TEST (link_port_after_internal_link)
 {
   GstElement *pipe = gst_pipeline_new (NULL);
@@ -243,6 +389,8 @@ base_hub_suite (void)
   tcase_add_test (tc_chain, handle_port_action);
   tcase_add_test (tc_chain, link_port_before_internal_link);
   tcase_add_test (tc_chain, link_port_after_internal_link);
+  tcase_add_test (tc_chain, batch_latency);
+  tcase_add_test (tc_chain, batch_block_pad);
 
   return s;
 }
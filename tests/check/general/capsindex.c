@@ -0,0 +1,111 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "kmscapsindex.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#define VP8_CAPS "video/x-vp8, width=(int)640, height=(int)480, " \
+  "framerate=(fraction)30/1"
+
+GST_START_TEST (check_fingerprint)
+{
+  GstCaps *a, *b, *c;
+  gchar *fa, *fb, *fc;
+
+  a = gst_caps_from_string (VP8_CAPS);
+  b = gst_caps_from_string (VP8_CAPS ", profile=(string)1");
+  c = gst_caps_from_string ("video/x-vp8, width=(int)320, height=(int)240, "
+      "framerate=(fraction)30/1");
+
+  fa = kms_caps_index_fingerprint (a);
+  fb = kms_caps_index_fingerprint (b);
+  fc = kms_caps_index_fingerprint (c);
+
+  fail_unless (g_strcmp0 (fa, fb) == 0);
+  fail_if (g_strcmp0 (fa, fc) == 0);
+
+  fail_unless (kms_caps_index_fingerprint (GST_CAPS_ANY) == NULL);
+
+  g_free (fa);
+  g_free (fb);
+  g_free (fc);
+  gst_caps_unref (a);
+  gst_caps_unref (b);
+  gst_caps_unref (c);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_lookup)
+{
+  KmsCapsIndex *index = kms_caps_index_new ();
+  GstElement *vp8_bin = gst_bin_new (NULL), *h264_bin = gst_bin_new (NULL);
+  GstCaps *vp8, *vp8_profile, *vp8_small, *h264, *indexed = NULL;
+
+  vp8 = gst_caps_from_string (VP8_CAPS);
+  vp8_profile = gst_caps_from_string (VP8_CAPS ", profile=(string)1");
+  vp8_small = gst_caps_from_string ("video/x-vp8, width=(int)320, "
+      "height=(int)240, framerate=(fraction)30/1");
+  h264 = gst_caps_from_string ("video/x-h264");
+
+  kms_caps_index_add (index, vp8, GST_BIN (vp8_bin));
+  kms_caps_index_add (index, h264, GST_BIN (h264_bin));
+
+  /* Fields out of the fingerprint do not matter */
+  fail_unless (kms_caps_index_lookup (index, vp8_profile,
+          &indexed) == GST_BIN (vp8_bin));
+  fail_unless (gst_caps_is_equal (indexed, vp8));
+
+  fail_unless (kms_caps_index_lookup (index, vp8_small, NULL) == NULL);
+  fail_unless (kms_caps_index_lookup (index, h264,
+          NULL) == GST_BIN (h264_bin));
+
+  /* Removed bins are not found any more, the others are */
+  kms_caps_index_remove (index, GST_BIN (vp8_bin));
+  fail_unless (kms_caps_index_lookup (index, vp8, NULL) == NULL);
+  fail_unless (kms_caps_index_lookup (index, vp8_profile, NULL) == NULL);
+  fail_unless (kms_caps_index_lookup (index, h264,
+          NULL) == GST_BIN (h264_bin));
+
+  kms_caps_index_destroy (index);
+
+  gst_caps_unref (vp8);
+  gst_caps_unref (vp8_profile);
+  gst_caps_unref (vp8_small);
+  gst_caps_unref (h264);
+  g_object_unref (vp8_bin);
+  g_object_unref (h264_bin);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+capsindex_suite (void)
+{
+  Suite *s = suite_create ("capsindex");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_fingerprint);
+  tcase_add_test (tc_chain, check_lookup);
+
+  return s;
+}
+
+GST_CHECK_MAIN (capsindex);
@@ -0,0 +1,300 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "kmsdectreebin.h"
+#include "kmsutils.h"
+#include "kmsaudiolevelmeta.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#define MAX_LATENESS (300 * GST_MSECOND)
+
+static guint decoded;
+
+/* Replaces the decoder, buffers are not real frames */
+static GstFlowReturn
+count_decoded (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  decoded++;
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+/* Pushes a frame that arrives @delay later than the first ones */
+static void
+push_frame (GstPad * src, gboolean keyframe, gboolean droppable,
+    GstClockTime delay)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, 100, NULL);
+
+  GST_BUFFER_PTS (buffer) = kms_utils_get_time_nsecs () - delay;
+  if (!keyframe) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+  if (droppable) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DROPPABLE);
+  }
+
+  gst_pad_push (src, buffer);
+}
+
+static guint64
+get_dropped (KmsDecTreeBin * bin)
+{
+  guint64 dropped;
+
+  g_object_get (bin, "dropped", &dropped, NULL);
+
+  return dropped;
+}
+
+GST_START_TEST (check_late_frames)
+{
+  GstCaps *caps = gst_caps_from_string ("video/x-vp8");
+  GstCaps *raw_caps = gst_caps_from_string ("video/x-raw");
+  GstPad *src, *sink;
+  GstSegment segment;
+  KmsDecTreeBin *bin;
+  GstElement *dec;
+  gint64 max_lateness;
+
+  bin = kms_dec_tree_bin_new (caps, raw_caps);
+  fail_if (bin == NULL);
+
+  /* Dropping is opt-in */
+  g_object_get (bin, "max-lateness", &max_lateness, NULL);
+  fail_unless (max_lateness == -1);
+  g_object_set (bin, "max-lateness", (gint64) MAX_LATENESS, NULL);
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_PLAYING);
+
+  dec = kms_tree_bin_get_input_element (KMS_TREE_BIN (bin));
+  sink = gst_element_get_static_pad (dec, "sink");
+  gst_pad_set_chain_function (sink, count_decoded);
+
+  src = gst_pad_new ("src", GST_PAD_SRC);
+  gst_pad_set_active (src, TRUE);
+  fail_unless (gst_pad_link (src, sink) == GST_PAD_LINK_OK);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (src, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (src, gst_event_new_caps (caps));
+  gst_pad_push_event (src, gst_event_new_segment (&segment));
+
+  /* On time, sets the delay of the stream */
+  push_frame (src, TRUE, FALSE, 0);
+  fail_unless (decoded == 1);
+
+  /* Past half the budget only non-reference frames are dropped */
+  push_frame (src, FALSE, TRUE, 200 * GST_MSECOND);
+  fail_unless (decoded == 1);
+  fail_unless (get_dropped (bin) == 1);
+  push_frame (src, FALSE, FALSE, 200 * GST_MSECOND);
+  fail_unless (decoded == 2);
+
+  /* Past the budget every frame is dropped until the next keyframe, even
+   * if on time again */
+  push_frame (src, FALSE, FALSE, 400 * GST_MSECOND);
+  push_frame (src, FALSE, FALSE, 0);
+  fail_unless (decoded == 2);
+  fail_unless (get_dropped (bin) == 3);
+  push_frame (src, TRUE, FALSE, 0);
+  fail_unless (decoded == 3);
+
+  /* Nothing is dropped once disabled */
+  g_object_set (bin, "max-lateness", (gint64) - 1, NULL);
+  push_frame (src, FALSE, TRUE, GST_SECOND);
+  push_frame (src, FALSE, FALSE, GST_SECOND);
+  fail_unless (decoded == 5);
+  fail_unless (get_dropped (bin) == 3);
+
+  gst_pad_unlink (src, sink);
+  g_object_unref (src);
+  g_object_unref (sink);
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_NULL);
+  g_object_unref (bin);
+  gst_caps_unref (caps);
+  gst_caps_unref (raw_caps);
+}
+
+GST_END_TEST;
+
+static void
+push_audio (GstPad * src, guint8 level)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, 100, NULL);
+
+  GST_BUFFER_PTS (buffer) = kms_utils_get_time_nsecs ();
+  kms_buffer_add_audio_level_meta (buffer, level, TRUE);
+
+  gst_pad_push (src, buffer);
+}
+
+GST_START_TEST (check_audio_level_gate)
+{
+  GstCaps *caps = gst_caps_from_string ("audio/x-opus");
+  GstCaps *raw_caps = gst_caps_from_string ("audio/x-raw");
+  GstPad *src, *sink, *tee_src;
+  GstElement *dec, *tee;
+  GstSegment segment;
+  KmsDecTreeBin *bin;
+  GstBuffer *buffer;
+
+  bin = kms_dec_tree_bin_new (caps, raw_caps);
+  fail_if (bin == NULL);
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_PLAYING);
+
+  dec = kms_tree_bin_get_input_element (KMS_TREE_BIN (bin));
+  sink = gst_element_get_static_pad (dec, "sink");
+  gst_pad_set_chain_function (sink, count_decoded);
+
+  tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
+  tee_src = gst_element_get_request_pad (tee, "src_%u");
+
+  src = gst_pad_new ("src", GST_PAD_SRC);
+  gst_pad_set_active (src, TRUE);
+  fail_unless (gst_pad_link (src, sink) == GST_PAD_LINK_OK);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (src, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (src, gst_event_new_caps (caps));
+  gst_pad_push_event (src, gst_event_new_segment (&segment));
+
+  decoded = 0;
+
+  /* Everything is decoded until a mixer asks for a gate */
+  push_audio (src, 60);
+  fail_unless (decoded == 1);
+
+  gst_pad_send_event (tee_src, kms_audio_level_gate_event_new (30));
+  push_audio (src, 60);
+  push_audio (src, 31);
+  fail_unless (decoded == 1);
+  push_audio (src, 30);
+  push_audio (src, 10);
+  fail_unless (decoded == 3);
+
+  /* Audio without level can not be judged */
+  buffer = gst_buffer_new_allocate (NULL, 100, NULL);
+  GST_BUFFER_PTS (buffer) = kms_utils_get_time_nsecs ();
+  gst_pad_push (src, buffer);
+  fail_unless (decoded == 4);
+
+  gst_pad_send_event (tee_src,
+      kms_audio_level_gate_event_new (KMS_AUDIO_LEVEL_SILENCE));
+  push_audio (src, KMS_AUDIO_LEVEL_SILENCE);
+  fail_unless (decoded == 5);
+
+  gst_element_release_request_pad (tee, tee_src);
+  g_object_unref (tee_src);
+  gst_pad_unlink (src, sink);
+  g_object_unref (src);
+  g_object_unref (sink);
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_NULL);
+  g_object_unref (bin);
+  gst_caps_unref (caps);
+  gst_caps_unref (raw_caps);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_audio_level_gate_consumers)
+{
+  GstCaps *caps = gst_caps_from_string ("audio/x-opus");
+  GstCaps *raw_caps = gst_caps_from_string ("audio/x-raw");
+  GstPad *src, *sink, *mixer_src, *other_src;
+  GstElement *dec, *tee;
+  GstSegment segment;
+  KmsDecTreeBin *bin;
+
+  bin = kms_dec_tree_bin_new (caps, raw_caps);
+  fail_if (bin == NULL);
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_PLAYING);
+
+  dec = kms_tree_bin_get_input_element (KMS_TREE_BIN (bin));
+  sink = gst_element_get_static_pad (dec, "sink");
+  gst_pad_set_chain_function (sink, count_decoded);
+
+  tee = kms_tree_bin_get_output_tee (KMS_TREE_BIN (bin));
+  mixer_src = gst_element_get_request_pad (tee, "src_%u");
+  other_src = gst_element_get_request_pad (tee, "src_%u");
+
+  src = gst_pad_new ("src", GST_PAD_SRC);
+  gst_pad_set_active (src, TRUE);
+  fail_unless (gst_pad_link (src, sink) == GST_PAD_LINK_OK);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (src, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (src, gst_event_new_caps (caps));
+  gst_pad_push_event (src, gst_event_new_segment (&segment));
+
+  decoded = 0;
+
+  /* Other consumers, like recorders, still want all the audio */
+  gst_pad_send_event (mixer_src, kms_audio_level_gate_event_new (30));
+  push_audio (src, 60);
+  fail_unless (decoded == 1);
+
+  /* The loosest gate is applied */
+  gst_pad_send_event (other_src, kms_audio_level_gate_event_new (50));
+  push_audio (src, 40);
+  push_audio (src, 60);
+  fail_unless (decoded == 2);
+
+  gst_pad_send_event (mixer_src, kms_audio_level_gate_event_new (20));
+  push_audio (src, 40);
+  fail_unless (decoded == 3);
+
+  /* Released consumers no longer count */
+  gst_element_release_request_pad (tee, other_src);
+  g_object_unref (other_src);
+  push_audio (src, 40);
+  push_audio (src, 20);
+  fail_unless (decoded == 4);
+
+  gst_element_release_request_pad (tee, mixer_src);
+  g_object_unref (mixer_src);
+  push_audio (src, 60);
+  fail_unless (decoded == 5);
+
+  gst_pad_unlink (src, sink);
+  g_object_unref (src);
+  g_object_unref (sink);
+  gst_element_set_state (GST_ELEMENT (bin), GST_STATE_NULL);
+  g_object_unref (bin);
+  gst_caps_unref (caps);
+  gst_caps_unref (raw_caps);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+dectreebin_suite (void)
+{
+  Suite *s = suite_create ("dectreebin");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_late_frames);
+  tcase_add_test (tc_chain, check_audio_level_gate);
+  tcase_add_test (tc_chain, check_audio_level_gate_consumers);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dectreebin);
@@ -0,0 +1,158 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsencoderpolicy.h"
+#include "kmsenctreebin.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+static void
+store_settings (const KmsEncoderSettings * settings, gpointer user_data)
+{
+  KmsEncoderSettings *stored = user_data;
+
+  *stored = *settings;
+}
+
+GST_START_TEST (check_threads)
+{
+  /* Small resolutions never get more than one thread */
+  fail_unless (kms_encoder_policy_threads_for (0, 32) == 1);
+  fail_unless (kms_encoder_policy_threads_for (320 * 240 * 30, 32) == 1);
+
+  /* 1080p gets several, limited by the cores */
+  fail_unless (kms_encoder_policy_threads_for (1920 * 1080 * 30, 32) > 4);
+  fail_unless (kms_encoder_policy_threads_for (1920 * 1080 * 30, 2) == 2);
+  fail_unless (kms_encoder_policy_threads_for (G_MAXUINT32, 32) <= 8);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_levels)
+{
+  fail_unless (kms_encoder_policy_level_for (0, 1) == KMS_ENCODER_LOAD_NORMAL);
+  fail_unless (kms_encoder_policy_level_for (640 * 480 * 30, 4) ==
+      KMS_ENCODER_LOAD_NORMAL);
+  fail_unless (kms_encoder_policy_level_for (1280 * 720 * 30, 1) ==
+      KMS_ENCODER_LOAD_SATURATED);
+  fail_unless (kms_encoder_policy_level_for (1920 * 1080 * 30, 1) ==
+      KMS_ENCODER_LOAD_OVERLOADED);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_budget)
+{
+  KmsEncoderSettings a_settings, b_settings;
+  KmsEncoderClient *a, *b;
+
+  kms_encoder_policy_set_cores (1);
+
+  a = kms_encoder_policy_register (store_settings, &a_settings);
+  b = kms_encoder_policy_register (store_settings, &b_settings);
+
+  kms_encoder_policy_set_format (a, 640, 480, 30, 1);
+  kms_encoder_policy_get_settings (a, &a_settings);
+  fail_unless (a_settings.level == KMS_ENCODER_LOAD_NORMAL);
+  fail_unless (a_settings.max_framerate == 0);
+
+  /* Both encoders are notified when the budget is exceeded */
+  kms_encoder_policy_set_format (b, 1280, 720, 30, 1);
+  fail_unless (a_settings.level == KMS_ENCODER_LOAD_OVERLOADED);
+  fail_unless (b_settings.level == KMS_ENCODER_LOAD_OVERLOADED);
+  fail_unless (a_settings.max_framerate > 0);
+
+  /* And when there is room again */
+  kms_encoder_policy_unregister (b);
+  fail_unless (a_settings.level == KMS_ENCODER_LOAD_NORMAL);
+  fail_unless (a_settings.max_framerate == 0);
+
+  kms_encoder_policy_unregister (a);
+  kms_encoder_policy_set_cores (0);
+}
+
+GST_END_TEST;
+
+static GstElement *
+find_vp8enc (KmsEncTreeBin * bin)
+{
+  GstIterator *it = gst_bin_iterate_recurse (GST_BIN (bin));
+  GValue item = G_VALUE_INIT;
+  GstElement *enc = NULL;
+
+  while (enc == NULL && gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElement *e = g_value_get_object (&item);
+
+    if (g_str_has_prefix (GST_OBJECT_NAME (e), "vp8enc")) {
+      enc = gst_object_ref (e);
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return enc;
+}
+
+GST_START_TEST (check_encoder_created_for_caps)
+{
+  KmsEncTreeBin *bin;
+  GstElement *enc;
+  GstCaps *caps;
+  guint threads;
+
+  kms_encoder_policy_set_cores (4);
+
+  /* The threads come from the target resolution before any buffer */
+  caps = gst_caps_from_string ("video/x-vp8, width=(int)1920, "
+      "height=(int)1080, framerate=(fraction)30/1");
+  bin = gst_object_ref_sink (kms_enc_tree_bin_new (caps, 300000, 0, G_MAXINT,
+          NULL));
+  gst_caps_unref (caps);
+
+  enc = find_vp8enc (bin);
+  fail_if (enc == NULL);
+  g_object_get (enc, "threads", &threads, NULL);
+  fail_unless (threads == kms_encoder_policy_threads_for (1920 * 1080 * 30,
+          4), "%u threads", threads);
+  fail_unless (threads > 1);
+
+  g_object_unref (enc);
+  g_object_unref (bin);
+  kms_encoder_policy_set_cores (0);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+encoderpolicy_suite (void)
+{
+  Suite *s = suite_create ("encoderpolicy");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_threads);
+  tcase_add_test (tc_chain, check_levels);
+  tcase_add_test (tc_chain, check_budget);
+  tcase_add_test (tc_chain, check_encoder_created_for_caps);
+
+  return s;
+}
+
+GST_CHECK_MAIN (encoderpolicy);
@@ -0,0 +1,185 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include "kmsencoderpool.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#define VP8_CAPS "video/x-vp8"
+#define MAX_IDLE_BINS 8
+#define RELEASED_BINS 16
+
+static void enable_pool (void) __attribute__ ((constructor));
+
+static void
+enable_pool (void)
+{
+  g_setenv ("KURENTO_WARM_ENCODERS", VP8_CAPS, TRUE);
+}
+
+static KmsEncTreeBin *
+acquire_vp8 (GstStructure * codec_configs)
+{
+  GstCaps *caps = gst_caps_from_string (VP8_CAPS);
+  KmsEncTreeBin *bin;
+
+  bin = kms_encoder_pool_acquire (caps, 300000, 0, G_MAXINT, codec_configs);
+  gst_caps_unref (caps);
+  fail_if (bin == NULL);
+
+  return gst_object_ref_sink (bin);
+}
+
+GST_START_TEST (check_release_and_reuse)
+{
+  GstStructure *config;
+  KmsEncTreeBin *bin, *other;
+  GstElement *parent;
+
+  fail_unless (kms_encoder_pool_is_enabled ());
+
+  bin = acquire_vp8 (NULL);
+  fail_unless (kms_encoder_pool_release (bin));
+  fail_unless (kms_encoder_pool_get_idle_count () == 1);
+
+  /* Configured differently */
+  config = gst_structure_new_from_string ("codec-config, "
+      "vp8=(structure)\"vp8, cpu-used=(int)4\"");
+  other = acquire_vp8 (config);
+  fail_if (other == bin);
+  fail_unless (kms_encoder_pool_get_idle_count () == 1);
+  g_object_unref (other);
+  gst_structure_free (config);
+
+  other = acquire_vp8 (NULL);
+  fail_unless (other == bin);
+  fail_unless (kms_encoder_pool_get_idle_count () == 0);
+  g_object_unref (other);
+
+  /* Bins still in a pipeline are not taken */
+  parent = gst_bin_new (NULL);
+  gst_bin_add (GST_BIN (parent), GST_ELEMENT (bin));
+  fail_if (kms_encoder_pool_release (bin));
+  fail_unless (kms_encoder_pool_get_idle_count () == 0);
+
+  g_object_unref (bin);
+  g_object_unref (parent);
+}
+
+GST_END_TEST;
+
+static gpointer
+release_bin (gpointer bin)
+{
+  return GINT_TO_POINTER (kms_encoder_pool_release (bin));
+}
+
+GST_START_TEST (check_idle_limit)
+{
+  KmsEncTreeBin *bins[RELEASED_BINS];
+  GThread *threads[RELEASED_BINS];
+  guint i, taken = 0;
+
+  for (i = 0; i < RELEASED_BINS; i++) {
+    bins[i] = acquire_vp8 (NULL);
+  }
+
+  for (i = 0; i < RELEASED_BINS; i++) {
+    threads[i] = g_thread_new (NULL, release_bin, bins[i]);
+  }
+
+  for (i = 0; i < RELEASED_BINS; i++) {
+    if (GPOINTER_TO_INT (g_thread_join (threads[i]))) {
+      taken++;
+    }
+    g_object_unref (bins[i]);
+  }
+
+  fail_unless (taken == MAX_IDLE_BINS, "%u bins taken", taken);
+  fail_unless (kms_encoder_pool_get_idle_count () == MAX_IDLE_BINS);
+}
+
+GST_END_TEST;
+
+static GstElement *
+find_encoder (KmsEncTreeBin * bin, const gchar * factory)
+{
+  GstIterator *it = gst_bin_iterate_recurse (GST_BIN (bin));
+  GValue item = G_VALUE_INIT;
+  GstElement *enc = NULL;
+
+  while (enc == NULL && gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElement *e = g_value_get_object (&item);
+    GstElementFactory *f = gst_element_get_factory (e);
+
+    if (f != NULL && g_strcmp0 (GST_OBJECT_NAME (f), factory) == 0) {
+      enc = gst_object_ref (e);
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return enc;
+}
+
+GST_START_TEST (check_warm_bin_config)
+{
+  GstStructure *config;
+  KmsEncTreeBin *bin;
+  GstElement *enc;
+  gint cpu_used, i;
+
+  kms_encoder_pool_warm_up ();
+
+  for (i = 0; i < 50 && kms_encoder_pool_get_idle_count () == 0; i++) {
+    g_usleep (100000);
+  }
+  fail_unless (kms_encoder_pool_get_idle_count () == 1);
+
+  config = gst_structure_new_from_string ("codec-config, "
+      "vp8=(structure)\"vp8, cpu-used=(int)4\"");
+  bin = acquire_vp8 (config);
+  gst_structure_free (config);
+
+  enc = find_encoder (bin, "vp8enc");
+  fail_if (enc == NULL);
+  g_object_get (enc, "cpu-used", &cpu_used, NULL);
+  fail_unless (cpu_used == 4, "cpu-used is %d", cpu_used);
+
+  g_object_unref (enc);
+  g_object_unref (bin);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+encoderpool_suite (void)
+{
+  Suite *s = suite_create ("encoderpool");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_release_and_reuse);
+  tcase_add_test (tc_chain, check_idle_limit);
+  tcase_add_test (tc_chain, check_warm_bin_config);
+
+  return s;
+}
+
+GST_CHECK_MAIN (encoderpool);
@@ -0,0 +1,210 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsexecutor.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+#include <stdlib.h>
+
+#define QUEUES 4
+#define ITEMS 100
+
+static GMutex mutex;
+static GCond cond;
+static guint done;
+static guint last[QUEUES];
+
+static void
+run_item (gpointer data)
+{
+  guint value = GPOINTER_TO_UINT (data);
+  guint queue = value / ITEMS;
+
+  /* Items of a queue never run in parallel, nor out of order */
+  fail_unless (g_atomic_int_get (&last[queue]) == value % ITEMS);
+  g_usleep (g_random_int_range (0, 100));
+  g_atomic_int_inc (&last[queue]);
+}
+
+static void
+item_done (gpointer data)
+{
+  g_mutex_lock (&mutex);
+  done++;
+  g_cond_signal (&cond);
+  g_mutex_unlock (&mutex);
+}
+
+GST_START_TEST (check_order)
+{
+  KmsExecutorQueue *queues[QUEUES];
+  guint i, j;
+
+  for (i = 0; i < QUEUES; i++) {
+    queues[i] = kms_executor_queue_new ();
+  }
+
+  for (j = 0; j < ITEMS; j++) {
+    for (i = 0; i < QUEUES; i++) {
+      kms_executor_queue_push (queues[i], run_item,
+          GUINT_TO_POINTER (i * ITEMS + j), item_done);
+    }
+  }
+
+  /* Pending work still runs */
+  for (i = 0; i < QUEUES; i++) {
+    kms_executor_queue_free (queues[i]);
+  }
+
+  g_mutex_lock (&mutex);
+  while (done < QUEUES * ITEMS) {
+    g_cond_wait (&cond, &mutex);
+  }
+  g_mutex_unlock (&mutex);
+
+  for (i = 0; i < QUEUES; i++) {
+    fail_unless (last[i] == ITEMS);
+  }
+}
+
+GST_END_TEST;
+
+static gboolean gate_open;
+static guint blocked_done;
+
+static void
+wait_gate (gpointer data)
+{
+  gint64 end_time = g_get_monotonic_time () + 10 * G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&mutex);
+  while (!gate_open) {
+    if (!g_cond_wait_until (&cond, &mutex, end_time)) {
+      break;
+    }
+  }
+  blocked_done++;
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&mutex);
+}
+
+static void
+open_gate (gpointer data)
+{
+  g_mutex_lock (&mutex);
+  gate_open = TRUE;
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&mutex);
+}
+
+GST_START_TEST (check_blocked_workers)
+{
+  const gchar *env = g_getenv ("KURENTO_EXECUTOR_THREADS");
+  KmsExecutorQueue *queue;
+  guint workers, i;
+
+  workers = MAX (g_get_num_processors (), 2);
+  if (env != NULL && atoi (env) > 0) {
+    workers = atoi (env);
+  }
+
+  /* Every worker waits for work of another queue */
+  for (i = 0; i < workers; i++) {
+    queue = kms_executor_queue_new ();
+    kms_executor_queue_push (queue, wait_gate, NULL, NULL);
+    kms_executor_queue_free (queue);
+  }
+
+  queue = kms_executor_queue_new ();
+  kms_executor_queue_push (queue, open_gate, NULL, NULL);
+  kms_executor_queue_free (queue);
+
+  g_mutex_lock (&mutex);
+  while (blocked_done < workers) {
+    g_cond_wait (&cond, &mutex);
+  }
+  fail_unless (gate_open, "Blocked workers starved the other queues");
+  g_mutex_unlock (&mutex);
+}
+
+GST_END_TEST;
+
+static void
+run_flag (gpointer data)
+{
+  g_atomic_int_set ((gint *) data, TRUE);
+}
+
+static void
+notify_flag (gpointer data)
+{
+  g_mutex_lock (&mutex);
+  g_atomic_int_inc ((gint *) data + 1);
+  g_cond_signal (&cond);
+  g_mutex_unlock (&mutex);
+}
+
+GST_START_TEST (check_try_push)
+{
+  KmsExecutorQueue *queue = kms_executor_queue_new ();
+  GMutex lock;
+  gint flags[2] = { FALSE, 0 };
+
+  g_mutex_init (&lock);
+
+  fail_unless (kms_executor_queue_try_push (&lock, &queue, run_flag, flags,
+          notify_flag));
+
+  g_mutex_lock (&mutex);
+  while (g_atomic_int_get (&flags[1]) < 1) {
+    g_cond_wait (&cond, &mutex);
+  }
+  g_mutex_unlock (&mutex);
+  fail_unless (g_atomic_int_get (&flags[0]));
+
+  /* Once the owner clears the queue only @notify is called */
+  kms_executor_queue_free (queue);
+  queue = NULL;
+  flags[0] = FALSE;
+
+  fail_if (kms_executor_queue_try_push (&lock, &queue, run_flag, flags,
+          notify_flag));
+  fail_if (g_atomic_int_get (&flags[0]));
+  fail_unless (g_atomic_int_get (&flags[1]) == 2);
+
+  g_mutex_clear (&lock);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+executor_suite (void)
+{
+  Suite *s = suite_create ("executor");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_order);
+  tcase_add_test (tc_chain, check_blocked_workers);
+  tcase_add_test (tc_chain, check_try_push);
+
+  return s;
+}
+
+GST_CHECK_MAIN (executor);
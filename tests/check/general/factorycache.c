@@ -0,0 +1,99 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsfactorycache.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+GST_START_TEST (check_cached_factory)
+{
+  GstCaps *caps = gst_caps_from_string ("video/x-vp8");
+  GstElementFactory *factory, *cached;
+  GstElement *enc;
+
+  factory =
+      kms_factory_cache_get (GST_ELEMENT_FACTORY_TYPE_ENCODER, NULL, caps);
+  fail_unless (factory != NULL);
+  fail_unless (g_strcmp0 (GST_OBJECT_NAME (factory), "vp8enc") == 0);
+
+  cached = kms_factory_cache_get (GST_ELEMENT_FACTORY_TYPE_ENCODER, NULL, caps);
+  fail_unless (cached == factory);
+
+  enc = kms_factory_cache_create (GST_ELEMENT_FACTORY_TYPE_ENCODER, NULL, caps);
+  fail_unless (enc != NULL);
+  fail_unless (gst_element_get_factory (enc) == factory);
+
+  g_object_unref (enc);
+  gst_object_unref (cached);
+  gst_object_unref (factory);
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_missing_factory)
+{
+  GstCaps *caps = gst_caps_from_string ("video/x-kms-unknown");
+
+  /* Also cached */
+  fail_unless (kms_factory_cache_get (GST_ELEMENT_FACTORY_TYPE_ENCODER, NULL,
+          caps) == NULL);
+  fail_unless (kms_factory_cache_get (GST_ELEMENT_FACTORY_TYPE_ENCODER, NULL,
+          caps) == NULL);
+
+  gst_caps_unref (caps);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_preferred_factory)
+{
+  const gchar *prefixes[] = { "vp8", NULL };
+  GstElementFactory *factory;
+
+  factory = gst_element_factory_find ("vp8enc");
+  fail_unless (factory != NULL);
+  fail_if (kms_factory_cache_is_preferred (factory));
+
+  kms_factory_cache_set_preferred (prefixes);
+  fail_unless (kms_factory_cache_is_preferred (factory));
+
+  kms_factory_cache_set_preferred (NULL);
+  fail_if (kms_factory_cache_is_preferred (factory));
+
+  gst_object_unref (factory);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+factorycache_suite (void)
+{
+  Suite *s = suite_create ("factorycache");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_cached_factory);
+  tcase_add_test (tc_chain, check_missing_factory);
+  tcase_add_test (tc_chain, check_preferred_factory);
+
+  return s;
+}
+
+GST_CHECK_MAIN (factorycache);
@@ -0,0 +1,155 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsgopcache.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#define FRAME_SIZE 1000         /* bytes */
+
+static GList *received;
+
+static GstFlowReturn
+chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  received = g_list_append (received, buffer);
+
+  return GST_FLOW_OK;
+}
+
+static void
+push_frame (GstPad * src, gboolean keyframe)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, FRAME_SIZE, NULL);
+
+  if (!keyframe) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  }
+
+  fail_unless (gst_pad_push (src, buffer) == GST_FLOW_OK);
+}
+
+static GstPad *
+link_output (GstElement * tee, GstPad ** tee_src)
+{
+  GstPad *sink = gst_pad_new ("sink", GST_PAD_SINK);
+
+  gst_pad_set_chain_function (sink, chain);
+  gst_pad_set_active (sink, TRUE);
+
+  *tee_src = gst_element_get_request_pad (tee, "src_%u");
+  fail_unless (gst_pad_link (*tee_src, sink) == GST_PAD_LINK_OK);
+
+  return sink;
+}
+
+static void
+unlink_output (GstElement * tee, GstPad * tee_src, GstPad * sink)
+{
+  gst_pad_unlink (tee_src, sink);
+  gst_element_release_request_pad (tee, tee_src);
+  g_object_unref (tee_src);
+  gst_pad_set_active (sink, FALSE);
+  g_object_unref (sink);
+
+  g_list_free_full (received, (GDestroyNotify) gst_buffer_unref);
+  received = NULL;
+}
+
+GST_START_TEST (check_prime)
+{
+  GstElement *tee = gst_element_factory_make ("tee", NULL);
+  GstPad *src, *tee_sink, *tee_src, *sink;
+  GstCaps *caps = gst_caps_from_string ("video/x-vp8");
+  GstSegment segment;
+  GstBuffer *buffer;
+  guint i;
+
+  g_object_set (tee, "allow-not-linked", TRUE, NULL);
+  kms_gop_cache_enable (tee, 4 * FRAME_SIZE);
+  gst_element_set_state (tee, GST_STATE_PLAYING);
+
+  src = gst_pad_new ("src", GST_PAD_SRC);
+  gst_pad_set_active (src, TRUE);
+  tee_sink = gst_element_get_static_pad (tee, "sink");
+  fail_unless (gst_pad_link (src, tee_sink) == GST_PAD_LINK_OK);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (src, gst_event_new_stream_start ("test"));
+  gst_pad_push_event (src, gst_event_new_caps (caps));
+  gst_pad_push_event (src, gst_event_new_segment (&segment));
+
+  /* Nothing cached before the first keyframe */
+  push_frame (src, FALSE);
+  sink = link_output (tee, &tee_src);
+  fail_if (kms_gop_cache_prime (tee, tee_src));
+  unlink_output (tee, tee_src, sink);
+
+  push_frame (src, TRUE);
+  push_frame (src, FALSE);
+  push_frame (src, FALSE);
+
+  sink = link_output (tee, &tee_src);
+  fail_unless (kms_gop_cache_prime (tee, tee_src));
+  push_frame (src, FALSE);
+
+  /* The cached GOP goes before the first live buffer */
+  fail_unless (g_list_length (received) == 4);
+  for (i = 0; i < 3; i++) {
+    buffer = g_list_nth_data (received, i);
+    fail_unless (GST_BUFFER_FLAG_IS_SET (buffer,
+            GST_BUFFER_FLAG_DECODE_ONLY));
+    fail_unless (GST_BUFFER_FLAG_IS_SET (buffer,
+            GST_BUFFER_FLAG_DELTA_UNIT) == (i != 0));
+  }
+  buffer = g_list_nth_data (received, 3);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY));
+
+  /* Only the first buffer is primed, then the GOP does not fit anymore */
+  push_frame (src, FALSE);
+  fail_unless (g_list_length (received) == 5);
+  unlink_output (tee, tee_src, sink);
+
+  sink = link_output (tee, &tee_src);
+  fail_if (kms_gop_cache_prime (tee, tee_src));
+  unlink_output (tee, tee_src, sink);
+
+  gst_pad_unlink (src, tee_sink);
+  g_object_unref (tee_sink);
+  g_object_unref (src);
+  gst_caps_unref (caps);
+  gst_element_set_state (tee, GST_STATE_NULL);
+  g_object_unref (tee);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+gopcache_suite (void)
+{
+  Suite *s = suite_create ("gopcache");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_prime);
+
+  return s;
+}
+
+GST_CHECK_MAIN (gopcache);
@@ -0,0 +1,135 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmsmixkernels.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+/* Not a multiple of any vector size, to run the scalar tails too */
+#define SAMPLES 1027
+#define INPUTS 3
+
+GST_START_TEST (check_s16)
+{
+  gint16 in[INPUTS][SAMPLES], out[SAMPLES];
+  gint32 mix[SAMPLES];
+  guint i, j;
+
+  GST_INFO ("Using %s kernels", kms_mix_kernels_get_name ());
+
+  for (i = 0; i < SAMPLES; i++) {
+    in[0][i] = g_random_int_range (G_MININT16, G_MAXINT16 + 1);
+    in[1][i] = g_random_int_range (G_MININT16, G_MAXINT16 + 1);
+    in[2][i] = (i % 2) ? G_MAXINT16 : G_MININT16;
+    mix[i] = 0;
+  }
+
+  for (j = 0; j < INPUTS; j++) {
+    kms_mix_kernels_accumulate_s16 (mix, in[j], SAMPLES);
+  }
+
+  for (j = 0; j < INPUTS; j++) {
+    kms_mix_kernels_subtract_s16 (out, mix, in[j], SAMPLES);
+
+    for (i = 0; i < SAMPLES; i++) {
+      gint32 expected = mix[i] - in[j][i];
+
+      fail_unless (out[i] == CLAMP (expected, G_MININT16, G_MAXINT16));
+    }
+  }
+
+  /* Without input, outputs get the whole mix */
+  kms_mix_kernels_subtract_s16 (out, mix, NULL, SAMPLES);
+  for (i = 0; i < SAMPLES; i++) {
+    fail_unless (out[i] == CLAMP (mix[i], G_MININT16, G_MAXINT16));
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_f32)
+{
+  gfloat in[INPUTS][SAMPLES], out[SAMPLES], mix[SAMPLES];
+  guint i, j;
+
+  for (i = 0; i < SAMPLES; i++) {
+    for (j = 0; j < INPUTS; j++) {
+      in[j][i] = g_random_double_range (-1.0, 1.0);
+    }
+    mix[i] = 0.0;
+  }
+
+  for (j = 0; j < INPUTS; j++) {
+    kms_mix_kernels_accumulate_f32 (mix, in[j], SAMPLES);
+  }
+
+  for (j = 0; j < INPUTS; j++) {
+    kms_mix_kernels_subtract_f32 (out, mix, in[j], SAMPLES);
+
+    for (i = 0; i < SAMPLES; i++) {
+      gfloat expected = CLAMP (mix[i] - in[j][i], -1.0, 1.0);
+
+      fail_unless (ABS (out[i] - expected) < 1e-6);
+    }
+  }
+
+  kms_mix_kernels_subtract_f32 (out, mix, NULL, SAMPLES);
+  for (i = 0; i < SAMPLES; i++) {
+    fail_unless (ABS (out[i] - CLAMP (mix[i], -1.0, 1.0)) < 1e-6);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_power)
+{
+  gint16 s16[SAMPLES];
+  gfloat f32[SAMPLES];
+  guint i;
+
+  for (i = 0; i < SAMPLES; i++) {
+    s16[i] = (i % 2) ? G_MAXINT16 : G_MININT16;
+    f32[i] = (i % 2) ? 0.5 : -0.5;
+  }
+
+  fail_unless (kms_mix_kernels_power_s16 (s16, SAMPLES) > 0.99);
+  fail_unless (ABS (kms_mix_kernels_power_f32 (f32, SAMPLES) - 0.25) < 1e-6);
+
+  memset (s16, 0, sizeof (s16));
+  fail_unless (kms_mix_kernels_power_s16 (s16, SAMPLES) == 0.0);
+  fail_unless (kms_mix_kernels_power_s16 (s16, 0) == 0.0);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+mixkernels_suite (void)
+{
+  Suite *s = suite_create ("mixkernels");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_s16);
+  tcase_add_test (tc_chain, check_f32);
+  tcase_add_test (tc_chain, check_power);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mixkernels);
@@ -130,6 +130,83 @@ GST_START_TEST (check_take_into_account_after_clear_time)
 
 GST_END_TEST;
 
+GST_START_TEST (check_notify_threshold)
+{
+  GstPad *pad;
+  RembEventManager *manager;
+  guint min_br = 0;
+
+  pad = gst_pad_new (NULL, GST_PAD_SRC);
+  gst_pad_set_active (pad, TRUE);
+  manager = kms_utils_remb_event_manager_create (pad);
+  kms_utils_remb_event_manager_set_callback (manager, bitrate_cb, &min_br,
+      NULL);
+  kms_utils_remb_event_manager_set_notify_threshold (manager, 0.1);
+  fail_unless (kms_utils_remb_event_manager_get_notify_threshold (manager) ==
+      0.1f);
+
+  gst_pad_send_event (pad, kms_utils_remb_event_upstream_new (1000, 1));
+  fail_unless (min_br == 1000);
+
+  /* Under the threshold: not notified but taken into account */
+  gst_pad_send_event (pad, kms_utils_remb_event_upstream_new (950, 1));
+  fail_unless (min_br == 1000);
+  fail_unless (kms_utils_remb_event_manager_get_min (manager) == 950);
+
+  gst_pad_send_event (pad, kms_utils_remb_event_upstream_new (850, 2));
+  fail_unless (min_br == 850);
+
+  gst_pad_send_event (pad, kms_utils_remb_event_upstream_new (2000, 2));
+  fail_unless (min_br == 950);
+
+  kms_utils_remb_event_manager_destroy (manager);
+  g_object_unref (pad);
+}
+
+GST_END_TEST;
+
+/* Checks the minimum against a full scan with many SSRCs */
+GST_START_TEST (check_many_ssrcs)
+{
+  GstPad *pad;
+  RembEventManager *manager;
+  guint bitrates[200];
+  GRand *rand;
+  guint i, j;
+
+  pad = gst_pad_new (NULL, GST_PAD_SRC);
+  gst_pad_set_active (pad, TRUE);
+  manager = kms_utils_remb_event_manager_create (pad);
+  rand = g_rand_new_with_seed (42);
+
+  for (i = 0; i < G_N_ELEMENTS (bitrates); i++) {
+    bitrates[i] = g_rand_int_range (rand, 100000, 2000000);
+    gst_pad_send_event (pad, kms_utils_remb_event_upstream_new (bitrates[i],
+            i));
+  }
+
+  for (i = 0; i < 2000; i++) {
+    guint ssrc = g_rand_int_range (rand, 0, G_N_ELEMENTS (bitrates));
+    guint min = G_MAXUINT;
+
+    bitrates[ssrc] = g_rand_int_range (rand, 100000, 2000000);
+    gst_pad_send_event (pad, kms_utils_remb_event_upstream_new (bitrates[ssrc],
+            ssrc));
+
+    for (j = 0; j < G_N_ELEMENTS (bitrates); j++) {
+      min = MIN (min, bitrates[j]);
+    }
+
+    fail_unless (kms_utils_remb_event_manager_get_min (manager) == min);
+  }
+
+  g_rand_free (rand);
+  kms_utils_remb_event_manager_destroy (manager);
+  g_object_unref (pad);
+}
+
+GST_END_TEST;
+
 /* Suite initialization */
 static Suite *
 rembmanager_suite (void)
@@ -140,6 +217,8 @@ rembmanager_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, check_min_br_update);
   tcase_add_test (tc_chain, check_take_into_account_after_clear_time);
+  tcase_add_test (tc_chain, check_notify_threshold);
+  tcase_add_test (tc_chain, check_many_ssrcs);
 
   return s;
 }
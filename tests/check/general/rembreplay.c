@@ -0,0 +1,451 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+/*
+ * Offline replay of the receiver side bandwidth estimation. A deterministic
+ * packet level model of a bottleneck link (or a recorded trace of receiver
+ * statistics) is fed into KmsRembLocal and RembEventManager at simulated
+ * time, without network nor rtpbin, and the resulting REMB trajectory is
+ * reported together with convergence time, overshoot and CPU cost.
+ *
+ * A recorded trace can be replayed setting REMB_REPLAY_TRACE to a CSV file
+ * with lines "time_ms,bitrate,bytes,packets,fraction_lost".
+ */
+
+#include "kmsremb.h"
+#include "kmsutils.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define REPLAY_TRACE_ENV "REMB_REPLAY_TRACE"
+
+#define PACKET_SIZE 1200        /* bytes */
+#define RTCP_INTERVAL 500       /* ms */
+#define DURATION 40000          /* ms */
+#define START_BITRATE 300000    /* bps */
+#define PROPAGATION_DELAY (30 * GST_MSECOND)
+#define MAX_QUEUE_DELAY (300 * GST_MSECOND)
+#define CONVERGENCE_TOLERANCE 0.2
+#define DOWNSTREAM_SSRC 1234
+#define RANDOM_SEED 0x4b4d53
+
+#define MAX_UPDATES (DURATION / RTCP_INTERVAL)
+
+typedef struct _ReplayScenario
+{
+  const gchar *name;
+  guint capacity;               /* bps */
+  guint capacity_after;         /* bps after half of the duration, 0 if none */
+  gdouble loss;                 /* random loss probability */
+  guint downstream_max;         /* REMB received from downstream, 0 if none */
+} ReplayScenario;
+
+typedef struct _ReplayResult
+{
+  guint n_updates;
+  guint bitrate[MAX_UPDATES];
+  GstClockTime convergence_time;
+  gdouble overshoot;
+  gdouble usecs_per_update;
+} ReplayResult;
+
+typedef struct _ReplayPacket
+{
+  GstClockTime send_time;
+  GstClockTime arrival_time;
+} ReplayPacket;
+
+static const ReplayScenario steady = {
+  "steady", 1000000, 0, 0.0, 0
+};
+
+static const ReplayScenario capacity_drop = {
+  "capacity-drop", 2000000, 500000, 0.0, 0
+};
+
+static const ReplayScenario lossy = {
+  "lossy", 1000000, 0, 0.03, 0
+};
+
+static const ReplayScenario downstream_limited = {
+  "downstream-limited", 2000000, 0, 0.0, 400000
+};
+
+static guint32
+abs_send_time (GstClockTime t)
+{
+  /* Same conversion as the one used to stamp outgoing packets */
+  return ((GST_TIME_AS_MSECONDS (t) << 18) / 1000) & 0x00ffffff;
+}
+
+static KmsRembLocal *
+replay_remb_local_new (const gchar * controller)
+{
+  KmsRembLocal *rl;
+  GstStructure *params;
+
+  rl = kms_remb_local_create (NULL, 0, 0);
+
+  params = gst_structure_new ("remb-params", "controller", G_TYPE_STRING,
+      controller, NULL);
+  kms_remb_local_set_params (rl, params);
+  gst_structure_free (params);
+
+  return rl;
+}
+
+static void
+replay_send_downstream_remb (GstPad * pad, guint bitrate)
+{
+  GstEvent *event;
+
+  event = kms_utils_remb_event_upstream_new (bitrate, DOWNSTREAM_SSRC);
+  gst_pad_send_event (pad, event);
+}
+
+static gint64
+replay_process (KmsRembLocal * rl, const KmsRembControllerInput * input,
+    guint * bitrate, gboolean * updated)
+{
+  gint64 start;
+
+  start = g_get_monotonic_time ();
+  *updated = kms_remb_local_process (rl, input, bitrate);
+
+  return g_get_monotonic_time () - start;
+}
+
+static void
+replay_compute_metrics (ReplayResult * result, guint expected,
+    guint first_update)
+{
+  guint i, peak = 0;
+
+  result->convergence_time = GST_CLOCK_TIME_NONE;
+
+  for (i = first_update; i < result->n_updates; i++) {
+    guint br = result->bitrate[i];
+
+    peak = MAX (peak, br);
+
+    if (ABS ((gdouble) br - expected) > expected * CONVERGENCE_TOLERANCE) {
+      result->convergence_time = GST_CLOCK_TIME_NONE;
+    } else if (!GST_CLOCK_TIME_IS_VALID (result->convergence_time)) {
+      result->convergence_time =
+          (i - first_update + 1) * RTCP_INTERVAL * GST_MSECOND;
+    }
+  }
+
+  result->overshoot = peak > expected ? (gdouble) (peak - expected) / expected
+      : 0.0;
+}
+
+static void
+replay_report (const gchar * name, const gchar * controller,
+    const ReplayResult * result)
+{
+  GString *trajectory = g_string_new (NULL);
+  guint i;
+
+  for (i = 0; i < result->n_updates; i++) {
+    g_string_append_printf (trajectory, " %u", result->bitrate[i] / 1000);
+  }
+
+  GST_INFO ("%s/%s trajectory (kbps):%s", name, controller, trajectory->str);
+  g_string_free (trajectory, TRUE);
+
+  if (GST_CLOCK_TIME_IS_VALID (result->convergence_time)) {
+    g_print ("%s/%s: convergence %" G_GUINT64_FORMAT " ms, overshoot %.1f%%, "
+        "%.2f us/update\n", name, controller,
+        GST_TIME_AS_MSECONDS (result->convergence_time),
+        result->overshoot * 100, result->usecs_per_update);
+  } else {
+    g_print ("%s/%s: not converged, overshoot %.1f%%, %.2f us/update\n", name,
+        controller, result->overshoot * 100, result->usecs_per_update);
+  }
+}
+
+/*
+ * Packet level model: the sender follows the last REMB, packets go through a
+ * FIFO bottleneck that drops them when the queue delay is too high and
+ * through a random loss channel.
+ */
+static void
+replay_scenario (const ReplayScenario * scenario, const gchar * controller,
+    ReplayResult * result)
+{
+  KmsRembLocal *rl;
+  KmsRembControllerInput input = { 0 };
+  GstPad *pad = NULL;
+  GQueue in_flight = G_QUEUE_INIT;
+  GRand *rand;
+  GstClockTime base = 10 * GST_SECOND, next_send, queue_free = 0;
+  GstClockTime now, last_rtcp;
+  guint send_rate = START_BITRATE, capacity = scenario->capacity;
+  guint64 bytes = 0, packets = 0, lost = 0;
+  gint64 cpu_usecs = 0;
+  guint first_update = 0;
+
+  memset (result, 0, sizeof (ReplayResult));
+
+  rand = g_rand_new_with_seed (RANDOM_SEED);
+  rl = replay_remb_local_new (controller);
+
+  if (scenario->downstream_max > 0) {
+    pad = gst_pad_new (NULL, GST_PAD_SRC);
+    gst_pad_set_active (pad, TRUE);
+    rl->event_manager = kms_utils_remb_event_manager_create (pad);
+  }
+
+  next_send = base;
+  last_rtcp = base;
+
+  for (now = base; now < base + DURATION * GST_MSECOND; now += GST_MSECOND) {
+    ReplayPacket *p;
+
+    if (scenario->capacity_after > 0 &&
+        now >= base + DURATION / 2 * GST_MSECOND) {
+      capacity = scenario->capacity_after;
+    }
+
+    while (next_send <= now) {
+      GstClockTime tx_time;
+
+      tx_time = gst_util_uint64_scale (PACKET_SIZE * 8, GST_SECOND, capacity);
+
+      if (queue_free > next_send + MAX_QUEUE_DELAY
+          || g_rand_double (rand) < scenario->loss) {
+        lost++;
+      } else {
+        p = g_slice_new (ReplayPacket);
+        queue_free = MAX (next_send, queue_free) + tx_time;
+        p->send_time = next_send;
+        p->arrival_time = queue_free + PROPAGATION_DELAY;
+        g_queue_push_tail (&in_flight, p);
+      }
+
+      next_send += gst_util_uint64_scale (PACKET_SIZE * 8, GST_SECOND,
+          send_rate);
+    }
+
+    /* The bottleneck is FIFO so packets arrive in order */
+    while ((p = g_queue_peek_head (&in_flight)) != NULL
+        && p->arrival_time <= now) {
+      g_queue_pop_head (&in_flight);
+      kms_remb_local_packet_received (rl, abs_send_time (p->send_time),
+          p->arrival_time, PACKET_SIZE);
+      bytes += PACKET_SIZE;
+      packets++;
+      g_slice_free (ReplayPacket, p);
+    }
+
+    if (now - last_rtcp < RTCP_INTERVAL * GST_MSECOND) {
+      continue;
+    }
+
+    if (pad != NULL) {
+      /* Downstream elements keep on refreshing their REMB */
+      replay_send_downstream_remb (pad, scenario->downstream_max);
+    }
+
+    if (packets + lost > 0) {
+      guint bitrate;
+      gboolean updated;
+
+      input.time = now;
+      input.bytes = bytes;
+      input.packets = packets;
+      input.bitrate =
+          gst_util_uint64_scale (bytes, 8 * GST_SECOND, now - last_rtcp);
+      input.fraction_lost = lost * 256 / (packets + lost);
+
+      cpu_usecs += replay_process (rl, &input, &bitrate, &updated);
+
+      if (updated) {
+        fail_unless (result->n_updates < MAX_UPDATES);
+        result->bitrate[result->n_updates++] = bitrate;
+        send_rate = bitrate;
+
+        if (now < base + DURATION / 2 * GST_MSECOND) {
+          first_update = result->n_updates;
+        }
+      }
+    }
+
+    bytes = packets = lost = 0;
+    last_rtcp = now;
+  }
+
+  if (result->n_updates > 0) {
+    result->usecs_per_update = (gdouble) cpu_usecs / result->n_updates;
+  }
+
+  if (scenario->capacity_after == 0) {
+    first_update = 0;
+  }
+
+  replay_compute_metrics (result,
+      scenario->downstream_max > 0 ? MIN (scenario->downstream_max, capacity) :
+      capacity, first_update);
+  replay_report (scenario->name, controller, result);
+
+  while (!g_queue_is_empty (&in_flight)) {
+    g_slice_free (ReplayPacket, g_queue_pop_head (&in_flight));
+  }
+
+  kms_remb_local_destroy (rl);
+  if (pad != NULL) {
+    g_object_unref (pad);
+  }
+  g_rand_free (rand);
+}
+
+static void
+check_scenario (const ReplayScenario * scenario, const gchar * controller)
+{
+  ReplayResult first, second;
+  guint i;
+
+  replay_scenario (scenario, controller, &first);
+  replay_scenario (scenario, controller, &second);
+
+  fail_unless (first.n_updates > 0);
+
+  /* Replays must be deterministic */
+  fail_unless (first.n_updates == second.n_updates);
+  for (i = 0; i < first.n_updates; i++) {
+    fail_unless (first.bitrate[i] == second.bitrate[i]);
+  }
+
+  for (i = 0; i < first.n_updates; i++) {
+    if (scenario->downstream_max > 0) {
+      fail_unless (first.bitrate[i] <= scenario->downstream_max,
+          "REMB %u over downstream max %u", first.bitrate[i],
+          scenario->downstream_max);
+    }
+  }
+
+  if (scenario->capacity_after > 0) {
+    fail_unless (first.bitrate[first.n_updates - 1] < scenario->capacity,
+        "REMB %u not adapted to the new capacity",
+        first.bitrate[first.n_updates - 1]);
+  }
+}
+
+GST_START_TEST (check_default_controller)
+{
+  check_scenario (&steady, KMS_REMB_CONTROLLER_DEFAULT);
+  check_scenario (&capacity_drop, KMS_REMB_CONTROLLER_DEFAULT);
+  check_scenario (&lossy, KMS_REMB_CONTROLLER_DEFAULT);
+  check_scenario (&downstream_limited, KMS_REMB_CONTROLLER_DEFAULT);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_delay_based_controller)
+{
+  check_scenario (&steady, KMS_REMB_CONTROLLER_DELAY_BASED);
+  check_scenario (&capacity_drop, KMS_REMB_CONTROLLER_DELAY_BASED);
+  check_scenario (&lossy, KMS_REMB_CONTROLLER_DELAY_BASED);
+  check_scenario (&downstream_limited, KMS_REMB_CONTROLLER_DELAY_BASED);
+}
+
+GST_END_TEST;
+
+static void
+replay_trace (const gchar * path, const gchar * controller)
+{
+  KmsRembLocal *rl;
+  ReplayResult result;
+  gint64 cpu_usecs = 0;
+  gchar line[256];
+  FILE *f;
+
+  f = fopen (path, "r");
+  fail_unless (f != NULL, "Cannot open %s", path);
+
+  memset (&result, 0, sizeof (ReplayResult));
+  rl = replay_remb_local_new (controller);
+
+  while (fgets (line, sizeof (line), f) != NULL &&
+      result.n_updates < MAX_UPDATES) {
+    KmsRembControllerInput input;
+    guint64 time_ms;
+    guint bitrate;
+    gboolean updated;
+
+    if (sscanf (line, "%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%"
+            G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%u", &time_ms,
+            &input.bitrate, &input.bytes, &input.packets,
+            &input.fraction_lost) != 5) {
+      continue;
+    }
+
+    input.time = time_ms * GST_MSECOND;
+    cpu_usecs += replay_process (rl, &input, &bitrate, &updated);
+
+    if (updated) {
+      result.bitrate[result.n_updates++] = bitrate;
+    }
+  }
+
+  fclose (f);
+
+  if (result.n_updates > 0) {
+    result.usecs_per_update = (gdouble) cpu_usecs / result.n_updates;
+    replay_compute_metrics (&result, result.bitrate[result.n_updates - 1], 0);
+  }
+
+  replay_report (path, controller, &result);
+
+  kms_remb_local_destroy (rl);
+}
+
+GST_START_TEST (check_recorded_trace)
+{
+  const gchar *path = g_getenv (REPLAY_TRACE_ENV);
+
+  if (path == NULL) {
+    GST_INFO ("No recorded trace, set " REPLAY_TRACE_ENV " to replay one");
+    return;
+  }
+
+  replay_trace (path, KMS_REMB_CONTROLLER_DEFAULT);
+  replay_trace (path, KMS_REMB_CONTROLLER_DELAY_BASED);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+rembreplay_suite (void)
+{
+  Suite *s = suite_create ("rembreplay");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_default_controller);
+  tcase_add_test (tc_chain, check_delay_based_controller);
+  tcase_add_test (tc_chain, check_recorded_trace);
+
+  return s;
+}
+
+GST_CHECK_MAIN (rembreplay);
@@ -0,0 +1,192 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmstranscoderregistry.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+static GMutex released_mutex;
+static GCond released_cond;
+static GstPad *released_pad;
+
+static void
+released_cb (GstPad * pad)
+{
+  g_mutex_lock (&released_mutex);
+  released_pad = pad;
+  g_cond_signal (&released_cond);
+  g_mutex_unlock (&released_mutex);
+}
+
+GST_START_TEST (check_registry_scope)
+{
+  GstElement *pipeline, *other, *a, *b;
+  KmsTranscoderRegistry *reg_a, *reg_b, *reg_other;
+
+  pipeline = gst_pipeline_new (NULL);
+  other = gst_pipeline_new (NULL);
+  a = gst_element_factory_make ("fakesink", NULL);
+  b = gst_element_factory_make ("fakesink", NULL);
+
+  /* Not in a pipeline */
+  fail_unless (kms_transcoder_registry_get (a) == NULL);
+
+  gst_bin_add (GST_BIN (pipeline), a);
+  gst_bin_add (GST_BIN (other), b);
+
+  reg_a = kms_transcoder_registry_get (a);
+  reg_b = kms_transcoder_registry_get (b);
+  reg_other = kms_transcoder_registry_get (other);
+
+  fail_unless (reg_a != NULL);
+  fail_unless (reg_a != reg_b);
+  fail_unless (reg_b == reg_other);
+
+  kms_transcoder_registry_unref (reg_a);
+  kms_transcoder_registry_unref (reg_b);
+  kms_transcoder_registry_unref (reg_other);
+
+  g_object_unref (pipeline);
+  g_object_unref (other);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_lookup)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  KmsTranscoderRegistry *reg;
+  GstBuffer *buffer, *forwarded, *modified;
+  guint upstream, downstream, filtered;
+
+  reg = kms_transcoder_registry_get (pipeline);
+  upstream = kms_transcoder_registry_new_stream (reg);
+  downstream = kms_transcoder_registry_new_stream (reg);
+  filtered = kms_transcoder_registry_new_stream (reg);
+
+  buffer = gst_buffer_new_allocate (NULL, 1000, NULL);
+  fail_unless (kms_transcoder_registry_lookup (reg, upstream,
+          buffer) == upstream);
+  kms_transcoder_registry_sample (reg, upstream, buffer);
+
+  /* Forwarding elements share the memory, even partially */
+  forwarded = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, 10, 500);
+  fail_unless (kms_transcoder_registry_lookup (reg, downstream,
+          forwarded) == upstream);
+
+  /* Memory already sampled keeps identifying the first stream */
+  kms_transcoder_registry_sample (reg, downstream, forwarded);
+  fail_unless (kms_transcoder_registry_lookup (reg, filtered,
+          forwarded) == upstream);
+
+  /* Modified media is a different stream */
+  modified = gst_buffer_copy_deep (buffer);
+  fail_unless (kms_transcoder_registry_lookup (reg, filtered,
+          modified) == filtered);
+
+  /* Removed streams are not matched any more */
+  kms_transcoder_registry_remove_stream (reg, upstream);
+  fail_unless (kms_transcoder_registry_lookup (reg, downstream,
+          forwarded) == downstream);
+
+  gst_buffer_unref (buffer);
+  gst_buffer_unref (forwarded);
+  gst_buffer_unref (modified);
+
+  kms_transcoder_registry_unref (reg);
+  g_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_share_encoder)
+{
+  GstElement *pipeline = gst_pipeline_new (NULL);
+  GstElement *owner = gst_bin_new (NULL), *subscriber = gst_bin_new (NULL);
+  GstElement *tee = gst_element_factory_make ("tee", NULL), *shared;
+  KmsTranscoderRegistry *reg;
+  GstCaps *h264, *vp8;
+  GstPad *pad;
+  guint stream;
+
+  gst_bin_add (GST_BIN (owner), tee);
+  gst_bin_add_many (GST_BIN (pipeline), owner, subscriber, NULL);
+
+  reg = kms_transcoder_registry_get (pipeline);
+  stream = kms_transcoder_registry_new_stream (reg);
+  h264 = gst_caps_from_string ("video/x-h264");
+  vp8 = gst_caps_from_string ("video/x-vp8");
+  pad = gst_pad_new ("src", GST_PAD_SRC);
+
+  kms_transcoder_registry_publish (reg, stream, h264, "0-100", tee);
+
+  fail_unless (kms_transcoder_registry_contains (reg, stream, h264, "0-100",
+          NULL));
+  fail_if (kms_transcoder_registry_contains (reg, stream, vp8, "0-100",
+          NULL));
+  fail_if (kms_transcoder_registry_contains (reg, stream, h264, "0-200",
+          NULL));
+  fail_if (kms_transcoder_registry_contains (reg, stream + 1, h264, "0-100",
+          NULL));
+
+  /* Owners do not subscribe to their own encoders */
+  fail_unless (kms_transcoder_registry_subscribe (reg, stream, h264, "0-100",
+          owner, pad, released_cb) == NULL);
+
+  shared = kms_transcoder_registry_subscribe (reg, stream, h264, "0-100",
+      subscriber, pad, released_cb);
+  fail_unless (shared == tee);
+  g_object_unref (shared);
+
+  g_mutex_lock (&released_mutex);
+  kms_transcoder_registry_withdraw (reg, tee);
+  while (released_pad == NULL) {
+    g_cond_wait (&released_cond, &released_mutex);
+  }
+  fail_unless (released_pad == pad);
+  g_mutex_unlock (&released_mutex);
+
+  fail_if (kms_transcoder_registry_contains (reg, stream, h264, "0-100",
+          NULL));
+
+  gst_caps_unref (h264);
+  gst_caps_unref (vp8);
+  g_object_unref (pad);
+
+  kms_transcoder_registry_unref (reg);
+  g_object_unref (pipeline);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+transcoderregistry_suite (void)
+{
+  Suite *s = suite_create ("transcoderregistry");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_registry_scope);
+  tcase_add_test (tc_chain, check_lookup);
+  tcase_add_test (tc_chain, check_share_encoder);
+
+  return s;
+}
+
+GST_CHECK_MAIN (transcoderregistry);
@@ -0,0 +1,211 @@
+/*
+ * (C) Copyright 2016 Kurento (http://kurento.org/)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "kmstwcc.h"
+
+#include <gst/check/gstcheck.h>
+#include <glib.h>
+
+#define PACKET_SIZE 1200        /* bytes */
+#define PACKET_INTERVAL 10      /* ms */
+#define FEEDBACK_INTERVAL 100   /* ms */
+#define NETWORK_DELAY (20 * GST_MSECOND)
+
+static void
+marshall_and_parse (KmsRTCPTWCCPacket * in, KmsRTCPTWCCPacket * out)
+{
+  GstBuffer *rtcp_buffer, *fci;
+  GstRTCPBuffer rtcp = GST_RTCP_BUFFER_INIT;
+  GstRTCPPacket packet;
+  guint len;
+
+  rtcp_buffer = gst_rtcp_buffer_new (1400);
+  fail_unless (gst_rtcp_buffer_map (rtcp_buffer, GST_MAP_READWRITE, &rtcp));
+  fail_unless (gst_rtcp_buffer_add_packet (&rtcp, GST_RTCP_TYPE_RTPFB,
+          &packet));
+  fail_unless (kms_rtcp_rtpfb_twcc_marshall_packet (&packet, in, 1, 2));
+  fail_unless (gst_rtcp_packet_fb_get_type (&packet) ==
+      KMS_RTCP_RTPFB_TYPE_TWCC);
+  fail_unless (gst_rtcp_packet_fb_get_sender_ssrc (&packet) == 1);
+  fail_unless (gst_rtcp_packet_fb_get_media_ssrc (&packet) == 2);
+
+  len = gst_rtcp_packet_fb_get_fci_length (&packet) * 4;
+  fci = gst_buffer_new_allocate (NULL, len, NULL);
+  gst_buffer_fill (fci, 0, gst_rtcp_packet_fb_get_fci (&packet), len);
+  gst_rtcp_buffer_unmap (&rtcp);
+
+  fail_unless (kms_rtcp_rtpfb_twcc_get_packet (fci, out));
+
+  gst_buffer_unref (fci);
+  gst_buffer_unref (rtcp_buffer);
+}
+
+GST_START_TEST (check_feedback_roundtrip)
+{
+  KmsTwccRecorder *rec;
+  KmsRTCPTWCCPacket packet, parsed;
+  GstClockTime base = 10 * GST_SECOND;
+  guint i;
+
+  rec = kms_twcc_recorder_new ();
+
+  /* Wraps around, 65533 and 0 are lost and 4 arrives 100 ms late */
+  for (i = 0; i < 16; i++) {
+    guint16 seq = 65530 + i;
+    GstClockTime arrival = base + i * 5 * GST_MSECOND;
+
+    if (seq == 65533 || seq == 0) {
+      continue;
+    }
+
+    if (i == 10) {
+      arrival += 100 * GST_MSECOND;
+    }
+
+    kms_twcc_recorder_add (rec, seq, arrival);
+  }
+
+  fail_unless (kms_twcc_recorder_build_feedback (rec, &packet,
+          KMS_RTCP_TWCC_MAX_PACKETS));
+  fail_unless (packet.base_seq == 65530);
+  fail_unless (packet.packet_count == 16);
+  fail_unless (packet.fb_pkt_count == 0);
+  fail_unless (packet.received[0]);
+  fail_if (packet.received[3]);
+  fail_if (packet.received[6]);
+  fail_unless (packet.deltas[10] > G_MAXUINT8);
+  fail_unless (packet.deltas[11] < 0);
+
+  marshall_and_parse (&packet, &parsed);
+
+  fail_unless (parsed.base_seq == packet.base_seq);
+  fail_unless (parsed.packet_count == packet.packet_count);
+  fail_unless (parsed.reference_time == packet.reference_time);
+  fail_unless (parsed.fb_pkt_count == packet.fb_pkt_count);
+
+  for (i = 0; i < packet.packet_count; i++) {
+    fail_unless (parsed.received[i] == packet.received[i]);
+    fail_unless (parsed.deltas[i] == packet.deltas[i]);
+  }
+
+  /* Everything has already been reported */
+  fail_if (kms_twcc_recorder_build_feedback (rec, &packet,
+          KMS_RTCP_TWCC_MAX_PACKETS));
+
+  /* Already reported packets are ignored */
+  kms_twcc_recorder_add (rec, 65533, base);
+  fail_if (kms_twcc_recorder_build_feedback (rec, &packet,
+          KMS_RTCP_TWCC_MAX_PACKETS));
+
+  kms_twcc_recorder_add (rec, 10, base + 100 * GST_MSECOND);
+  fail_unless (kms_twcc_recorder_build_feedback (rec, &packet,
+          KMS_RTCP_TWCC_MAX_PACKETS));
+  fail_unless (packet.base_seq == 10);
+  fail_unless (packet.packet_count == 1);
+  fail_unless (packet.fb_pkt_count == 1);
+
+  kms_twcc_recorder_destroy (rec);
+}
+
+GST_END_TEST;
+
+/* Sends at a constant rate through a bottleneck of @capacity bps */
+static guint
+simulate (guint start_bitrate, guint capacity, guint duration_ms)
+{
+  KmsTwccRecorder *rec;
+  KmsTwccEstimator *est;
+  KmsRTCPTWCCPacket packet, parsed;
+  GstClockTime base = 10 * GST_SECOND, queue_free = 0, tx_time;
+  guint target = start_bitrate;
+  guint16 seq = 0;
+  guint t;
+
+  rec = kms_twcc_recorder_new ();
+  est = kms_twcc_estimator_new (start_bitrate, 30000, 5000000);
+  tx_time = gst_util_uint64_scale (PACKET_SIZE * 8, GST_SECOND, capacity);
+
+  for (t = 0; t < duration_ms; t += PACKET_INTERVAL) {
+    GstClockTime send_time = base + t * GST_MSECOND;
+
+    queue_free = MAX (send_time, queue_free) + tx_time;
+
+    kms_twcc_estimator_packet_sent (est, seq, PACKET_SIZE, send_time);
+    kms_twcc_recorder_add (rec, seq, queue_free + NETWORK_DELAY);
+    seq++;
+
+    if ((t + PACKET_INTERVAL) % FEEDBACK_INTERVAL != 0) {
+      continue;
+    }
+
+    while (kms_twcc_recorder_build_feedback (rec, &packet, 128)) {
+      marshall_and_parse (&packet, &parsed);
+      fail_unless (kms_twcc_estimator_on_feedback (est, &parsed, send_time,
+              &target));
+    }
+  }
+
+  fail_unless (target == kms_twcc_estimator_get_target_bitrate (est));
+
+  kms_twcc_estimator_destroy (est);
+  kms_twcc_recorder_destroy (rec);
+
+  return target;
+}
+
+GST_START_TEST (check_estimator_overuse)
+{
+  guint target;
+
+  /* Sending 960 kbps through a 500 kbps link */
+  target = simulate (1000000, 500000, 3000);
+  GST_DEBUG ("Target bitrate on overuse: %u", target);
+
+  fail_unless (target < 500000);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (check_estimator_increase)
+{
+  guint target;
+
+  /* Sending 960 kbps through a 10 Mbps link */
+  target = simulate (300000, 10000000, 5000);
+  GST_DEBUG ("Target bitrate without congestion: %u", target);
+
+  fail_unless (target > 300000);
+}
+
+GST_END_TEST;
+
+/* Suite initialization */
+static Suite *
+twcc_suite (void)
+{
+  Suite *s = suite_create ("twcc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, check_feedback_roundtrip);
+  tcase_add_test (tc_chain, check_estimator_overuse);
+  tcase_add_test (tc_chain, check_estimator_increase);
+
+  return s;
+}
+
+GST_CHECK_MAIN (twcc);
@@ -242,6 +242,77 @@ GST_START_TEST (check_kms_utils_set_pad_query_function_full)
 
 GST_END_TEST;
 
+#define MS(t) ((t) * GST_MSECOND)
+
+static gboolean
+send_delta_frames (KeyFrameCoalescer * c, guint from, guint to, guint * flush)
+{
+  gboolean flushed = FALSE;
+  guint t;
+
+  for (t = from; t < to; t += 33) {
+    if (kms_utils_key_frame_coalescer_frame (c, FALSE, 1000, MS (t))) {
+      fail_if (flushed);
+      flushed = TRUE;
+      *flush = t;
+    }
+  }
+
+  return flushed;
+}
+
+GST_START_TEST (check_key_frame_coalescer)
+{
+  KeyFrameCoalescer *c = kms_utils_key_frame_coalescer_new ();
+  GstStructure *stats;
+  guint64 v;
+  guint i, flush;
+
+  /* Not tracking keyframes: fixed dispersion */
+  fail_unless (kms_utils_key_frame_coalescer_request (c, MS (0)));
+  fail_if (kms_utils_key_frame_coalescer_request (c, MS (500)));
+  fail_unless (kms_utils_key_frame_coalescer_request (c, MS (1000)));
+
+  kms_utils_key_frame_coalescer_reset (c, TRUE);
+
+  /* Concurrent requests are merged until the keyframe arrives */
+  fail_unless (kms_utils_key_frame_coalescer_request (c, MS (2000)));
+  for (i = 0; i < 199; i++) {
+    fail_if (kms_utils_key_frame_coalescer_request (c, MS (2010)));
+  }
+  fail_if (kms_utils_key_frame_coalescer_frame (c, TRUE, 30000, MS (2100)));
+
+  /* Natural keyframes every 3 seconds, 30 times bigger than delta frames */
+  fail_if (send_delta_frames (c, 2133, 5100, &flush));
+  fail_if (kms_utils_key_frame_coalescer_frame (c, TRUE, 30000, MS (5100)));
+
+  /* A natural keyframe is coming, the request waits for it */
+  fail_if (send_delta_frames (c, 5133, 5500, &flush));
+  fail_if (kms_utils_key_frame_coalescer_request (c, MS (5500)));
+  fail_if (send_delta_frames (c, 5533, 8100, &flush));
+  fail_if (kms_utils_key_frame_coalescer_frame (c, TRUE, 30000, MS (8100)));
+
+  stats = kms_utils_key_frame_coalescer_get_stats (c);
+  fail_unless (gst_structure_get_uint64 (stats, "forwarded", &v));
+  fail_unless (v == 3);
+  fail_unless (gst_structure_get_uint64 (stats, "suppressed", &v));
+  fail_unless (v == 201);
+  fail_unless (gst_structure_get_uint64 (stats, "gop", &v));
+  fail_unless (v == 3 * GST_SECOND);
+  fail_unless (gst_structure_get_uint64 (stats, "dispersion", &v));
+  fail_unless (v == 3 * GST_SECOND);
+  gst_structure_free (stats);
+
+  /* The natural keyframe does not come, the request is sent by itself */
+  fail_if (kms_utils_key_frame_coalescer_request (c, MS (8200)));
+  fail_unless (send_delta_frames (c, 8133, 12000, &flush));
+  fail_unless (flush >= 11300);
+
+  kms_utils_key_frame_coalescer_destroy (c);
+}
+
+GST_END_TEST;
+
 /* Suite initialization */
 static Suite *
 utils_suite (void)
@@ -256,6 +327,7 @@ utils_suite (void)
   tcase_add_test (tc_chain, check_kms_utils_set_pad_event_function_full);
 
   tcase_add_test (tc_chain, check_kms_utils_set_pad_query_function_full);
+  tcase_add_test (tc_chain, check_key_frame_coalescer);
 
   return s;
 }